@@ -0,0 +1,92 @@
+// Interpreter against GCC on the README sieve.
+//
+// Writes the sieve from the README with a growing limit and times the two
+// ways of running it end to end: `SILC --interp`, and compiling with SILC and
+// GCC and then running the executable. The interpreter has no GCC to wait
+// for, so it wins on small programs; the table shows where the compiled code
+// catches up. Pass the path of the SILC binary, ./SILC by default.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define REPEATS 3
+
+static const long limits[] = {100, 10000, 100000, 400000};
+
+static double now_seconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void write_sieve(const char* path, const long limit) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Could not write %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(file,
+            "let limit = %ld;\n"
+            "let n = 2;\n"
+            "out \"Prime numbers up to %ld:\\n\";\n"
+            "while n <= limit\n"
+            "{\n"
+            "    let is_prime = 1;\n"
+            "    let i = 2;\n"
+            "    while i * i <= n\n"
+            "    {\n"
+            "        if n %% i == 0\n"
+            "        {\n"
+            "            is_prime = 0;\n"
+            "            brk;\n"
+            "        }\n"
+            "        i = i + 1;\n"
+            "    }\n"
+            "    if is_prime == 1\n"
+            "    {\n"
+            "        out n;\n"
+            "    }\n"
+            "    n = n + 1;\n"
+            "}\n"
+            "ret 0;\n", limit, limit);
+    fclose(file);
+}
+
+// Best wall time of a shell command over REPEATS runs
+static double time_command(const char* command) {
+    double best = 0.0;
+    for (int run = 0; run < REPEATS; run++) {
+        const double start = now_seconds();
+        if (system(command) != 0) {
+            fprintf(stderr, "Error: Command failed: %s\n", command);
+            exit(EXIT_FAILURE);
+        }
+        const double elapsed = now_seconds() - start;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(const int argc, const char** argv) {
+    const char* silc = argc > 1 ? argv[1] : "./SILC";
+    const char* source = "interp_bench.slc";
+    char command[512];
+
+    printf("%8s %12s %12s %12s %12s\n", "limit", "interp", "gcc compile", "gcc run", "gcc total");
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        write_sieve(source, limits[i]);
+
+        snprintf(command, sizeof(command), "%s --interp %s > /dev/null", silc, source);
+        const double interp = time_command(command);
+        snprintf(command, sizeof(command), "%s %s interp_bench.exe > /dev/null", silc, source);
+        const double compile = time_command(command);
+        const double run = time_command("./interp_bench.exe > /dev/null");
+
+        printf("%8ld %10.1f ms %10.1f ms %10.1f ms %10.1f ms\n", limits[i], interp * 1e3, compile * 1e3,
+               run * 1e3, (compile + run) * 1e3);
+    }
+    remove(source);
+    remove("interp_bench.exe");
+    return 0;
+}
@@ -0,0 +1,147 @@
+// Microbenchmark for identifier-heavy lexing.
+//
+// Builds synthetic sources in memory and reports the time per word, first for
+// growing source sizes and then per word class. Keyword classification is a
+// single perfect-hash probe, so every row should land at about the same cost
+// per word no matter how large the source is or which word it holds. A last
+// section compares the scanner instruction sets on indented, string-heavy code.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lexer.h"
+#include "scan.h"
+#include "intern.h"
+
+#define REPEATS 5
+
+static const char* mixed_words[] = {
+    "x", "count", "letter", "returned", "whilex", "interval", "brk2", "constant",
+    "synchronizedx", "a_very_long_identifier_name_42", "tmp", "i", "j", "index",
+    "let", "while", "out", "if",
+};
+
+typedef struct {
+    const char* name;
+    const char* words[4];
+} WordClass;
+
+static const WordClass word_classes[] = {
+    {"short identifiers", {"x", "i", "n", "k"}},
+    {"keyword prefixes", {"letter", "whilex", "returned", "outer"}},
+    {"long identifiers", {"a_very_long_identifier_name_42", "another_long_name", "synchronizedx", "total_count"}},
+    {"keywords", {"let", "while", "out", "brk"}},
+};
+
+static double now_seconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Fill a buffer with count words drawn round-robin from words, one statement-like run per line.
+static char* build_source(const char* const* words, const int word_count, const long count, size_t* length) {
+    size_t capacity = 0;
+    for (int i = 0; i < word_count; i++) {
+        capacity += strlen(words[i]) + 3;
+    }
+    capacity = capacity * (size_t)(count / word_count + 1) + 1;
+
+    char* buffer = malloc(capacity);
+    if (buffer == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+
+    size_t used = 0;
+    for (long i = 0; i < count; i++) {
+        const char* word = words[i % word_count];
+        const size_t word_length = strlen(word);
+        memcpy(buffer + used, word, word_length);
+        used += word_length;
+        buffer[used++] = (i % 8 == 7) ? '\n' : ' ';
+    }
+    buffer[used] = '\0';
+    *length = used;
+    return buffer;
+}
+
+// Lex the whole buffer and return the best time per word over REPEATS runs
+static double time_per_word(const char* buffer, const size_t length, const long count) {
+    double best = 0.0;
+    for (int run = 0; run < REPEATS; run++) {
+        // Identifier names are views into buffer, so every run interns from scratch
+        Arena arena;
+        arena_init(&arena);
+        intern_init(&arena);
+        lexer_init_buffer(buffer, length);
+        long words = 0;
+        const double start = now_seconds();
+        for (Token token = lexer_next_token(); token.type != TOKEN_EOF; token = lexer_next_token()) {
+            words++;
+        }
+        const double elapsed = now_seconds() - start;
+        intern_cleanup();
+        arena_release(&arena);
+        if (words != count) {
+            fprintf(stderr, "Error: lexed %ld words, expected %ld\n", words, count);
+            exit(EXIT_FAILURE);
+        }
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best * 1e9 / (double)count;
+}
+
+// Deeply indented out statements with long string literals, the shape of generated sources
+static char* build_indented_source(const long lines, size_t* length) {
+    const char* line = "                        out \"a string literal long enough to span a few vectors\";\n";
+    const size_t line_length = strlen(line);
+    char* buffer = malloc(line_length * (size_t)lines + 1);
+    if (buffer == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    for (long i = 0; i < lines; i++) {
+        memcpy(buffer + line_length * (size_t)i, line, line_length);
+    }
+    *length = line_length * (size_t)lines;
+    buffer[*length] = '\0';
+    return buffer;
+}
+
+int main() {
+    const int mixed_count = (int)(sizeof(mixed_words) / sizeof(mixed_words[0]));
+    const long sizes[] = {10000, 100000, 1000000, 10000000};
+
+    printf("%-24s %12s %12s\n", "source", "words", "ns/word");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t length;
+        char* buffer = build_source(mixed_words, mixed_count, sizes[i], &length);
+        printf("%-24s %12ld %12.2f\n", "mixed", sizes[i], time_per_word(buffer, length, sizes[i]));
+        free(buffer);
+    }
+
+    printf("\n");
+    for (size_t i = 0; i < sizeof(word_classes) / sizeof(word_classes[0]); i++) {
+        const long count = 1000000;
+        size_t length;
+        char* buffer = build_source(word_classes[i].words, 4, count, &length);
+        printf("%-24s %12ld %12.2f\n", word_classes[i].name, count, time_per_word(buffer, length, count));
+        free(buffer);
+    }
+
+    printf("\n%-24s %12s %12s\n", "scanner", "bytes", "MB/s");
+    const ScanLevel best = scan_level();
+    size_t length;
+    char* buffer = build_indented_source(200000, &length);
+    for (ScanLevel level = SCAN_SCALAR; level <= best; level++) {
+        scan_set_level(level);
+        const double ns_per_token = time_per_word(buffer, length, 200000 * 3);
+        const double seconds = ns_per_token * 200000 * 3 * 1e-9;
+        printf("%-24s %12zu %12.0f\n", scan_level_to_string(level), length, (double)length / seconds / 1e6);
+    }
+    free(buffer);
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Scaling benchmark for semantic analysis.
+//
+// Builds programs with a growing number of declarations, first flat in the
+// global scope and then one per level of nested if blocks that all shadow the
+// same name. Lookup, declaration and scope push/pop are constant time, so the
+// time per declaration should stay flat as the programs grow. The benchmark
+// fits a line to log time per declaration against log declarations and fails
+// when its slope passes MAX_SLOPE: a quadratic scope walk has slope 1, while
+// cache misses on the larger programs only add a small step.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "intern.h"
+
+#define REPEATS 5
+#define MAX_SLOPE 0.3
+
+static double now_seconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static char* allocate(const size_t size) {
+    char* buffer = malloc(size);
+    if (buffer == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    return buffer;
+}
+
+// count global declarations, each reading the one before it
+static char* build_flat_source(const long count, size_t* length) {
+    char* buffer = allocate((size_t)count * 48 + 64);
+    size_t used = (size_t)sprintf(buffer, "let v0 = 0;\n");
+    for (long i = 1; i < count; i++) {
+        used += (size_t)sprintf(buffer + used, "let v%ld = v%ld + 1;\n", i, i - 1);
+    }
+    *length = used;
+    return buffer;
+}
+
+// count nested if blocks, each shadowing x and reading the outer x
+static char* build_nested_source(const long count, size_t* length) {
+    char* buffer = allocate((size_t)count * 40 + 64);
+    size_t used = (size_t)sprintf(buffer, "let x = 0;\n");
+    for (long i = 0; i < count; i++) {
+        used += (size_t)sprintf(buffer + used, "if x < 1 { let y = x; let x = y + 1;\n");
+    }
+    for (long i = 0; i < count; i++) {
+        buffer[used++] = '}';
+    }
+    buffer[used] = '\0';
+    *length = used;
+    return buffer;
+}
+
+// Parse the buffer and return the best analysis time per declaration over REPEATS runs
+static double time_per_declaration(const char* buffer, const size_t length, const long declarations) {
+    double best = 0.0;
+    for (int run = 0; run < REPEATS; run++) {
+        Arena arena;
+        arena_init(&arena);
+        intern_init(&arena);
+        lexer_init_buffer(buffer, length);
+        const TokenStream tokens = lexer_tokenize(&arena);
+        parser_init(&tokens, &arena);
+        Program program = parser_parse();
+        semantic_init(&arena);
+
+        const double start = now_seconds();
+        const SemanticResult result = semantic_analyze(&program);
+        const double elapsed = now_seconds() - start;
+
+        semantic_cleanup();
+        parser_cleanup();
+        intern_cleanup();
+        arena_release(&arena);
+        if (result != SEMANTIC_OK) {
+            fprintf(stderr, "Error: semantic analysis failed\n");
+            exit(EXIT_FAILURE);
+        }
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best * 1e9 / (double)declarations;
+}
+
+// Time each size and check that the cost per declaration does not grow with it
+static bool run_series(const char* name, char* (*build)(long, size_t*), const long* sizes, const int size_count,
+                       const int declarations_per_unit) {
+    // Least squares over the log-log points
+    double sum_x = 0.0;
+    double sum_y = 0.0;
+    double sum_xx = 0.0;
+    double sum_xy = 0.0;
+    for (int i = 0; i < size_count; i++) {
+        size_t length;
+        char* buffer = build(sizes[i], &length);
+        const long declarations = sizes[i] * declarations_per_unit;
+        const double cost = time_per_declaration(buffer, length, declarations);
+        printf("%-24s %12ld %12.2f\n", name, declarations, cost);
+        free(buffer);
+
+        const double x = log((double)declarations);
+        const double y = log(cost);
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+    }
+    const double slope = (size_count * sum_xy - sum_x * sum_y) / (size_count * sum_xx - sum_x * sum_x);
+    printf("%-24s %12s %12.2f\n", name, "slope", slope);
+    if (slope > MAX_SLOPE) {
+        fprintf(stderr, "Error: %s cost per declaration grows as declarations^%.2f\n", name, slope);
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    const long flat_sizes[] = {1000, 4000, 16000, 64000, 256000};
+    const long nested_sizes[] = {100, 400, 1600, 6400};
+
+    printf("%-24s %12s %12s\n", "program", "declarations", "ns/decl");
+    bool ok = run_series("flat", build_flat_source, flat_sizes, 5, 1);
+    ok = run_series("nested", build_nested_source, nested_sizes, 4, 2) && ok;
+
+    return ok ? 0 : EXIT_FAILURE;
+}
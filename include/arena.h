@@ -0,0 +1,34 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator owned by a compilation. The lexer, parser and semantic
+// analyzer allocate from it and nothing is freed individually: the whole
+// front end is torn down with a single arena_release().
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+    ArenaChunk* chunks;
+    size_t allocations;  // Number of allocations served
+    size_t bytes;        // Bytes handed out
+    size_t reserved;     // Bytes obtained from the system
+} Arena;
+
+// Initialize an empty arena
+void arena_init(Arena* arena);
+
+// Allocate size bytes aligned for any type
+void* arena_alloc(Arena* arena, size_t size);
+
+// Allocate size zeroed bytes
+void* arena_alloc_zeroed(Arena* arena, size_t size);
+
+// Resize a block to new_size, in place when it is the latest allocation
+void* arena_grow(Arena* arena, void* block, size_t old_size, size_t new_size);
+
+// Free every chunk of the arena
+void arena_release(Arena* arena);
+
+#endif // ARENA_H
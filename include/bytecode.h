@@ -0,0 +1,106 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ir.h"
+
+// Register bytecode for the interpreter. An instruction is an opcode word and
+// its operands, all int32_t: registers, string slots, offsets into the text,
+// 32-bit immediates and jump targets as word offsets into the code. Every
+// value of the IR gets a register of its own, and constants are registers
+// that start out holding them. Opcodes are specialised by operand type: _I
+// for int64_t, _D for double, _K for an immediate right operand. The string
+// builtins work on views, which point into a string slot or the text. Array
+// elements are register values, so one opcode serves either element type; a
+// _CHECKED access carries the source line for its error. Map opcodes take a
+// number key in a register (_D) or a string key as a view (_S).
+
+// Opcode and operand words, including the opcode
+#define BYTECODE_OPS(OP) \
+    OP(MOV, 3)          /* d = a */ \
+    OP(ADD_I, 4) OP(SUB_I, 4) OP(MUL_I, 4) OP(MOD_I, 4) \
+    OP(AND_I, 4) OP(OR_I, 4) OP(XOR_I, 4) OP(SHL_I, 4) OP(SHR_I, 4) \
+    OP(ADD_IK, 4)       /* d = a + k */ \
+    OP(ADD_D, 4) OP(SUB_D, 4) OP(MUL_D, 4) OP(DIV_D, 4) \
+    OP(NEG_I, 3) OP(BITNOT_I, 3) OP(NOT_I, 3) OP(NEG_D, 3) OP(NOT_D, 3) \
+    OP(EQ_I, 4) OP(NE_I, 4) OP(LT_I, 4) OP(GT_I, 4) OP(LE_I, 4) OP(GE_I, 4) \
+    OP(EQ_D, 4) OP(NE_D, 4) OP(LT_D, 4) OP(GT_D, 4) OP(LE_D, 4) OP(GE_D, 4) \
+    OP(TO_D, 3) OP(TO_I, 3) \
+    OP(IN_D, 3)         /* d = a, then read a double into d */ \
+    OP(OUT_I, 2) OP(OUT_D, 2) \
+    OP(IN_S, 2)         /* Read a word into slot */ \
+    OP(OUT_S, 2)        /* Print slot */ \
+    OP(OUT_TEXT, 2)     /* Print the text at offset */ \
+    OP(SET_S, 3)        /* Copy slot b into slot a */ \
+    OP(SET_TEXT, 4)     /* Copy c bytes of text at offset b into slot a */ \
+    OP(APPEND_S, 3)     /* Append slot b to slot a */ \
+    OP(APPEND_TEXT, 4)  /* Append c bytes of text at offset b to slot a */ \
+    OP(MOVE_S, 3)       /* Swap slots a and b, when b is not read again */ \
+    OP(VIEW_S, 3)       /* View a = slot b */ \
+    OP(VIEW_TEXT, 4)    /* View a = c bytes of text at offset b */ \
+    OP(SLICE, 5)        /* View a = slice(view b, c, d) */ \
+    OP(SPLIT, 5)        /* View a = split(view b, view c, d) */ \
+    OP(LEN, 3)          /* d = bytes in view a */ \
+    OP(FIND, 5)         /* d = find(view a, view b, c) */ \
+    OP(CMP, 4)          /* d = compare(view a, view b) */ \
+    OP(EQ_S, 4)         /* d = whether views a and b have the same text */ \
+    OP(SET_V, 3)        /* Copy view b into slot a */ \
+    OP(APPEND_V, 3)     /* Append view b to slot a */ \
+    OP(OUT_V, 2)        /* Print view */ \
+    OP(A_CLEAR, 2)      /* Empty array a */ \
+    OP(A_PUSH, 3)       /* Append b to array a */ \
+    OP(A_SET, 3)        /* Copy array b into array a */ \
+    OP(A_LEN, 3)        /* d = elements in array a */ \
+    OP(A_LOAD, 4)       /* d = element c of array b */ \
+    OP(A_LOAD_CHECKED, 5) \
+    OP(A_STORE, 4)      /* Element b of array a = c */ \
+    OP(A_STORE_CHECKED, 5) \
+    OP(M_CLEAR, 2)      /* Empty map a */ \
+    OP(M_LEN, 3)        /* d = keys in map a */ \
+    OP(M_GET_D, 4) OP(M_GET_S, 4)   /* d = value of key c in map b, or 0 */ \
+    OP(M_HAS_D, 4) OP(M_HAS_S, 4)   /* d = whether map b has key c */ \
+    OP(M_DEL_D, 4) OP(M_DEL_S, 4)   /* d = whether key c was removed from map b */ \
+    OP(M_PUT_D, 4) OP(M_PUT_S, 4)   /* Key b of map a = c */ \
+    OP(JMP, 2) \
+    OP(JNZ_I, 3) OP(JZ_I, 3) OP(JNZ_D, 3) OP(JZ_D, 3) \
+    OP(JEQ_I, 4) OP(JNE_I, 4) OP(JLT_I, 4) OP(JGT_I, 4) OP(JLE_I, 4) OP(JGE_I, 4) \
+    OP(JEQ_IK, 4) OP(JNE_IK, 4) OP(JLT_IK, 4) OP(JGT_IK, 4) OP(JLE_IK, 4) OP(JGE_IK, 4) \
+    OP(EXIT_I, 2) OP(EXIT_D, 2) \
+    OP(RETURN, 1)
+
+#define BYTECODE_ENUM(name, words) BC_##name,
+typedef enum {
+    BYTECODE_OPS(BYTECODE_ENUM)
+    BC_OP_COUNT
+} BytecodeOp;
+#undef BYTECODE_ENUM
+
+typedef union {
+    int64_t i;
+    double d;
+} BytecodeValue;
+
+typedef struct {
+    int32_t* code;
+    int length;
+    int capacity;
+    BytecodeValue* registers;   // Initial register file: constants, zero elsewhere
+    int register_count;
+    int string_count;           // String slots, which grow as needed
+    int view_count;
+    int array_count;
+    int map_count;
+    char* text;                 // Output computed at compile time, then the literals, NUL-terminated
+    size_t text_length;
+    size_t text_capacity;
+    size_t precomputed_length;
+} Bytecode;
+
+// Compile the reachable blocks of a program, to run after printing the
+// output the compiler already produced
+Bytecode bytecode_compile(const IrProgram* ir, const char* precomputed, size_t precomputed_length);
+
+void bytecode_free(Bytecode* bytecode);
+
+#endif // BYTECODE_H
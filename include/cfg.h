@@ -0,0 +1,45 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include "ir.h"
+
+// Control-flow analysis over the IR: reverse postorder, dominators and
+// natural loops. The analysis is a snapshot; passes that change the CFG other
+// than through cfg_preheader() must analyze again.
+
+typedef struct {
+    int header;
+    int preheader;      // Only block outside the loop that enters it, or -1
+    int parent;         // Innermost enclosing loop, or -1
+    int depth;          // 1 for outermost loops
+    int* blocks;        // Header first
+    int block_count;
+    int block_capacity;
+} IrLoop;
+
+typedef struct {
+    int* order;         // Reachable blocks in reverse postorder
+    int order_count;
+    int* idom;          // Immediate dominator of each block, -1 for the entry and unreachable blocks
+    int* loop_of;       // Innermost loop containing each block, or -1
+    int block_capacity;
+    IrLoop* loops;      // Enclosing loops come before the loops they contain
+    int loop_count;
+} Cfg;
+
+// Analyze the reachable blocks of a program
+Cfg cfg_analyze(const IrProgram* ir);
+
+// Whether block a dominates block b
+bool cfg_dominates(const Cfg* cfg, int a, int b);
+
+// Whether a block is part of a loop, directly or through a nested loop
+bool cfg_in_loop(const Cfg* cfg, int block, int loop);
+
+// Return the loop's preheader, creating one when the header has several
+// entries from outside the loop or its entry also branches elsewhere
+int cfg_preheader(IrProgram* ir, Cfg* cfg, int loop);
+
+void cfg_free(Cfg* cfg);
+
+#endif // CFG_H
@@ -2,6 +2,7 @@
 #define CODEGEN_H
 
 #include "parser.h"
+#include "ir.h"
 
 // Initialize the code generator
 void codegen_init(const char* output_file);
@@ -9,9 +10,15 @@ void codegen_init(const char* output_file);
 //Generate code from an expression
 void codegen_expression(const Expression* expr);
 
-// Generate C code from a block of statements
+// Write text to stdout in one call when the program starts, before anything it prints
+void codegen_precomputed_output(const char* text, size_t length);
+
+// Generate C code from a program annotated by semantic analysis
 void codegen_generate(Program program);
 
+// Generate C code from optimized IR
+void codegen_generate_ir(const IrProgram* ir);
+
 // Free resources used by the code generator
 void codegen_cleanup();
 
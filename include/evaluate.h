@@ -0,0 +1,26 @@
+#ifndef EVALUATE_H
+#define EVALUATE_H
+
+#include <stdint.h>
+#include "parser.h"
+
+// Compile-time evaluation of the part of a program that reads no input.
+
+typedef struct {
+    char* text;         // What the evaluated statements print, or nullptr
+    size_t length;
+    int evaluated;      // Top-level statements that ran at compile time
+    bool finished;      // Whether the program exits without reading input
+} Evaluation;
+
+// Run the program's top-level statements until one of them could read input,
+// within budget steps. When that prefix finishes, it is replaced by its
+// output: the program then restores the top-level variables and runs the
+// rest, or only exits with the status of its `ret`. Programs that exhaust
+// the budget, or do something C leaves undefined, are left as they are.
+Evaluation evaluate_program(Program* program, Arena* arena, int64_t budget);
+
+// Free the evaluated output
+void evaluate_cleanup(Evaluation* evaluation);
+
+#endif // EVALUATE_H
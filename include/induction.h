@@ -0,0 +1,39 @@
+#ifndef INDUCTION_H
+#define INDUCTION_H
+
+#include <stdio.h>
+#include "ir.h"
+#include "cfg.h"
+
+// Induction variables: header phis that a loop steps by an invariant amount
+// on every iteration.
+
+// The induction variable a loop's header tests to keep running
+typedef struct {
+    int phi;
+    int init;           // Its value on entry
+    int bound;          // Invariant it is compared against
+    IrOp op;            // Comparison that continues the loop, counter on the left
+    int64_t step;
+} LoopCounter;
+
+// Find the header phi, stepped by a constant on the loop's only back edge,
+// that the header compares against an invariant in the direction it moves.
+// Other exits may leave the loop earlier.
+bool induction_find_counter(IrProgram* ir, const Cfg* cfg, int loop, LoopCounter* counter);
+
+// Iterations the header allows when the counter starts at and is compared
+// against constants, or -1, also when the counter could wrap around the int64
+// range before the test fails
+int64_t induction_trip_count(const IrProgram* ir, const LoopCounter* counter);
+
+// Replace integer multiplications of an induction variable, by an invariant
+// or by itself, with new induction variables updated by addition
+void induction_reduce_strength(IrProgram* ir, FILE* report);
+
+// Mark loops that only exit from their header, on a comparison of an
+// induction variable stepped by a constant against an invariant bound, so the
+// code generator can emit them as counted for loops
+void induction_mark_counted_loops(IrProgram* ir, FILE* report);
+
+#endif // INDUCTION_H
@@ -0,0 +1,27 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+#include "lexer.h"
+#include "arena.h"
+
+// Global identifier interner. Every distinct identifier gets a dense ID,
+// counting up from 0 in order of first appearance. Names are views into the
+// source buffer, so the interner must be cleaned up before the lexer.
+
+// Initialize the interner, allocating its tables from arena
+void intern_init(Arena* arena);
+
+// Get the ID of an identifier, assigning a new one on first sight
+uint32_t intern(const char* text, int length);
+
+// Get the name behind an ID
+Lexeme intern_name(uint32_t id);
+
+// Number of IDs handed out so far
+uint32_t intern_count();
+
+// Forget every ID; the tables themselves are released with the arena
+void intern_cleanup();
+
+#endif // INTERN_H
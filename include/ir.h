@@ -0,0 +1,192 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "parser.h"
+#include "arena.h"
+
+// Mid-level IR in SSA form. A program is one function made of basic blocks;
+// every numeric value is an instruction, and variables only exist while the
+// IR is built. String variables stay buffers addressed by slot; slots past
+// the program's own variables hold the intermediate strings of concatenations
+// and the views that the string builtins take. A view points into the text
+// of a string or literal and is used up before anything can change it.
+// Arrays and maps are addressed by slot too.
+
+typedef enum {
+    IR_CONST,       // value of the instruction's type
+    IR_PHI,         // one argument per predecessor, in predecessor order
+    IR_COPY,        // args[0]; left behind when a value is replaced
+    IR_NEG, IR_NOT, IR_BITNOT,
+    IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_MOD,
+    IR_AND, IR_OR, IR_XOR, IR_SHL, IR_SHR,
+    IR_EQ, IR_NE, IR_LT, IR_GT, IR_LE, IR_GE,
+    IR_TO_DOUBLE, IR_TO_INT,
+    IR_IN,          // Read a double; args[0] is kept when input fails
+    IR_OUT,         // Print args[0]
+    IR_IN_STRING,   // Read a word into string slot
+    IR_OUT_STRING,  // Print string slot source, or text when source is -1
+    IR_SET_STRING,  // Copy string slot source, or text when source is -1, into slot
+    IR_APPEND_STRING,   // Append string slot source, or text, to slot
+    IR_MOVE_STRING, // Give slot the text of slot source, which is not read again before it is set
+    // The builtins. Their string operands are the slot or text of source and
+    // other, and their numbers args[0] and args[1]; they are side effects, so
+    // they stay in order with the instructions that change strings.
+    IR_SLICE_STRING,    // View slot of args[1] bytes of source from args[0]
+    IR_SPLIT_STRING,    // View slot of piece args[0] of source cut at each other
+    IR_LENGTH_STRING,   // Bytes in source
+    IR_FIND_STRING,     // Offset of other in source from args[0], or -1
+    IR_COMPARE_STRING,  // -1, 0 or 1 as source sorts before, with or after other
+    IR_EQUAL_STRING,    // Whether source and other have the same text
+    // Arrays. An index is checked against the length unless in_bounds; every
+    // access is a side effect, so reads stay in order with the instructions
+    // that change the array.
+    IR_LOAD_ARRAY,      // Element args[0] of slot
+    IR_LENGTH_ARRAY,    // Elements in slot
+    IR_CLEAR_ARRAY,     // Empty slot
+    IR_PUSH_ARRAY,      // Append args[0] to slot
+    IR_SET_ARRAY,       // Copy array slot source into slot
+    IR_STORE_ARRAY,     // Set element args[0] of slot to args[1]
+    // Maps. The key is args[0] in a map of numbers and the string operand
+    // source in a map of strings; each operation is a side effect, like the
+    // array accesses.
+    IR_GET_MAP,         // Value of the key in slot, or 0
+    IR_HAS_MAP,         // 1 if slot has the key, else 0
+    IR_DEL_MAP,         // Remove the key from slot; 1 if it was there, else 0
+    IR_LENGTH_MAP,      // Keys in slot
+    IR_CLEAR_MAP,       // Empty slot
+    IR_PUT_MAP,         // Set the key in slot to args[1]
+} IrOp;
+
+typedef enum {
+    TERM_NONE,      // Block is still being built
+    TERM_JUMP,      // Go to succ[0]
+    TERM_BRANCH,    // Go to succ[0] if cond is non-zero, else succ[1]
+    TERM_EXIT,      // Exit the program with status cond
+    TERM_RETURN     // Fall off the end of the program
+} IrTerminator;
+
+typedef struct {
+    IrOp op;
+    VarType type;       // TYPE_INT or TYPE_DOUBLE for values
+    int block;
+    int prev;           // Neighbours within the block, or -1
+    int next;
+    int args[2];
+    union {
+        int64_t integer;
+        double real;
+    } value;            // IR_CONST
+    int* phi_args;
+    int phi_count;
+    int slot;           // String, array and map instructions
+    int source;
+    Lexeme text;
+    int other;          // Second string operand of a builtin
+    Lexeme other_text;
+    int line;           // Source line of the expression that produced it
+    bool in_bounds;     // Array index proven in range
+    bool removed;
+} IrInst;
+
+typedef struct {
+    int first;          // Instruction list, phis first, or -1 when empty
+    int last;
+    int* preds;
+    int pred_count;
+    int pred_capacity;
+    IrTerminator term;
+    int cond;
+    int succ[2];
+    int loop_depth;
+    int counter;        // Loop headers emitted as a counted for: the phi it steps, or -1
+    int line;           // Loop headers: source line of the while statement
+    int incomplete;     // Phis waiting for the block to be sealed
+    bool sealed;
+    bool removed;
+} IrBlock;
+
+typedef struct {
+    IrInst* insts;
+    int inst_count;
+    int inst_capacity;
+    IrBlock* blocks;    // Block 0 is the entry
+    int block_count;
+    int block_capacity;
+    const Symbol* symbols;
+    int symbol_count;
+    Arena* arena;
+} IrProgram;
+
+// Lower an analyzed program into SSA form, allocating the IR from arena
+IrProgram ir_lower(const Program* program, Arena* arena);
+
+// Create an empty block
+int ir_new_block(IrProgram* ir);
+
+// Append an instruction to a block and return its value
+int ir_append(IrProgram* ir, int block, IrOp op, VarType type, int a, int b);
+
+// Insert an instruction before another one and return its value
+int ir_insert_before(IrProgram* ir, int before, IrOp op, VarType type, int a, int b);
+
+// Append a constant to a block
+int ir_const_int(IrProgram* ir, int block, int64_t value);
+int ir_const_double(IrProgram* ir, int block, double value);
+
+// Unlink an instruction from its block
+void ir_remove(IrProgram* ir, int inst);
+
+// Move an instruction to the end of a block
+void ir_move(IrProgram* ir, int inst, int block);
+
+// Add a predecessor to a block
+void ir_add_pred(IrProgram* ir, int block, int pred);
+
+// Remove the edge from pred to block, dropping the matching phi arguments
+void ir_remove_edge(IrProgram* ir, int pred, int block);
+
+// Follow copies to the value an operand stands for
+int ir_resolve(const IrProgram* ir, int value);
+
+// Replace an instruction with a copy of value
+void ir_replace(IrProgram* ir, int inst, int value);
+
+// Number of successors of a block's terminator
+int ir_succ_count(const IrBlock* block);
+
+// Whether an instruction must run even if its value is unused
+bool ir_has_side_effect(IrOp op);
+
+// Whether an instruction can fault at run time. Only % can: by zero, or
+// INT64_MIN % -1, so it may trap unless its divisor is a constant other than
+// 0 and -1.
+bool ir_may_trap(const IrProgram* ir, const IrInst* inst);
+
+// Whether a value is a constant
+bool ir_is_const(const IrProgram* ir, int value);
+
+// Whether a side effect also yields a number: the string builtins that do,
+// array loads and lengths, and the map lookups
+bool ir_effect_has_value(IrOp op);
+
+// Zeroed memory for count items of size, for the scratch arrays of passes
+// and backends. Running out of memory exits.
+void* ir_allocate(size_t count, size_t size);
+
+// Resize memory from ir_allocate() to count items of size
+void* ir_reallocate(void* memory, size_t count, size_t size);
+
+// Make room for one more item after count, doubling the capacity when full
+void* ir_grow(void* items, int count, int* capacity, size_t size);
+
+// Print the IR in a readable form
+void ir_dump(const IrProgram* ir, FILE* out);
+
+// Print one instruction, without indentation or newline
+void ir_dump_inst(const IrProgram* ir, int inst, FILE* out);
+
+const char* ir_op_to_string(IrOp op);
+
+#endif // IR_H
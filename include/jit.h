@@ -0,0 +1,26 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "x86.h"
+
+// Running generated code in the compiler's own process, for `SILC run`.
+
+typedef struct {
+    uint8_t* memory;    // Code and the C library addresses, then the bss
+    size_t size;
+    int (*entry)(void);
+} JitProgram;
+
+// Whether this build can run generated code in memory
+bool jit_supported();
+
+// Map the code into executable memory and resolve its references to the bss
+// and the C library. Return false when the memory cannot be mapped.
+bool jit_load(const X86Code* code, JitProgram* program);
+
+// Run the program's main and return its exit status, with stdout flushed
+int jit_run(const JitProgram* program);
+
+void jit_free(JitProgram* program);
+
+#endif // JIT_H
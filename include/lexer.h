@@ -2,6 +2,9 @@
 #define LEXER_H
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
 
 typedef enum {
     TOKEN_RETURN,
@@ -44,27 +47,72 @@ typedef enum {
     TOKEN_WHILE,
     TOKEN_IN,
     TOKEN_BREAK,
-    TOKEN_CONTINUE
+    TOKEN_CONTINUE,
+    TOKEN_COMMA,
+    TOKEN_LBRACKET,
+    TOKEN_RBRACKET
 } Ttype;
 
+// A view into the source buffer. Not NUL-terminated.
+typedef struct {
+    const char* text;
+    int length;
+} Lexeme;
+
 typedef struct {
     Ttype type;
-    char* value;
+    size_t offset;  // Byte offset of the lexeme in the source buffer
+    int length;     // Length of the lexeme (string literals exclude the quotes)
     int line;
     int column;
+    uint32_t symbol; // Interned identifier ID, for TOKEN_IDENT
 } Token;
 
-// Initialize the lexer with a file
+// The whole source tokenized up front, one entry per token in parallel arrays.
+// The last entry is always TOKEN_EOF.
+typedef struct {
+    uint8_t* types;     // Ttype of each token
+    uint32_t* offsets;
+    uint32_t* lengths;
+    uint32_t* lines;
+    uint32_t* columns;
+    uint32_t* symbols;  // Interned identifier ID of each TOKEN_IDENT
+    int count;
+    int capacity;
+} TokenStream;
+
+// Initialize the lexer with a file, reading the whole stream into memory
 void lexer_init(FILE* source_file);
 
+// Initialize the lexer over a caller-owned buffer that outlives the lexer
+void lexer_init_buffer(const char* buffer, size_t length);
+
+// Initialize the lexer by memory-mapping the file at path, reading it instead when it
+// cannot be mapped. Returns false if the file could not be opened.
+bool lexer_init_mapped(const char* path);
+
 // Get the next token from the source
 Token lexer_next_token();
 
+// Tokenize the rest of the source into a token stream allocated from arena
+TokenStream lexer_tokenize(Arena* arena);
+
+// Get the token at index as a Token
+Token token_stream_at(const TokenStream* stream, int index);
+
+// Get a view of the text of the token at index
+Lexeme token_stream_lexeme(const TokenStream* stream, int index);
+
 // Free resources used by the lexer
 void lexer_cleanup();
 
 // Utility functions
 const char* token_type_to_string(Ttype type);
-void token_free(Token* token);
+Lexeme token_lexeme(const Token* token);
+bool lexeme_equals(Lexeme a, Lexeme b);
+
+// Resolve the C escapes of a string literal's text the way the C compiler reads
+// them. Writes at most text.length bytes and a NUL to decoded; returns the length.
+size_t lexeme_decode_string(Lexeme text, char* decoded);
 
 #endif // LEXER_H
\ No newline at end of file
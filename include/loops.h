@@ -0,0 +1,21 @@
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include <stdio.h>
+#include "ir.h"
+
+// Loop restructuring: fusion of adjacent loops over the same range, and
+// unrolling of inner loops with a constant trip count.
+
+// Merge a counted loop into the loop right before it when both step the same
+// counter over the same range, neither reads a value the other computes, and
+// at most one of them has effects, so the order of those effects is kept
+void loops_fuse(IrProgram* ir, FILE* report);
+
+// Unroll innermost loops whose header counts a constant number of iterations:
+// completely when the trip count times the loop's size stays within limit
+// instructions, otherwise by the largest factor of the trip count up to 8
+// that does, so the copies in between need no test. A limit of 0 disables it.
+void loops_unroll(IrProgram* ir, int limit, FILE* report);
+
+#endif // LOOPS_H
@@ -0,0 +1,11 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "x86.h"
+
+// Write generated code as an x86-64 ELF relocatable object defining main, for
+// the system linker to link against the C library. Return false when the
+// file cannot be written.
+bool object_write_elf(const char* path, const X86Code* code);
+
+#endif // OBJECT_H
@@ -0,0 +1,23 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <stdio.h>
+#include "ir.h"
+
+typedef struct {
+    int level;
+    FILE* report;       // Where passes describe what they changed, or nullptr
+    int unroll_limit;   // Instructions an unrolled loop may grow to, 0 to never unroll
+    bool fuse_loops;
+} OptimizeOptions;
+
+// Optimize the IR in place. Level 1 and above fold and propagate constants,
+// number values to reuse repeated computations, propagate copies, drop
+// unreachable blocks and dead code, and merge blocks.
+// Level 2 and above also hoist loop-invariant values out of loops, reduce
+// multiplications of induction variables to additions, fuse adjacent loops
+// over the same range, unroll inner loops with a constant trip count, and mark
+// counted loops.
+void optimize_program(IrProgram* ir, const OptimizeOptions* options);
+
+#endif // OPTIMIZE_H
@@ -1,6 +1,7 @@
 #ifndef PARSER_H
 #define PARSER_H
 #include "lexer.h"
+#include "arena.h"
 
 // Forward declaration first
 typedef struct Statement Statement;
@@ -9,18 +10,90 @@ typedef enum {
     STMT_RETURN, STMT_LET, STMT_IF, STMT_OUT, STMT_EXPR, STMT_WHILE, STMT_IN, STMT_BREAK, STMT_CONTINUE
 } StatementType;
 
-typedef enum { TYPE_DOUBLE, TYPE_STRING } VarType;
+typedef enum {
+    TYPE_DOUBLE, TYPE_STRING, TYPE_INT,
+    TYPE_VIEW,          // Slice of a string; only the IR has slots of this type
+    TYPE_INT_ARRAY, TYPE_DOUBLE_ARRAY,
+    TYPE_DOUBLE_MAP, TYPE_STRING_MAP    // Maps by key type; every value is a double
+} VarType;
+
+// A declared variable, found by the slot that semantic analysis gives it
 typedef struct {
-    char name[256];
+    uint32_t symbol;
     VarType type;
 } Symbol;
 
-
-typedef struct {
-    Ttype* token_types;
-    char** token_values;
-    int len;
-} Expression;
+typedef enum {
+    EXPR_NUMBER, EXPR_STRING, EXPR_IDENT, EXPR_UNARY, EXPR_BINARY, EXPR_ASSIGN, EXPR_CALL,
+    EXPR_ARRAY,         // [element, ...]
+    EXPR_INDEX,         // array[index]
+    EXPR_STORE,         // array[index] = value
+    EXPR_MAP            // {}: an empty map
+} ExpressionKind;
+
+// Functions a call can name. slice and split return views into the text of
+// their first argument rather than copies.
+typedef enum {
+    BUILTIN_LEN,        // len(s): bytes in s, elements in an array or keys in a map
+    BUILTIN_SLICE,      // slice(s, start, count): count bytes from start, clamped to s
+    BUILTIN_FIND,       // find(s, t) or find(s, t, from): offset of t in s from from, or -1
+    BUILTIN_SPLIT,      // split(s, separator, n): piece n of s cut at each separator, or ""
+    BUILTIN_COMPARE,    // compare(a, b): -1, 0 or 1 as a sorts before, with or after b
+    BUILTIN_PUSH,       // push(array, value): append value to an array variable, returning its length
+    BUILTIN_GET,        // get(map, key): the value of key in a map variable, or 0
+    BUILTIN_PUT,        // put(map, key, value): set the value of key, returning the number of keys
+    BUILTIN_HAS,        // has(map, key): 1 if the map has key, else 0
+    BUILTIN_DEL         // del(map, key): remove key, returning 1 if it was there, else 0
+} Builtin;
+
+typedef struct Expression Expression;
+
+struct Expression {
+    ExpressionKind kind;
+    Ttype op;       // Operator token of unary and binary nodes
+    VarType type;   // Filled in by semantic analysis
+    int line;
+    union {
+        struct {
+            double value;
+            Lexeme text;
+        } number;
+        Lexeme string;      // String literal body, without quotes
+        struct {
+            uint32_t symbol;    // Interned ID of the name
+            int slot;           // Resolved by semantic analysis
+        } ident;
+        struct {
+            Expression* operand;
+        } unary;
+        struct {
+            Expression* left;
+            Expression* right;
+        } binary;
+        struct {
+            uint32_t target;
+            int slot;
+            Expression* value;
+        } assign;
+        struct {
+            uint32_t name;
+            Builtin builtin;    // Resolved by semantic analysis
+            Expression** args;
+            int count;
+        } call;
+        struct {
+            Expression** elements;
+            int count;
+        } array;
+        struct {
+            uint32_t array;     // Name of the array variable
+            int slot;           // Resolved by semantic analysis
+            Expression* index;
+            Expression* value;  // EXPR_STORE
+            bool in_bounds;     // Proven by semantic analysis, so the index needs no check
+        } index;
+    };
+};
 
 typedef struct {
     Expression* expr;
@@ -31,8 +104,9 @@ typedef struct {
 } ReturnStatement;
 
 typedef struct {
-    char* ident;
+    uint32_t ident;
     Expression* expr;
+    int slot;       // Resolved by semantic analysis
 } LetStatement;
 
 typedef struct {
@@ -48,7 +122,8 @@ typedef struct {
 } OutStatement;
 
 typedef struct {
-    char* ident;
+    uint32_t ident;
+    int slot;
 } InStatement;
 
 typedef struct {
@@ -74,10 +149,12 @@ typedef struct {
     Statement* statements;
     int count;
     int capacity;
+    Symbol* symbols;    // Variables by slot, filled in by semantic analysis of the whole program
+    int symbol_count;
 } Program;
 
-// Initialize the parser
-void parser_init();
+// Initialize the parser over a tokenized source; the program is allocated from arena
+void parser_init(const TokenStream* stream, Arena* arena);
 
 // Parse the tokens into an AST
 Program parser_parse();
@@ -85,15 +162,9 @@ Program parser_parse();
 // Free the resources used by the parser
 void parser_cleanup();
 
-// Free the resources used by the program
-void program_free(Program* program);
-
 // Parse an Expression
 static Expression* parse_expression();
 
-//Free the resources used by the expression
-void expression_free(Expression* expr);
-
 static Statement parse_expression_statement();
 static Statement parse_if_statement();
 static Statement parse_out_statement();
@@ -102,7 +173,5 @@ static Statement parse_break_statement() ;
 static Statement parse_continue_statement();
 static Program parser_parse_block();
 static Program parse_block_statements();
-void if_statement_free(const IfStatement* if_stmt);
-void while_statement_free(const WhileStatement* while_stmt);
 
 #endif // PARSER_H
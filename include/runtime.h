@@ -0,0 +1,11 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+// The runtime the generated C includes ahead of main: buffered output, with
+// integers formatted through a table of digit pairs and doubles formatted
+// without printf wherever the result is the same, and input read in blocks
+// or mapped, with numbers parsed by hand where that rounds as strtod does.
+// silc_out_init() must run first; the buffer is flushed at exit.
+extern const char runtime_source[];
+
+#endif // RUNTIME_H
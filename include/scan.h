@@ -0,0 +1,55 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Character-class scanners used by the lexer. Each one starts at position and
+// returns the offset of the first byte that ends the run (or length). Scanners
+// that can cross newlines advance *line and move *line_start to the byte after
+// the last newline they pass.
+
+typedef enum {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2
+} ScanLevel;
+
+// Skip whitespace (as isspace in the C locale)
+size_t scan_whitespace(const char* text, size_t position, size_t length, int* line, size_t* line_start);
+
+// Skip identifier characters: letters, digits and '_'
+size_t scan_identifier(const char* text, size_t position, size_t length);
+
+// Find the closing '"' of a string literal whose body starts at position
+size_t scan_string(const char* text, size_t position, size_t length, int* line, size_t* line_start);
+
+// Byte searches for the string builtins, returning the offset they stop at or
+// length when they find nothing: the first c, the c after n others, the first
+// byte where a and b differ, and the first occurrence of a pattern of size > 0
+size_t scan_find_byte(const char* text, size_t length, char c);
+size_t scan_nth_byte(const char* text, size_t length, char c, size_t n);
+size_t scan_mismatch(const char* a, const char* b, size_t length);
+size_t scan_find(const char* text, size_t length, const char* pattern, size_t size);
+
+// The string builtins on byte ranges, as the runtime of the generated C
+// defines them; slices and pieces point into the text they come from
+typedef struct {
+    const char* text;
+    size_t length;
+} ScanText;
+
+ScanText scan_slice(ScanText text, int64_t start, int64_t count);
+int64_t scan_find_from(ScanText text, ScanText pattern, int64_t from);
+ScanText scan_split(ScanText text, ScanText separator, int64_t n);
+int scan_compare(ScanText a, ScanText b);
+
+// The instruction set the scanners use, detected from the CPU on first use
+ScanLevel scan_level();
+
+// Restrict the scanners to at most the given level (for benchmarks)
+void scan_set_level(ScanLevel level);
+
+const char* scan_level_to_string(ScanLevel level);
+
+#endif // SCAN_H
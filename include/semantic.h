@@ -12,31 +12,35 @@ typedef enum {
     SEMANTIC_ERROR_REDECLARED_VAR,
     SEMANTIC_ERROR_TYPE_MISMATCH,
     SEMANTIC_ERROR_BREAK_OUTSIDE_LOOP,
-    SEMANTIC_ERROR_CONTINUE_OUTSIDE_LOOP
+    SEMANTIC_ERROR_CONTINUE_OUTSIDE_LOOP,
+    SEMANTIC_ERROR_INVALID_CALL
 } SemanticResult;
 
 typedef struct {
-    char name[256];
-    VarType type;
-    int is_declared;
+    uint32_t symbol;
+    int slot;       // Slot of the declared variable, stable across inference passes
+    int depth;      // Scope depth of the declaration
+    int shadowed;   // Binding hidden by this one, or -1
 } SymbolEntry;
 
+// Every scope shares one table indexed by intern ID. Declarations are pushed
+// onto a binding log, and popping a scope unwinds the log to its mark.
 typedef struct {
-    SymbolEntry* entries;
-    int count;
-    int capacity;
-} Scope;
-
-typedef struct {
-    Scope* scopes;
-    int scope_count;
-    int scope_capacity;
+    int* visible;           // Per intern ID: innermost visible binding, or -1
+    uint32_t symbol_count;
+    SymbolEntry* bindings;
+    int binding_count;
+    int binding_capacity;
+    int* marks;             // binding_count when each open scope was pushed
+    int depth;
+    int mark_capacity;
 } ScopeStack;
 
-// Initialize semantic analyzer
-void semantic_init();
+// Initialize semantic analyzer, allocating its scopes from arena; identifiers must already be interned
+void semantic_init(Arena* arena);
 
-// Analyze the program
+// Analyze the program, inferring the type of every variable and expression. Every
+// declaration and use is annotated with its variable's slot in program->symbols.
 SemanticResult semantic_analyze(Program* program);
 
 // Cleanup semantic analyzer
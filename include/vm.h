@@ -0,0 +1,11 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+
+// Running bytecode, for `SILC --interp`.
+
+// Run a program and return its exit status, with stdout flushed
+int vm_run(const Bytecode* bytecode);
+
+#endif // VM_H
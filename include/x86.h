@@ -0,0 +1,69 @@
+#ifndef X86_H
+#define X86_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ir.h"
+
+// Native code generation for x86-64 under the System V ABI. The IR becomes one
+// function, `int main(void)`, at the start of the code, followed by a small
+// runtime for out and in and by the constants; values live in registers given
+// out by linear scan, with doubles in SSE2 registers. Strings are a text
+// pointer, length and capacity in a zero-filled bss, their text on the heap,
+// and views a text pointer and length beside them; arrays are laid out like
+// strings, with 8-byte elements, and maps are Swiss tables probed with SSE2.
+// The C library is reached
+// through relocations, so the code can be written as an object file or placed
+// in memory and run; the string builtins search with its memmem and memcmp.
+
+typedef enum {
+    X86_PRINTF,
+    X86_SCANF,
+    X86_FWRITE,
+    X86_REALLOC,
+    X86_FREE,
+    X86_MEMMOVE,
+    X86_MEMMEM,
+    X86_MEMCMP,
+    X86_STRLEN,
+    X86_EXIT,
+    X86_FPRINTF,
+    X86_FFLUSH,
+    X86_STDOUT,
+    X86_STDERR,
+    X86_EXTERN_COUNT
+} X86Extern;
+
+typedef enum {
+    X86_RELOC_BSS,      // Address of bss + addend
+    X86_RELOC_EXTERN    // Address of a word holding the address of symbol
+} X86RelocKind;
+
+// A 32-bit field relative to the end of the field, which ends its instruction
+typedef struct {
+    X86RelocKind kind;
+    size_t offset;
+    X86Extern symbol;
+    int64_t addend;
+} X86Reloc;
+
+typedef struct {
+    uint8_t* code;
+    size_t length;
+    size_t capacity;
+    size_t main_size;   // Bytes of main, before the runtime
+    X86Reloc* relocs;
+    int reloc_count;
+    int reloc_capacity;
+    size_t bss_size;
+} X86Code;
+
+// Generate code for a program, which first writes the precomputed output
+X86Code x86_generate(const IrProgram* ir, const char* precomputed, size_t precomputed_length);
+
+// Name of a C library symbol the code refers to
+const char* x86_extern_name(X86Extern symbol);
+
+void x86_free(X86Code* code);
+
+#endif // X86_H
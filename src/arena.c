@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include "arena.h"
+
+#define ARENA_CHUNK_SIZE (256 * 1024)
+#define ARENA_ALIGN alignof(max_align_t)
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    size_t used;
+    size_t capacity;
+    size_t last;      // Offset of the latest allocation, for in-place growth
+    bool dedicated;   // Holds a single large block that may be reallocated
+    alignas(max_align_t) unsigned char data[];
+};
+
+static size_t align_up(const size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static ArenaChunk* new_chunk(Arena* arena, const size_t capacity) {
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + capacity);
+    if (chunk == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    chunk->next = nullptr;
+    chunk->used = 0;
+    chunk->capacity = capacity;
+    chunk->last = 0;
+    chunk->dedicated = false;
+    arena->reserved += sizeof(ArenaChunk) + capacity;
+    return chunk;
+}
+
+void arena_init(Arena* arena) {
+    arena->chunks = nullptr;
+    arena->allocations = 0;
+    arena->bytes = 0;
+    arena->reserved = 0;
+}
+
+void* arena_alloc(Arena* arena, const size_t size) {
+    const size_t aligned = align_up(size ? size : 1);
+    arena->allocations++;
+    arena->bytes += size;
+
+    ArenaChunk* chunk = arena->chunks;
+    if (chunk == NULL || chunk->capacity - chunk->used < aligned) {
+        if (aligned > ARENA_CHUNK_SIZE / 4) {
+            // Large blocks get a chunk of their own behind the current one,
+            // so the space left in the current chunk is not wasted
+            ArenaChunk* own = new_chunk(arena, aligned);
+            own->used = aligned;
+            own->dedicated = true;
+            if (chunk == NULL) {
+                arena->chunks = own;
+            } else {
+                own->next = chunk->next;
+                chunk->next = own;
+            }
+            return own->data;
+        }
+        chunk = new_chunk(arena, ARENA_CHUNK_SIZE);
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    chunk->last = chunk->used;
+    chunk->used += aligned;
+    return chunk->data + chunk->last;
+}
+
+void* arena_alloc_zeroed(Arena* arena, const size_t size) {
+    void* block = arena_alloc(arena, size);
+    memset(block, 0, size);
+    return block;
+}
+
+void* arena_grow(Arena* arena, void* block, const size_t old_size, const size_t new_size) {
+    if (block == NULL) {
+        return arena_alloc(arena, new_size);
+    }
+    if (new_size <= old_size) {
+        return block;
+    }
+
+    ArenaChunk* chunk = arena->chunks;
+    if (chunk != NULL && (unsigned char*)block == chunk->data + chunk->last &&
+        chunk->capacity - chunk->last >= align_up(new_size)) {
+        chunk->used = chunk->last + align_up(new_size);
+        arena->bytes += new_size - old_size;
+        return block;
+    }
+
+    // A large block that owns its chunk is resized with realloc
+    for (ArenaChunk** link = &arena->chunks; *link != NULL; link = &(*link)->next) {
+        ArenaChunk* own = *link;
+        if (own->dedicated && (unsigned char*)block == own->data) {
+            const size_t aligned = align_up(new_size);
+            ArenaChunk* resized = realloc(own, sizeof(ArenaChunk) + aligned);
+            if (resized == NULL) {
+                fprintf(stderr, "Memory allocation error\n");
+                exit(1);
+            }
+            arena->reserved += aligned - resized->capacity;
+            arena->bytes += new_size - old_size;
+            resized->capacity = aligned;
+            resized->used = aligned;
+            *link = resized;
+            return resized->data;
+        }
+    }
+
+    void* moved = arena_alloc(arena, new_size);
+    memcpy(moved, block, old_size);
+    return moved;
+}
+
+void arena_release(Arena* arena) {
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena_init(arena);
+}
@@ -0,0 +1,700 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "cfg.h"
+
+// Blocks are laid out in reverse postorder. Phis become copies on the edges
+// into their block, made as if at once through a spare register. An integer
+// compare that only feeds the branch ending its block becomes a compare and
+// jump.
+
+// A condition a jump tests: the compare and jump opcode, or JNZ_I or JNZ_D
+// with a register
+typedef struct {
+    BytecodeOp op;
+    int a;
+    int32_t b;          // Register or immediate of a compare
+} Test;
+
+typedef struct {
+    int from;
+    int to;
+} Copy;
+
+typedef struct {
+    int at;             // Word holding the target
+    int block;
+} Fixup;
+
+static Bytecode out;
+static const IrProgram* ir;
+static Cfg cfg;
+static int* registers;      // By value, or -1
+static int* uses;
+static bool* fused;         // Compare evaluated by the branch that uses it
+static int* string_slots;   // By symbol: the string slot, the view of a view symbol, or the array or map
+static int scratch_view;    // Two views that hold the string operands of a builtin
+static int* block_offsets;
+static Fixup* fixups;
+static int fixup_count;
+static int fixup_capacity;
+static int spare;
+
+// Make room for length more bytes of text
+static void reserve_text(const size_t length) {
+    if (out.text_length + length <= out.text_capacity) return;
+    while (out.text_length + length > out.text_capacity) {
+        out.text_capacity = out.text_capacity > 0 ? out.text_capacity * 2 : 256;
+    }
+    char* grown = realloc(out.text, out.text_capacity);
+    if (grown == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    out.text = grown;
+}
+
+// --- Emission ---------------------------------------------------------------
+
+static void emit(const int32_t word) {
+    out.code = ir_grow(out.code, out.length, &out.capacity, sizeof(int32_t));
+    out.code[out.length++] = word;
+}
+
+static void emit2(const BytecodeOp op, const int a) {
+    emit(op);
+    emit(a);
+}
+
+static void emit3(const BytecodeOp op, const int a, const int b) {
+    emit2(op, a);
+    emit(b);
+}
+
+static void emit4(const BytecodeOp op, const int a, const int b, const int c) {
+    emit3(op, a, b);
+    emit(c);
+}
+
+// Emit the target of a jump to a block, patched once every block is placed
+static void emit_target(const int block) {
+    fixups = ir_grow(fixups, fixup_count, &fixup_capacity, sizeof(Fixup));
+    fixups[fixup_count++] = (Fixup){out.length, block};
+    emit(-1);
+}
+
+// Append bytes and a NUL to the text and return their offset
+static int add_text(const char* bytes, const size_t length) {
+    reserve_text(length + 1);
+    const size_t offset = out.text_length;
+    if (length > 0) memcpy(out.text + offset, bytes, length);
+    out.text[offset + length] = '\0';
+    out.text_length += length + 1;
+    return (int)offset;
+}
+
+// A string literal with its escapes resolved the way the C compiler reads
+// them. The other backends print literals as printf formats, so a format has
+// each %% printed as %.
+static int add_literal(const Lexeme text, const bool format) {
+    reserve_text((size_t)text.length + 1);
+    char* decoded = out.text + out.text_length;
+    size_t length = lexeme_decode_string(text, decoded);
+    if (format) {
+        size_t kept = 0;
+        for (size_t i = 0; i < length; i++) {
+            decoded[kept++] = decoded[i];
+            if (decoded[i] == '%' && i + 1 < length && decoded[i + 1] == '%') i++;
+        }
+        decoded[kept] = '\0';
+        length = kept;
+    }
+    const size_t offset = out.text_length;
+    out.text_length += length + 1;
+    return (int)offset;
+}
+
+// --- Registers --------------------------------------------------------------
+
+static bool is_compare(const IrOp op) {
+    return op >= IR_EQ && op <= IR_GE;
+}
+
+static bool is_int(const int value) {
+    return ir->insts[value].type == TYPE_INT;
+}
+
+static bool small_const(const int value) {
+    const IrInst* inst = &ir->insts[value];
+    return inst->op == IR_CONST && inst->type == TYPE_INT && inst->value.integer >= INT32_MIN &&
+           inst->value.integer <= INT32_MAX;
+}
+
+// Count the uses of every value in reachable code, and find the integer
+// compares that the branch ending their block can evaluate itself
+static void count_uses() {
+    for (int i = 0; i < cfg.order_count; i++) {
+        const IrBlock* block = &ir->blocks[cfg.order[i]];
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            for (int a = 0; a < 2; a++) {
+                if (inst->args[a] >= 0) uses[ir_resolve(ir, inst->args[a])]++;
+            }
+            for (int p = 0; p < inst->phi_count; p++) {
+                const int value = ir_resolve(ir, inst->phi_args[p]);
+                if (value != id) uses[value]++;
+            }
+        }
+        if (block->term == TERM_BRANCH || block->term == TERM_EXIT) uses[ir_resolve(ir, block->cond)]++;
+    }
+    for (int i = 0; i < cfg.order_count; i++) {
+        const int b = cfg.order[i];
+        const IrBlock* block = &ir->blocks[b];
+        if (block->term != TERM_BRANCH) continue;
+        const int cond = ir_resolve(ir, block->cond);
+        const IrInst* inst = &ir->insts[cond];
+        if (!is_compare(inst->op) || inst->block != b || uses[cond] != 1) continue;
+        if (!is_int(ir_resolve(ir, inst->args[0]))) continue;
+        fused[cond] = true;
+    }
+}
+
+// Give every value that is used, and every input, a register; constants
+// start out holding their value
+static void assign_registers() {
+    int capacity = 0;
+    for (int i = 0; i < cfg.order_count; i++) {
+        for (int id = ir->blocks[cfg.order[i]].first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            switch (inst->op) {
+                case IR_COPY: case IR_OUT: case IR_IN_STRING: case IR_OUT_STRING: case IR_SET_STRING:
+                case IR_APPEND_STRING: case IR_MOVE_STRING: case IR_SLICE_STRING: case IR_SPLIT_STRING:
+                case IR_CLEAR_ARRAY: case IR_PUSH_ARRAY: case IR_SET_ARRAY: case IR_STORE_ARRAY:
+                case IR_CLEAR_MAP: case IR_PUT_MAP:
+                    continue;
+                case IR_IN:
+                    break;
+                default:
+                    if (uses[id] == 0 || fused[id]) continue;
+                    break;
+            }
+            out.registers = ir_grow(out.registers, out.register_count, &capacity, sizeof(BytecodeValue));
+            BytecodeValue* initial = &out.registers[out.register_count];
+            initial->i = 0;
+            if (inst->op == IR_CONST) {
+                if (inst->type == TYPE_INT) {
+                    initial->i = inst->value.integer;
+                } else {
+                    initial->d = inst->value.real;
+                }
+            }
+            registers[id] = out.register_count++;
+        }
+    }
+    out.registers = ir_grow(out.registers, out.register_count, &capacity, sizeof(BytecodeValue));
+    out.registers[out.register_count].i = 0;
+    spare = out.register_count++;
+}
+
+static int reg(const int value) {
+    return registers[ir_resolve(ir, value)];
+}
+
+// --- Instructions -----------------------------------------------------------
+
+// Compare opcodes in IR order, from EQ to GE
+static BytecodeOp compare_op(const IrOp op, const BytecodeOp first) {
+    return (BytecodeOp)(first + (op - IR_EQ));
+}
+
+// The compare that holds when the operands are swapped
+static IrOp swapped(const IrOp op) {
+    switch (op) {
+        case IR_LT: return IR_GT;
+        case IR_GT: return IR_LT;
+        case IR_LE: return IR_GE;
+        case IR_GE: return IR_LE;
+        default: return op;
+    }
+}
+
+static void compile_int(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int a = ir_resolve(ir, inst->args[0]);
+    const int b = inst->args[1] >= 0 ? ir_resolve(ir, inst->args[1]) : -1;
+    const int d = registers[id];
+    switch (inst->op) {
+        case IR_ADD:
+            if (small_const(b)) {
+                emit4(BC_ADD_IK, d, registers[a], (int32_t)ir->insts[b].value.integer);
+            } else if (small_const(a)) {
+                emit4(BC_ADD_IK, d, registers[b], (int32_t)ir->insts[a].value.integer);
+            } else {
+                emit4(BC_ADD_I, d, registers[a], registers[b]);
+            }
+            return;
+        case IR_SUB:
+            if (small_const(b) && ir->insts[b].value.integer != INT32_MIN) {
+                emit4(BC_ADD_IK, d, registers[a], (int32_t)-ir->insts[b].value.integer);
+            } else {
+                emit4(BC_SUB_I, d, registers[a], registers[b]);
+            }
+            return;
+        case IR_MUL: emit4(BC_MUL_I, d, registers[a], registers[b]); return;
+        case IR_MOD: emit4(BC_MOD_I, d, registers[a], registers[b]); return;
+        case IR_AND: emit4(BC_AND_I, d, registers[a], registers[b]); return;
+        case IR_OR: emit4(BC_OR_I, d, registers[a], registers[b]); return;
+        case IR_XOR: emit4(BC_XOR_I, d, registers[a], registers[b]); return;
+        case IR_SHL: emit4(BC_SHL_I, d, registers[a], registers[b]); return;
+        case IR_SHR: emit4(BC_SHR_I, d, registers[a], registers[b]); return;
+        case IR_NEG: emit3(BC_NEG_I, d, registers[a]); return;
+        case IR_BITNOT: emit3(BC_BITNOT_I, d, registers[a]); return;
+        case IR_TO_INT: emit3(BC_TO_I, d, registers[a]); return;
+        default:
+            fprintf(stderr, "Error: Invalid integer IR operator %s\n", ir_op_to_string(inst->op));
+            exit(EXIT_FAILURE);
+    }
+}
+
+static void compile_double(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int a = reg(inst->args[0]);
+    const int d = registers[id];
+    switch (inst->op) {
+        case IR_ADD: emit4(BC_ADD_D, d, a, reg(inst->args[1])); return;
+        case IR_SUB: emit4(BC_SUB_D, d, a, reg(inst->args[1])); return;
+        case IR_MUL: emit4(BC_MUL_D, d, a, reg(inst->args[1])); return;
+        case IR_DIV: emit4(BC_DIV_D, d, a, reg(inst->args[1])); return;
+        case IR_NEG: emit3(BC_NEG_D, d, a); return;
+        case IR_TO_DOUBLE: emit3(BC_TO_D, d, a); return;
+        default:
+            fprintf(stderr, "Error: Invalid double IR operator %s\n", ir_op_to_string(inst->op));
+            exit(EXIT_FAILURE);
+    }
+}
+
+static bool is_view(const int slot) {
+    return slot >= 0 && ir->symbols[slot].type == TYPE_VIEW;
+}
+
+// A string instruction taking a slot, a view, or a literal as its offset and length
+static void compile_string(const IrInst* inst, const BytecodeOp from_slot, const BytecodeOp from_text,
+                           const BytecodeOp from_view) {
+    if (is_view(inst->source)) {
+        emit3(from_view, string_slots[inst->slot], string_slots[inst->source]);
+    } else if (inst->source >= 0) {
+        emit3(from_slot, string_slots[inst->slot], string_slots[inst->source]);
+    } else {
+        // The value ends at the first NUL, as in the other backends
+        const int offset = add_literal(inst->text, false);
+        emit4(from_text, string_slots[inst->slot], offset, (int)strlen(out.text + offset));
+    }
+}
+
+static void compile_builtin(int id);
+
+// An unused load is dropped unless it checks its index, which it then loads into the spare register
+static void compile_array(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int array = string_slots[inst->slot];
+    switch (inst->op) {
+        case IR_LOAD_ARRAY: {
+            if (registers[id] < 0 && inst->in_bounds) return;
+            const int d = registers[id] >= 0 ? registers[id] : spare;
+            emit4(inst->in_bounds ? BC_A_LOAD : BC_A_LOAD_CHECKED, d, array, reg(inst->args[0]));
+            if (!inst->in_bounds) emit(inst->line);
+            return;
+        }
+        case IR_LENGTH_ARRAY:
+            if (registers[id] >= 0) emit3(BC_A_LEN, registers[id], array);
+            return;
+        case IR_CLEAR_ARRAY:
+            emit2(BC_A_CLEAR, array);
+            return;
+        case IR_PUSH_ARRAY:
+            emit3(BC_A_PUSH, array, reg(inst->args[0]));
+            return;
+        case IR_SET_ARRAY:
+            if (inst->source != inst->slot) emit3(BC_A_SET, array, string_slots[inst->source]);
+            return;
+        default:
+            emit4(inst->in_bounds ? BC_A_STORE : BC_A_STORE_CHECKED, array, reg(inst->args[0]), reg(inst->args[1]));
+            if (!inst->in_bounds) emit(inst->line);
+            return;
+    }
+}
+
+static int operand_view(int slot, Lexeme text, int scratch);
+
+// An unused lookup is dropped; an unused del still removes its key, into the spare register
+static void compile_map(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int map = string_slots[inst->slot];
+    if (inst->op == IR_CLEAR_MAP) {
+        emit2(BC_M_CLEAR, map);
+        return;
+    }
+    if (registers[id] < 0 && inst->op != IR_DEL_MAP && inst->op != IR_PUT_MAP) return;
+    if (inst->op == IR_LENGTH_MAP) {
+        emit3(BC_M_LEN, registers[id], map);
+        return;
+    }
+    const bool strings = ir->symbols[inst->slot].type == TYPE_STRING_MAP;
+    const int key = strings ? operand_view(inst->source, inst->text, scratch_view) : reg(inst->args[0]);
+    const int d = registers[id] >= 0 ? registers[id] : spare;
+    switch (inst->op) {
+        case IR_GET_MAP:
+            emit4(strings ? BC_M_GET_S : BC_M_GET_D, d, map, key);
+            return;
+        case IR_HAS_MAP:
+            emit4(strings ? BC_M_HAS_S : BC_M_HAS_D, d, map, key);
+            return;
+        case IR_DEL_MAP:
+            emit4(strings ? BC_M_DEL_S : BC_M_DEL_D, d, map, key);
+            return;
+        default:
+            emit4(strings ? BC_M_PUT_S : BC_M_PUT_D, map, key, reg(inst->args[1]));
+            return;
+    }
+}
+
+static void compile_instruction(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    switch (inst->op) {
+        case IR_CONST:
+        case IR_PHI:
+        case IR_COPY:
+            return;
+        case IR_IN:
+            emit3(BC_IN_D, registers[id], reg(inst->args[0]));
+            return;
+        case IR_OUT:
+            emit2(is_int(ir_resolve(ir, inst->args[0])) ? BC_OUT_I : BC_OUT_D, reg(inst->args[0]));
+            return;
+        case IR_IN_STRING:
+            emit2(BC_IN_S, string_slots[inst->slot]);
+            return;
+        case IR_OUT_STRING:
+            if (is_view(inst->source)) {
+                emit2(BC_OUT_V, string_slots[inst->source]);
+            } else if (inst->source >= 0) {
+                emit2(BC_OUT_S, string_slots[inst->source]);
+            } else {
+                emit2(BC_OUT_TEXT, add_literal(inst->text, true));
+            }
+            return;
+        case IR_SET_STRING:
+            if (inst->source == inst->slot) return;
+            compile_string(inst, BC_SET_S, BC_SET_TEXT, BC_SET_V);
+            return;
+        case IR_APPEND_STRING:
+            compile_string(inst, BC_APPEND_S, BC_APPEND_TEXT, BC_APPEND_V);
+            return;
+        case IR_MOVE_STRING:
+            emit3(BC_MOVE_S, string_slots[inst->slot], string_slots[inst->source]);
+            return;
+        case IR_SLICE_STRING:
+        case IR_SPLIT_STRING:
+        case IR_LENGTH_STRING:
+        case IR_FIND_STRING:
+        case IR_COMPARE_STRING:
+        case IR_EQUAL_STRING:
+            compile_builtin(id);
+            return;
+        case IR_LOAD_ARRAY:
+        case IR_LENGTH_ARRAY:
+        case IR_CLEAR_ARRAY:
+        case IR_PUSH_ARRAY:
+        case IR_SET_ARRAY:
+        case IR_STORE_ARRAY:
+            compile_array(id);
+            return;
+        case IR_GET_MAP:
+        case IR_HAS_MAP:
+        case IR_DEL_MAP:
+        case IR_LENGTH_MAP:
+        case IR_CLEAR_MAP:
+        case IR_PUT_MAP:
+            compile_map(id);
+            return;
+        default:
+            if (registers[id] < 0) return;
+            if (inst->op == IR_NOT) {
+                const int a = ir_resolve(ir, inst->args[0]);
+                emit3(is_int(a) ? BC_NOT_I : BC_NOT_D, registers[id], registers[a]);
+            } else if (is_compare(inst->op)) {
+                const bool ints = is_int(ir_resolve(ir, inst->args[0]));
+                emit4(compare_op(inst->op, ints ? BC_EQ_I : BC_EQ_D), registers[id], reg(inst->args[0]),
+                      reg(inst->args[1]));
+            } else if (inst->type == TYPE_INT) {
+                compile_int(id);
+            } else {
+                compile_double(id);
+            }
+            return;
+    }
+}
+
+// --- Control flow -----------------------------------------------------------
+
+static int edge_copies(const int block, const int target, Copy* copies) {
+    const IrBlock* succ = &ir->blocks[target];
+    int index = 0;
+    while (index < succ->pred_count && succ->preds[index] != block) index++;
+
+    int count = 0;
+    for (int id = succ->first; id >= 0 && ir->insts[id].op == IR_PHI; id = ir->insts[id].next) {
+        if (registers[id] < 0) continue;
+        const int from = reg(ir->insts[id].phi_args[index]);
+        if (from == registers[id]) continue;
+        if (copies != nullptr) copies[count] = (Copy){from, registers[id]};
+        count++;
+    }
+    return count;
+}
+
+static bool reads(const Copy* copies, const int count, const int r) {
+    for (int i = 0; i < count; i++) {
+        if (copies[i].from == r) return true;
+    }
+    return false;
+}
+
+// Copy into the phis as if at once: write a register only once nothing still
+// reads it, and break cycles through the spare register
+static void emit_edge_copies(const int block, const int target) {
+    const int total = edge_copies(block, target, nullptr);
+    if (total == 0) return;
+    Copy* copies = ir_allocate((size_t)total, sizeof(Copy));
+    int count = edge_copies(block, target, copies);
+    while (count > 0) {
+        bool progress = false;
+        for (int i = 0; i < count; i++) {
+            if (reads(copies, count, copies[i].to)) continue;
+            emit3(BC_MOV, copies[i].to, copies[i].from);
+            copies[i--] = copies[--count];
+            progress = true;
+        }
+        if (progress) continue;
+
+        const int blocked = copies[0].to;
+        emit3(BC_MOV, spare, blocked);
+        for (int i = 0; i < count; i++) {
+            if (copies[i].from == blocked) copies[i].from = spare;
+        }
+    }
+    free(copies);
+}
+
+// Follow an edge; next is the block placed after this one, or -1
+static void emit_edge(const int block, const int target, const int next) {
+    emit_edge_copies(block, target);
+    if (target != next) {
+        emit(BC_JMP);
+        emit_target(target);
+    }
+}
+
+static BytecodeOp inverse(const BytecodeOp op) {
+    switch (op) {
+        case BC_JNZ_I: return BC_JZ_I;
+        case BC_JNZ_D: return BC_JZ_D;
+        case BC_JEQ_I: return BC_JNE_I;
+        case BC_JNE_I: return BC_JEQ_I;
+        case BC_JLT_I: return BC_JGE_I;
+        case BC_JGE_I: return BC_JLT_I;
+        case BC_JGT_I: return BC_JLE_I;
+        case BC_JLE_I: return BC_JGT_I;
+        case BC_JEQ_IK: return BC_JNE_IK;
+        case BC_JNE_IK: return BC_JEQ_IK;
+        case BC_JLT_IK: return BC_JGE_IK;
+        case BC_JGE_IK: return BC_JLT_IK;
+        case BC_JGT_IK: return BC_JLE_IK;
+        case BC_JLE_IK: return BC_JGT_IK;
+        default: return op;
+    }
+}
+
+// Emit a jump taken when the test holds, or fails, without its target
+static void emit_test(const Test* test, const bool holds) {
+    const BytecodeOp op = holds ? test->op : inverse(test->op);
+    emit2(op, test->a);
+    if (op != BC_JNZ_I && op != BC_JZ_I && op != BC_JNZ_D && op != BC_JZ_D) emit(test->b);
+}
+
+static Test branch_test(const int cond) {
+    const IrInst* inst = &ir->insts[cond];
+    if (!fused[cond]) return (Test){is_int(cond) ? BC_JNZ_I : BC_JNZ_D, registers[cond], 0};
+    const int a = ir_resolve(ir, inst->args[0]);
+    const int b = ir_resolve(ir, inst->args[1]);
+    if (small_const(b)) {
+        return (Test){compare_op(inst->op, BC_JEQ_IK), registers[a], (int32_t)ir->insts[b].value.integer};
+    }
+    if (small_const(a)) {
+        return (Test){compare_op(swapped(inst->op), BC_JEQ_IK), registers[b], (int32_t)ir->insts[a].value.integer};
+    }
+    return (Test){compare_op(inst->op, BC_JEQ_I), registers[a], registers[b]};
+}
+
+static void compile_branch(const int b, const int next) {
+    const IrBlock* block = &ir->blocks[b];
+    const Test test = branch_test(ir_resolve(ir, block->cond));
+    const int taken = block->succ[0];
+    const int other = block->succ[1];
+    const bool taken_copies = edge_copies(b, taken, nullptr) > 0;
+    const bool other_copies = edge_copies(b, other, nullptr) > 0;
+
+    if (!taken_copies && !other_copies) {
+        if (taken == next) {
+            emit_test(&test, false);
+            emit_target(other);
+        } else {
+            emit_test(&test, true);
+            emit_target(taken);
+            if (other != next) {
+                emit(BC_JMP);
+                emit_target(other);
+            }
+        }
+    } else if (!taken_copies) {
+        emit_test(&test, true);
+        emit_target(taken);
+        emit_edge(b, other, next);
+    } else if (!other_copies) {
+        emit_test(&test, false);
+        emit_target(other);
+        emit_edge(b, taken, next);
+    } else {
+        emit_test(&test, false);
+        const int skip = out.length;
+        emit(-1);
+        emit_edge(b, taken, -1);
+        out.code[skip] = out.length;
+        emit_edge(b, other, next);
+    }
+}
+
+static void compile_terminator(const int b, const int next) {
+    const IrBlock* block = &ir->blocks[b];
+    switch (block->term) {
+        case TERM_JUMP:
+            emit_edge(b, block->succ[0], next);
+            return;
+        case TERM_BRANCH:
+            compile_branch(b, next);
+            return;
+        case TERM_EXIT: {
+            const int status = ir_resolve(ir, block->cond);
+            emit2(is_int(status) ? BC_EXIT_I : BC_EXIT_D, registers[status]);
+            return;
+        }
+        default:
+            emit(BC_RETURN);
+            return;
+    }
+}
+
+// The view of a builtin's string operand, loaded into a scratch view unless it is one
+static int operand_view(const int slot, const Lexeme text, const int scratch) {
+    if (is_view(slot)) return string_slots[slot];
+    if (slot >= 0) {
+        emit3(BC_VIEW_S, scratch, string_slots[slot]);
+    } else {
+        const int offset = add_literal(text, false);
+        emit4(BC_VIEW_TEXT, scratch, offset, (int)strlen(out.text + offset));
+    }
+    return scratch;
+}
+
+static void compile_builtin(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const bool to_view = inst->op == IR_SLICE_STRING || inst->op == IR_SPLIT_STRING;
+    if (!to_view && registers[id] < 0) return;
+    const int a = operand_view(inst->source, inst->text, scratch_view);
+    const int b = inst->op == IR_SLICE_STRING || inst->op == IR_LENGTH_STRING
+                      ? -1
+                      : operand_view(inst->other, inst->other_text, scratch_view + 1);
+    switch (inst->op) {
+        case IR_SLICE_STRING:
+            emit4(BC_SLICE, string_slots[inst->slot], a, reg(inst->args[0]));
+            emit(reg(inst->args[1]));
+            return;
+        case IR_SPLIT_STRING:
+            emit4(BC_SPLIT, string_slots[inst->slot], a, b);
+            emit(reg(inst->args[0]));
+            return;
+        case IR_LENGTH_STRING:
+            emit3(BC_LEN, registers[id], a);
+            return;
+        case IR_FIND_STRING:
+            emit4(BC_FIND, registers[id], a, b);
+            emit(reg(inst->args[0]));
+            return;
+        default:
+            emit4(inst->op == IR_COMPARE_STRING ? BC_CMP : BC_EQ_S, registers[id], a, b);
+            return;
+    }
+}
+
+// --- Driver -----------------------------------------------------------------
+
+Bytecode bytecode_compile(const IrProgram* program, const char* precomputed, const size_t precomputed_length) {
+    ir = program;
+    out = (Bytecode){0};
+    cfg = cfg_analyze(ir);
+    registers = ir_allocate((size_t)ir->inst_count, sizeof(int));
+    for (int i = 0; i < ir->inst_count; i++) registers[i] = -1;
+    uses = ir_allocate((size_t)ir->inst_count, sizeof(int));
+    fused = ir_allocate((size_t)ir->inst_count, sizeof(bool));
+    block_offsets = ir_allocate((size_t)ir->block_count, sizeof(int));
+    string_slots = ir_allocate((size_t)ir->symbol_count, sizeof(int));
+    for (int slot = 0; slot < ir->symbol_count; slot++) {
+        if (ir->symbols[slot].type == TYPE_STRING) string_slots[slot] = out.string_count++;
+        if (ir->symbols[slot].type == TYPE_VIEW) string_slots[slot] = out.view_count++;
+        if (ir->symbols[slot].type == TYPE_INT_ARRAY || ir->symbols[slot].type == TYPE_DOUBLE_ARRAY) {
+            string_slots[slot] = out.array_count++;
+        }
+        if (ir->symbols[slot].type == TYPE_DOUBLE_MAP || ir->symbols[slot].type == TYPE_STRING_MAP) {
+            string_slots[slot] = out.map_count++;
+        }
+    }
+    scratch_view = out.view_count;
+    out.view_count += 2;
+
+    add_text(precomputed, precomputed_length);
+    out.precomputed_length = precomputed_length;
+
+    count_uses();
+    assign_registers();
+    for (int i = 0; i < cfg.order_count; i++) {
+        const int b = cfg.order[i];
+        block_offsets[b] = out.length;
+        for (int id = ir->blocks[b].first; id >= 0; id = ir->insts[id].next) {
+            compile_instruction(id);
+        }
+        compile_terminator(b, i + 1 < cfg.order_count ? cfg.order[i + 1] : -1);
+    }
+    for (int i = 0; i < fixup_count; i++) {
+        out.code[fixups[i].at] = block_offsets[fixups[i].block];
+    }
+
+    free(registers);
+    free(uses);
+    free(fused);
+    free(block_offsets);
+    free(string_slots);
+    free(fixups);
+    cfg_free(&cfg);
+    fixups = nullptr;
+    fixup_count = fixup_capacity = 0;
+    ir = nullptr;
+    return out;
+}
+
+void bytecode_free(Bytecode* bytecode) {
+    free(bytecode->code);
+    free(bytecode->registers);
+    free(bytecode->text);
+    *bytecode = (Bytecode){0};
+}
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cfg.h"
+
+static void add_loop_block(IrLoop* loop, const int block) {
+    if (loop->block_count >= loop->block_capacity) {
+        loop->block_capacity = loop->block_capacity ? loop->block_capacity * 2 : 8;
+        loop->blocks = ir_reallocate(loop->blocks, (size_t)loop->block_capacity, sizeof(int));
+    }
+    loop->blocks[loop->block_count++] = block;
+}
+
+// Depth-first search from the entry, recording blocks in reverse postorder
+static void compute_order(const IrProgram* ir, Cfg* cfg) {
+    const int count = ir->block_count;
+    bool* visited = ir_allocate((size_t)count, sizeof(bool));
+    int* stack = ir_allocate((size_t)count, sizeof(int));
+    int* next_succ = ir_allocate((size_t)count, sizeof(int));
+    int* postorder = ir_allocate((size_t)count, sizeof(int));
+    int post_count = 0;
+
+    int top = 0;
+    stack[top++] = 0;
+    visited[0] = true;
+    while (top > 0) {
+        const int b = stack[top - 1];
+        const IrBlock* block = &ir->blocks[b];
+        if (next_succ[b] < ir_succ_count(block)) {
+            const int succ = block->succ[next_succ[b]++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                stack[top++] = succ;
+            }
+        } else {
+            postorder[post_count++] = b;
+            top--;
+        }
+    }
+
+    for (int i = 0; i < post_count; i++) {
+        cfg->order[i] = postorder[post_count - 1 - i];
+    }
+    cfg->order_count = post_count;
+    free(visited);
+    free(stack);
+    free(next_succ);
+    free(postorder);
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+static void compute_dominators(const IrProgram* ir, Cfg* cfg) {
+    int* rank = ir_allocate((size_t)ir->block_count, sizeof(int));
+    for (int b = 0; b < ir->block_count; b++) rank[b] = -1;
+    for (int i = 0; i < cfg->order_count; i++) rank[cfg->order[i]] = i;
+
+    for (int b = 0; b < ir->block_count; b++) cfg->idom[b] = -1;
+    cfg->idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < cfg->order_count; i++) {
+            const int b = cfg->order[i];
+            const IrBlock* block = &ir->blocks[b];
+            int idom = -1;
+            for (int p = 0; p < block->pred_count; p++) {
+                int pred = block->preds[p];
+                if (rank[pred] < 0 || cfg->idom[pred] < 0) continue;
+                if (idom < 0) {
+                    idom = pred;
+                    continue;
+                }
+                while (pred != idom) {
+                    while (rank[pred] > rank[idom]) pred = cfg->idom[pred];
+                    while (rank[idom] > rank[pred]) idom = cfg->idom[idom];
+                }
+            }
+            if (idom != cfg->idom[b]) {
+                cfg->idom[b] = idom;
+                changed = true;
+            }
+        }
+    }
+    cfg->idom[0] = -1;
+    free(rank);
+}
+
+// A loop per header with back edges; headers are visited in reverse
+// postorder, so enclosing loops are found first and inner loops take over
+// loop_of for their own blocks
+static void find_loops(const IrProgram* ir, Cfg* cfg) {
+    int* stamp = ir_allocate((size_t)ir->block_count, sizeof(int));
+    int* worklist = ir_allocate((size_t)ir->block_count, sizeof(int));
+    int loop_capacity = 0;
+
+    for (int i = 0; i < cfg->order_count; i++) {
+        const int header = cfg->order[i];
+        const IrBlock* block = &ir->blocks[header];
+        bool has_latch = false;
+        for (int p = 0; p < block->pred_count; p++) {
+            const int pred = block->preds[p];
+            if ((cfg->idom[pred] >= 0 || pred == 0) && cfg_dominates(cfg, header, pred)) has_latch = true;
+        }
+        if (!has_latch) continue;
+
+        if (cfg->loop_count >= loop_capacity) {
+            loop_capacity = loop_capacity ? loop_capacity * 2 : 8;
+            cfg->loops = ir_reallocate(cfg->loops, (size_t)loop_capacity, sizeof(IrLoop));
+        }
+        const int id = cfg->loop_count++;
+        IrLoop* loop = &cfg->loops[id];
+        memset(loop, 0, sizeof(IrLoop));
+        loop->header = header;
+        loop->preheader = -1;
+        loop->parent = cfg->loop_of[header];
+        loop->depth = loop->parent >= 0 ? cfg->loops[loop->parent].depth + 1 : 1;
+
+        // Walk back from the latches to the header
+        stamp[header] = id + 1;
+        add_loop_block(loop, header);
+        int count = 0;
+        for (int p = 0; p < block->pred_count; p++) {
+            const int pred = block->preds[p];
+            if ((cfg->idom[pred] >= 0 || pred == 0) && cfg_dominates(cfg, header, pred) && stamp[pred] != id + 1) {
+                stamp[pred] = id + 1;
+                add_loop_block(loop, pred);
+                worklist[count++] = pred;
+            }
+        }
+        while (count > 0) {
+            const IrBlock* member = &ir->blocks[worklist[--count]];
+            for (int p = 0; p < member->pred_count; p++) {
+                const int pred = member->preds[p];
+                if (stamp[pred] != id + 1) {
+                    stamp[pred] = id + 1;
+                    add_loop_block(loop, pred);
+                    worklist[count++] = pred;
+                }
+            }
+        }
+        for (int b = 0; b < loop->block_count; b++) {
+            cfg->loop_of[loop->blocks[b]] = id;
+        }
+    }
+    free(stamp);
+    free(worklist);
+}
+
+Cfg cfg_analyze(const IrProgram* ir) {
+    Cfg cfg = {0};
+    cfg.block_capacity = ir->block_count;
+    cfg.order = ir_allocate((size_t)ir->block_count, sizeof(int));
+    cfg.idom = ir_allocate((size_t)ir->block_count, sizeof(int));
+    cfg.loop_of = ir_allocate((size_t)ir->block_count, sizeof(int));
+    for (int b = 0; b < ir->block_count; b++) cfg.loop_of[b] = -1;
+
+    compute_order(ir, &cfg);
+    compute_dominators(ir, &cfg);
+    find_loops(ir, &cfg);
+    return cfg;
+}
+
+bool cfg_dominates(const Cfg* cfg, const int a, int b) {
+    while (b >= 0) {
+        if (b == a) return true;
+        b = cfg->idom[b];
+    }
+    return false;
+}
+
+bool cfg_in_loop(const Cfg* cfg, const int block, const int loop) {
+    for (int l = cfg->loop_of[block]; l >= 0; l = cfg->loops[l].parent) {
+        if (l == loop) return true;
+    }
+    return false;
+}
+
+int cfg_preheader(IrProgram* ir, Cfg* cfg, const int loop) {
+    if (cfg->loops[loop].preheader >= 0) return cfg->loops[loop].preheader;
+    const int header = cfg->loops[loop].header;
+
+    int outside = 0;
+    int entry = -1;
+    for (int p = 0; p < ir->blocks[header].pred_count; p++) {
+        const int pred = ir->blocks[header].preds[p];
+        if (!cfg_in_loop(cfg, pred, loop)) {
+            outside++;
+            entry = pred;
+        }
+    }
+    if (outside == 1 && ir->blocks[entry].term == TERM_JUMP) {
+        cfg->loops[loop].preheader = entry;
+        return entry;
+    }
+
+    const int preheader = ir_new_block(ir);
+    if (preheader >= cfg->block_capacity) {
+        cfg->block_capacity = cfg->block_capacity * 2 + 1;
+        cfg->order = ir_reallocate(cfg->order, (size_t)cfg->block_capacity, sizeof(int));
+        cfg->idom = ir_reallocate(cfg->idom, (size_t)cfg->block_capacity, sizeof(int));
+        cfg->loop_of = ir_reallocate(cfg->loop_of, (size_t)cfg->block_capacity, sizeof(int));
+    }
+    IrBlock* block = &ir->blocks[header];
+    IrBlock* pre = &ir->blocks[preheader];
+    pre->term = TERM_JUMP;
+    pre->succ[0] = header;
+    pre->sealed = true;
+    pre->loop_depth = block->loop_depth;
+
+    // Outside entries move to the preheader, in order, and the phis they fed
+    // are split: the preheader merges the outside values and the header takes
+    // that merge as the value of its single new entry
+    for (int id = block->first; id >= 0 && ir->insts[id].op == IR_PHI; id = ir->insts[id].next) {
+        IrInst* phi = &ir->insts[id];
+        int* outer_args = arena_alloc(ir->arena, sizeof(int) * (size_t)outside);
+        int kept = 0;
+        int moved = 0;
+        for (int p = 0; p < block->pred_count; p++) {
+            if (cfg_in_loop(cfg, block->preds[p], loop)) {
+                phi->phi_args[kept++] = phi->phi_args[p];
+            } else {
+                outer_args[moved++] = phi->phi_args[p];
+            }
+        }
+        int value = outer_args[0];
+        if (outside > 1) {
+            value = ir_append(ir, preheader, IR_PHI, phi->type, -1, -1);
+            ir->insts[value].phi_args = outer_args;
+            ir->insts[value].phi_count = outside;
+            ir->insts[value].line = ir->insts[id].line;
+            phi = &ir->insts[id];
+        }
+        phi->phi_args[kept] = value;
+        phi->phi_count = kept + 1;
+    }
+
+    int kept = 0;
+    for (int p = 0; p < block->pred_count; p++) {
+        const int pred = block->preds[p];
+        if (cfg_in_loop(cfg, pred, loop)) {
+            block->preds[kept++] = pred;
+            continue;
+        }
+        IrBlock* source = &ir->blocks[pred];
+        for (int s = 0; s < ir_succ_count(source); s++) {
+            if (source->succ[s] == header) source->succ[s] = preheader;
+        }
+        ir_add_pred(ir, preheader, pred);
+        block = &ir->blocks[header];
+    }
+    block->preds[kept++] = preheader;
+    block->pred_count = kept;
+
+    // The preheader takes the header's place in the dominator tree and order
+    const int parent = cfg->loops[loop].parent;
+    cfg->idom[preheader] = cfg->idom[header];
+    cfg->idom[header] = preheader;
+    cfg->loop_of[preheader] = parent;
+    for (int l = parent; l >= 0; l = cfg->loops[l].parent) {
+        add_loop_block(&cfg->loops[l], preheader);
+    }
+    int position = 0;
+    while (cfg->order[position] != header) position++;
+    memmove(&cfg->order[position + 1], &cfg->order[position], sizeof(int) * (size_t)(cfg->order_count - position));
+    cfg->order[position] = preheader;
+    cfg->order_count++;
+
+    cfg->loops[loop].preheader = preheader;
+    return preheader;
+}
+
+void cfg_free(Cfg* cfg) {
+    for (int l = 0; l < cfg->loop_count; l++) {
+        free(cfg->loops[l].blocks);
+    }
+    free(cfg->loops);
+    free(cfg->order);
+    free(cfg->idom);
+    free(cfg->loop_of);
+    memset(cfg, 0, sizeof(Cfg));
+}
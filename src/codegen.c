@@ -1,12 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <math.h>
 #include "codegen.h"
+#include "cfg.h"
+#include "intern.h"
+#include "runtime.h"
 #include <string.h>
 static FILE* output;
 static int indent_level = 1;
-static int temp_var_counter = 0;
-static Symbol symbol_table[1024];
-static int symbol_count = 0;
+static const Symbol* symbols;   // Variables by slot, as resolved by semantic analysis
+static const char* precomputed; // Output worked out at compile time
+static size_t precomputed_length;
 
 // Helper function to add proper indentation
 static void add_indent() {
@@ -15,6 +20,60 @@ static void add_indent() {
     }
 }
 
+// One byte of text inside a C string literal
+static void emit_string_char(const unsigned char c) {
+    switch (c) {
+        case '\n': fprintf(output, "\\n"); break;
+        case '\t': fprintf(output, "\\t"); break;
+        case '\\': fprintf(output, "\\\\"); break;
+        case '"': fprintf(output, "\\\""); break;
+        case '?': fprintf(output, "\\?"); break;
+        default:
+            if (c < ' ' || c >= 127) {
+                fprintf(output, "\\%03o", c);
+            } else {
+                fputc(c, output);
+            }
+            break;
+    }
+}
+
+// Print a string literal through the runtime. Literals used to be printf
+// formats, so each %% still prints as %.
+static void emit_out_literal(const Lexeme text) {
+    char* decoded = malloc((size_t)text.length + 1);
+    if (decoded == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    const size_t length = lexeme_decode_string(text, decoded);
+    size_t printed = 0;
+    fprintf(output, "silc_out_text(\"");
+    for (size_t i = 0; i < length; i++) {
+        emit_string_char((unsigned char)decoded[i]);
+        printed++;
+        if (decoded[i] == '%' && i + 1 < length && decoded[i + 1] == '%') i++;
+    }
+    fprintf(output, "\", %zu);\n", printed);
+    free(decoded);
+}
+
+// A string literal's value as the text and length arguments of a runtime
+// call. The value ends at the first NUL, where strcpy used to stop.
+static void emit_string_text(const Lexeme text) {
+    char* decoded = malloc((size_t)text.length + 1);
+    if (decoded == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    lexeme_decode_string(text, decoded);
+    const size_t length = strlen(decoded);
+    fprintf(output, "\"");
+    for (size_t i = 0; i < length; i++) emit_string_char((unsigned char)decoded[i]);
+    fprintf(output, "\", %zu", length);
+    free(decoded);
+}
+
 void codegen_init(const char* output_file) {
     output = fopen(output_file, "w");
     if (output == NULL) {
@@ -23,121 +82,611 @@ void codegen_init(const char* output_file) {
     }
 }
 
-// Function to add a variable to the symbol table
-static void add_symbol(const char* name, const VarType type) {
-    if (symbol_count < 1024) {
-        strcpy(symbol_table[symbol_count].name, name);
-        symbol_table[symbol_count].type = type;
-        symbol_count++;
+static const char* operator_text(const Ttype op) {
+    switch (op) {
+        case TOKEN_PLUS: return "+";
+        case TOKEN_MINUS: return "-";
+        case TOKEN_MUL: return "*";
+        case TOKEN_DIV: return "/";
+        case TOKEN_MOD: return "%";
+        case TOKEN_EQEQ: return "==";
+        case TOKEN_NEQ: return "!=";
+        case TOKEN_LT: return "<";
+        case TOKEN_GT: return ">";
+        case TOKEN_LTE: return "<=";
+        case TOKEN_GTE: return ">=";
+        case TOKEN_AND: return "&&";
+        case TOKEN_OR: return "||";
+        case TOKEN_NOT: return "!";
+        case TOKEN_XOR: return "^";
+        case TOKEN_BITWISE_OR: return "|";
+        case TOKEN_BITWISE_AND: return "&";
+        case TOKEN_BITWISE_NOT: return "~";
+        case TOKEN_LSHIFT: return "<<";
+        case TOKEN_RSHIFT: return ">>";
+        default:
+            fprintf(stderr, "Error: Invalid operator in expression\n");
+            exit(EXIT_FAILURE);
     }
 }
 
-// Function to get a variable's type from the symbol table
-static VarType get_symbol_type(const char* name) {
-    for (int i = 0; i < symbol_count; i++) {
-        if (strcmp(symbol_table[i].name, name) == 0) {
-            return symbol_table[i].type;
-        }
+// Operators that C only defines on integers; double operands are truncated to int64_t
+static bool is_integer_operator(const Ttype op) {
+    return op == TOKEN_MOD || op == TOKEN_XOR || op == TOKEN_BITWISE_OR || op == TOKEN_BITWISE_AND ||
+           op == TOKEN_BITWISE_NOT || op == TOKEN_LSHIFT || op == TOKEN_RSHIFT;
+}
+
+// Emit an operand, truncated when its operator needs an integer and it is not one already
+static void codegen_operand(const Expression* expr, const bool as_integer) {
+    if (as_integer && expr->type != TYPE_INT) fprintf(output, "(int64_t)");
+    codegen_expression(expr);
+}
+
+// Integer + - * and negation wrap at 64 bits, as in the other backends, so
+// they are done in uint64_t, where C defines the wrap
+static bool wraps(const Expression* expr) {
+    if (expr->type != TYPE_INT) return false;
+    if (expr->kind == EXPR_UNARY) return expr->op == TOKEN_MINUS;
+    return expr->kind == EXPR_BINARY &&
+           (expr->op == TOKEN_PLUS || expr->op == TOKEN_MINUS || expr->op == TOKEN_MUL);
+}
+
+// A variable is named with its slot, as in the IR emitter, so that no name
+// from the runtime or the C library can clash with it
+static void emit_variable(const int slot) {
+    const Lexeme name = intern_name(symbols[slot].symbol);
+    fprintf(output, "%.*s_%d", name.length, name.text, slot);
+}
+
+// Emit the value of an assignment without the target
+static void codegen_assignment(const Expression* expr) {
+    emit_variable(expr->assign.slot);
+    fprintf(output, " = ");
+    codegen_expression(expr->assign.value);
+}
+
+// String expressions become a line of runtime calls that write into a
+// variable, or into a temporary when there is none: a static SilcString
+// declared where it is needed. A concatenation sets its first operand and
+// appends the rest, so `s = s + t` appends in place; when a later operand
+// reads or assigns the target, the result is built in a temporary and
+// moved over.
+//
+// The builtins read their string operands as SilcViews. A concatenation
+// read that way is built by the same calls, joined into a comma expression,
+// in one of the view temporaries declared at the top of main.
+
+typedef struct {
+    int slot;           // -1 for a temporary, -2 for a view temporary
+    uint32_t symbol;    // Name, or number of the temporary
+} StringTarget;
+
+static int string_calls;        // Calls on the current line
+static uint32_t string_temp_count;
+static uint32_t view_temp_count;
+static int view_depth;          // Views being built inside an expression
+
+static void begin_string_call() {
+    if (string_calls++ > 0) fprintf(output, view_depth > 0 ? ", " : " ");
+}
+
+static void end_string_call() {
+    fprintf(output, view_depth > 0 ? ")" : ");");
+}
+
+static void emit_string_target(const StringTarget target) {
+    if (target.slot == -2) {
+        fprintf(output, "&view_temps[%u]", target.symbol);
+    } else if (target.slot < 0) {
+        fprintf(output, "&string_temp%u", target.symbol);
+    } else {
+        fprintf(output, "&");
+        emit_variable(target.slot);
     }
-    return TYPE_DOUBLE; // Default to double if not found
 }
 
+static StringTarget new_string_temp() {
+    begin_string_call();
+    fprintf(output, "static SilcString string_temp%u;", string_temp_count);
+    return (StringTarget){-1, string_temp_count++};
+}
 
-void codegen_expression(const Expression* expr) {
-    if (!expr || expr->len == 0) {
-        fprintf(output, "0");  // Default for empty expressions
+// Whether an expression reads or assigns a string variable
+static bool mentions_slot(const Expression* expr, const int slot) {
+    switch (expr->kind) {
+        case EXPR_IDENT:
+            return expr->ident.slot == slot;
+        case EXPR_ASSIGN:
+            return expr->assign.slot == slot || mentions_slot(expr->assign.value, slot);
+        case EXPR_BINARY:
+            return mentions_slot(expr->binary.left, slot) || mentions_slot(expr->binary.right, slot);
+        case EXPR_CALL:
+            for (int i = 0; i < expr->call.count; i++) {
+                if (mentions_slot(expr->call.args[i], slot)) return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+static void codegen_string_into(const Expression* expr, StringTarget target);
+static void codegen_view(const Expression* expr);
+
+// silc_string_set or silc_string_append with a literal, a variable, a view
+// or an assignment, which runs first
+static void codegen_string_call(const char* function, const StringTarget target, const Expression* operand) {
+    StringTarget source;
+    switch (operand->kind) {
+        case EXPR_STRING:
+            begin_string_call();
+            fprintf(output, "silc_string_%s_text(", function);
+            emit_string_target(target);
+            fprintf(output, ", ");
+            emit_string_text(operand->string);
+            end_string_call();
+            return;
+        case EXPR_CALL:
+            begin_string_call();
+            fprintf(output, "silc_string_%s_view(", function);
+            emit_string_target(target);
+            fprintf(output, ", ");
+            codegen_view(operand);
+            end_string_call();
+            return;
+        case EXPR_IDENT:
+            source = (StringTarget){operand->ident.slot, operand->ident.symbol};
+            break;
+        case EXPR_ASSIGN:
+            source = (StringTarget){operand->assign.slot, operand->assign.target};
+            codegen_string_into(operand->assign.value, source);
+            break;
+        default:
+            fprintf(stderr, "Error: Invalid string expression\n");
+            exit(EXIT_FAILURE);
+    }
+    if (strcmp(function, "set") == 0 && source.slot == target.slot) return;
+    begin_string_call();
+    fprintf(output, "silc_string_%s(", function);
+    emit_string_target(target);
+    fprintf(output, ", ");
+    emit_string_target(source);
+    end_string_call();
+}
+
+static void codegen_string_append(const Expression* expr, const StringTarget target) {
+    if (expr->kind == EXPR_BINARY) {
+        codegen_string_append(expr->binary.left, target);
+        codegen_string_append(expr->binary.right, target);
+    } else {
+        codegen_string_call("append", target, expr);
+    }
+}
+
+static void codegen_string_into(const Expression* expr, const StringTarget target) {
+    if (expr->kind != EXPR_BINARY) {
+        codegen_string_call("set", target, expr);
+    } else if (target.slot >= 0 && mentions_slot(expr->binary.right, target.slot)) {
+        const StringTarget temp = new_string_temp();
+        codegen_string_into(expr, temp);
+        begin_string_call();
+        fprintf(output, "silc_string_move(");
+        emit_string_target(target);
+        fprintf(output, ", ");
+        emit_string_target(temp);
+        end_string_call();
+    } else {
+        codegen_string_into(expr->binary.left, target);
+        codegen_string_append(expr->binary.right, target);
+    }
+}
+
+// The assignments in a string expression whose value is not used
+static void codegen_string_effects(const Expression* expr) {
+    if (expr->kind == EXPR_BINARY) {
+        codegen_string_effects(expr->binary.left);
+        codegen_string_effects(expr->binary.right);
+    } else if (expr->kind == EXPR_ASSIGN) {
+        codegen_string_into(expr->assign.value, (StringTarget){expr->assign.slot, expr->assign.target});
+    }
+}
+
+// Print a string expression other than a literal
+static void codegen_out_string(const Expression* expr) {
+    StringTarget source;
+    if (expr->kind == EXPR_CALL) {
+        begin_string_call();
+        fprintf(output, "silc_out_view(");
+        codegen_view(expr);
+        fprintf(output, ");");
         return;
     }
+    if (expr->kind == EXPR_IDENT) {
+        source = (StringTarget){expr->ident.slot, expr->ident.symbol};
+    } else if (expr->kind == EXPR_ASSIGN) {
+        source = (StringTarget){expr->assign.slot, expr->assign.target};
+        codegen_string_into(expr->assign.value, source);
+    } else {
+        source = new_string_temp();
+        codegen_string_into(expr, source);
+    }
+    begin_string_call();
+    fprintf(output, "silc_out_string(");
+    emit_string_target(source);
+    fprintf(output, ");");
+}
 
-    for (int i = 0; i < expr->len; i++) {
-        switch (expr->token_types[i]) {
-            case TOKEN_NUMBER:
-                if (strchr(expr->token_values[i], '.') == NULL) {
-                    fprintf(output, " %s.0", expr->token_values[i]);
-                } else {
-                    fprintf(output, " %s", expr->token_values[i]);
-                }
-                break;
-            case TOKEN_MOD:
-            case TOKEN_XOR:
-            case TOKEN_BITWISE_OR:
-            case TOKEN_BITWISE_AND:
-            case TOKEN_LSHIFT:
-            case TOKEN_RSHIFT:
-                // Cast left operand to long
-                if (i > 0) {
-                    if (expr->token_types[i-1] == TOKEN_NUMBER) {
-                        const unsigned long seek_len = strlen(expr->token_values[i-1]) + 4; // " " + number + ".0"
-                        fseek(output, -seek_len, SEEK_CUR);
-                        fprintf(output, " (long)(%s.0)", expr->token_values[i-1]);
-                    } else if (expr->token_types[i-1] == TOKEN_IDENT) {
-                        const unsigned long seek_len = strlen(expr->token_values[i-1]) + 1; // " " + identifier
-                        fseek(output, -seek_len, SEEK_CUR);
-                        fprintf(output, " (long)(%s)", expr->token_values[i-1]);
-                    }
-                }
+// A string operand as a SilcView. Operands cannot assign, so views taken
+// first still hold when the later ones are built.
+static void codegen_view(const Expression* expr) {
+    switch (expr->kind) {
+        case EXPR_STRING:
+            fprintf(output, "silc_view_text(");
+            emit_string_text(expr->string);
+            fprintf(output, ")");
+            return;
+        case EXPR_IDENT:
+            fprintf(output, "silc_view(&");
+            emit_variable(expr->ident.slot);
+            fprintf(output, ")");
+            return;
+        case EXPR_CALL: {
+            Expression* const* args = expr->call.args;
+            if (expr->call.builtin == BUILTIN_SLICE) {
+                fprintf(output, "silc_slice(");
+                codegen_view(args[0]);
+                fprintf(output, ", ");
+                codegen_operand(args[1], true);
+            } else {
+                fprintf(output, "silc_split(");
+                codegen_view(args[0]);
+                fprintf(output, ", ");
+                codegen_view(args[1]);
+            }
+            fprintf(output, ", ");
+            codegen_operand(args[2], true);
+            fprintf(output, ")");
+            return;
+        }
+        case EXPR_BINARY: {
+            const int outer_calls = string_calls;
+            const StringTarget temp = {-2, view_temp_count++};
+            string_calls = 0;
+            view_depth++;
+            fprintf(output, "(");
+            codegen_string_into(expr, temp);
+            begin_string_call();
+            fprintf(output, "silc_view(");
+            emit_string_target(temp);
+            fprintf(output, "))");
+            view_depth--;
+            string_calls = outer_calls;
+            return;
+        }
+        default:
+            fprintf(stderr, "Error: Invalid string expression\n");
+            exit(EXIT_FAILURE);
+    }
+}
 
-                // Print the C operator
-                if (expr->token_types[i] == TOKEN_MOD) fprintf(output, " %%");
-                else if (expr->token_types[i] == TOKEN_XOR) fprintf(output, " ^");
-                else if (expr->token_types[i] == TOKEN_BITWISE_OR) fprintf(output, " |");
-                else if (expr->token_types[i] == TOKEN_BITWISE_AND) fprintf(output, " &");
-                else if (expr->token_types[i] == TOKEN_LSHIFT) fprintf(output, " <<");
-                else if (expr->token_types[i] == TOKEN_RSHIFT) fprintf(output, " >>");
-
-                // Cast the right operand and skip it in the next loop iteration
-                if (i + 1 < expr->len) {
-                     if (expr->token_types[i+1] == TOKEN_NUMBER) {
-                        fprintf(output, " (long)(%s.0)", expr->token_values[i+1]);
-                     } else if (expr->token_types[i+1] == TOKEN_IDENT) {
-                        fprintf(output, " (long)(%s)", expr->token_values[i+1]);
-                     }
-                    i++; // Manually advance loop counter
-                }
+// Arrays are static structs of contiguous elements, like strings, and are
+// copied whole on assignment through the runtime
+static const char* array_prefix(const VarType type) {
+    return type == TYPE_INT_ARRAY ? "silc_int_array" : "silc_double_array";
+}
+
+// Set an array variable to a literal, a variable or an assignment, which runs first
+static void codegen_array_into(const Expression* expr, const int slot) {
+    const VarType type = symbols[slot].type;
+    switch (expr->kind) {
+        case EXPR_ARRAY:
+            begin_string_call();
+            fprintf(output, "%s_set_items(&", array_prefix(type));
+            emit_variable(slot);
+            if (expr->array.count == 0) {
+                fprintf(output, ", NULL, 0);");
+                return;
+            }
+            fprintf(output, ", (%s[]){", type == TYPE_INT_ARRAY ? "int64_t" : "double");
+            for (int i = 0; i < expr->array.count; i++) {
+                if (i > 0) fprintf(output, ", ");
+                codegen_expression(expr->array.elements[i]);
+            }
+            fprintf(output, "}, %d);", expr->array.count);
+            return;
+        case EXPR_IDENT:
+            if (expr->ident.slot == slot) return;
+            begin_string_call();
+            fprintf(output, "%s_set(&", array_prefix(type));
+            emit_variable(slot);
+            fprintf(output, ", &");
+            emit_variable(expr->ident.slot);
+            fprintf(output, ");");
+            return;
+        case EXPR_ASSIGN:
+            codegen_array_into(expr->assign.value, expr->assign.slot);
+            if (expr->assign.slot == slot) return;
+            begin_string_call();
+            fprintf(output, "%s_set(&", array_prefix(type));
+            emit_variable(slot);
+            fprintf(output, ", &");
+            emit_variable(expr->assign.slot);
+            fprintf(output, ");");
+            return;
+        default:
+            fprintf(stderr, "Error: Invalid array expression\n");
+            exit(EXIT_FAILURE);
+    }
+}
+
+// Maps are static SilcMaps, emptied by their declaration. A string key is
+// read as a view, which the runtime copies when it adds the key.
+static const char* map_prefix(const VarType type) {
+    return type == TYPE_STRING_MAP ? "silc_string_map" : "silc_double_map";
+}
+
+static const char* map_function(const Builtin builtin) {
+    switch (builtin) {
+        case BUILTIN_GET: return "get";
+        case BUILTIN_HAS: return "has";
+        case BUILTIN_PUT: return "put";
+        default: return "del";
+    }
+}
+
+static void emit_map_clear(const int slot) {
+    fprintf(output, "silc_map_clear(&");
+    emit_variable(slot);
+    fprintf(output, ");");
+}
+
+// An element, with its index checked against the length unless proven in range
+static void codegen_element(const Expression* expr) {
+    emit_variable(expr->index.slot);
+    fprintf(output, ".data[");
+    if (expr->index.in_bounds) {
+        codegen_operand(expr->index.index, true);
+    } else {
+        fprintf(output, "silc_index(");
+        codegen_operand(expr->index.index, true);
+        fprintf(output, ", ");
+        emit_variable(expr->index.slot);
+        fprintf(output, ".length, %d)", expr->line);
+    }
+    fprintf(output, "]");
+}
+
+// The builtins that return numbers
+static void codegen_call(const Expression* expr) {
+    Expression* const* args = expr->call.args;
+    switch (expr->call.builtin) {
+        case BUILTIN_LEN:
+            if (args[0]->type == TYPE_INT_ARRAY || args[0]->type == TYPE_DOUBLE_ARRAY) {
+                emit_variable(args[0]->ident.slot);
+                fprintf(output, ".length");
+                return;
+            }
+            if (args[0]->type == TYPE_DOUBLE_MAP || args[0]->type == TYPE_STRING_MAP) {
+                emit_variable(args[0]->ident.slot);
+                fprintf(output, ".count");
+                return;
+            }
+            fprintf(output, "(int64_t)");
+            codegen_view(args[0]);
+            fprintf(output, ".length");
+            return;
+        case BUILTIN_FIND:
+            fprintf(output, "silc_find(");
+            codegen_view(args[0]);
+            fprintf(output, ", ");
+            codegen_view(args[1]);
+            fprintf(output, ", ");
+            if (expr->call.count > 2) {
+                codegen_operand(args[2], true);
+            } else {
+                fprintf(output, "0");
+            }
+            fprintf(output, ")");
+            return;
+        case BUILTIN_COMPARE:
+            fprintf(output, "silc_compare(");
+            codegen_view(args[0]);
+            fprintf(output, ", ");
+            codegen_view(args[1]);
+            fprintf(output, ")");
+            return;
+        case BUILTIN_PUSH:
+            fprintf(output, "%s_push(&", array_prefix(args[0]->type));
+            emit_variable(args[0]->ident.slot);
+            fprintf(output, ", ");
+            codegen_expression(args[1]);
+            fprintf(output, ")");
+            return;
+        case BUILTIN_GET:
+        case BUILTIN_HAS:
+        case BUILTIN_PUT:
+        case BUILTIN_DEL:
+            fprintf(output, "%s_%s(&", map_prefix(args[0]->type), map_function(expr->call.builtin));
+            emit_variable(args[0]->ident.slot);
+            fprintf(output, ", ");
+            if (args[0]->type == TYPE_STRING_MAP) {
+                codegen_view(args[1]);
+            } else {
+                codegen_expression(args[1]);
+            }
+            if (expr->call.builtin == BUILTIN_PUT) {
+                fprintf(output, ", ");
+                codegen_expression(args[2]);
+            }
+            fprintf(output, ")");
+            return;
+        default:
+            fprintf(stderr, "Error: Invalid numeric expression\n");
+            exit(EXIT_FAILURE);
+    }
+}
+
+// Concatenations read as views, each needing a view temporary
+static uint32_t count_view_temps(const Expression* expr, const bool as_view) {
+    if (expr == nullptr) return 0;
+    switch (expr->kind) {
+        case EXPR_UNARY:
+            return count_view_temps(expr->unary.operand, false);
+        case EXPR_BINARY:
+            if (expr->type == TYPE_STRING) {
+                return (as_view ? 1 : 0) + count_view_temps(expr->binary.left, false) +
+                       count_view_temps(expr->binary.right, false);
+            } else {
+                const bool strings = expr->binary.left->type == TYPE_STRING;
+                return count_view_temps(expr->binary.left, strings) + count_view_temps(expr->binary.right, strings);
+            }
+        case EXPR_ASSIGN:
+            return count_view_temps(expr->assign.value, false);
+        case EXPR_CALL: {
+            uint32_t count = 0;
+            for (int i = 0; i < expr->call.count; i++) {
+                count += count_view_temps(expr->call.args[i], expr->call.args[i]->type == TYPE_STRING);
+            }
+            return count;
+        }
+        case EXPR_ARRAY: {
+            uint32_t count = 0;
+            for (int i = 0; i < expr->array.count; i++) count += count_view_temps(expr->array.elements[i], false);
+            return count;
+        }
+        case EXPR_INDEX:
+        case EXPR_STORE:
+            return count_view_temps(expr->index.index, false) + count_view_temps(expr->index.value, false);
+        default:
+            return 0;
+    }
+}
+
+static uint32_t count_statement_view_temps(const Statement* statements, const int count) {
+    uint32_t temps = 0;
+    for (int i = 0; i < count; i++) {
+        const Statement* stmt = &statements[i];
+        switch (stmt->type) {
+            case STMT_LET:
+                temps += count_view_temps(stmt->let_stmt.expr, false);
                 break;
-            case TOKEN_BITWISE_NOT:
-                fprintf(output, " ~");
-                // Cast the right operand and skip it in the next loop iteration
-                if (i + 1 < expr->len) {
-                    if (expr->token_types[i+1] == TOKEN_NUMBER) {
-                        fprintf(output, "(long)(%s.0)", expr->token_values[i+1]);
-                    } else if (expr->token_types[i+1] == TOKEN_IDENT) {
-                        fprintf(output, "(long)(%s)", expr->token_values[i+1]);
-                    }
-                    i++; // Manually advance loop counter
-                }
+            case STMT_RETURN:
+                temps += count_view_temps(stmt->ret_stmt.expr, false);
                 break;
-            case TOKEN_STRING:
-                fprintf(output, " \"%s\"", expr->token_values[i]);
+            case STMT_IF:
+                temps += count_view_temps(stmt->if_stmt.condition, false);
+                temps += count_statement_view_temps(stmt->if_stmt.if_block, stmt->if_stmt.if_count);
+                temps += count_statement_view_temps(stmt->if_stmt.else_block, stmt->if_stmt.else_count);
                 break;
-            case TOKEN_IDENT:
-            case TOKEN_PLUS:
-            case TOKEN_MINUS:
-            case TOKEN_MUL:
-            case TOKEN_DIV:
-            case TOKEN_LPAREN:
-            case TOKEN_RPAREN:
-            case TOKEN_LBRACE:
-            case TOKEN_RBRACE:
-            case TOKEN_EQ:
-            case TOKEN_EQEQ:
-            case TOKEN_NEQ:
-            case TOKEN_LT:
-            case TOKEN_GT:
-            case TOKEN_LTE:
-            case TOKEN_GTE:
-                fprintf(output, " %s", expr->token_values[i]);
+            case STMT_WHILE:
+                temps += count_view_temps(stmt->while_stmt.condition, false);
+                temps += count_statement_view_temps(stmt->while_stmt.body, stmt->while_stmt.body_count);
                 break;
-            case TOKEN_AND:
-                fprintf(output, " &&");
+            case STMT_OUT:
+                temps += count_view_temps(stmt->out_stmt.expr, false);
                 break;
-            case TOKEN_OR:
-                fprintf(output, " ||");
+            case STMT_EXPR:
+                temps += count_view_temps(stmt->expr_stmt.expr, false);
                 break;
             default:
-                fprintf(stderr, "Error: Invalid token in expression\n");
-                exit(EXIT_FAILURE);
+                break;
+        }
+    }
+    return temps;
+}
+
+// Compound nodes are parenthesized, so the C output keeps the tree's grouping
+void codegen_expression(const Expression* expr) {
+    switch (expr->kind) {
+        case EXPR_NUMBER: {
+            const Lexeme text = expr->number.text;
+            if (expr->type == TYPE_INT) {
+                fprintf(output, "%" PRId64, (int64_t)expr->number.value);
+            } else if (memchr(text.text, '.', text.length) == NULL) {
+                fprintf(output, "%.*s.0", text.length, text.text);
+            } else {
+                fprintf(output, "%.*s", text.length, text.text);
+            }
+            break;
+        }
+        case EXPR_STRING:
+            fprintf(output, "\"%.*s\"", expr->string.length, expr->string.text);
+            break;
+        case EXPR_IDENT:
+            emit_variable(expr->ident.slot);
+            break;
+        case EXPR_UNARY:
+            if (wraps(expr)) {
+                fprintf(output, "((int64_t)-(uint64_t)");
+                codegen_expression(expr->unary.operand);
+                fprintf(output, ")");
+                break;
+            }
+            fprintf(output, "(%s", operator_text(expr->op));
+            codegen_operand(expr->unary.operand, is_integer_operator(expr->op));
+            fprintf(output, ")");
+            break;
+        case EXPR_BINARY: {
+            if (expr->binary.left->type == TYPE_STRING) {
+                fprintf(output, expr->op == TOKEN_EQEQ ? "silc_equal(" : "(!silc_equal(");
+                codegen_view(expr->binary.left);
+                fprintf(output, ", ");
+                codegen_view(expr->binary.right);
+                fprintf(output, expr->op == TOKEN_EQEQ ? ")" : "))");
+                break;
+            }
+            if (wraps(expr)) {
+                fprintf(output, "((int64_t)((uint64_t)");
+                codegen_expression(expr->binary.left);
+                fprintf(output, " %s (uint64_t)", operator_text(expr->op));
+                codegen_expression(expr->binary.right);
+                fprintf(output, "))");
+                break;
+            }
+            // Shift counts are taken modulo 64, as x86-64 takes them
+            if (expr->op == TOKEN_LSHIFT || expr->op == TOKEN_RSHIFT) {
+                fprintf(output, expr->op == TOKEN_LSHIFT ? "((int64_t)((uint64_t)" : "((int64_t)");
+                codegen_operand(expr->binary.left, true);
+                fprintf(output, " %s (", operator_text(expr->op));
+                codegen_operand(expr->binary.right, true);
+                fprintf(output, expr->op == TOKEN_LSHIFT ? " & 63)))" : " & 63))");
+                break;
+            }
+            const bool as_integer = is_integer_operator(expr->op);
+            fprintf(output, "(");
+            // Division of integers still yields a double, as do literals
+            // whose sum or product leaves the int64 range
+            if ((expr->op == TOKEN_DIV || expr->type == TYPE_DOUBLE) && expr->binary.left->type == TYPE_INT &&
+                expr->binary.right->type == TYPE_INT) {
+                fprintf(output, "(double)");
+            }
+            codegen_operand(expr->binary.left, as_integer);
+            fprintf(output, " %s ", operator_text(expr->op));
+            codegen_operand(expr->binary.right, as_integer);
+            fprintf(output, ")");
+            break;
         }
+        case EXPR_ASSIGN:
+            fprintf(output, "(");
+            codegen_assignment(expr);
+            fprintf(output, ")");
+            break;
+        case EXPR_CALL:
+            codegen_call(expr);
+            break;
+        case EXPR_INDEX:
+            codegen_element(expr);
+            break;
+        case EXPR_STORE:
+            fprintf(output, "(");
+            codegen_element(expr);
+            fprintf(output, " = ");
+            codegen_expression(expr->index.value);
+            fprintf(output, ")");
+            break;
+        default:
+            fprintf(stderr, "Error: Invalid expression\n");
+            exit(EXIT_FAILURE);
     }
 }
 
@@ -148,39 +697,58 @@ static void codegen_statements(const Statement* statements, const int count) {
         add_indent();
 
         switch (stmt.type) {
-            case STMT_LET:
-                VarType type;
-                // Check if the expression is a string literal to determine type
-                if (stmt.let_stmt.expr != NULL && stmt.let_stmt.expr->len == 1 && stmt.let_stmt.expr->token_types[0] == TOKEN_STRING) {
-                    // It's a string initialization
-                    fprintf(output, "char %s[256] =", stmt.let_stmt.ident);
-                    codegen_expression(stmt.let_stmt.expr);
-                    type = TYPE_STRING;
+            case STMT_LET: {
+                const int slot = stmt.let_stmt.slot;
+                const Expression* init = stmt.let_stmt.expr;
+                const VarType type = symbols[slot].type;
+                if (type == TYPE_STRING) {
+                    // Static, so that a declaration in a loop reuses its buffer
+                    fprintf(output, "static SilcString ");
+                    emit_variable(slot);
+                    fprintf(output, ";");
+                    string_calls = 1;
+                    codegen_string_into(init, (StringTarget){slot, stmt.let_stmt.ident});
+                    fprintf(output, "\n");
+                    break;
+                }
+                if (type == TYPE_INT_ARRAY || type == TYPE_DOUBLE_ARRAY) {
+                    fprintf(output, "static %s ", type == TYPE_INT_ARRAY ? "SilcIntArray" : "SilcDoubleArray");
+                    emit_variable(slot);
+                    fprintf(output, ";");
+                    string_calls = 1;
+                    codegen_array_into(init, slot);
+                    fprintf(output, "\n");
+                    break;
+                }
+                if (type == TYPE_DOUBLE_MAP || type == TYPE_STRING_MAP) {
+                    fprintf(output, "static SilcMap ");
+                    emit_variable(slot);
+                    fprintf(output, "; ");
+                    emit_map_clear(slot);
+                    fprintf(output, "\n");
+                    break;
+                }
+                // A declaration without a value starts at zero, as in the IR
+                // paths, even when it runs again in a later iteration
+                fprintf(output, "%s ", type == TYPE_INT ? "int64_t" : "double");
+                emit_variable(slot);
+                fprintf(output, " = ");
+                if (init != NULL) {
+                    codegen_expression(init);
                 } else {
-                    // It's a double or uninitialized
-                    fprintf(output, "double %s", stmt.let_stmt.ident);
-                    if (stmt.let_stmt.expr != NULL) {
-                        fprintf(output, " =");
-                        codegen_expression(stmt.let_stmt.expr);
-                    }
-                    type = TYPE_DOUBLE;
+                    fprintf(output, "0");
                 }
                 fprintf(output, ";\n");
-                // Add the new variable to our symbol table
-                add_symbol(stmt.let_stmt.ident, type);
                 break;
+            }
 
             case STMT_RETURN:
                 if (stmt.ret_stmt.expr != NULL) {
-                    // Check if the expression is a single identifier that is a string variable
-                    if (stmt.ret_stmt.expr->len == 1 && stmt.ret_stmt.expr->token_types[0] == TOKEN_IDENT) {
-                        if (get_symbol_type(stmt.ret_stmt.expr->token_values[0]) == TYPE_STRING) {
-                            fprintf(stderr, "Error: Cannot return a string variable.\n");
-                            exit(EXIT_FAILURE);
-                        }
+                    // The parser already prevents returning string literals
+                    if (stmt.ret_stmt.expr->type == TYPE_STRING) {
+                        fprintf(stderr, "Error: Cannot return a string variable.\n");
+                        exit(EXIT_FAILURE);
                     }
-                    // The parser already prevents returning string literals.
-                    // This logic assumes returning complex expressions involving strings is also invalid.
                     fprintf(output, "exit(");
                     codegen_expression(stmt.ret_stmt.expr);
                     fprintf(output, ");\n");
@@ -213,61 +781,24 @@ static void codegen_statements(const Statement* statements, const int count) {
                 fprintf(output, "\n");
                 break;
             case STMT_OUT:
-                bool is_string_var = false;
-                bool is_string_literal = false;
-
-                if (stmt.out_stmt.expr != NULL && stmt.out_stmt.expr->len == 1) {
-                    if (stmt.out_stmt.expr->token_types[0] == TOKEN_STRING) {
-                        is_string_literal = true;
-                    } else if (stmt.out_stmt.expr->token_types[0] == TOKEN_IDENT) {
-                        if (get_symbol_type(stmt.out_stmt.expr->token_values[0]) == TYPE_STRING) {
-                            is_string_var = true;
-                        }
-                    }
-                }
+                const Expression* value = stmt.out_stmt.expr;
 
-                if (is_string_literal) {
-                    // If it's a string literal, print it directly.
-                    fprintf(output, "printf(\"%s\");\n", stmt.out_stmt.expr->token_values[0]);
-                } else if (is_string_var) {
-                    // If it's a string variable, print it using a format specifier.
-                    fprintf(output, "printf(\"%%s\\n\", %s);\n", stmt.out_stmt.expr->token_values[0]);
+                if (value->kind == EXPR_STRING) {
+                    emit_out_literal(value->string);
+                } else if (value->type == TYPE_STRING) {
+                    string_calls = 0;
+                    codegen_out_string(value);
+                    fprintf(output, "\n");
                 } else {
-                    // Existing logic for numbers and other expressions
-                    fprintf(output, "{\n");
-                    indent_level++;
-                    add_indent();
-                    fprintf(output, "double temp_val_%d =", temp_var_counter);
-                    codegen_expression(stmt.out_stmt.expr);
-                    fprintf(output, ";\n");
-                    add_indent();
-                    fprintf(output, "if (floor(temp_val_%d) == ceil(temp_val_%d)) {\n", temp_var_counter, temp_var_counter);
-                    indent_level++;
-                    add_indent();
-                    fprintf(output, "printf(\"%%.0f\\n\", temp_val_%d);\n", temp_var_counter);
-                    indent_level--;
-                    add_indent();
-                    fprintf(output, "} else {\n");
-                    indent_level++;
-                    add_indent();
-                    fprintf(output, "printf(\"%%f\\n\", temp_val_%d);\n", temp_var_counter);
-                    indent_level--;
-                    add_indent();
-                    fprintf(output, "}\n");
-                    indent_level--;
-                    add_indent();
-                    fprintf(output, "}\n");
-                    temp_var_counter++;
+                    fprintf(output, value->type == TYPE_INT ? "silc_out_int(" : "silc_out_double(");
+                    codegen_expression(value);
+                    fprintf(output, ");\n");
                 }
                 break;
             case STMT_IN:
-                const char* ident = stmt.in_stmt.ident;
-                type = get_symbol_type(ident);
-                if (type == TYPE_STRING) {
-                    fprintf(output, "scanf(\"%%255s\", %s);\n", ident);
-                } else {
-                    fprintf(output, "scanf(\"%%lf\", &%s);\n", ident);
-                }
+                fprintf(output, symbols[stmt.in_stmt.slot].type == TYPE_STRING ? "silc_in_string(&" : "silc_in_double(&");
+                emit_variable(stmt.in_stmt.slot);
+                fprintf(output, ");\n");
                 break;
             case STMT_BREAK:
                 fprintf(output, "break;\n");
@@ -289,41 +820,82 @@ static void codegen_statements(const Statement* statements, const int count) {
                 fprintf(output, "}\n");
                 break;
             case STMT_EXPR:
-                const Expression* expr = stmt.expr_stmt.expr;
-
-                // Check for string assignment pattern: identifier = "string"
-                if (expr->len == 3 &&
-                    expr->token_types[0] == TOKEN_IDENT &&
-                    expr->token_types[1] == TOKEN_EQ &&
-                    expr->token_types[2] == TOKEN_STRING) {
-
-                    const char* identifier = expr->token_values[0];
-                    if (get_symbol_type(identifier) == TYPE_STRING) {
-                        // Generate strcpy for string assignment
-                        fprintf(output, "strcpy(%s, \"%s\");\n", identifier, expr->token_values[2]);
-                    } else {
-                        // Not a string variable, so generate a standard assignment.
-                        // This could be an error (e.g., num_var = "string"), which C would catch.
-                        codegen_expression(expr);
-                        fprintf(output, ";\n");
-                    }
-                    } else {
-                        // For all other expressions, generate the code as before.
-                        codegen_expression(expr);
-                        fprintf(output, ";\n");
+                if (stmt.expr_stmt.expr->type == TYPE_STRING) {
+                    string_calls = 0;
+                    codegen_string_effects(stmt.expr_stmt.expr);
+                    fprintf(output, "\n");
+                    break;
+                }
+                if (stmt.expr_stmt.expr->type == TYPE_INT_ARRAY || stmt.expr_stmt.expr->type == TYPE_DOUBLE_ARRAY) {
+                    // Only an assignment does anything
+                    string_calls = 0;
+                    if (stmt.expr_stmt.expr->kind == EXPR_ASSIGN) {
+                        const Expression* assign = stmt.expr_stmt.expr;
+                        codegen_array_into(assign->assign.value, assign->assign.slot);
                     }
+                    fprintf(output, "\n");
+                    break;
+                }
+                if (stmt.expr_stmt.expr->type == TYPE_DOUBLE_MAP || stmt.expr_stmt.expr->type == TYPE_STRING_MAP) {
+                    // Assigning {} empties the map
+                    if (stmt.expr_stmt.expr->kind == EXPR_ASSIGN) emit_map_clear(stmt.expr_stmt.expr->assign.slot);
+                    fprintf(output, "\n");
+                    break;
+                }
+                // A top-level assignment needs no parentheses
+                if (stmt.expr_stmt.expr->kind == EXPR_ASSIGN) {
+                    codegen_assignment(stmt.expr_stmt.expr);
+                } else {
+                    codegen_expression(stmt.expr_stmt.expr);
+                }
+                fprintf(output, ";\n");
                 break;
             default: ;
         }
     }
 }
 
-void codegen_generate(const Program program) {
+void codegen_precomputed_output(const char* text, const size_t length) {
+    precomputed = text;
+    precomputed_length = length;
+}
+
+// The precomputed output as a C string literal, a line of output per source line
+static void emit_precomputed() {
+    fprintf(output, "static const char precomputed_output[] =\n\t\"");
+    for (size_t i = 0; i < precomputed_length; i++) {
+        emit_string_char((unsigned char)precomputed[i]);
+        if (precomputed[i] == '\n' && i + 1 < precomputed_length) fprintf(output, "\"\n\t\"");
+    }
+    fprintf(output, "\";\n\n");
+}
+
+static void codegen_prelude() {
     fprintf(output, "#include <stdio.h>\n");
+    fprintf(output, "#include <stdint.h>\n");
+    fprintf(output, "#include <inttypes.h>\n");
     fprintf(output, "#include <stdlib.h>\n");
     fprintf(output, "#include <string.h>\n");
     fprintf(output, "#include <math.h>\n\n");
+    fprintf(output, "%s\n", runtime_source);
+    if (precomputed_length > 0) emit_precomputed();
     fprintf(output, "int main() {\n");
+    add_indent();
+    fprintf(output, "silc_out_init();\n");
+    if (precomputed_length > 0) {
+        add_indent();
+        fprintf(output, "silc_out_text(precomputed_output, sizeof(precomputed_output) - 1);\n");
+    }
+}
+
+void codegen_generate(const Program program) {
+    symbols = program.symbols;
+    codegen_prelude();
+    const uint32_t view_temps = count_statement_view_temps(program.statements, program.count);
+    if (view_temps > 0) {
+        add_indent();
+        fprintf(output, "static SilcString view_temps[%u];\n", view_temps);
+    }
 
     // Process each statement in the program
     codegen_statements(program.statements, program.count);
@@ -334,9 +906,879 @@ void codegen_generate(const Program program) {
     fprintf(output, "}\n");
 }
 
+// IR emission: blocks become labels and control flow becomes gotos. A pure
+// value used once, later in its own block with no side effect in between, is
+// written inline at its use so the C keeps expression trees; every other value
+// is a local. Incoming edges assign phis directly, except in blocks whose phis
+// read each other: those are fed through v_in, which the edge sets and the
+// block copies into v on entry, so every phi still sees the values from before
+// the edge. Counted loop headers open a for statement that tests the condition
+// and steps the counter; the loop's blocks follow inside it, and the back edge
+// becomes continue.
+
+typedef enum {
+    STEP_BLOCK,
+    STEP_OPEN,          // for statement of a counted loop, before its header
+    STEP_CLOSE
+} EmitStepKind;
+
+typedef struct {
+    EmitStepKind kind;
+    int block;
+} EmitStep;
+
+static const IrProgram* program_ir;
+static bool* inlined;
+static bool* staged;
+static EmitStep* steps;
+static int step_count;
+static int current_step;
+static int* open_loops;     // Headers of the for statements being emitted
+static int open_count;
+static bool* jumped;        // Blocks some goto targets, which get a label
+
+static const char* ir_operator_text(const IrOp op) {
+    switch (op) {
+        case IR_ADD: return "+";
+        case IR_SUB: return "-";
+        case IR_MUL: return "*";
+        case IR_DIV: return "/";
+        case IR_MOD: return "%";
+        case IR_AND: return "&";
+        case IR_OR: return "|";
+        case IR_XOR: return "^";
+        case IR_SHL: return "<<";
+        case IR_SHR: return ">>";
+        case IR_EQ: return "==";
+        case IR_NE: return "!=";
+        case IR_LT: return "<";
+        case IR_GT: return ">";
+        case IR_LE: return "<=";
+        case IR_GE: return ">=";
+        case IR_NEG: return "-";
+        case IR_NOT: return "!";
+        case IR_BITNOT: return "~";
+        default:
+            fprintf(stderr, "Error: Invalid IR operator %s\n", ir_op_to_string(op));
+            exit(EXIT_FAILURE);
+    }
+}
+
+static void emit_constant(const IrInst* inst) {
+    if (inst->type == TYPE_INT) {
+        if (inst->value.integer == INT64_MIN) {
+            fprintf(output, "INT64_MIN");
+        } else if (inst->value.integer < 0) {
+            fprintf(output, "(%" PRId64 ")", inst->value.integer);
+        } else {
+            fprintf(output, "%" PRId64, inst->value.integer);
+        }
+        return;
+    }
+
+    const double value = inst->value.real;
+    if (isnan(value)) {
+        fprintf(output, "NAN");
+    } else if (isinf(value)) {
+        fprintf(output, value > 0 ? "INFINITY" : "(-INFINITY)");
+    } else {
+        // %.17g round-trips every double; make sure C reads it as one
+        char text[40];
+        snprintf(text, sizeof(text), "%.17g", value);
+        const char* suffix = strpbrk(text, ".e") ? "" : ".0";
+        fprintf(output, signbit(value) ? "(%s%s)" : "%s%s", text, suffix);
+    }
+}
+
+static void emit_expression(int id);
+
+static void emit_value(const int value) {
+    const int resolved = ir_resolve(program_ir, value);
+    const IrInst* inst = &program_ir->insts[resolved];
+    if (inst->op == IR_CONST) {
+        emit_constant(inst);
+    } else if (inlined[resolved]) {
+        fprintf(output, "(");
+        emit_expression(resolved);
+        fprintf(output, ")");
+    } else {
+        fprintf(output, "v%d", resolved);
+    }
+}
+
+// Whether C evaluates an integer value as int: literals, and inlined
+// comparisons or expressions built only from those
+static bool is_c_int_value(const int value) {
+    const int resolved = ir_resolve(program_ir, value);
+    const IrInst* inst = &program_ir->insts[resolved];
+    if (inst->type != TYPE_INT) return false;
+    if (inst->op == IR_CONST) return true;
+    if (!inlined[resolved]) return false;
+    switch (inst->op) {
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE: case IR_NOT:
+            return true;
+        case IR_BITNOT:
+            return is_c_int_value(inst->args[0]);
+        case IR_MOD: case IR_AND: case IR_OR: case IR_XOR:
+            return is_c_int_value(inst->args[0]) && is_c_int_value(inst->args[1]);
+        default:
+            return false;
+    }
+}
+
+// Widen int values where staying int would change the meaning
+static void emit_int64_value(const int value) {
+    if (is_c_int_value(value)) fprintf(output, "(int64_t)");
+    emit_value(value);
+}
+
+// A value that is already the whole of a parenthesized C expression
+static void emit_operand(const int value) {
+    const int resolved = ir_resolve(program_ir, value);
+    if (inlined[resolved]) {
+        emit_expression(resolved);
+    } else {
+        emit_value(resolved);
+    }
+}
+
+static void emit_string_slot(const int slot) {
+    const Lexeme name = intern_name(program_ir->symbols[slot].symbol);
+    fprintf(output, "%.*s_%d", name.length, name.text, slot);
+}
+
+static bool is_view_slot(const int slot) {
+    return slot >= 0 && program_ir->symbols[slot].type == TYPE_VIEW;
+}
+
+// A call of silc_string_set or silc_string_append on a slot and a slot, view or literal
+static void emit_string_call(const char* function, const IrInst* inst) {
+    add_indent();
+    const char* suffix = inst->source < 0 ? "_text" : is_view_slot(inst->source) ? "_view" : "";
+    fprintf(output, "silc_string_%s%s(&", function, suffix);
+    emit_string_slot(inst->slot);
+    fprintf(output, ", ");
+    if (inst->source >= 0) {
+        if (!is_view_slot(inst->source)) fprintf(output, "&");
+        emit_string_slot(inst->source);
+    } else {
+        emit_string_text(inst->text);
+    }
+    fprintf(output, ");\n");
+}
+
+// A string operand of a builtin as a SilcView
+static void emit_view(const int slot, const Lexeme text) {
+    if (slot < 0) {
+        fprintf(output, "silc_view_text(");
+        emit_string_text(text);
+        fprintf(output, ")");
+    } else if (is_view_slot(slot)) {
+        emit_string_slot(slot);
+    } else {
+        fprintf(output, "silc_view(&");
+        emit_string_slot(slot);
+        fprintf(output, ")");
+    }
+}
+
+static void emit_builtin(const IrInst* inst, const int id) {
+    add_indent();
+    if (inst->slot >= 0) {
+        emit_string_slot(inst->slot);
+    } else {
+        fprintf(output, "v%d", id);
+    }
+    fprintf(output, " = ");
+    switch (inst->op) {
+        case IR_SLICE_STRING:
+            fprintf(output, "silc_slice(");
+            emit_view(inst->source, inst->text);
+            fprintf(output, ", ");
+            emit_int64_value(inst->args[0]);
+            fprintf(output, ", ");
+            emit_int64_value(inst->args[1]);
+            break;
+        case IR_SPLIT_STRING:
+            fprintf(output, "silc_split(");
+            emit_view(inst->source, inst->text);
+            fprintf(output, ", ");
+            emit_view(inst->other, inst->other_text);
+            fprintf(output, ", ");
+            emit_int64_value(inst->args[0]);
+            break;
+        case IR_LENGTH_STRING:
+            fprintf(output, "(int64_t)(");
+            emit_view(inst->source, inst->text);
+            fprintf(output, ").length;\n");
+            return;
+        case IR_FIND_STRING:
+            fprintf(output, "silc_find(");
+            emit_view(inst->source, inst->text);
+            fprintf(output, ", ");
+            emit_view(inst->other, inst->other_text);
+            fprintf(output, ", ");
+            emit_int64_value(inst->args[0]);
+            break;
+        default:
+            fprintf(output, "silc_%s(", inst->op == IR_COMPARE_STRING ? "compare" : "equal");
+            emit_view(inst->source, inst->text);
+            fprintf(output, ", ");
+            emit_view(inst->other, inst->other_text);
+            break;
+    }
+    fprintf(output, ");\n");
+}
+
+static bool is_array_slot(const int slot) {
+    const VarType type = program_ir->symbols[slot].type;
+    return type == TYPE_INT_ARRAY || type == TYPE_DOUBLE_ARRAY;
+}
+
+// The element an array instruction indexes, checked unless proven in range
+static void emit_element(const IrInst* inst) {
+    emit_string_slot(inst->slot);
+    fprintf(output, ".data[");
+    if (inst->in_bounds) {
+        emit_int64_value(inst->args[0]);
+    } else {
+        fprintf(output, "silc_index(");
+        emit_int64_value(inst->args[0]);
+        fprintf(output, ", ");
+        emit_string_slot(inst->slot);
+        fprintf(output, ".length, %d)", inst->line);
+    }
+    fprintf(output, "]");
+}
+
+static void emit_array(const IrInst* inst, const int id) {
+    add_indent();
+    const char* prefix = array_prefix(program_ir->symbols[inst->slot].type);
+    switch (inst->op) {
+        case IR_LOAD_ARRAY:
+            fprintf(output, "v%d = ", id);
+            emit_element(inst);
+            break;
+        case IR_LENGTH_ARRAY:
+            fprintf(output, "v%d = ", id);
+            emit_string_slot(inst->slot);
+            fprintf(output, ".length");
+            break;
+        case IR_CLEAR_ARRAY:
+            emit_string_slot(inst->slot);
+            fprintf(output, ".length = 0");
+            break;
+        case IR_PUSH_ARRAY:
+            fprintf(output, "%s_push(&", prefix);
+            emit_string_slot(inst->slot);
+            fprintf(output, ", ");
+            if (inst->type == TYPE_INT) {
+                emit_int64_value(inst->args[0]);
+            } else {
+                emit_operand(inst->args[0]);
+            }
+            fprintf(output, ")");
+            break;
+        case IR_SET_ARRAY:
+            fprintf(output, "%s_set(&", prefix);
+            emit_string_slot(inst->slot);
+            fprintf(output, ", &");
+            emit_string_slot(inst->source);
+            fprintf(output, ")");
+            break;
+        default:
+            emit_element(inst);
+            fprintf(output, " = ");
+            if (inst->type == TYPE_INT) {
+                emit_int64_value(inst->args[1]);
+            } else {
+                emit_operand(inst->args[1]);
+            }
+            break;
+    }
+    fprintf(output, ";\n");
+}
+
+static bool is_map_slot(const int slot) {
+    const VarType type = program_ir->symbols[slot].type;
+    return type == TYPE_DOUBLE_MAP || type == TYPE_STRING_MAP;
+}
+
+static void emit_map(const IrInst* inst, const int id) {
+    add_indent();
+    const VarType type = program_ir->symbols[inst->slot].type;
+    switch (inst->op) {
+        case IR_LENGTH_MAP:
+            fprintf(output, "v%d = ", id);
+            emit_string_slot(inst->slot);
+            fprintf(output, ".count;\n");
+            return;
+        case IR_CLEAR_MAP:
+            fprintf(output, "silc_map_clear(&");
+            emit_string_slot(inst->slot);
+            fprintf(output, ");\n");
+            return;
+        case IR_GET_MAP:
+            fprintf(output, "v%d = %s_get(&", id, map_prefix(type));
+            break;
+        case IR_HAS_MAP:
+            fprintf(output, "v%d = %s_has(&", id, map_prefix(type));
+            break;
+        case IR_DEL_MAP:
+            fprintf(output, "v%d = %s_del(&", id, map_prefix(type));
+            break;
+        default:
+            fprintf(output, "%s_put(&", map_prefix(type));
+            break;
+    }
+    emit_string_slot(inst->slot);
+    fprintf(output, ", ");
+    if (type == TYPE_STRING_MAP) {
+        emit_view(inst->source, inst->text);
+    } else {
+        emit_operand(inst->args[0]);
+    }
+    if (inst->op == IR_PUT_MAP) {
+        fprintf(output, ", ");
+        emit_operand(inst->args[1]);
+    }
+    fprintf(output, ");\n");
+}
+
+// The right-hand side of a pure value
+static void emit_expression(const int id) {
+    const IrInst* inst = &program_ir->insts[id];
+    // Integer + - * and negation wrap in uint64_t, where C defines the wrap
+    if (inst->type == TYPE_INT && (inst->op == IR_ADD || inst->op == IR_SUB || inst->op == IR_MUL)) {
+        fprintf(output, "(int64_t)((uint64_t)");
+        emit_value(inst->args[0]);
+        fprintf(output, " %s (uint64_t)", ir_operator_text(inst->op));
+        emit_value(inst->args[1]);
+        fprintf(output, ")");
+        return;
+    }
+    // Shift counts are taken modulo 64, as x86-64 takes them
+    if (inst->op == IR_SHL || inst->op == IR_SHR) {
+        fprintf(output, inst->op == IR_SHL ? "(int64_t)((uint64_t)" : "(int64_t)");
+        emit_value(inst->args[0]);
+        fprintf(output, " %s ", ir_operator_text(inst->op));
+        const IrInst* count = &program_ir->insts[ir_resolve(program_ir, inst->args[1])];
+        if (count->op == IR_CONST) {
+            fprintf(output, "%d", (int)(count->value.integer & 63));
+        } else {
+            fprintf(output, "(");
+            emit_value(inst->args[1]);
+            fprintf(output, " & 63)");
+        }
+        if (inst->op == IR_SHL) fprintf(output, ")");
+        return;
+    }
+    if (inst->type == TYPE_INT && inst->op == IR_NEG) {
+        fprintf(output, "(int64_t)-(uint64_t)");
+        emit_value(inst->args[0]);
+        return;
+    }
+    switch (inst->op) {
+        case IR_COPY:
+            emit_value(inst->args[0]);
+            return;
+        case IR_NEG:
+        case IR_NOT:
+        case IR_BITNOT:
+            fprintf(output, "%s", ir_operator_text(inst->op));
+            emit_value(inst->args[0]);
+            return;
+        case IR_TO_DOUBLE:
+        case IR_TO_INT:
+            fprintf(output, "(%s)", inst->op == IR_TO_INT ? "int64_t" : "double");
+            emit_value(inst->args[0]);
+            return;
+        default:
+            emit_value(inst->args[0]);
+            break;
+    }
+    fprintf(output, " %s ", ir_operator_text(inst->op));
+    emit_value(inst->args[1]);
+}
+
+static void emit_instruction(const int id) {
+    const IrInst* inst = &program_ir->insts[id];
+    if (inlined[id]) return;
+    switch (inst->op) {
+        case IR_CONST:
+        case IR_PHI:
+            return;
+        case IR_IN:
+            add_indent();
+            fprintf(output, "v%d = ", id);
+            emit_value(inst->args[0]);
+            fprintf(output, "; silc_in_double(&v%d);\n", id);
+            return;
+        case IR_OUT:
+            add_indent();
+            if (program_ir->insts[ir_resolve(program_ir, inst->args[0])].type == TYPE_INT) {
+                fprintf(output, "silc_out_int(");
+                emit_int64_value(inst->args[0]);
+            } else {
+                fprintf(output, "silc_out_double(");
+                emit_operand(inst->args[0]);
+            }
+            fprintf(output, ");\n");
+            return;
+        case IR_IN_STRING:
+            add_indent();
+            fprintf(output, "silc_in_string(&");
+            emit_string_slot(inst->slot);
+            fprintf(output, ");\n");
+            return;
+        case IR_OUT_STRING:
+            add_indent();
+            if (is_view_slot(inst->source)) {
+                fprintf(output, "silc_out_view(");
+                emit_string_slot(inst->source);
+                fprintf(output, ");\n");
+            } else if (inst->source >= 0) {
+                fprintf(output, "silc_out_string(&");
+                emit_string_slot(inst->source);
+                fprintf(output, ");\n");
+            } else {
+                emit_out_literal(inst->text);
+            }
+            return;
+        case IR_SET_STRING:
+            if (inst->source == inst->slot) return;
+            emit_string_call("set", inst);
+            return;
+        case IR_APPEND_STRING:
+            emit_string_call("append", inst);
+            return;
+        case IR_MOVE_STRING:
+            emit_string_call("move", inst);
+            return;
+        case IR_SLICE_STRING:
+        case IR_SPLIT_STRING:
+        case IR_LENGTH_STRING:
+        case IR_FIND_STRING:
+        case IR_COMPARE_STRING:
+        case IR_EQUAL_STRING:
+            emit_builtin(inst, id);
+            return;
+        case IR_LOAD_ARRAY:
+        case IR_LENGTH_ARRAY:
+        case IR_CLEAR_ARRAY:
+        case IR_PUSH_ARRAY:
+        case IR_SET_ARRAY:
+        case IR_STORE_ARRAY:
+            emit_array(inst, id);
+            return;
+        case IR_GET_MAP:
+        case IR_HAS_MAP:
+        case IR_DEL_MAP:
+        case IR_LENGTH_MAP:
+        case IR_CLEAR_MAP:
+        case IR_PUT_MAP:
+            emit_map(inst, id);
+            return;
+        default:
+            add_indent();
+            fprintf(output, "v%d = ", id);
+            emit_expression(id);
+            fprintf(output, ";\n");
+            return;
+    }
+}
+
+// The value a counted loop's back edge gives its counter
+static int counter_update(const IrBlock* header) {
+    const IrInst* counter = &program_ir->insts[header->counter];
+    for (int i = 0; i < counter->phi_count; i++) {
+        const int value = ir_resolve(program_ir, counter->phi_args[i]);
+        const IrInst* inst = &program_ir->insts[value];
+        if (inst->op != IR_ADD && inst->op != IR_SUB) continue;
+        if (ir_resolve(program_ir, inst->args[0]) == header->counter) return value;
+        if (ir_resolve(program_ir, inst->args[1]) == header->counter) return value;
+    }
+    fprintf(stderr, "Error: Counted loop B%d has no counter update\n", (int)(header - program_ir->blocks));
+    exit(EXIT_FAILURE);
+}
+
+static void emit_loop_open(const int b) {
+    const IrBlock* block = &program_ir->blocks[b];
+    const IrInst* update = &program_ir->insts[counter_update(block)];
+    const bool counter_first = ir_resolve(program_ir, update->args[0]) == block->counter;
+    // The test itself, even when the header body also keeps it in a local
+    add_indent();
+    fprintf(output, "for (; ");
+    emit_expression(ir_resolve(program_ir, block->cond));
+    fprintf(output, "; v%d = (int64_t)((uint64_t)v%d %s (uint64_t)", block->counter, block->counter,
+            ir_operator_text(update->op));
+    emit_value(update->args[counter_first ? 1 : 0]);
+    fprintf(output, ")) {\n");
+    indent_level++;
+    open_loops[open_count++] = b;
+}
+
+// Set the phi inputs of target for the edge from block, except skip
+static void emit_edge_copies(const int block, const int target, const int skip) {
+    const IrBlock* succ = &program_ir->blocks[target];
+    int index = 0;
+    while (index < succ->pred_count && succ->preds[index] != block) index++;
+
+    for (int id = succ->first; id >= 0 && program_ir->insts[id].op == IR_PHI; id = program_ir->insts[id].next) {
+        const int value = ir_resolve(program_ir, program_ir->insts[id].phi_args[index]);
+        if (value == id || id == skip) continue;
+        add_indent();
+        fprintf(output, staged[target] ? "v%d_in = " : "v%d = ", id);
+        emit_value(value);
+        fprintf(output, ";\n");
+    }
+}
+
+// The block control falls into after the current step, or -1
+static int fallthrough_block() {
+    if (current_step + 1 >= step_count || steps[current_step + 1].kind == STEP_CLOSE) return -1;
+    return steps[current_step + 1].block;
+}
+
+// Whether an edge becomes a goto rather than continue or falling through
+static bool edge_jumps(const int target, const bool explicit) {
+    if (open_count > 0 && target == open_loops[open_count - 1]) return false;
+    return explicit || target != fallthrough_block();
+}
+
+// Transfer control along an edge; explicit forces a statement even when the
+// target comes next
+static void emit_edge(const int block, const int target, const bool explicit) {
+    if (open_count > 0 && target == open_loops[open_count - 1]) {
+        emit_edge_copies(block, target, program_ir->blocks[target].counter);
+        const bool closes = current_step + 1 < step_count && steps[current_step + 1].kind == STEP_CLOSE;
+        if (explicit || !closes) {
+            add_indent();
+            fprintf(output, "continue;\n");
+        }
+        return;
+    }
+    emit_edge_copies(block, target, -1);
+    if (edge_jumps(target, explicit)) {
+        add_indent();
+        fprintf(output, "goto B%d;\n", target);
+    }
+}
+
+static void emit_terminator(const int b) {
+    const IrBlock* block = &program_ir->blocks[b];
+    switch (block->term) {
+        case TERM_JUMP:
+            emit_edge(b, block->succ[0], false);
+            break;
+        case TERM_BRANCH:
+            if (block->counter >= 0) {
+                // The for statement already tested the condition
+                emit_edge(b, block->succ[0], false);
+                break;
+            }
+            add_indent();
+            fprintf(output, "if (");
+            emit_operand(block->cond);
+            fprintf(output, ") {\n");
+            indent_level++;
+            emit_edge(b, block->succ[0], true);
+            indent_level--;
+            add_indent();
+            fprintf(output, "}\n");
+            emit_edge(b, block->succ[1], false);
+            break;
+        case TERM_EXIT:
+            add_indent();
+            fprintf(output, "exit(");
+            emit_operand(block->cond);
+            fprintf(output, ");\n");
+            break;
+        default:
+            add_indent();
+            fprintf(output, "return 0;\n");
+            break;
+    }
+}
+
+static void emit_declarations() {
+    for (int slot = 0; slot < program_ir->symbol_count; slot++) {
+        if (program_ir->symbols[slot].type == TYPE_STRING) {
+            add_indent();
+            fprintf(output, "SilcString ");
+            emit_string_slot(slot);
+            fprintf(output, " = {0};\n");
+        } else if (program_ir->symbols[slot].type == TYPE_VIEW) {
+            add_indent();
+            fprintf(output, "SilcView ");
+            emit_string_slot(slot);
+            fprintf(output, " = {0};\n");
+        } else if (is_array_slot(slot)) {
+            add_indent();
+            fprintf(output, "%s ", program_ir->symbols[slot].type == TYPE_INT_ARRAY ? "SilcIntArray" : "SilcDoubleArray");
+            emit_string_slot(slot);
+            fprintf(output, " = {0};\n");
+        } else if (is_map_slot(slot)) {
+            add_indent();
+            fprintf(output, "SilcMap ");
+            emit_string_slot(slot);
+            fprintf(output, " = {0};\n");
+        }
+    }
+    for (int b = 0; b < program_ir->block_count; b++) {
+        const IrBlock* block = &program_ir->blocks[b];
+        if (block->removed) continue;
+        for (int id = block->first; id >= 0; id = program_ir->insts[id].next) {
+            const IrInst* inst = &program_ir->insts[id];
+            if (inst->op == IR_CONST || inlined[id]) continue;
+            if (ir_has_side_effect(inst->op) && inst->op != IR_IN && !ir_effect_has_value(inst->op)) continue;
+            const char* type = inst->type == TYPE_INT ? "int64_t" : "double";
+            add_indent();
+            if (inst->op == IR_PHI && staged[b]) {
+                fprintf(output, "%s v%d, v%d_in;\n", type, id, id);
+            } else {
+                fprintf(output, "%s v%d;\n", type, id);
+            }
+        }
+    }
+}
+
+static void count_use(const int value, const int block, const int position, int* uses, int* use_block,
+                      int* use_position) {
+    if (value < 0) return;
+    const int resolved = ir_resolve(program_ir, value);
+    uses[resolved]++;
+    use_block[resolved] = block;
+    use_position[resolved] = position;
+}
+
+// Whether an expression written into phi reads a phi of the same block that
+// comes before it, and so is assigned first on the edge
+static bool reads_earlier_phi(const int value, const int block, const int phi) {
+    const IrInst* inst = &program_ir->insts[value];
+    for (int i = 0; i < 2; i++) {
+        if (inst->args[i] < 0) continue;
+        const int arg = ir_resolve(program_ir, inst->args[i]);
+        const IrInst* operand = &program_ir->insts[arg];
+        if (operand->op == IR_PHI && operand->block == block && arg != phi) {
+            for (int id = program_ir->blocks[block].first; id != phi; id = program_ir->insts[id].next) {
+                if (id == arg) return true;
+            }
+        } else if (inlined[arg] && reads_earlier_phi(arg, block, phi)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decide which values are written inline and which blocks stage their phis
+static void plan_emission() {
+    const int count = program_ir->inst_count;
+    inlined = ir_allocate((size_t)count, sizeof(bool));
+    staged = ir_allocate((size_t)program_ir->block_count, sizeof(bool));
+    int* uses = ir_allocate((size_t)count, sizeof(int));
+    int* use_block = ir_allocate((size_t)count, sizeof(int));
+    int* use_position = ir_allocate((size_t)count, sizeof(int));
+    int* position = ir_allocate((size_t)count, sizeof(int));
+    int* end_effects = ir_allocate((size_t)program_ir->block_count, sizeof(int));
+
+    // Positions count the side effects before each instruction; a phi use gets
+    // position -1 so that it never qualifies
+    for (int b = 0; b < program_ir->block_count; b++) {
+        const IrBlock* block = &program_ir->blocks[b];
+        if (block->removed) continue;
+        int effects = 0;
+        for (int id = block->first; id >= 0; id = program_ir->insts[id].next) {
+            const IrInst* inst = &program_ir->insts[id];
+            position[id] = effects;
+            for (int i = 0; i < 2; i++) count_use(inst->args[i], b, effects, uses, use_block, use_position);
+            for (int i = 0; i < inst->phi_count; i++) {
+                const int value = ir_resolve(program_ir, inst->phi_args[i]);
+                count_use(value, b, -1, uses, use_block, use_position);
+                if (value != id && program_ir->insts[value].op == IR_PHI && program_ir->insts[value].block == b) {
+                    staged[b] = true;
+                }
+            }
+            if (ir_has_side_effect(inst->op)) effects++;
+        }
+        end_effects[b] = effects;
+        if (block->term == TERM_BRANCH || block->term == TERM_EXIT) {
+            count_use(block->cond, b, effects, uses, use_block, use_position);
+        }
+    }
+
+    for (int b = 0; b < program_ir->block_count; b++) {
+        const IrBlock* block = &program_ir->blocks[b];
+        if (block->removed) continue;
+        for (int id = block->first; id >= 0; id = program_ir->insts[id].next) {
+            const IrOp op = program_ir->insts[id].op;
+            if (op == IR_CONST || op == IR_PHI || ir_has_side_effect(op)) continue;
+            inlined[id] = uses[id] == 1 && use_block[id] == b && use_position[id] == position[id];
+        }
+    }
+
+    // A phi input used nowhere else and computed at the end of a block that
+    // only jumps is written straight into the phi, unless it reads a phi that
+    // the edge assigns before this one
+    for (int b = 0; b < program_ir->block_count; b++) {
+        const IrBlock* block = &program_ir->blocks[b];
+        if (block->removed) continue;
+        for (int id = block->first; id >= 0 && program_ir->insts[id].op == IR_PHI; id = program_ir->insts[id].next) {
+            const IrInst* phi = &program_ir->insts[id];
+            for (int p = 0; p < phi->phi_count; p++) {
+                const int value = ir_resolve(program_ir, phi->phi_args[p]);
+                const IrInst* inst = &program_ir->insts[value];
+                const int pred = block->preds[p];
+                if (inst->op == IR_CONST || inst->op == IR_PHI || ir_has_side_effect(inst->op)) continue;
+                if (uses[value] != 1 || inst->block != pred || program_ir->blocks[pred].term != TERM_JUMP) continue;
+                if (position[value] != end_effects[pred]) continue;
+                if (!staged[b] && reads_earlier_phi(value, b, id)) continue;
+                inlined[value] = true;
+            }
+        }
+    }
+
+    // A counter update used only by its phi is the for statement's step
+    for (int b = 0; b < program_ir->block_count; b++) {
+        const IrBlock* block = &program_ir->blocks[b];
+        if (block->removed || block->counter < 0) continue;
+        const int update = counter_update(block);
+        if (uses[update] == 1) inlined[update] = true;
+    }
+    free(uses);
+    free(use_block);
+    free(use_position);
+    free(position);
+    free(end_effects);
+}
+
+static int compare_blocks(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+static void sequence_loop(const Cfg* cfg, int loop, bool* placed);
+
+// Place a block, or the outermost counted loop around it that is not open yet
+static void sequence_block(const Cfg* cfg, const int b, const int enclosing, bool* placed) {
+    if (placed[b]) return;
+    int counted = -1;
+    for (int l = cfg->loop_of[b]; l >= 0 && l != enclosing; l = cfg->loops[l].parent) {
+        if (program_ir->blocks[cfg->loops[l].header].counter >= 0) counted = l;
+    }
+    if (counted >= 0) {
+        sequence_loop(cfg, counted, placed);
+        return;
+    }
+    placed[b] = true;
+    steps[step_count++] = (EmitStep){STEP_BLOCK, b};
+}
+
+// A counted loop's blocks in order, header first, inside its for statement
+static void sequence_loop(const Cfg* cfg, const int loop, bool* placed) {
+    const IrLoop* info = &cfg->loops[loop];
+    placed[info->header] = true;
+    steps[step_count++] = (EmitStep){STEP_OPEN, info->header};
+    steps[step_count++] = (EmitStep){STEP_BLOCK, info->header};
+
+    int* blocks = ir_allocate((size_t)info->block_count, sizeof(int));
+    memcpy(blocks, info->blocks, sizeof(int) * (size_t)info->block_count);
+    qsort(blocks, (size_t)info->block_count, sizeof(int), compare_blocks);
+    for (int i = 0; i < info->block_count; i++) {
+        sequence_block(cfg, blocks[i], loop, placed);
+    }
+    free(blocks);
+    steps[step_count++] = (EmitStep){STEP_CLOSE, info->header};
+}
+
+// Find the blocks that need a label, walking the steps the way emission does
+// so that each edge is seen with the same for statements open
+static void plan_labels() {
+    jumped = ir_allocate((size_t)program_ir->block_count, sizeof(bool));
+    for (current_step = 0; current_step < step_count; current_step++) {
+        const IrBlock* block = &program_ir->blocks[steps[current_step].block];
+        if (steps[current_step].kind == STEP_OPEN) {
+            open_loops[open_count++] = steps[current_step].block;
+        } else if (steps[current_step].kind == STEP_CLOSE) {
+            open_count--;
+            jumped[block->succ[1]] |= edge_jumps(block->succ[1], false);
+        } else if (block->term == TERM_JUMP || (block->term == TERM_BRANCH && block->counter >= 0)) {
+            jumped[block->succ[0]] |= edge_jumps(block->succ[0], false);
+        } else if (block->term == TERM_BRANCH) {
+            jumped[block->succ[0]] |= edge_jumps(block->succ[0], true);
+            jumped[block->succ[1]] |= edge_jumps(block->succ[1], false);
+        }
+    }
+}
+
+// Order the blocks for emission, grouping each counted loop
+static void plan_sequence() {
+    Cfg cfg = cfg_analyze(program_ir);
+    bool* placed = ir_allocate((size_t)program_ir->block_count, sizeof(bool));
+    steps = ir_allocate((size_t)program_ir->block_count * 3, sizeof(EmitStep));
+    open_loops = ir_allocate((size_t)program_ir->block_count, sizeof(int));
+    step_count = 0;
+    open_count = 0;
+    for (int b = 0; b < program_ir->block_count; b++) {
+        if (!program_ir->blocks[b].removed) sequence_block(&cfg, b, -1, placed);
+    }
+    free(placed);
+    cfg_free(&cfg);
+}
+
+void codegen_generate_ir(const IrProgram* ir) {
+    program_ir = ir;
+    plan_emission();
+    plan_sequence();
+    plan_labels();
+    codegen_prelude();
+    emit_declarations();
+
+    for (current_step = 0; current_step < step_count; current_step++) {
+        const int b = steps[current_step].block;
+        const IrBlock* block = &ir->blocks[b];
+        if (steps[current_step].kind == STEP_OPEN) {
+            if (jumped[b]) fprintf(output, "B%d:\n", b);
+            emit_loop_open(b);
+            continue;
+        }
+        if (steps[current_step].kind == STEP_CLOSE) {
+            indent_level--;
+            open_count--;
+            add_indent();
+            fprintf(output, "}\n");
+            emit_edge(b, block->succ[1], false);
+            continue;
+        }
+        if (jumped[b] && block->counter < 0) fprintf(output, "B%d:\n", b);
+
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            if (ir->insts[id].op == IR_PHI) {
+                if (!staged[b]) continue;
+                add_indent();
+                fprintf(output, "v%d = v%d_in;\n", id, id);
+            } else {
+                emit_instruction(id);
+            }
+        }
+        emit_terminator(b);
+    }
+
+    fprintf(output, "}\n");
+    free(inlined);
+    free(staged);
+    free(steps);
+    free(open_loops);
+    free(jumped);
+    inlined = staged = jumped = nullptr;
+    steps = nullptr;
+    open_loops = nullptr;
+    program_ir = nullptr;
+}
+
 void codegen_cleanup() {
     if (output != NULL) {
         fclose(output);
         output = nullptr;
     }
+    symbols = nullptr;
 }
\ No newline at end of file
@@ -0,0 +1,894 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "evaluate.h"
+#include "scan.h"
+
+// Output, and strings, beyond this are left to run time rather than embedded in the C
+#define MAX_OUTPUT (1 << 20)
+// Likewise for the elements of an array
+#define MAX_ELEMENTS (1 << 12)
+
+// The evaluator follows the C the code generators emit, on the types that
+// semantic analysis inferred. Anything that would read input, trap or be
+// undefined at run time stops it, and the program is then compiled as usual.
+
+typedef struct {
+    VarType type;
+    union {
+        int64_t integer;
+        double real;
+    };
+} Value;
+
+// A string variable, NUL-terminated once it has text
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+} Text;
+
+// An array variable, with its elements in its element type
+typedef struct {
+    Value* items;
+    int64_t length;
+    int64_t capacity;
+} Elements;
+
+typedef enum {
+    FLOW_NORMAL,
+    FLOW_BREAK,
+    FLOW_CONTINUE,
+    FLOW_EXIT,
+    FLOW_STOP           // The evaluator cannot go on
+} Flow;
+
+static const Symbol* symbols;
+static Value* values;           // By slot
+static Text* strings;           // By slot
+static Elements* arrays;        // By slot
+static char* output;
+static size_t output_length;
+static size_t output_capacity;
+static int64_t steps_left;
+static bool stopped;
+static Value status;
+
+static void* allocate(const size_t count, const size_t size) {
+    void* memory = calloc(count > 0 ? count : 1, size);
+    if (memory == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    return memory;
+}
+
+static void append(const char* text, const size_t length) {
+    if (output_length + length > MAX_OUTPUT) {
+        stopped = true;
+        return;
+    }
+    if (output_length + length > output_capacity) {
+        output_capacity = output_capacity ? output_capacity * 2 : 4096;
+        while (output_capacity < output_length + length) output_capacity *= 2;
+        output = realloc(output, output_capacity);
+        if (output == NULL) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(1);
+        }
+    }
+    memcpy(output + output_length, text, length);
+    output_length += length;
+}
+
+static void text_append(Text* text, const char* data, const size_t length) {
+    if (text->length + length > MAX_OUTPUT) {
+        stopped = true;
+        return;
+    }
+    if (text->length + length + 1 > text->capacity) {
+        text->capacity = text->capacity ? text->capacity * 2 : 64;
+        while (text->capacity < text->length + length + 1) text->capacity *= 2;
+        text->text = realloc(text->text, text->capacity);
+        if (text->text == NULL) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(1);
+        }
+    }
+    if (length > 0) memcpy(text->text + text->length, data, length);
+    text->length += length;
+    text->text[text->length] = '\0';
+}
+
+// Give a string variable the text of value, which is left empty
+static void set_string(const int slot, Text* value) {
+    free(strings[slot].text);
+    strings[slot] = *value;
+    *value = (Text){0};
+}
+
+static Value int_value(const int64_t integer) {
+    return (Value){.type = TYPE_INT, .integer = integer};
+}
+
+static Value double_value(const double real) {
+    return (Value){.type = TYPE_DOUBLE, .real = real};
+}
+
+static Value stop() {
+    stopped = true;
+    return int_value(0);
+}
+
+// C's conversion; double to int64_t is undefined outside its range
+static Value convert(const Value value, const VarType type) {
+    if (value.type == type) return value;
+    if (type == TYPE_DOUBLE) return double_value((double)value.integer);
+    if (!(value.real >= -9223372036854775808.0 && value.real < 9223372036854775808.0)) return stop();
+    return int_value((int64_t)value.real);
+}
+
+static bool truth(const Value value) {
+    return value.type == TYPE_INT ? value.integer != 0 : value.real != 0.0;
+}
+
+// Decode a string literal the way the C compiler reads it into at most
+// capacity - 1 characters, or return false for escapes the evaluator does not
+// model. In a printf format, %% is a percent sign and any other conversion
+// stops evaluation.
+static bool decode_literal(const Lexeme text, const bool format, char* decoded, const size_t capacity,
+                           size_t* length) {
+    size_t count = 0;
+    for (int i = 0; i < text.length; i++) {
+        char c = text.text[i];
+        if (c == '\\' && i + 1 < text.length) {
+            switch (text.text[++i]) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case '\\': c = '\\'; break;
+                case '\'': c = '\''; break;
+                case '"': c = '"'; break;
+                default: return false;
+            }
+        } else if (c == '%' && format) {
+            if (i + 1 >= text.length || text.text[i + 1] != '%') return false;
+            i++;
+        } else if ((unsigned char)c < ' ' || c == '\\') {
+            return false;
+        }
+        if (count + 1 >= capacity) return false;
+        decoded[count++] = c;
+    }
+    decoded[count] = '\0';
+    *length = count;
+    return true;
+}
+
+static Value evaluate(const Expression* expr);
+static void evaluate_string(const Expression* expr, Text* value);
+
+static bool is_array(const VarType type) {
+    return type == TYPE_INT_ARRAY || type == TYPE_DOUBLE_ARRAY;
+}
+
+static VarType element_type(const int slot) {
+    return symbols[slot].type == TYPE_INT_ARRAY ? TYPE_INT : TYPE_DOUBLE;
+}
+
+static void push_element(Elements* array, const Value value) {
+    if (array->length >= MAX_ELEMENTS) {
+        stopped = true;
+        return;
+    }
+    if (array->length == array->capacity) {
+        array->capacity = array->capacity ? array->capacity * 2 : 8;
+        array->items = realloc(array->items, sizeof(Value) * (size_t)array->capacity);
+        if (array->items == NULL) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(1);
+        }
+    }
+    array->items[array->length++] = value;
+}
+
+static void copy_array(const int slot, const int source) {
+    if (slot == source) return;
+    arrays[slot].length = 0;
+    for (int64_t i = 0; i < arrays[source].length && !stopped; i++) push_element(&arrays[slot], arrays[source].items[i]);
+}
+
+// Set an array variable to a literal, a variable or an assignment, which runs first
+static void evaluate_array_into(const Expression* expr, const int slot) {
+    switch (expr->kind) {
+        case EXPR_ARRAY: {
+            // The elements may read the array, so they are all evaluated before it changes
+            Value* elements = allocate((size_t)expr->array.count, sizeof(Value));
+            for (int i = 0; i < expr->array.count && !stopped; i++) {
+                elements[i] = convert(evaluate(expr->array.elements[i]), element_type(slot));
+            }
+            arrays[slot].length = 0;
+            for (int i = 0; i < expr->array.count && !stopped; i++) push_element(&arrays[slot], elements[i]);
+            free(elements);
+            return;
+        }
+        case EXPR_IDENT:
+            copy_array(slot, expr->ident.slot);
+            return;
+        case EXPR_ASSIGN:
+            evaluate_array_into(expr->assign.value, expr->assign.slot);
+            if (!stopped) copy_array(slot, expr->assign.slot);
+            return;
+        default:
+            stopped = true;
+            return;
+    }
+}
+
+// array[index], or array[index] = value; an index out of range fails at run time
+static Value evaluate_element(const Expression* expr) {
+    Elements* array = &arrays[expr->index.slot];
+    const Value index = convert(evaluate(expr->index.index), TYPE_INT);
+    if (stopped || index.integer < 0 || index.integer >= array->length) return stop();
+    if (expr->kind == EXPR_INDEX) return array->items[index.integer];
+    const Value value = convert(evaluate(expr->index.value), element_type(expr->index.slot));
+    if (!stopped) array->items[index.integer] = value;
+    return value;
+}
+
+// The operands of a builtin: its strings as texts and its numbers as int64_t.
+// They cannot assign, so their order does not matter.
+static void evaluate_arguments(const Expression* expr, Text* texts, int64_t* numbers) {
+    for (int i = 0; i < expr->call.count && !stopped; i++) {
+        const Expression* arg = expr->call.args[i];
+        if (arg->type == TYPE_STRING) {
+            evaluate_string(arg, &texts[i]);
+        } else {
+            numbers[i] = convert(evaluate(arg), TYPE_INT).integer;
+        }
+    }
+}
+
+static ScanText scan_text(const Text* text) {
+    return (ScanText){text->text != NULL ? text->text : "", text->length};
+}
+
+// Append the value of a string expression, running the assignments in it
+static void evaluate_string(const Expression* expr, Text* value) {
+    switch (expr->kind) {
+        case EXPR_STRING: {
+            const size_t capacity = (size_t)expr->string.length + 1;
+            char* decoded = allocate(capacity, sizeof(char));
+            size_t length;
+            if (decode_literal(expr->string, false, decoded, capacity, &length)) {
+                text_append(value, decoded, length);
+            } else {
+                stopped = true;
+            }
+            free(decoded);
+            return;
+        }
+        case EXPR_IDENT:
+            text_append(value, strings[expr->ident.slot].text, strings[expr->ident.slot].length);
+            return;
+        case EXPR_ASSIGN: {
+            Text assigned = {0};
+            evaluate_string(expr->assign.value, &assigned);
+            set_string(expr->assign.slot, &assigned);
+            text_append(value, strings[expr->assign.slot].text, strings[expr->assign.slot].length);
+            return;
+        }
+        case EXPR_BINARY:
+            evaluate_string(expr->binary.left, value);
+            if (!stopped) evaluate_string(expr->binary.right, value);
+            return;
+        case EXPR_CALL: {
+            Text texts[3] = {0};
+            int64_t numbers[3] = {0};
+            evaluate_arguments(expr, texts, numbers);
+            if (!stopped) {
+                const ScanText piece = expr->call.builtin == BUILTIN_SLICE
+                                           ? scan_slice(scan_text(&texts[0]), numbers[1], numbers[2])
+                                           : scan_split(scan_text(&texts[0]), scan_text(&texts[1]), numbers[2]);
+                text_append(value, piece.text, piece.length);
+            }
+            for (int i = 0; i < 3; i++) free(texts[i].text);
+            return;
+        }
+        default:
+            stopped = true;
+            return;
+    }
+}
+
+// && and || only evaluate their right operand when it decides the result
+static Value evaluate_logical(const Expression* expr) {
+    const bool left = truth(evaluate(expr->binary.left));
+    if (stopped) return int_value(0);
+    if (expr->op == TOKEN_AND ? !left : left) return int_value(left);
+    return int_value(truth(evaluate(expr->binary.right)));
+}
+
+static Value evaluate_comparison(const Ttype op, const Value left, const Value right) {
+    if (left.type == TYPE_INT && right.type == TYPE_INT) {
+        const int64_t x = left.integer;
+        const int64_t y = right.integer;
+        switch (op) {
+            case TOKEN_EQEQ: return int_value(x == y);
+            case TOKEN_NEQ: return int_value(x != y);
+            case TOKEN_LT: return int_value(x < y);
+            case TOKEN_GT: return int_value(x > y);
+            case TOKEN_LTE: return int_value(x <= y);
+            default: return int_value(x >= y);
+        }
+    }
+    const double x = convert(left, TYPE_DOUBLE).real;
+    const double y = convert(right, TYPE_DOUBLE).real;
+    switch (op) {
+        case TOKEN_EQEQ: return int_value(x == y);
+        case TOKEN_NEQ: return int_value(x != y);
+        case TOKEN_LT: return int_value(x < y);
+        case TOKEN_GT: return int_value(x > y);
+        case TOKEN_LTE: return int_value(x <= y);
+        default: return int_value(x >= y);
+    }
+}
+
+// Integer operators, with int64_t arithmetic wrapping as it does at run time
+static Value evaluate_integer(const Ttype op, const int64_t x, const int64_t y) {
+    switch (op) {
+        case TOKEN_PLUS: return int_value((int64_t)((uint64_t)x + (uint64_t)y));
+        case TOKEN_MINUS: return int_value((int64_t)((uint64_t)x - (uint64_t)y));
+        case TOKEN_MUL: return int_value((int64_t)((uint64_t)x * (uint64_t)y));
+        case TOKEN_MOD:
+            if (y == 0 || (x == INT64_MIN && y == -1)) return stop();
+            return int_value(x % y);
+        case TOKEN_BITWISE_AND: return int_value(x & y);
+        case TOKEN_BITWISE_OR: return int_value(x | y);
+        case TOKEN_XOR: return int_value(x ^ y);
+        case TOKEN_LSHIFT:
+            return int_value((int64_t)((uint64_t)x << (y & 63)));
+        case TOKEN_RSHIFT:
+            return int_value(x >> (y & 63));
+        default:
+            return stop();
+    }
+}
+
+// The builtins that yield numbers
+static Value evaluate_call(const Expression* expr) {
+    const Expression* first = expr->call.args[0];
+    if (expr->call.builtin == BUILTIN_PUSH) {
+        const int slot = first->ident.slot;
+        const Value value = convert(evaluate(expr->call.args[1]), element_type(slot));
+        if (!stopped) push_element(&arrays[slot], value);
+        return int_value(arrays[slot].length);
+    }
+    if (expr->call.builtin == BUILTIN_LEN && is_array(first->type)) {
+        return int_value(arrays[first->ident.slot].length);
+    }
+
+    Text texts[3] = {0};
+    int64_t numbers[3] = {0};
+    evaluate_arguments(expr, texts, numbers);
+    Value result = int_value(0);
+    if (!stopped) {
+        switch (expr->call.builtin) {
+            case BUILTIN_LEN:
+                result = int_value((int64_t)texts[0].length);
+                break;
+            case BUILTIN_FIND:
+                result = int_value(scan_find_from(scan_text(&texts[0]), scan_text(&texts[1]), numbers[2]));
+                break;
+            case BUILTIN_COMPARE:
+                result = int_value(scan_compare(scan_text(&texts[0]), scan_text(&texts[1])));
+                break;
+            default:
+                result = stop();
+                break;
+        }
+    }
+    for (int i = 0; i < 3; i++) free(texts[i].text);
+    return result;
+}
+
+static Value evaluate_string_equal(const Expression* expr) {
+    Text left = {0};
+    Text right = {0};
+    evaluate_string(expr->binary.left, &left);
+    if (!stopped) evaluate_string(expr->binary.right, &right);
+    const bool equal = scan_compare(scan_text(&left), scan_text(&right)) == 0;
+    free(left.text);
+    free(right.text);
+    return int_value(expr->op == TOKEN_EQEQ ? equal : !equal);
+}
+
+static Value evaluate_binary(const Expression* expr) {
+    const Ttype op = expr->op;
+    if (op == TOKEN_AND || op == TOKEN_OR) return evaluate_logical(expr);
+    if (expr->binary.left->type == TYPE_STRING) return evaluate_string_equal(expr);
+
+    const Value left = evaluate(expr->binary.left);
+    if (stopped) return left;
+    const Value right = evaluate(expr->binary.right);
+    if (stopped) return right;
+
+    switch (op) {
+        case TOKEN_EQEQ: case TOKEN_NEQ: case TOKEN_LT: case TOKEN_GT: case TOKEN_LTE: case TOKEN_GTE:
+            return evaluate_comparison(op, left, right);
+        case TOKEN_DIV:
+            return double_value(convert(left, TYPE_DOUBLE).real / convert(right, TYPE_DOUBLE).real);
+        case TOKEN_MOD: case TOKEN_BITWISE_AND: case TOKEN_BITWISE_OR: case TOKEN_XOR:
+        case TOKEN_LSHIFT: case TOKEN_RSHIFT: {
+            const Value x = convert(left, TYPE_INT);
+            const Value y = convert(right, TYPE_INT);
+            if (stopped) return x;
+            return evaluate_integer(op, x.integer, y.integer);
+        }
+        default:
+            break;
+    }
+
+    const Value x = convert(left, expr->type);
+    const Value y = convert(right, expr->type);
+    if (stopped) return x;
+    if (expr->type == TYPE_INT) return evaluate_integer(op, x.integer, y.integer);
+    switch (op) {
+        case TOKEN_PLUS: return double_value(x.real + y.real);
+        case TOKEN_MINUS: return double_value(x.real - y.real);
+        case TOKEN_MUL: return double_value(x.real * y.real);
+        default: return stop();
+    }
+}
+
+static Value evaluate(const Expression* expr) {
+    if (stopped) return int_value(0);
+    switch (expr->kind) {
+        case EXPR_NUMBER:
+            if (expr->type == TYPE_INT) return int_value((int64_t)expr->number.value);
+            return double_value(expr->number.value);
+        case EXPR_IDENT:
+            if (symbols[expr->ident.slot].type == TYPE_STRING) return stop();
+            return values[expr->ident.slot];
+        case EXPR_UNARY: {
+            const Value operand = evaluate(expr->unary.operand);
+            if (stopped) return operand;
+            switch (expr->op) {
+                case TOKEN_MINUS: {
+                    const Value value = convert(operand, expr->type);
+                    if (value.type == TYPE_DOUBLE) return double_value(-value.real);
+                    if (value.integer == INT64_MIN) return stop();
+                    return int_value(-value.integer);
+                }
+                case TOKEN_NOT:
+                    return int_value(!truth(operand));
+                default: {
+                    const Value value = convert(operand, TYPE_INT);
+                    return int_value(~value.integer);
+                }
+            }
+        }
+        case EXPR_BINARY:
+            return evaluate_binary(expr);
+        case EXPR_ASSIGN: {
+            if (symbols[expr->assign.slot].type == TYPE_STRING) return stop();
+            const Value value = convert(evaluate(expr->assign.value), symbols[expr->assign.slot].type);
+            if (!stopped) values[expr->assign.slot] = value;
+            return value;
+        }
+        case EXPR_CALL:
+            return evaluate_call(expr);
+        case EXPR_INDEX:
+        case EXPR_STORE:
+            return evaluate_element(expr);
+        default:
+            return stop();
+    }
+}
+
+static void evaluate_out(const Expression* expr) {
+    if (expr->kind == EXPR_STRING) {
+        // A literal is the printf format itself
+        const size_t capacity = (size_t)expr->string.length + 1;
+        char* decoded = allocate(capacity, sizeof(char));
+        size_t length;
+        if (decode_literal(expr->string, true, decoded, capacity, &length)) {
+            append(decoded, length);
+        } else {
+            stopped = true;
+        }
+        free(decoded);
+        return;
+    }
+    if (expr->type == TYPE_STRING) {
+        Text value = {0};
+        evaluate_string(expr, &value);
+        if (!stopped) {
+            append(value.text, value.length);
+            append("\n", 1);
+        }
+        free(value.text);
+        return;
+    }
+
+    const Value value = evaluate(expr);
+    if (stopped) return;
+    char text[512];
+    int length;
+    if (value.type == TYPE_INT) {
+        length = snprintf(text, sizeof(text), "%" PRId64 "\n", value.integer);
+    } else {
+        length = snprintf(text, sizeof(text), floor(value.real) == ceil(value.real) ? "%.0f\n" : "%f\n", value.real);
+    }
+    if (length < 0 || (size_t)length >= sizeof(text)) {
+        stopped = true;
+        return;
+    }
+    append(text, (size_t)length);
+}
+
+static Flow run_statements(const Statement* statements, int count);
+
+static Flow run_statement(const Statement* stmt) {
+    if (steps_left-- <= 0) return FLOW_STOP;
+
+    switch (stmt->type) {
+        case STMT_LET: {
+            const int slot = stmt->let_stmt.slot;
+            const Expression* init = stmt->let_stmt.expr;
+            if (symbols[slot].type == TYPE_STRING) {
+                if (init == NULL) return FLOW_STOP;
+                Text value = {0};
+                evaluate_string(init, &value);
+                set_string(slot, &value);
+            } else if (is_array(symbols[slot].type)) {
+                evaluate_array_into(init, slot);
+            } else if (init == NULL) {
+                values[slot] = convert(int_value(0), symbols[slot].type);
+            } else {
+                values[slot] = convert(evaluate(init), symbols[slot].type);
+            }
+            break;
+        }
+        case STMT_EXPR:
+            if (stmt->expr_stmt.expr->type == TYPE_STRING) {
+                Text value = {0};
+                evaluate_string(stmt->expr_stmt.expr, &value);
+                free(value.text);
+            } else if (is_array(stmt->expr_stmt.expr->type)) {
+                const Expression* expr = stmt->expr_stmt.expr;
+                if (expr->kind == EXPR_ASSIGN) evaluate_array_into(expr->assign.value, expr->assign.slot);
+            } else {
+                evaluate(stmt->expr_stmt.expr);
+            }
+            break;
+        case STMT_OUT:
+            evaluate_out(stmt->out_stmt.expr);
+            break;
+        case STMT_IN:
+            return FLOW_STOP;
+        case STMT_IF: {
+            const bool taken = truth(evaluate(stmt->if_stmt.condition));
+            if (stopped) return FLOW_STOP;
+            if (taken) return run_statements(stmt->if_stmt.if_block, stmt->if_stmt.if_count);
+            return run_statements(stmt->if_stmt.else_block, stmt->if_stmt.else_count);
+        }
+        case STMT_WHILE:
+            while (true) {
+                if (steps_left-- <= 0) return FLOW_STOP;
+                const bool taken = truth(evaluate(stmt->while_stmt.condition));
+                if (stopped) return FLOW_STOP;
+                if (!taken) break;
+                const Flow flow = run_statements(stmt->while_stmt.body, stmt->while_stmt.body_count);
+                if (flow == FLOW_BREAK) break;
+                if (flow == FLOW_EXIT || flow == FLOW_STOP) return flow;
+            }
+            break;
+        case STMT_BREAK:
+            return FLOW_BREAK;
+        case STMT_CONTINUE:
+            return FLOW_CONTINUE;
+        case STMT_RETURN:
+            if (stmt->ret_stmt.expr->type == TYPE_STRING) return FLOW_STOP;
+            status = evaluate(stmt->ret_stmt.expr);
+            if (stopped) return FLOW_STOP;
+            // exit() takes an int
+            if (status.type == TYPE_DOUBLE && !(status.real > -2147483649.0 && status.real < 2147483648.0)) {
+                return FLOW_STOP;
+            }
+            return FLOW_EXIT;
+        default:
+            break;
+    }
+    return stopped ? FLOW_STOP : FLOW_NORMAL;
+}
+
+static Flow run_statements(const Statement* statements, const int count) {
+    for (int i = 0; i < count; i++) {
+        const Flow flow = run_statement(&statements[i]);
+        if (flow != FLOW_NORMAL) return flow;
+    }
+    return FLOW_NORMAL;
+}
+
+static bool is_map(const VarType type) {
+    return type == TYPE_DOUBLE_MAP || type == TYPE_STRING_MAP;
+}
+
+// Whether an expression declares, changes or reads a map
+static bool uses_map(const Expression* expr) {
+    if (expr == nullptr) return false;
+    if (expr->kind == EXPR_MAP || is_map(expr->type)) return true;
+    switch (expr->kind) {
+        case EXPR_UNARY:
+            return uses_map(expr->unary.operand);
+        case EXPR_BINARY:
+            return uses_map(expr->binary.left) || uses_map(expr->binary.right);
+        case EXPR_ASSIGN:
+            return uses_map(expr->assign.value);
+        case EXPR_CALL:
+            for (int i = 0; i < expr->call.count; i++) {
+                if (uses_map(expr->call.args[i])) return true;
+            }
+            return false;
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->array.count; i++) {
+                if (uses_map(expr->array.elements[i])) return true;
+            }
+            return false;
+        case EXPR_INDEX:
+        case EXPR_STORE:
+            return uses_map(expr->index.index) || uses_map(expr->index.value);
+        default:
+            return false;
+    }
+}
+
+// Whether statements read input or use a map. Both are left to the compiled
+// program: the evaluated prefix is rebuilt as declarations, and a map has no
+// literal to rebuild it with.
+static bool runs_only_compiled(const Statement* statements, const int count) {
+    for (int i = 0; i < count; i++) {
+        const Statement* stmt = &statements[i];
+        switch (stmt->type) {
+            case STMT_IN:
+                return true;
+            case STMT_LET:
+                if (uses_map(stmt->let_stmt.expr)) return true;
+                break;
+            case STMT_RETURN:
+                if (uses_map(stmt->ret_stmt.expr)) return true;
+                break;
+            case STMT_OUT:
+                if (uses_map(stmt->out_stmt.expr)) return true;
+                break;
+            case STMT_EXPR:
+                if (uses_map(stmt->expr_stmt.expr)) return true;
+                break;
+            case STMT_IF:
+                if (uses_map(stmt->if_stmt.condition) ||
+                    runs_only_compiled(stmt->if_stmt.if_block, stmt->if_stmt.if_count) ||
+                    runs_only_compiled(stmt->if_stmt.else_block, stmt->if_stmt.else_count)) {
+                    return true;
+                }
+                break;
+            case STMT_WHILE:
+                if (uses_map(stmt->while_stmt.condition) ||
+                    runs_only_compiled(stmt->while_stmt.body, stmt->while_stmt.body_count)) {
+                    return true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Rebuilding the program
+
+static Lexeme copy_text(Arena* arena, const char* text, const int length) {
+    char* copy = arena_alloc(arena, (size_t)length + 1);
+    memcpy(copy, text, (size_t)length);
+    copy[length] = '\0';
+    return (Lexeme){copy, length};
+}
+
+static Expression* new_expression(Arena* arena, const ExpressionKind kind, const VarType type) {
+    Expression* expr = arena_alloc_zeroed(arena, sizeof(Expression));
+    expr->kind = kind;
+    expr->op = TOKEN_UNKNOWN;
+    expr->type = type;
+    return expr;
+}
+
+static Expression* new_number(Arena* arena, const VarType type, const double number, const char* text) {
+    Expression* expr = new_expression(arena, EXPR_NUMBER, type);
+    expr->number.value = number;
+    expr->number.text = copy_text(arena, text, (int)strlen(text));
+    return expr;
+}
+
+// A literal for a value, or nullptr when C has none
+static Expression* value_literal(Arena* arena, const Value value) {
+    char text[64];
+    if (value.type == TYPE_DOUBLE) {
+        if (!isfinite(value.real)) return nullptr;
+        // A literal with a fraction, so that C reads it as a double
+        snprintf(text, sizeof(text), "%.17g", value.real);
+        if (strpbrk(text, ".e") == NULL) strcat(text, ".0");
+        char* exponent = strchr(text, 'e');
+        if (exponent != NULL && memchr(text, '.', (size_t)(exponent - text)) == NULL) {
+            memmove(exponent + 2, exponent, strlen(exponent) + 1);
+            exponent[0] = '.';
+            exponent[1] = '0';
+        }
+        return new_number(arena, TYPE_DOUBLE, value.real, text);
+    }
+
+    // Integers beyond 2^53 do not survive the double a number literal holds,
+    // so they are built from their halves
+    const int64_t integer = value.integer;
+    if (integer >= -(INT64_C(1) << 53) && integer <= (INT64_C(1) << 53)) {
+        snprintf(text, sizeof(text), "%" PRId64, integer);
+        return new_number(arena, TYPE_INT, (double)integer, text);
+    }
+    Expression* high = new_expression(arena, EXPR_BINARY, TYPE_INT);
+    high->op = TOKEN_LSHIFT;
+    snprintf(text, sizeof(text), "%" PRId64, integer >> 32);
+    high->binary.left = new_number(arena, TYPE_INT, (double)(integer >> 32), text);
+    high->binary.right = new_number(arena, TYPE_INT, 32.0, "32");
+    Expression* whole = new_expression(arena, EXPR_BINARY, TYPE_INT);
+    whole->op = TOKEN_BITWISE_OR;
+    whole->binary.left = high;
+    snprintf(text, sizeof(text), "%" PRId64, integer & 0xffffffff);
+    whole->binary.right = new_number(arena, TYPE_INT, (double)(integer & 0xffffffff), text);
+    return whole;
+}
+
+// A string literal body that C reads back as text
+static Expression* string_literal(Arena* arena, const Text* text) {
+    char* encoded = arena_alloc(arena, text->length * 2 + 1);
+    int length = 0;
+    for (size_t i = 0; i < text->length; i++) {
+        const char* c = &text->text[i];
+        switch (*c) {
+            case '\n': encoded[length++] = '\\'; encoded[length++] = 'n'; break;
+            case '\t': encoded[length++] = '\\'; encoded[length++] = 't'; break;
+            case '\r': encoded[length++] = '\\'; encoded[length++] = 'r'; break;
+            case '\\': encoded[length++] = '\\'; encoded[length++] = '\\'; break;
+            case '"': encoded[length++] = '\\'; encoded[length++] = '"'; break;
+            default: encoded[length++] = *c; break;
+        }
+    }
+    Expression* expr = new_expression(arena, EXPR_STRING, TYPE_STRING);
+    expr->string = (Lexeme){encoded, length};
+    return expr;
+}
+
+// An array literal of an array variable's elements
+static Expression* array_literal(Arena* arena, const int slot) {
+    const Elements* array = &arrays[slot];
+    Expression* expr = new_expression(arena, EXPR_ARRAY, symbols[slot].type);
+    expr->array.count = (int)array->length;
+    expr->array.elements = arena_alloc(arena, sizeof(Expression*) * (size_t)(array->length > 0 ? array->length : 1));
+    for (int64_t i = 0; i < array->length; i++) {
+        expr->array.elements[i] = value_literal(arena, array->items[i]);
+        if (expr->array.elements[i] == nullptr) return nullptr;
+    }
+    return expr;
+}
+
+// Replace the first count statements with declarations of the top-level
+// variables they left behind, holding their current values
+static bool replace_prefix(Program* program, Arena* arena, const int count) {
+    bool* declared = allocate((size_t)program->symbol_count, sizeof(bool));
+    Statement* statements = arena_alloc(arena, sizeof(Statement) * (size_t)(count + program->count));
+    int kept = 0;
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++) {
+        const Statement* stmt = &program->statements[i];
+        if (stmt->type != STMT_LET || declared[stmt->let_stmt.slot]) continue;
+        const int slot = stmt->let_stmt.slot;
+        declared[slot] = true;
+
+        Statement let = *stmt;
+        if (symbols[slot].type == TYPE_STRING) {
+            let.let_stmt.expr = string_literal(arena, &strings[slot]);
+        } else if (is_array(symbols[slot].type)) {
+            let.let_stmt.expr = array_literal(arena, slot);
+            ok = let.let_stmt.expr != nullptr;
+        } else {
+            let.let_stmt.expr = value_literal(arena, values[slot]);
+            ok = let.let_stmt.expr != nullptr;
+        }
+        statements[kept++] = let;
+    }
+    free(declared);
+    if (!ok) return false;
+
+    for (int i = count; i < program->count; i++) {
+        statements[kept++] = program->statements[i];
+    }
+    program->statements = statements;
+    program->count = kept;
+    program->capacity = kept;
+    return true;
+}
+
+// Replace the whole program with its exit
+static bool replace_with_exit(Program* program, Arena* arena, const bool exits) {
+    Statement* statements = arena_alloc(arena, sizeof(Statement));
+    program->count = 0;
+    program->statements = statements;
+    if (!exits) return true;
+
+    Expression* value = value_literal(arena, status);
+    if (value == nullptr) return false;
+    statements[0].type = STMT_RETURN;
+    statements[0].ret_stmt.expr = value;
+    program->count = 1;
+    return true;
+}
+
+Evaluation evaluate_program(Program* program, Arena* arena, const int64_t budget) {
+    Evaluation result = {0};
+    symbols = program->symbols;
+    values = allocate((size_t)program->symbol_count, sizeof(Value));
+    strings = allocate((size_t)program->symbol_count, sizeof(*strings));
+    arrays = allocate((size_t)program->symbol_count, sizeof(*arrays));
+    for (int slot = 0; slot < program->symbol_count; slot++) {
+        values[slot] = convert(int_value(0), symbols[slot].type == TYPE_INT ? TYPE_INT : TYPE_DOUBLE);
+    }
+    output = nullptr;
+    output_length = 0;
+    output_capacity = 0;
+    steps_left = budget;
+    stopped = false;
+
+    int evaluated = 0;
+    Flow flow = FLOW_NORMAL;
+    while (evaluated < program->count && flow == FLOW_NORMAL) {
+        if (runs_only_compiled(&program->statements[evaluated], 1)) break;
+        flow = run_statement(&program->statements[evaluated]);
+        evaluated++;
+    }
+
+    bool replaced = false;
+    if (flow == FLOW_EXIT || (flow == FLOW_NORMAL && evaluated == program->count)) {
+        replaced = replace_with_exit(program, arena, flow == FLOW_EXIT);
+        result.finished = replaced;
+    } else if (flow == FLOW_NORMAL && evaluated > 0) {
+        replaced = replace_prefix(program, arena, evaluated);
+    }
+
+    if (replaced) {
+        result.text = output;
+        result.length = output_length;
+        result.evaluated = evaluated;
+    } else {
+        free(output);
+    }
+    free(values);
+    for (int slot = 0; slot < program->symbol_count; slot++) {
+        free(strings[slot].text);
+        free(arrays[slot].items);
+    }
+    free(strings);
+    free(arrays);
+    values = nullptr;
+    strings = nullptr;
+    arrays = nullptr;
+    output = nullptr;
+    symbols = nullptr;
+    return result;
+}
+
+void evaluate_cleanup(Evaluation* evaluation) {
+    free(evaluation->text);
+    evaluation->text = nullptr;
+    evaluation->length = 0;
+}
@@ -0,0 +1,407 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include "induction.h"
+#include "cfg.h"
+
+typedef struct {
+    int phi;
+    int init_index;     // Phi argument from the preheader
+    int latch_index;    // Phi argument from the latch
+    int next;           // phi + step or phi - step
+    int step;
+    bool subtract;
+} BasicIv;
+
+// A reduced multiplication, reused for later ones with the same operands
+typedef struct {
+    int phi;
+    int factor;         // -1 for phi * phi
+    int value;
+} Reduced;
+
+static IrProgram* ir;
+static Cfg cfg;
+static int line;            // Source line of the multiplication being reduced
+
+static bool is_invariant(const int loop, const int value) {
+    return ir_is_const(ir, value) || !cfg_in_loop(&cfg, ir->insts[value].block, loop);
+}
+
+// The only predecessor of the header inside the loop, or -1 when there are several
+static int single_latch(const int loop) {
+    const IrBlock* header = &ir->blocks[cfg.loops[loop].header];
+    int latch = -1;
+    for (int p = 0; p < header->pred_count; p++) {
+        if (!cfg_in_loop(&cfg, header->preds[p], loop)) continue;
+        if (latch >= 0) return -1;
+        latch = header->preds[p];
+    }
+    return latch;
+}
+
+// Recognize phi = phi(init, phi +- step) in a header with one entry and one latch
+static bool find_basic_iv(const int loop, const int phi, BasicIv* iv) {
+    const IrInst* inst = &ir->insts[phi];
+    const int header = cfg.loops[loop].header;
+    const IrBlock* block = &ir->blocks[header];
+    if (inst->op != IR_PHI || inst->block != header || inst->type != TYPE_INT) return false;
+    if (block->pred_count != 2 || inst->phi_count != 2) return false;
+
+    iv->phi = phi;
+    iv->latch_index = cfg_in_loop(&cfg, block->preds[0], loop) ? 0 : 1;
+    iv->init_index = 1 - iv->latch_index;
+    if (cfg_in_loop(&cfg, block->preds[iv->init_index], loop)) return false;
+
+    iv->next = ir_resolve(ir, inst->phi_args[iv->latch_index]);
+    const IrInst* next = &ir->insts[iv->next];
+    if (next->type != TYPE_INT || next->block < 0 || !cfg_in_loop(&cfg, next->block, loop)) return false;
+    const int a = ir_resolve(ir, next->args[0]);
+    const int b = ir_resolve(ir, next->args[1]);
+    if (next->op == IR_ADD && a == phi && is_invariant(loop, b)) {
+        iv->step = b;
+    } else if (next->op == IR_ADD && b == phi && is_invariant(loop, a)) {
+        iv->step = a;
+    } else if (next->op == IR_SUB && a == phi && is_invariant(loop, b)) {
+        iv->step = b;
+    } else {
+        return false;
+    }
+    iv->subtract = next->op == IR_SUB;
+    return true;
+}
+
+static int insert_after(const int after, const IrOp op, const int a, const int b) {
+    const int next = ir->insts[after].next;
+    const int id = next >= 0 ? ir_insert_before(ir, next, op, TYPE_INT, a, b)
+                             : ir_append(ir, ir->insts[after].block, op, TYPE_INT, a, b);
+    ir->insts[id].line = line;
+    return id;
+}
+
+static int append(const int block, const IrOp op, const int a, const int b) {
+    const int id = ir_append(ir, block, op, TYPE_INT, a, b);
+    ir->insts[id].line = line;
+    return id;
+}
+
+// A new header phi taking init from the preheader and next from the latch.
+// It goes after the existing phis: the back edge assigns them in order, so
+// updates that add the new variable still read it before it steps.
+static int new_iv_phi(const BasicIv* iv) {
+    int last = ir->blocks[ir->insts[iv->phi].block].first;
+    while (ir->insts[last].next >= 0 && ir->insts[ir->insts[last].next].op == IR_PHI) last = ir->insts[last].next;
+    const int phi = insert_after(last, IR_PHI, -1, -1);
+    ir->insts[phi].phi_args = arena_alloc(ir->arena, sizeof(int) * 2);
+    ir->insts[phi].phi_count = 2;
+    ir->insts[phi].line = ir->insts[iv->phi].line;
+    return phi;
+}
+
+// phi * factor as q = phi(init * factor, q +- step * factor)
+static int reduce_linear(const BasicIv* iv, const int factor, const int preheader) {
+    const int init = ir->insts[iv->phi].phi_args[iv->init_index];
+    const int start = append(preheader, IR_MUL, init, factor);
+    const int delta = append(preheader, IR_MUL, iv->step, factor);
+    const int phi = new_iv_phi(iv);
+    const int next = insert_after(iv->next, iv->subtract ? IR_SUB : IR_ADD, phi, delta);
+    ir->insts[phi].phi_args[iv->init_index] = start;
+    ir->insts[phi].phi_args[iv->latch_index] = next;
+    return phi;
+}
+
+// phi * phi by finite differences: with step e, (phi + e)^2 = phi^2 + u where
+// u = 2e * phi + e^2, and u itself steps by 2e^2
+static int reduce_square(const BasicIv* iv, const int preheader) {
+    const int init = ir->insts[iv->phi].phi_args[iv->init_index];
+    int step = iv->step;
+    if (iv->subtract) step = append(preheader, IR_NEG, step, -1);
+    const int twice = append(preheader, IR_ADD, step, step);
+    const int square_start = append(preheader, IR_MUL, init, init);
+    const int linear = append(preheader, IR_MUL, twice, init);
+    const int step_square = append(preheader, IR_MUL, step, step);
+    const int difference_start = append(preheader, IR_ADD, linear, step_square);
+    const int difference_step = append(preheader, IR_MUL, twice, step);
+
+    // The square's phi comes first, so the edge assigns it before the
+    // difference it adds
+    const int square = new_iv_phi(iv);
+    const int difference = new_iv_phi(iv);
+    const int square_next = insert_after(iv->next, IR_ADD, square, difference);
+    const int difference_next = insert_after(square_next, IR_ADD, difference, difference_step);
+    ir->insts[square].phi_args[iv->init_index] = square_start;
+    ir->insts[square].phi_args[iv->latch_index] = square_next;
+    ir->insts[difference].phi_args[iv->init_index] = difference_start;
+    ir->insts[difference].phi_args[iv->latch_index] = difference_next;
+    return square;
+}
+
+// Which operand of a multiplication is a basic induction variable of the
+// loop, with the other invariant or the same variable; -1 when neither
+static int iv_operand(const int loop, const int mul, BasicIv* iv) {
+    const IrInst* inst = &ir->insts[mul];
+    if (inst->op != IR_MUL || inst->type != TYPE_INT) return -1;
+    const int a = ir_resolve(ir, inst->args[0]);
+    const int b = ir_resolve(ir, inst->args[1]);
+    if (find_basic_iv(loop, a, iv) && (b == a || is_invariant(loop, b))) return 0;
+    if (find_basic_iv(loop, b, iv) && is_invariant(loop, a)) return 1;
+    return -1;
+}
+
+static bool has_candidate(const int loop) {
+    const int header = cfg.loops[loop].header;
+    for (int i = 0; i < cfg.loops[loop].block_count; i++) {
+        for (int id = ir->blocks[cfg.loops[loop].blocks[i]].first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            if (inst->op != IR_MUL || inst->type != TYPE_INT) continue;
+            for (int a = 0; a < 2; a++) {
+                const IrInst* operand = &ir->insts[ir_resolve(ir, inst->args[a])];
+                if (operand->op == IR_PHI && operand->block == header) return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void reduce_loop(const int loop, FILE* report) {
+    const int header = cfg.loops[loop].header;
+    if (header == 0 || single_latch(loop) < 0 || !has_candidate(loop)) return;
+    const int preheader = cfg_preheader(ir, &cfg, loop);
+
+    Reduced* reduced = nullptr;
+    int reduced_count = 0;
+    int reduced_capacity = 0;
+    for (int i = 0; i < cfg.loops[loop].block_count; i++) {
+        for (int id = ir->blocks[cfg.loops[loop].blocks[i]].first, next; id >= 0; id = next) {
+            next = ir->insts[id].next;
+            BasicIv iv;
+            const int operand = iv_operand(loop, id, &iv);
+            if (operand < 0) continue;
+            const int other = ir_resolve(ir, ir->insts[id].args[1 - operand]);
+            const int factor = other == iv.phi ? -1 : other;
+
+            int value = -1;
+            for (int r = 0; r < reduced_count; r++) {
+                if (reduced[r].phi == iv.phi && reduced[r].factor == factor) value = reduced[r].value;
+            }
+            if (value < 0) {
+                line = ir->insts[id].line;
+                value = factor < 0 ? reduce_square(&iv, preheader) : reduce_linear(&iv, factor, preheader);
+                if (reduced_count >= reduced_capacity) {
+                    reduced_capacity = reduced_capacity ? reduced_capacity * 2 : 8;
+                    reduced = realloc(reduced, sizeof(Reduced) * (size_t)reduced_capacity);
+                    if (reduced == NULL) {
+                        fprintf(stderr, "Memory allocation error\n");
+                        exit(1);
+                    }
+                }
+                reduced[reduced_count++] = (Reduced){iv.phi, factor, value};
+            }
+
+            if (report != nullptr) {
+                fprintf(report, "line %d: reduced ", ir->insts[id].line);
+                ir_dump_inst(ir, id, report);
+                fprintf(report, " to additions in the loop at line %d\n", ir->blocks[header].line);
+            }
+            ir_replace(ir, id, value);
+            ir_remove(ir, id);
+        }
+    }
+    free(reduced);
+}
+
+void induction_reduce_strength(IrProgram* program, FILE* report) {
+    ir = program;
+    cfg = cfg_analyze(ir);
+    for (int loop = cfg.loop_count - 1; loop >= 0; loop--) {
+        reduce_loop(loop, report);
+    }
+    cfg_free(&cfg);
+    ir = nullptr;
+}
+
+static void mark_escape(const int value, const int block, bool* escapes) {
+    if (value < 0) return;
+    const int resolved = ir_resolve(ir, value);
+    const int loop = cfg.loop_of[ir->insts[resolved].block];
+    if (loop >= 0 && !cfg_in_loop(&cfg, block, loop)) escapes[resolved] = true;
+}
+
+// Values used outside the innermost loop that defines them
+static bool* find_escapes() {
+    bool* escapes = calloc(ir->inst_count > 0 ? (size_t)ir->inst_count : 1, sizeof(bool));
+    if (escapes == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    for (int i = 0; i < cfg.order_count; i++) {
+        const int b = cfg.order[i];
+        const IrBlock* block = &ir->blocks[b];
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            mark_escape(inst->args[0], b, escapes);
+            mark_escape(inst->args[1], b, escapes);
+            for (int a = 0; a < inst->phi_count; a++) {
+                // A phi argument is used at the end of the matching predecessor
+                mark_escape(inst->phi_args[a], block->preds[a], escapes);
+            }
+        }
+        if (block->term == TERM_BRANCH || block->term == TERM_EXIT) mark_escape(block->cond, b, escapes);
+    }
+    return escapes;
+}
+
+static IrOp mirror(const IrOp op) {
+    switch (op) {
+        case IR_LT: return IR_GT;
+        case IR_GT: return IR_LT;
+        case IR_LE: return IR_GE;
+        case IR_GE: return IR_LE;
+        default: return op;
+    }
+}
+
+// Iterations of a loop whose counter and bound are constants, or -1. Once
+// the test has passed, a last step that could carry the counter past the
+// int64 range wraps it back to where the test passes again.
+static int64_t constant_trip_count(const IrOp op, const int64_t init, const int64_t bound, const int64_t step) {
+    const uint64_t magnitude = step < 0 ? -(uint64_t)step : (uint64_t)step;
+    switch (op) {
+        case IR_LT:
+            if (init >= bound) return 0;
+            if (bound - 1 > INT64_MAX - step) return -1;
+            return (int64_t)(((uint64_t)bound - (uint64_t)init + magnitude - 1) / magnitude);
+        case IR_LE:
+            if (init > bound) return 0;
+            if (bound > INT64_MAX - step) return -1;
+            return (int64_t)(((uint64_t)bound - (uint64_t)init) / magnitude + 1);
+        case IR_GT:
+            if (init <= bound) return 0;
+            if (bound + 1 < INT64_MIN - step) return -1;
+            return (int64_t)(((uint64_t)init - (uint64_t)bound + magnitude - 1) / magnitude);
+        case IR_GE:
+            if (init < bound) return 0;
+            if (bound < INT64_MIN - step) return -1;
+            return (int64_t)(((uint64_t)init - (uint64_t)bound) / magnitude + 1);
+        default:
+            return -1;
+    }
+}
+
+static bool phis_read_each_other(const IrBlock* block, const int header) {
+    for (int id = block->first; id >= 0 && ir->insts[id].op == IR_PHI; id = ir->insts[id].next) {
+        const IrInst* phi = &ir->insts[id];
+        for (int a = 0; a < phi->phi_count; a++) {
+            const int value = ir_resolve(ir, phi->phi_args[a]);
+            if (value != id && ir->insts[value].op == IR_PHI && ir->insts[value].block == header) return true;
+        }
+    }
+    return false;
+}
+
+// The header phi that a loop's test steps towards its bound
+static bool find_counter(const int loop, LoopCounter* counter) {
+    const int header = cfg.loops[loop].header;
+    const IrBlock* block = &ir->blocks[header];
+    if (header == 0 || block->term != TERM_BRANCH || single_latch(loop) < 0) return false;
+    if (!cfg_in_loop(&cfg, block->succ[0], loop) || cfg_in_loop(&cfg, block->succ[1], loop)) return false;
+
+    const int cond = ir_resolve(ir, block->cond);
+    const IrInst* test = &ir->insts[cond];
+    if (test->block != header || test->op < IR_LT || test->op > IR_GE) return false;
+    const int a = ir_resolve(ir, test->args[0]);
+    const int b = ir_resolve(ir, test->args[1]);
+    if (ir->insts[a].type != TYPE_INT || ir->insts[b].type != TYPE_INT) return false;
+
+    BasicIv iv;
+    IrOp op = test->op;
+    int bound;
+    if (find_basic_iv(loop, a, &iv) && is_invariant(loop, b)) {
+        bound = b;
+    } else if (find_basic_iv(loop, b, &iv) && is_invariant(loop, a)) {
+        bound = a;
+        op = mirror(op);
+    } else {
+        return false;
+    }
+    if (!ir_is_const(ir, iv.step)) return false;
+    int64_t step = ir->insts[iv.step].value.integer;
+    if (iv.subtract) step = step == INT64_MIN ? 0 : -step;
+    const bool upward = op == IR_LT || op == IR_LE;
+    if (step == 0 || (step > 0) != upward) return false;
+
+    counter->phi = iv.phi;
+    counter->init = ir_resolve(ir, ir->insts[iv.phi].phi_args[iv.init_index]);
+    counter->bound = bound;
+    counter->op = op;
+    counter->step = step;
+    return true;
+}
+
+bool induction_find_counter(IrProgram* program, const Cfg* analysis, const int loop, LoopCounter* counter) {
+    ir = program;
+    cfg = *analysis;
+    const bool found = find_counter(loop, counter);
+    cfg = (Cfg){0};
+    ir = nullptr;
+    return found;
+}
+
+int64_t induction_trip_count(const IrProgram* program, const LoopCounter* counter) {
+    const IrInst* init = &program->insts[counter->init];
+    const IrInst* bound = &program->insts[counter->bound];
+    if (init->op != IR_CONST || bound->op != IR_CONST) return -1;
+    return constant_trip_count(counter->op, init->value.integer, bound->value.integer, counter->step);
+}
+
+static void mark_loop(const int loop, const bool* escapes, FILE* report) {
+    const int header = cfg.loops[loop].header;
+    IrBlock* block = &ir->blocks[header];
+    LoopCounter counter;
+    if (!find_counter(loop, &counter) || phis_read_each_other(block, header)) return;
+
+    // Leaving the loop happens after the for statement, where values computed
+    // in the header body no longer stand for the last test
+    const IrBlock* exit = &ir->blocks[block->succ[1]];
+    int index = 0;
+    while (exit->preds[index] != header) index++;
+    for (int id = exit->first; id >= 0 && ir->insts[id].op == IR_PHI; id = ir->insts[id].next) {
+        const IrInst* value = &ir->insts[ir_resolve(ir, ir->insts[id].phi_args[index])];
+        if (value->block == header && value->op != IR_PHI) return;
+    }
+
+    // The header is the only exit
+    for (int i = 0; i < cfg.loops[loop].block_count; i++) {
+        const int b = cfg.loops[loop].blocks[i];
+        if (b == header) continue;
+        for (int s = 0; s < ir_succ_count(&ir->blocks[b]); s++) {
+            if (!cfg_in_loop(&cfg, ir->blocks[b].succ[s], loop)) return;
+        }
+    }
+
+    // The test moves into the for statement, ahead of the rest of the header,
+    // which then only runs when the test passes
+    for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+        const IrInst* inst = &ir->insts[id];
+        if (inst->op == IR_PHI) continue;
+        if (escapes[id] || ir_may_trap(ir, inst) || ir_has_side_effect(inst->op)) return;
+    }
+
+    block->counter = counter.phi;
+    if (report == nullptr) return;
+    fprintf(report, "line %d: loop counted by v%d, step %" PRId64, ir->blocks[header].line, counter.phi, counter.step);
+    const int64_t trips = induction_trip_count(ir, &counter);
+    if (trips >= 0) fprintf(report, ", %" PRId64 " iterations", trips);
+    fprintf(report, "\n");
+}
+
+void induction_mark_counted_loops(IrProgram* program, FILE* report) {
+    ir = program;
+    cfg = cfg_analyze(ir);
+    bool* escapes = find_escapes();
+    for (int loop = 0; loop < cfg.loop_count; loop++) {
+        mark_loop(loop, escapes, report);
+    }
+    free(escapes);
+    cfg_free(&cfg);
+    ir = nullptr;
+}
@@ -0,0 +1,93 @@
+#include <string.h>
+#include "intern.h"
+
+static Arena* arena;
+
+// Open-addressing table of ID + 1 (0 marks an empty slot), kept at most half full
+static uint32_t* slots;
+static uint32_t slot_count;
+
+// Per-ID data
+static Lexeme* names;
+static uint32_t* hashes;
+static uint32_t count;
+static uint32_t capacity;
+
+static uint32_t hash_name(const char* text, const int length) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void rehash(const uint32_t new_slot_count) {
+    slots = arena_alloc_zeroed(arena, new_slot_count * sizeof(uint32_t));
+    slot_count = new_slot_count;
+
+    for (uint32_t id = 0; id < count; id++) {
+        uint32_t slot = hashes[id] & (slot_count - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = id + 1;
+    }
+}
+
+void intern_init(Arena* owner) {
+    intern_cleanup();
+    arena = owner;
+}
+
+uint32_t intern(const char* text, const int length) {
+    if (slot_count == 0) {
+        rehash(1024);
+    }
+
+    const uint32_t hash = hash_name(text, length);
+    uint32_t slot = hash & (slot_count - 1);
+    while (slots[slot] != 0) {
+        const uint32_t id = slots[slot] - 1;
+        if (hashes[id] == hash && names[id].length == length &&
+            memcmp(names[id].text, text, (size_t)length) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & (slot_count - 1);
+    }
+
+    if (count == capacity) {
+        const uint32_t grown = capacity ? capacity * 2 : 256;
+        names = arena_grow(arena, names, capacity * sizeof(Lexeme), grown * sizeof(Lexeme));
+        hashes = arena_grow(arena, hashes, capacity * sizeof(uint32_t), grown * sizeof(uint32_t));
+        capacity = grown;
+    }
+
+    const uint32_t id = count++;
+    names[id].text = text;
+    names[id].length = length;
+    hashes[id] = hash;
+
+    if (count * 2 > slot_count) {
+        rehash(slot_count * 2);
+    } else {
+        slots[slot] = id + 1;
+    }
+    return id;
+}
+
+Lexeme intern_name(const uint32_t id) {
+    return names[id];
+}
+
+uint32_t intern_count() {
+    return count;
+}
+
+void intern_cleanup() {
+    slots = nullptr;
+    names = nullptr;
+    hashes = nullptr;
+    slot_count = 0;
+    count = 0;
+    capacity = 0;
+}
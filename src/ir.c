@@ -0,0 +1,1211 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "ir.h"
+#include "intern.h"
+
+// SSA construction follows Braun et al., "Simple and Efficient Construction of
+// SSA Form": the current value of a variable is recorded per block, reads
+// search the predecessors, and phis are only placed where a read needs one.
+// Blocks whose predecessors are not all known yet (loop headers) are unsealed,
+// and their phis get operands once the block is sealed.
+
+typedef struct {
+    uint64_t key;       // (block << 32 | slot) + 1, 0 when free
+    int value;
+} Definition;
+
+typedef struct {
+    int slot;
+    int phi;
+    int next;
+} IncompletePhi;
+
+typedef struct {
+    int header;
+    int exit;
+} Loop;
+
+static IrProgram* ir;
+static int current;
+static int line;
+
+static Definition* definitions;
+static uint32_t definition_slots;
+static uint32_t definition_count;
+
+static IncompletePhi* incomplete;
+static int incomplete_count;
+static int incomplete_capacity;
+
+static Loop* loops;
+static int loop_count;
+static int loop_capacity;
+
+// Temporary slots of one type, taken and released in stack order
+typedef struct {
+    int* slots;
+    int count;
+    int capacity;
+    int used;
+} TempSlots;
+
+// The program's variables, then temporary slots for concatenations and views
+static Symbol* symbols;
+static int symbol_capacity;
+static TempSlots string_temps;
+static TempSlots view_temps;
+
+// Grow an arena array of element_size elements to hold at least needed
+static void* reserve(Arena* arena, void* items, int* capacity, const int needed, const size_t element_size) {
+    if (needed <= *capacity) return items;
+    int new_capacity = *capacity ? *capacity * 2 : 8;
+    while (new_capacity < needed) new_capacity *= 2;
+    items = arena_grow(arena, items, (size_t)*capacity * element_size, (size_t)new_capacity * element_size);
+    *capacity = new_capacity;
+    return items;
+}
+
+int ir_new_block(IrProgram* program) {
+    if (program->block_count >= program->block_capacity) {
+        const int capacity = program->block_capacity ? program->block_capacity * 2 : 64;
+        program->blocks = arena_grow(program->arena, program->blocks, sizeof(IrBlock) * program->block_capacity,
+                                     sizeof(IrBlock) * capacity);
+        program->block_capacity = capacity;
+    }
+    IrBlock* block = &program->blocks[program->block_count];
+    memset(block, 0, sizeof(IrBlock));
+    block->first = -1;
+    block->last = -1;
+    block->cond = -1;
+    block->succ[0] = -1;
+    block->succ[1] = -1;
+    block->counter = -1;
+    block->incomplete = -1;
+    return program->block_count++;
+}
+
+static int new_inst(IrProgram* program, const int block, const IrOp op, const VarType type, const int a, const int b) {
+    if (program->inst_count >= program->inst_capacity) {
+        const int capacity = program->inst_capacity ? program->inst_capacity * 2 : 256;
+        program->insts = arena_grow(program->arena, program->insts, sizeof(IrInst) * program->inst_capacity,
+                                    sizeof(IrInst) * capacity);
+        program->inst_capacity = capacity;
+    }
+    IrInst* inst = &program->insts[program->inst_count];
+    memset(inst, 0, sizeof(IrInst));
+    inst->op = op;
+    inst->type = type;
+    inst->block = block;
+    inst->args[0] = a;
+    inst->args[1] = b;
+    inst->slot = -1;
+    inst->source = -1;
+    inst->other = -1;
+    return program->inst_count++;
+}
+
+int ir_append(IrProgram* program, const int block, const IrOp op, const VarType type, const int a, const int b) {
+    const int id = new_inst(program, block, op, type, a, b);
+    IrBlock* owner = &program->blocks[block];
+    program->insts[id].prev = owner->last;
+    program->insts[id].next = -1;
+    if (owner->last >= 0) {
+        program->insts[owner->last].next = id;
+    } else {
+        owner->first = id;
+    }
+    owner->last = id;
+    return id;
+}
+
+int ir_insert_before(IrProgram* program, const int before, const IrOp op, const VarType type, const int a, const int b) {
+    const int block = program->insts[before].block;
+    const int id = new_inst(program, block, op, type, a, b);
+    const int prev = program->insts[before].prev;
+    program->insts[id].prev = prev;
+    program->insts[id].next = before;
+    program->insts[before].prev = id;
+    if (prev >= 0) {
+        program->insts[prev].next = id;
+    } else {
+        program->blocks[block].first = id;
+    }
+    return id;
+}
+
+int ir_const_int(IrProgram* program, const int block, const int64_t value) {
+    const int id = ir_append(program, block, IR_CONST, TYPE_INT, -1, -1);
+    program->insts[id].value.integer = value;
+    return id;
+}
+
+int ir_const_double(IrProgram* program, const int block, const double value) {
+    const int id = ir_append(program, block, IR_CONST, TYPE_DOUBLE, -1, -1);
+    program->insts[id].value.real = value;
+    return id;
+}
+
+static void unlink_inst(IrProgram* program, const int id) {
+    IrInst* inst = &program->insts[id];
+    IrBlock* block = &program->blocks[inst->block];
+    if (inst->prev >= 0) {
+        program->insts[inst->prev].next = inst->next;
+    } else {
+        block->first = inst->next;
+    }
+    if (inst->next >= 0) {
+        program->insts[inst->next].prev = inst->prev;
+    } else {
+        block->last = inst->prev;
+    }
+    inst->prev = -1;
+    inst->next = -1;
+}
+
+void ir_remove(IrProgram* program, const int id) {
+    unlink_inst(program, id);
+    program->insts[id].removed = true;
+}
+
+void ir_move(IrProgram* program, const int id, const int block) {
+    unlink_inst(program, id);
+    IrInst* inst = &program->insts[id];
+    IrBlock* target = &program->blocks[block];
+    inst->block = block;
+    inst->prev = target->last;
+    if (target->last >= 0) {
+        program->insts[target->last].next = id;
+    } else {
+        target->first = id;
+    }
+    target->last = id;
+}
+
+void ir_add_pred(IrProgram* program, const int block, const int pred) {
+    IrBlock* target = &program->blocks[block];
+    target->preds = reserve(program->arena, target->preds, &target->pred_capacity, target->pred_count + 1,
+                            sizeof(int));
+    target->preds[target->pred_count++] = pred;
+}
+
+void ir_remove_edge(IrProgram* program, const int pred, const int block) {
+    IrBlock* target = &program->blocks[block];
+    int index = -1;
+    for (int i = 0; i < target->pred_count; i++) {
+        if (target->preds[i] == pred) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) return;
+
+    memmove(&target->preds[index], &target->preds[index + 1], sizeof(int) * (target->pred_count - index - 1));
+    target->pred_count--;
+    for (int id = target->first; id >= 0; id = program->insts[id].next) {
+        IrInst* phi = &program->insts[id];
+        if (phi->op != IR_PHI) break;
+        if (index < phi->phi_count) {
+            memmove(&phi->phi_args[index], &phi->phi_args[index + 1], sizeof(int) * (phi->phi_count - index - 1));
+            phi->phi_count--;
+        }
+    }
+}
+
+int ir_resolve(const IrProgram* program, int value) {
+    while (value >= 0 && program->insts[value].op == IR_COPY) {
+        value = program->insts[value].args[0];
+    }
+    return value;
+}
+
+void ir_replace(IrProgram* program, const int id, const int value) {
+    IrInst* inst = &program->insts[id];
+    inst->op = IR_COPY;
+    inst->args[0] = value;
+    inst->args[1] = -1;
+    inst->phi_count = 0;
+}
+
+int ir_succ_count(const IrBlock* block) {
+    switch (block->term) {
+        case TERM_JUMP: return 1;
+        case TERM_BRANCH: return 2;
+        default: return 0;
+    }
+}
+
+bool ir_has_side_effect(const IrOp op) {
+    return op == IR_IN || op == IR_OUT || (op >= IR_IN_STRING && op <= IR_PUT_MAP);
+}
+
+bool ir_may_trap(const IrProgram* program, const IrInst* inst) {
+    if (inst->op != IR_MOD) return false;
+    const int divisor = ir_resolve(program, inst->args[1]);
+    return !ir_is_const(program, divisor) || program->insts[divisor].value.integer == 0 ||
+           program->insts[divisor].value.integer == -1;
+}
+
+bool ir_is_const(const IrProgram* program, const int value) {
+    return program->insts[value].op == IR_CONST;
+}
+
+void* ir_allocate(const size_t count, const size_t size) {
+    void* memory = calloc(count > 0 ? count : 1, size);
+    if (memory == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    return memory;
+}
+
+void* ir_reallocate(void* memory, const size_t count, const size_t size) {
+    memory = realloc(memory, (count > 0 ? count : 1) * size);
+    if (memory == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    return memory;
+}
+
+void* ir_grow(void* items, const int count, int* capacity, const size_t size) {
+    if (count < *capacity) return items;
+    *capacity = *capacity > 0 ? *capacity * 2 : 16;
+    return ir_reallocate(items, (size_t)*capacity, size);
+}
+
+bool ir_effect_has_value(const IrOp op) {
+    return (op >= IR_LENGTH_STRING && op <= IR_LENGTH_ARRAY) || (op >= IR_GET_MAP && op <= IR_LENGTH_MAP);
+}
+
+// ---------------------------------------------------------------------------
+// Variable definitions per block
+
+static void define(const int block, const int slot, const int value);
+
+static uint32_t definition_index(const uint64_t key) {
+    uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(hash >> 32) & (definition_slots - 1);
+}
+
+static void rehash_definitions(const uint32_t slots) {
+    Definition* old = definitions;
+    const uint32_t old_slots = definition_slots;
+    definitions = arena_alloc_zeroed(ir->arena, sizeof(Definition) * slots);
+    definition_slots = slots;
+    for (uint32_t i = 0; i < old_slots; i++) {
+        if (old[i].key != 0) {
+            uint32_t index = definition_index(old[i].key);
+            while (definitions[index].key != 0) index = (index + 1) & (slots - 1);
+            definitions[index] = old[i];
+        }
+    }
+}
+
+static void define(const int block, const int slot, const int value) {
+    if ((definition_count + 1) * 2 > definition_slots) {
+        rehash_definitions(definition_slots ? definition_slots * 2 : 1024);
+    }
+    const uint64_t key = ((uint64_t)block << 32 | (uint32_t)slot) + 1;
+    uint32_t index = definition_index(key);
+    while (definitions[index].key != 0 && definitions[index].key != key) {
+        index = (index + 1) & (definition_slots - 1);
+    }
+    if (definitions[index].key == 0) definition_count++;
+    definitions[index].key = key;
+    definitions[index].value = value;
+}
+
+static bool lookup(const int block, const int slot, int* value) {
+    if (definition_slots == 0) return false;
+    const uint64_t key = ((uint64_t)block << 32 | (uint32_t)slot) + 1;
+    for (uint32_t index = definition_index(key); definitions[index].key != 0;
+         index = (index + 1) & (definition_slots - 1)) {
+        if (definitions[index].key == key) {
+            *value = definitions[index].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int read_variable(int slot, int block);
+
+static int new_phi(const int block, const VarType type) {
+    const int first = ir->blocks[block].first;
+    if (first >= 0) return ir_insert_before(ir, first, IR_PHI, type, -1, -1);
+    return ir_append(ir, block, IR_PHI, type, -1, -1);
+}
+
+static void add_phi_operands(const int slot, const int phi) {
+    const int block = ir->insts[phi].block;
+    const int count = ir->blocks[block].pred_count;
+    int* args = arena_alloc(ir->arena, sizeof(int) * (count ? count : 1));
+    for (int i = 0; i < count; i++) {
+        args[i] = read_variable(slot, ir->blocks[block].preds[i]);
+    }
+    ir->insts[phi].phi_args = args;
+    ir->insts[phi].phi_count = count;
+}
+
+static int zero(const int block, const VarType type) {
+    return type == TYPE_INT ? ir_const_int(ir, block, 0) : ir_const_double(ir, block, 0.0);
+}
+
+static int read_variable(const int slot, const int block) {
+    int value;
+    if (lookup(block, slot, &value)) return value;
+
+    const VarType type = ir->symbols[slot].type;
+    const IrBlock* owner = &ir->blocks[block];
+    if (!owner->sealed) {
+        value = new_phi(block, type);
+        incomplete = reserve(ir->arena, incomplete, &incomplete_capacity, incomplete_count + 1, sizeof(IncompletePhi));
+        incomplete[incomplete_count] = (IncompletePhi){slot, value, ir->blocks[block].incomplete};
+        ir->blocks[block].incomplete = incomplete_count++;
+    } else if (owner->pred_count == 0) {
+        // Unreachable code, or a variable read before any definition
+        value = zero(block, type);
+    } else if (owner->pred_count == 1) {
+        value = read_variable(slot, owner->preds[0]);
+    } else {
+        value = new_phi(block, type);
+        define(block, slot, value); // Break cycles through loops
+        add_phi_operands(slot, value);
+    }
+    define(block, slot, value);
+    return value;
+}
+
+static void seal(const int block) {
+    for (int i = ir->blocks[block].incomplete; i >= 0; i = incomplete[i].next) {
+        add_phi_operands(incomplete[i].slot, incomplete[i].phi);
+    }
+    ir->blocks[block].incomplete = -1;
+    ir->blocks[block].sealed = true;
+}
+
+// ---------------------------------------------------------------------------
+// Lowering
+
+static int new_block() {
+    const int block = ir_new_block(ir);
+    ir->blocks[block].loop_depth = loop_count;
+    return block;
+}
+
+static void jump(const int from, const int to) {
+    ir->blocks[from].term = TERM_JUMP;
+    ir->blocks[from].succ[0] = to;
+    ir_add_pred(ir, to, from);
+}
+
+static void branch(const int from, const int cond, const int if_true, const int if_false) {
+    ir->blocks[from].term = TERM_BRANCH;
+    ir->blocks[from].cond = cond;
+    ir->blocks[from].succ[0] = if_true;
+    ir->blocks[from].succ[1] = if_false;
+    ir_add_pred(ir, if_true, from);
+    ir_add_pred(ir, if_false, from);
+}
+
+// Continue lowering in a fresh block that nothing jumps to
+static void start_unreachable() {
+    current = new_block();
+    seal(current);
+}
+
+static int emit(const IrOp op, const VarType type, const int a, const int b) {
+    const int id = ir_append(ir, current, op, type, a, b);
+    ir->insts[id].line = line;
+    return id;
+}
+
+static int convert(const int value, const VarType type) {
+    if (ir->insts[value].type == type) return value;
+    return emit(type == TYPE_INT ? IR_TO_INT : IR_TO_DOUBLE, type, value, -1);
+}
+
+static bool is_truth_value(const int value) {
+    const IrOp op = ir->insts[value].op;
+    return op == IR_NOT || (op >= IR_EQ && op <= IR_GE);
+}
+
+// 0 or 1 for a value tested against zero
+static int truth(const int value) {
+    if (is_truth_value(value)) return value;
+    return emit(IR_NE, TYPE_INT, value, zero(current, ir->insts[value].type));
+}
+
+static IrOp binary_op(const Ttype op) {
+    switch (op) {
+        case TOKEN_PLUS: return IR_ADD;
+        case TOKEN_MINUS: return IR_SUB;
+        case TOKEN_MUL: return IR_MUL;
+        case TOKEN_DIV: return IR_DIV;
+        case TOKEN_MOD: return IR_MOD;
+        case TOKEN_BITWISE_AND: return IR_AND;
+        case TOKEN_BITWISE_OR: return IR_OR;
+        case TOKEN_XOR: return IR_XOR;
+        case TOKEN_LSHIFT: return IR_SHL;
+        case TOKEN_RSHIFT: return IR_SHR;
+        case TOKEN_EQEQ: return IR_EQ;
+        case TOKEN_NEQ: return IR_NE;
+        case TOKEN_LT: return IR_LT;
+        case TOKEN_GT: return IR_GT;
+        case TOKEN_LTE: return IR_LE;
+        case TOKEN_GTE: return IR_GE;
+        default:
+            fprintf(stderr, "Error: Invalid operator in expression\n");
+            exit(EXIT_FAILURE);
+    }
+}
+
+static int lower_value(const Expression* expr);
+
+// A string operand: a slot, or a literal when slot is -1
+typedef struct {
+    int slot;
+    Lexeme text;
+} StringValue;
+
+static void emit_string(const IrOp op, const int slot, const StringValue value) {
+    const int id = emit(op, TYPE_STRING, -1, -1);
+    ir->insts[id].slot = slot;
+    ir->insts[id].source = value.slot;
+    ir->insts[id].text = value.text;
+}
+
+// A slot for an intermediate result, free again once the slots taken after
+// it are released
+static int take_temp(TempSlots* temps, const VarType type, const char* name) {
+    if (temps->used == temps->count) {
+        symbols = reserve(ir->arena, symbols, &symbol_capacity, ir->symbol_count + 1, sizeof(Symbol));
+        symbols[ir->symbol_count] = (Symbol){intern(name, (int)strlen(name)), type};
+        temps->slots = reserve(ir->arena, temps->slots, &temps->capacity, temps->count + 1, sizeof(int));
+        temps->slots[temps->count++] = ir->symbol_count++;
+        ir->symbols = symbols;
+    }
+    return temps->slots[temps->used++];
+}
+
+static int take_string_temp() {
+    return take_temp(&string_temps, TYPE_STRING, "string_temp");
+}
+
+static void release_string_temp() {
+    string_temps.used--;
+}
+
+// The temporaries in use, to release together once a string operand has been read
+typedef struct {
+    int strings;
+    int views;
+} TempMark;
+
+static TempMark mark_temps() {
+    return (TempMark){string_temps.used, view_temps.used};
+}
+
+static void release_temps(const TempMark mark) {
+    string_temps.used = mark.strings;
+    view_temps.used = mark.views;
+}
+
+// Whether an expression reads or assigns a string slot
+static bool mentions_slot(const Expression* expr, const int slot) {
+    switch (expr->kind) {
+        case EXPR_IDENT:
+            return expr->ident.slot == slot;
+        case EXPR_ASSIGN:
+            return expr->assign.slot == slot || mentions_slot(expr->assign.value, slot);
+        case EXPR_BINARY:
+            return mentions_slot(expr->binary.left, slot) || mentions_slot(expr->binary.right, slot);
+        case EXPR_CALL:
+            for (int i = 0; i < expr->call.count; i++) {
+                if (mentions_slot(expr->call.args[i], slot)) return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+static void lower_string_into(const Expression* expr, int slot);
+static StringValue lower_view(const Expression* expr);
+
+// A literal, a variable, a view, or an assignment, which is lowered first.
+// The temporaries a view reads stay taken until the caller releases them.
+static StringValue lower_string(const Expression* expr) {
+    switch (expr->kind) {
+        case EXPR_STRING:
+            return (StringValue){-1, expr->string};
+        case EXPR_IDENT:
+            return (StringValue){expr->ident.slot, {0}};
+        case EXPR_ASSIGN:
+            lower_string_into(expr->assign.value, expr->assign.slot);
+            return (StringValue){expr->assign.slot, {0}};
+        case EXPR_CALL:
+            return lower_view(expr);
+        default:
+            fprintf(stderr, "Error: Invalid string expression\n");
+            exit(EXIT_FAILURE);
+    }
+}
+
+// A string operand of a builtin; a concatenation is built in a temporary
+static StringValue lower_operand(const Expression* expr) {
+    if (expr->kind != EXPR_BINARY) return lower_string(expr);
+    const int temp = take_string_temp();
+    lower_string_into(expr, temp);
+    return (StringValue){temp, {0}};
+}
+
+static int lower_int(const Expression* expr) {
+    return convert(lower_value(expr), TYPE_INT);
+}
+
+// A builtin with its number operands, which are lowered first: a view is
+// then read before any other string is built
+static int emit_builtin(const IrOp op, const VarType type, const int a, const int b, const Expression* source,
+                        const Expression* other) {
+    const StringValue text = lower_operand(source);
+    const StringValue second = other != nullptr ? lower_operand(other) : (StringValue){-1, {0}};
+    const int id = emit(op, type, a, b);
+    ir->insts[id].source = text.slot;
+    ir->insts[id].text = text.text;
+    ir->insts[id].other = second.slot;
+    ir->insts[id].other_text = second.text;
+    return id;
+}
+
+// slice and split, into a view temporary
+static StringValue lower_view(const Expression* expr) {
+    Expression* const* args = expr->call.args;
+    int id;
+    if (expr->call.builtin == BUILTIN_SLICE) {
+        const int start = lower_int(args[1]);
+        const int count = lower_int(args[2]);
+        id = emit_builtin(IR_SLICE_STRING, TYPE_STRING, start, count, args[0], nullptr);
+    } else {
+        id = emit_builtin(IR_SPLIT_STRING, TYPE_STRING, lower_int(args[2]), -1, args[0], args[1]);
+    }
+    const int view = take_temp(&view_temps, TYPE_VIEW, "view_temp");
+    ir->insts[id].slot = view;
+    return (StringValue){view, {0}};
+}
+
+// The builtins that yield numbers, and string comparison
+static int lower_string_value(const Expression* expr) {
+    const TempMark mark = mark_temps();
+    Expression* const* args = expr->call.args;
+    int value;
+    if (expr->kind == EXPR_BINARY) {
+        value = emit_builtin(IR_EQUAL_STRING, TYPE_INT, -1, -1, expr->binary.left, expr->binary.right);
+        if (expr->op == TOKEN_NEQ) value = emit(IR_NOT, TYPE_INT, value, -1);
+    } else if (expr->call.builtin == BUILTIN_LEN && args[0]->kind == EXPR_STRING) {
+        // A literal's length is known; its value ends at the first NUL
+        char* decoded = arena_alloc(ir->arena, (size_t)args[0]->string.length + 1);
+        lexeme_decode_string(args[0]->string, decoded);
+        value = ir_const_int(ir, current, (int64_t)strlen(decoded));
+    } else if (expr->call.builtin == BUILTIN_LEN) {
+        value = emit_builtin(IR_LENGTH_STRING, TYPE_INT, -1, -1, args[0], nullptr);
+    } else if (expr->call.builtin == BUILTIN_FIND) {
+        const int from = expr->call.count > 2 ? lower_int(args[2]) : ir_const_int(ir, current, 0);
+        value = emit_builtin(IR_FIND_STRING, TYPE_INT, from, -1, args[0], args[1]);
+    } else {
+        value = emit_builtin(IR_COMPARE_STRING, TYPE_INT, -1, -1, args[0], args[1]);
+    }
+    release_temps(mark);
+    return value;
+}
+
+// Append every operand of a concatenation, left to right
+static void append_string(const Expression* expr, const int slot) {
+    if (expr->kind == EXPR_BINARY) {
+        append_string(expr->binary.left, slot);
+        append_string(expr->binary.right, slot);
+    } else {
+        const TempMark mark = mark_temps();
+        emit_string(IR_APPEND_STRING, slot, lower_string(expr));
+        release_temps(mark);
+    }
+}
+
+// A concatenation copies its first operand into the slot and appends the
+// rest, so `s = s + t` appends in place. When a later operand reads or
+// assigns the slot, the result is built in a temporary and moved over.
+static void lower_string_into(const Expression* expr, const int slot) {
+    if (expr->kind != EXPR_BINARY) {
+        const TempMark mark = mark_temps();
+        const StringValue value = lower_string(expr);
+        if (value.slot != slot) emit_string(IR_SET_STRING, slot, value);
+        release_temps(mark);
+    } else if (mentions_slot(expr->binary.right, slot)) {
+        const int temp = take_string_temp();
+        lower_string_into(expr, temp);
+        emit_string(IR_MOVE_STRING, slot, (StringValue){temp, {0}});
+        release_string_temp();
+    } else {
+        lower_string_into(expr->binary.left, slot);
+        append_string(expr->binary.right, slot);
+    }
+}
+
+// The assignments in a string expression whose value is not used
+static void lower_string_effects(const Expression* expr) {
+    if (expr->kind == EXPR_BINARY) {
+        lower_string_effects(expr->binary.left);
+        lower_string_effects(expr->binary.right);
+    } else if (expr->kind == EXPR_ASSIGN) {
+        lower_string_into(expr->assign.value, expr->assign.slot);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Arrays
+
+static VarType element_type(const int slot) {
+    return ir->symbols[slot].type == TYPE_INT_ARRAY ? TYPE_INT : TYPE_DOUBLE;
+}
+
+static int emit_array(const IrOp op, const VarType type, const int slot, const int a, const int b) {
+    const int id = emit(op, type, a, b);
+    ir->insts[id].slot = slot;
+    return id;
+}
+
+// Set an array slot to a literal, a variable or an assignment, which is
+// lowered first. A literal's elements are all evaluated before the slot is
+// emptied, since they may read it.
+static void lower_array_into(const Expression* expr, const int slot) {
+    const VarType type = element_type(slot);
+    switch (expr->kind) {
+        case EXPR_ARRAY: {
+            int* elements = malloc(sizeof(int) * (size_t)(expr->array.count > 0 ? expr->array.count : 1));
+            if (elements == NULL) {
+                fprintf(stderr, "Memory allocation error\n");
+                exit(1);
+            }
+            for (int i = 0; i < expr->array.count; i++) {
+                elements[i] = convert(lower_value(expr->array.elements[i]), type);
+            }
+            emit_array(IR_CLEAR_ARRAY, type, slot, -1, -1);
+            for (int i = 0; i < expr->array.count; i++) emit_array(IR_PUSH_ARRAY, type, slot, elements[i], -1);
+            free(elements);
+            return;
+        }
+        case EXPR_IDENT:
+            if (expr->ident.slot != slot) {
+                ir->insts[emit_array(IR_SET_ARRAY, type, slot, -1, -1)].source = expr->ident.slot;
+            }
+            return;
+        case EXPR_ASSIGN:
+            lower_array_into(expr->assign.value, expr->assign.slot);
+            if (expr->assign.slot != slot) {
+                ir->insts[emit_array(IR_SET_ARRAY, type, slot, -1, -1)].source = expr->assign.slot;
+            }
+            return;
+        default:
+            fprintf(stderr, "Error: Invalid array expression\n");
+            exit(EXIT_FAILURE);
+    }
+}
+
+// array[index], or array[index] = value, which yields the value stored
+static int lower_element(const Expression* expr) {
+    const int slot = expr->index.slot;
+    const int index = convert(lower_value(expr->index.index), TYPE_INT);
+    int id;
+    if (expr->kind == EXPR_INDEX) {
+        id = emit_array(IR_LOAD_ARRAY, element_type(slot), slot, index, -1);
+    } else {
+        const int value = convert(lower_value(expr->index.value), element_type(slot));
+        id = emit_array(IR_STORE_ARRAY, element_type(slot), slot, index, value);
+    }
+    ir->insts[id].in_bounds = expr->index.in_bounds;
+    return expr->kind == EXPR_INDEX ? id : ir->insts[id].args[1];
+}
+
+// push(array, value); its value, the new length, is read only when used
+static int lower_push(const Expression* expr, const bool used) {
+    const int slot = expr->call.args[0]->ident.slot;
+    const int value = convert(lower_value(expr->call.args[1]), element_type(slot));
+    emit_array(IR_PUSH_ARRAY, element_type(slot), slot, value, -1);
+    return used ? emit_array(IR_LENGTH_ARRAY, TYPE_INT, slot, -1, -1) : -1;
+}
+
+static bool is_array_slot(const int slot) {
+    return ir->symbols[slot].type == TYPE_INT_ARRAY || ir->symbols[slot].type == TYPE_DOUBLE_ARRAY;
+}
+
+// ---------------------------------------------------------------------------
+// Maps
+
+static bool is_map_slot(const int slot) {
+    return ir->symbols[slot].type == TYPE_DOUBLE_MAP || ir->symbols[slot].type == TYPE_STRING_MAP;
+}
+
+// get, has, del and put. The numbers are lowered before a string key, so its
+// view is read before any other string is built. put's value, the number of
+// keys, is read only when used.
+static int lower_map(const Expression* expr, const bool used) {
+    Expression* const* args = expr->call.args;
+    const int slot = args[0]->ident.slot;
+    const bool strings = ir->symbols[slot].type == TYPE_STRING_MAP;
+    const int key = strings ? -1 : convert(lower_value(args[1]), TYPE_DOUBLE);
+    const int value = expr->call.builtin == BUILTIN_PUT ? convert(lower_value(args[2]), TYPE_DOUBLE) : -1;
+    IrOp op;
+    switch (expr->call.builtin) {
+        case BUILTIN_GET: op = IR_GET_MAP; break;
+        case BUILTIN_HAS: op = IR_HAS_MAP; break;
+        case BUILTIN_DEL: op = IR_DEL_MAP; break;
+        default: op = IR_PUT_MAP; break;
+    }
+    const VarType type = op == IR_HAS_MAP || op == IR_DEL_MAP ? TYPE_INT : TYPE_DOUBLE;
+    const TempMark mark = mark_temps();
+    const int id = strings ? emit_builtin(op, type, key, value, args[1], nullptr) : emit(op, type, key, value);
+    ir->insts[id].slot = slot;
+    release_temps(mark);
+    if (op != IR_PUT_MAP) return id;
+    return used ? emit_array(IR_LENGTH_MAP, TYPE_INT, slot, -1, -1) : -1;
+}
+
+static bool is_map_call(const Expression* expr) {
+    return expr->kind == EXPR_CALL && expr->call.builtin >= BUILTIN_GET && expr->call.builtin <= BUILTIN_DEL;
+}
+
+// && and || only evaluate their right operand when it decides the result
+static int lower_logical(const Expression* expr) {
+    const bool is_and = expr->op == TOKEN_AND;
+    const int left = truth(lower_value(expr->binary.left));
+    const int shortcut = ir_const_int(ir, current, is_and ? 0 : 1);
+    const int left_block = current;
+    const int right_block = new_block();
+    const int merge = new_block();
+    if (is_and) {
+        branch(left_block, left, right_block, merge);
+    } else {
+        branch(left_block, left, merge, right_block);
+    }
+    seal(right_block);
+
+    current = right_block;
+    const int right = truth(lower_value(expr->binary.right));
+    jump(current, merge);
+    seal(merge);
+
+    current = merge;
+    const int phi = new_phi(merge, TYPE_INT);
+    ir->insts[phi].phi_args = arena_alloc(ir->arena, sizeof(int) * 2);
+    ir->insts[phi].phi_args[0] = shortcut;
+    ir->insts[phi].phi_args[1] = right;
+    ir->insts[phi].phi_count = 2;
+    return phi;
+}
+
+static int lower_node(const Expression* expr) {
+    switch (expr->kind) {
+        case EXPR_NUMBER:
+            if (expr->type == TYPE_INT) return ir_const_int(ir, current, (int64_t)expr->number.value);
+            return ir_const_double(ir, current, expr->number.value);
+        case EXPR_IDENT:
+            return read_variable(expr->ident.slot, current);
+        case EXPR_UNARY: {
+            const int operand = lower_value(expr->unary.operand);
+            switch (expr->op) {
+                case TOKEN_MINUS: return emit(IR_NEG, expr->type, operand, -1);
+                case TOKEN_NOT: return emit(IR_NOT, TYPE_INT, operand, -1);
+                default: return emit(IR_BITNOT, TYPE_INT, convert(operand, TYPE_INT), -1);
+            }
+        }
+        case EXPR_BINARY: {
+            if (expr->op == TOKEN_AND || expr->op == TOKEN_OR) return lower_logical(expr);
+            if (expr->binary.left->type == TYPE_STRING) return lower_string_value(expr);
+
+            const IrOp op = binary_op(expr->op);
+            int left = lower_value(expr->binary.left);
+            int right = lower_value(expr->binary.right);
+            VarType operand_type;
+            if (op >= IR_EQ && op <= IR_GE) {
+                const bool both_int = ir->insts[left].type == TYPE_INT && ir->insts[right].type == TYPE_INT;
+                operand_type = both_int ? TYPE_INT : TYPE_DOUBLE;
+            } else if (op >= IR_MOD && op <= IR_SHR) {
+                operand_type = TYPE_INT;
+            } else {
+                operand_type = op == IR_DIV ? TYPE_DOUBLE : expr->type;
+            }
+            left = convert(left, operand_type);
+            right = convert(right, operand_type);
+            return emit(op, expr->type, left, right);
+        }
+        case EXPR_ASSIGN: {
+            const int value = convert(lower_value(expr->assign.value), ir->symbols[expr->assign.slot].type);
+            define(current, expr->assign.slot, value);
+            return value;
+        }
+        case EXPR_CALL:
+            if (expr->call.builtin == BUILTIN_PUSH) return lower_push(expr, true);
+            if (is_map_call(expr)) return lower_map(expr, true);
+            if (expr->call.builtin == BUILTIN_LEN && expr->call.args[0]->kind == EXPR_IDENT &&
+                is_array_slot(expr->call.args[0]->ident.slot)) {
+                return emit_array(IR_LENGTH_ARRAY, TYPE_INT, expr->call.args[0]->ident.slot, -1, -1);
+            }
+            if (expr->call.builtin == BUILTIN_LEN && expr->call.args[0]->kind == EXPR_IDENT &&
+                is_map_slot(expr->call.args[0]->ident.slot)) {
+                return emit_array(IR_LENGTH_MAP, TYPE_INT, expr->call.args[0]->ident.slot, -1, -1);
+            }
+            return lower_string_value(expr);
+        case EXPR_INDEX:
+        case EXPR_STORE:
+            return lower_element(expr);
+        default:
+            fprintf(stderr, "Error: Invalid numeric expression\n");
+            exit(EXIT_FAILURE);
+    }
+}
+
+// Lower an expression; the instructions it emits itself, after its operands,
+// take its source line
+static int lower_value(const Expression* expr) {
+    const int outer_line = line;
+    line = expr->line;
+    const int value = lower_node(expr);
+    line = outer_line;
+    return value;
+}
+
+static void lower_statements(const Statement* statements, int count);
+
+static void lower_if(const IfStatement* stmt) {
+    const int cond = lower_value(stmt->condition);
+    const int then_block = new_block();
+    const int merge = new_block();
+    const int else_block = stmt->else_count > 0 ? new_block() : merge;
+    branch(current, cond, then_block, else_block);
+
+    seal(then_block);
+    current = then_block;
+    lower_statements(stmt->if_block, stmt->if_count);
+    jump(current, merge);
+
+    if (else_block != merge) {
+        seal(else_block);
+        current = else_block;
+        lower_statements(stmt->else_block, stmt->else_count);
+        jump(current, merge);
+    }
+
+    seal(merge);
+    current = merge;
+}
+
+static void lower_while(const WhileStatement* stmt) {
+    loops = reserve(ir->arena, loops, &loop_capacity, loop_count + 1, sizeof(Loop));
+    Loop loop;
+    loop_count++;
+    loop.header = new_block();
+    ir->blocks[loop.header].line = stmt->condition->line;
+    jump(current, loop.header);
+    current = loop.header;
+    const int cond = lower_value(stmt->condition);
+
+    const int body = new_block();
+    loop.exit = ir_new_block(ir);
+    ir->blocks[loop.exit].loop_depth = loop_count - 1;
+    branch(current, cond, body, loop.exit);
+    seal(body);
+
+    loops[loop_count - 1] = loop;
+    current = body;
+    lower_statements(stmt->body, stmt->body_count);
+    jump(current, loop.header);
+    loop_count--;
+
+    seal(loop.header);
+    seal(loop.exit);
+    current = loop.exit;
+}
+
+static void lower_statement(const Statement* stmt) {
+    switch (stmt->type) {
+        case STMT_LET: {
+            const int slot = stmt->let_stmt.slot;
+            const VarType type = ir->symbols[slot].type;
+            if (type == TYPE_STRING) {
+                lower_string_into(stmt->let_stmt.expr, slot);
+            } else if (is_array_slot(slot)) {
+                lower_array_into(stmt->let_stmt.expr, slot);
+            } else if (is_map_slot(slot)) {
+                emit_array(IR_CLEAR_MAP, TYPE_DOUBLE, slot, -1, -1);
+            } else {
+                const int value = stmt->let_stmt.expr ? convert(lower_value(stmt->let_stmt.expr), type)
+                                                      : zero(current, type);
+                define(current, slot, value);
+            }
+            break;
+        }
+        case STMT_EXPR: {
+            const Expression* expr = stmt->expr_stmt.expr;
+            if (expr->type == TYPE_STRING) {
+                lower_string_effects(expr);
+            } else if (expr->type == TYPE_INT_ARRAY || expr->type == TYPE_DOUBLE_ARRAY) {
+                // Only an assignment does anything
+                if (expr->kind == EXPR_ASSIGN) lower_array_into(expr->assign.value, expr->assign.slot);
+            } else if (expr->type == TYPE_DOUBLE_MAP || expr->type == TYPE_STRING_MAP) {
+                // Assigning {} empties the map
+                if (expr->kind == EXPR_ASSIGN) emit_array(IR_CLEAR_MAP, TYPE_DOUBLE, expr->assign.slot, -1, -1);
+            } else if (expr->kind == EXPR_CALL && expr->call.builtin == BUILTIN_PUSH) {
+                lower_push(expr, false);
+            } else if (is_map_call(expr) && expr->call.builtin == BUILTIN_PUT) {
+                lower_map(expr, false);
+            } else {
+                lower_value(expr);
+            }
+            break;
+        }
+        case STMT_OUT:
+            if (stmt->out_stmt.expr->kind == EXPR_BINARY && stmt->out_stmt.expr->type == TYPE_STRING) {
+                const int temp = take_string_temp();
+                lower_string_into(stmt->out_stmt.expr, temp);
+                emit_string(IR_OUT_STRING, -1, (StringValue){temp, {0}});
+                release_string_temp();
+            } else if (stmt->out_stmt.expr->type == TYPE_STRING) {
+                const TempMark mark = mark_temps();
+                emit_string(IR_OUT_STRING, -1, lower_string(stmt->out_stmt.expr));
+                release_temps(mark);
+            } else {
+                emit(IR_OUT, TYPE_DOUBLE, lower_value(stmt->out_stmt.expr), -1);
+            }
+            break;
+        case STMT_IN: {
+            const int slot = stmt->in_stmt.slot;
+            if (ir->symbols[slot].type == TYPE_STRING) {
+                emit_string(IR_IN_STRING, slot, (StringValue){-1, {0}});
+            } else {
+                define(current, slot, emit(IR_IN, TYPE_DOUBLE, read_variable(slot, current), -1));
+            }
+            break;
+        }
+        case STMT_IF:
+            lower_if(&stmt->if_stmt);
+            break;
+        case STMT_WHILE:
+            lower_while(&stmt->while_stmt);
+            break;
+        case STMT_BREAK:
+            jump(current, loops[loop_count - 1].exit);
+            start_unreachable();
+            break;
+        case STMT_CONTINUE:
+            jump(current, loops[loop_count - 1].header);
+            start_unreachable();
+            break;
+        case STMT_RETURN: {
+            const int status = lower_value(stmt->ret_stmt.expr);
+            ir->blocks[current].term = TERM_EXIT;
+            ir->blocks[current].cond = status;
+            start_unreachable();
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void lower_statements(const Statement* statements, const int count) {
+    for (int i = 0; i < count; i++) {
+        lower_statement(&statements[i]);
+    }
+}
+
+IrProgram ir_lower(const Program* program, Arena* arena) {
+    IrProgram result = {0};
+    result.arena = arena;
+    result.symbol_count = program->symbol_count;
+    symbol_capacity = 0;
+    symbols = reserve(arena, nullptr, &symbol_capacity, program->symbol_count, sizeof(Symbol));
+    if (program->symbol_count > 0) memcpy(symbols, program->symbols, sizeof(Symbol) * (size_t)program->symbol_count);
+    result.symbols = symbols;
+    string_temps = (TempSlots){0};
+    view_temps = (TempSlots){0};
+
+    ir = &result;
+    definitions = NULL;
+    definition_slots = 0;
+    definition_count = 0;
+    incomplete = NULL;
+    incomplete_count = 0;
+    incomplete_capacity = 0;
+    loops = NULL;
+    loop_count = 0;
+    loop_capacity = 0;
+    line = 0;
+
+    current = new_block();
+    seal(current);
+    lower_statements(program->statements, program->count);
+    ir->blocks[current].term = TERM_RETURN;
+
+    ir = nullptr;
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Printing
+
+const char* ir_op_to_string(const IrOp op) {
+    switch (op) {
+        case IR_CONST: return "const";
+        case IR_PHI: return "phi";
+        case IR_COPY: return "copy";
+        case IR_NEG: return "neg";
+        case IR_NOT: return "not";
+        case IR_BITNOT: return "bitnot";
+        case IR_ADD: return "add";
+        case IR_SUB: return "sub";
+        case IR_MUL: return "mul";
+        case IR_DIV: return "div";
+        case IR_MOD: return "mod";
+        case IR_AND: return "and";
+        case IR_OR: return "or";
+        case IR_XOR: return "xor";
+        case IR_SHL: return "shl";
+        case IR_SHR: return "shr";
+        case IR_EQ: return "eq";
+        case IR_NE: return "ne";
+        case IR_LT: return "lt";
+        case IR_GT: return "gt";
+        case IR_LE: return "le";
+        case IR_GE: return "ge";
+        case IR_TO_DOUBLE: return "to_double";
+        case IR_TO_INT: return "to_int";
+        case IR_IN: return "in";
+        case IR_OUT: return "out";
+        case IR_IN_STRING: return "in_string";
+        case IR_OUT_STRING: return "out_string";
+        case IR_SET_STRING: return "set_string";
+        case IR_APPEND_STRING: return "append_string";
+        case IR_MOVE_STRING: return "move_string";
+        case IR_SLICE_STRING: return "slice_string";
+        case IR_SPLIT_STRING: return "split_string";
+        case IR_LENGTH_STRING: return "length_string";
+        case IR_FIND_STRING: return "find_string";
+        case IR_COMPARE_STRING: return "compare_string";
+        case IR_EQUAL_STRING: return "equal_string";
+        case IR_LOAD_ARRAY: return "load_array";
+        case IR_LENGTH_ARRAY: return "length_array";
+        case IR_CLEAR_ARRAY: return "clear_array";
+        case IR_PUSH_ARRAY: return "push_array";
+        case IR_SET_ARRAY: return "set_array";
+        case IR_STORE_ARRAY: return "store_array";
+        case IR_GET_MAP: return "get_map";
+        case IR_HAS_MAP: return "has_map";
+        case IR_DEL_MAP: return "del_map";
+        case IR_LENGTH_MAP: return "length_map";
+        case IR_CLEAR_MAP: return "clear_map";
+        case IR_PUT_MAP: return "put_map";
+        default: return "unknown";
+    }
+}
+
+static void dump_slot(const IrProgram* program, const int slot, FILE* out) {
+    const Lexeme name = intern_name(program->symbols[slot].symbol);
+    fprintf(out, " %.*s", name.length, name.text);
+}
+
+static void dump_string(const IrProgram* program, const int slot, const Lexeme text, FILE* out) {
+    if (slot >= 0) {
+        dump_slot(program, slot, out);
+    } else {
+        fprintf(out, " \"%.*s\"", text.length, text.text);
+    }
+}
+
+void ir_dump_inst(const IrProgram* program, const int id, FILE* out) {
+    const IrInst* inst = &program->insts[id];
+    if (inst->op == IR_IN || ir_effect_has_value(inst->op) || !ir_has_side_effect(inst->op)) {
+        fprintf(out, "v%d:%s = ", id, inst->type == TYPE_INT ? "int" : "double");
+    }
+    fprintf(out, "%s", ir_op_to_string(inst->op));
+    if (inst->op == IR_CONST) {
+        if (inst->type == TYPE_INT) {
+            fprintf(out, " %" PRId64, inst->value.integer);
+        } else {
+            fprintf(out, " %.17g", inst->value.real);
+        }
+    } else if (inst->op == IR_PHI) {
+        for (int i = 0; i < inst->phi_count; i++) {
+            fprintf(out, "%s v%d", i ? "," : "", inst->phi_args[i]);
+        }
+    } else if (inst->op >= IR_IN_STRING && inst->op <= IR_MOVE_STRING) {
+        if (inst->op != IR_OUT_STRING) {
+            dump_slot(program, inst->slot, out);
+        }
+        if (inst->op != IR_IN_STRING) dump_string(program, inst->source, inst->text, out);
+    } else if (inst->op >= IR_SLICE_STRING && inst->op <= IR_EQUAL_STRING) {
+        if (inst->slot >= 0) dump_slot(program, inst->slot, out);
+        dump_string(program, inst->source, inst->text, out);
+        if (inst->op == IR_SPLIT_STRING || inst->op == IR_FIND_STRING || inst->op >= IR_COMPARE_STRING) {
+            dump_string(program, inst->other, inst->other_text, out);
+        }
+        for (int i = 0; i < 2 && inst->args[i] >= 0; i++) fprintf(out, ", v%d", inst->args[i]);
+    } else if (inst->op >= IR_LOAD_ARRAY && inst->op <= IR_STORE_ARRAY) {
+        dump_slot(program, inst->slot, out);
+        if (inst->op == IR_SET_ARRAY) dump_slot(program, inst->source, out);
+        for (int i = 0; i < 2 && inst->args[i] >= 0; i++) fprintf(out, ", v%d", inst->args[i]);
+        if (inst->in_bounds) fprintf(out, " ; in bounds");
+    } else if (inst->op >= IR_GET_MAP && inst->op <= IR_PUT_MAP) {
+        dump_slot(program, inst->slot, out);
+        if (program->symbols[inst->slot].type == TYPE_STRING_MAP && inst->op != IR_LENGTH_MAP &&
+            inst->op != IR_CLEAR_MAP) {
+            fprintf(out, ",");
+            dump_string(program, inst->source, inst->text, out);
+        }
+        for (int i = 0; i < 2; i++) {
+            if (inst->args[i] >= 0) fprintf(out, ", v%d", inst->args[i]);
+        }
+    } else {
+        for (int i = 0; i < 2 && inst->args[i] >= 0; i++) {
+            fprintf(out, "%s v%d", i ? "," : "", inst->args[i]);
+        }
+    }
+}
+
+void ir_dump(const IrProgram* program, FILE* out) {
+    for (int b = 0; b < program->block_count; b++) {
+        const IrBlock* block = &program->blocks[b];
+        if (block->removed) continue;
+
+        fprintf(out, "B%d:", b);
+        if (block->pred_count > 0) {
+            fprintf(out, "  ; preds");
+            for (int i = 0; i < block->pred_count; i++) fprintf(out, " B%d", block->preds[i]);
+        }
+        if (block->counter >= 0) fprintf(out, "  ; counted by v%d", block->counter);
+        fprintf(out, "\n");
+
+        for (int id = block->first; id >= 0; id = program->insts[id].next) {
+            fprintf(out, "    ");
+            ir_dump_inst(program, id, out);
+            fprintf(out, "\n");
+        }
+
+        switch (block->term) {
+            case TERM_JUMP:
+                fprintf(out, "    jump B%d\n", block->succ[0]);
+                break;
+            case TERM_BRANCH:
+                fprintf(out, "    branch v%d, B%d, B%d\n", block->cond, block->succ[0], block->succ[1]);
+                break;
+            case TERM_EXIT:
+                fprintf(out, "    exit v%d\n", block->cond);
+                break;
+            case TERM_RETURN:
+                fprintf(out, "    return\n");
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#define _GNU_SOURCE     // memmem
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jit.h"
+
+#if defined(__linux__) && defined(__x86_64__)
+#define JIT_X86 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define JIT_X86 0
+#endif
+
+bool jit_supported() {
+    return JIT_X86;
+}
+
+#if JIT_X86
+
+static size_t round_up(const size_t size, const size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// The word each X86_RELOC_EXTERN reference reads the symbol's address from
+static uint64_t extern_address(const X86Extern symbol) {
+    switch (symbol) {
+        case X86_PRINTF: return (uint64_t)(uintptr_t)&printf;
+        case X86_SCANF: return (uint64_t)(uintptr_t)&scanf;
+        case X86_FWRITE: return (uint64_t)(uintptr_t)&fwrite;
+        case X86_REALLOC: return (uint64_t)(uintptr_t)&realloc;
+        case X86_FREE: return (uint64_t)(uintptr_t)&free;
+        case X86_MEMMOVE: return (uint64_t)(uintptr_t)&memmove;
+        case X86_MEMMEM: return (uint64_t)(uintptr_t)&memmem;
+        case X86_MEMCMP: return (uint64_t)(uintptr_t)&memcmp;
+        case X86_STRLEN: return (uint64_t)(uintptr_t)&strlen;
+        case X86_EXIT: return (uint64_t)(uintptr_t)&exit;
+        case X86_FPRINTF: return (uint64_t)(uintptr_t)&fprintf;
+        case X86_FFLUSH: return (uint64_t)(uintptr_t)&fflush;
+        case X86_STDOUT: return (uint64_t)(uintptr_t)&stdout;
+        case X86_STDERR: return (uint64_t)(uintptr_t)&stderr;
+        default: return 0;
+    }
+}
+
+// One mapping keeps every reference within the 32-bit displacements: the code,
+// a table of addresses after it, and the bss on pages of its own that stay
+// writable once the rest is made executable
+bool jit_load(const X86Code* code, JitProgram* program) {
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t table = round_up(code->length, 8);
+    const size_t bss = round_up(table + sizeof(uint64_t) * X86_EXTERN_COUNT, page);
+    const size_t size = bss + round_up(code->bss_size, page);
+    uint8_t* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return false;
+
+    memcpy(memory, code->code, code->length);
+    for (int i = 0; i < X86_EXTERN_COUNT; i++) {
+        const uint64_t address = extern_address(i);
+        memcpy(memory + table + sizeof(uint64_t) * (size_t)i, &address, sizeof(address));
+    }
+    for (int i = 0; i < code->reloc_count; i++) {
+        const X86Reloc* reloc = &code->relocs[i];
+        const size_t target = reloc->kind == X86_RELOC_BSS ? bss + (size_t)reloc->addend
+                                                           : table + sizeof(uint64_t) * (size_t)reloc->symbol;
+        const int32_t displacement = (int32_t)((int64_t)target - (int64_t)(reloc->offset + 4));
+        memcpy(memory + reloc->offset, &displacement, sizeof(displacement));
+    }
+
+    if (mprotect(memory, bss, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return false;
+    }
+    program->memory = memory;
+    program->size = size;
+    program->entry = (int (*)(void))(void*)memory;
+    return true;
+}
+
+int jit_run(const JitProgram* program) {
+    const int status = program->entry();
+    fflush(stdout);
+    return status;
+}
+
+void jit_free(JitProgram* program) {
+    if (program->memory != nullptr) munmap(program->memory, program->size);
+    *program = (JitProgram){0};
+}
+
+#else
+
+bool jit_load(const X86Code* code, JitProgram* program) {
+    (void)code;
+    *program = (JitProgram){0};
+    return false;
+}
+
+int jit_run(const JitProgram* program) {
+    (void)program;
+    return 1;
+}
+
+void jit_free(JitProgram* program) {
+    *program = (JitProgram){0};
+}
+
+#endif
@@ -1,345 +1,474 @@
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include "lexer.h"
+#include "scan.h"
+#include "intern.h"
 
-static FILE* source;
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char* source;
+static size_t source_length;
+static size_t position;
 static int current_line = 1;
-static int current_column = 0;
-static char current_char;
+static size_t line_start;
 
-void lexer_init(FILE* source_file) {
-    source = source_file;
+// Ownership of the source buffer, released by lexer_cleanup()
+static char* owned_buffer;
+static void* mapped_view;
+static size_t mapped_length;
+#ifdef _WIN32
+static HANDLE mapped_file = INVALID_HANDLE_VALUE;
+static HANDLE mapped_handle;
+#endif
+
+static void reset_state(const char* buffer, const size_t length) {
+    source = buffer;
+    source_length = length;
+    position = 0;
     current_line = 1;
-    current_column = 0;
-    current_char = (char)fgetc(source);
+    line_start = 0;
 }
 
-static void advance() {
-    if (current_char == '\n') {
-        current_line++;
-        current_column = 0;
-    } else {
-        current_column++;
+void lexer_init(FILE* source_file) {
+    size_t capacity = 64 * 1024;
+    size_t length = 0;
+    char* buffer = malloc(capacity);
+    if (buffer == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+
+    size_t read;
+    while ((read = fread(buffer + length, 1, capacity - length, source_file)) > 0) {
+        length += read;
+        if (length == capacity) {
+            capacity *= 2;
+            char* tmp = realloc(buffer, capacity);
+            if (tmp == NULL) {
+                free(buffer);
+                fprintf(stderr, "Memory allocation error\n");
+                exit(1);
+            }
+            buffer = tmp;
+        }
     }
-    current_char = (char)fgetc(source);
+
+    owned_buffer = buffer;
+    reset_state(buffer, length);
 }
 
-static void skip_whitespace() {
-    while (current_char != EOF && isspace(current_char)) {
-        advance();
+void lexer_init_buffer(const char* buffer, const size_t length) {
+    reset_state(buffer, length);
+}
+
+bool lexer_init_mapped(const char* path) {
+#ifdef _WIN32
+    const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                    FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    // Empty files cannot be mapped; hand them to the stream reader instead
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    void* view = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
+    if (view == NULL) {
+        if (mapping != NULL) CloseHandle(mapping);
+        CloseHandle(file);
+        FILE* stream = fopen(path, "rb");
+        if (stream == NULL) return false;
+        lexer_init(stream);
+        fclose(stream);
+        return true;
     }
+
+    mapped_file = file;
+    mapped_handle = mapping;
+    mapped_view = view;
+    mapped_length = (size_t)size.QuadPart;
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    // Pipes and devices cannot be mapped; read them through the descriptor we already hold
+    struct stat st;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (view == MAP_FAILED) {
+        FILE* stream = fdopen(fd, "r");
+        if (stream == NULL) {
+            close(fd);
+            return false;
+        }
+        lexer_init(stream);
+        fclose(stream);
+        return true;
+    }
+    close(fd);
+    posix_madvise(view, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    mapped_view = view;
+    mapped_length = (size_t)st.st_size;
+#endif
+
+    reset_state(mapped_view, mapped_length);
+    return true;
 }
 
-static char* allocate_string(const char* str) {
+void lexer_cleanup() {
+    if (owned_buffer != NULL) {
+        free(owned_buffer);
+        owned_buffer = nullptr;
+    }
+    if (mapped_view != NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapped_view);
+        CloseHandle(mapped_handle);
+        CloseHandle(mapped_file);
+        mapped_file = INVALID_HANDLE_VALUE;
+#else
+        munmap(mapped_view, mapped_length);
+#endif
+        mapped_view = nullptr;
+        mapped_length = 0;
+    }
+    reset_state(nullptr, 0);
+}
 
-    const size_t len = strlen(str);
-    char* result = malloc(len + 1);
-    if (result == NULL) {
-        fprintf(stderr, "Memory allocation error\n");
-        exit(1);
+static char peek_at(const size_t offset) {
+    return position + offset < source_length ? source[position + offset] : '\0';
+}
+
+static void advance() {
+    if (source[position] == '\n') {
+        current_line++;
+        line_start = position + 1;
     }
+    position++;
+}
 
-    strcpy(result, str);
-    return result;
+static void skip_whitespace() {
+    position = scan_whitespace(source, position, source_length, &current_line, &line_start);
 }
 
-static Token create_token(const Ttype type, char* value) {
+static Token create_token(const Ttype type, const size_t offset, const size_t length,
+                          const int line, const size_t column) {
     Token token;
     token.type = type;
-    token.value = value;
-    token.line = current_line;
-    token.column = current_column;
+    token.offset = offset;
+    token.length = (int)length;
+    token.line = line;
+    token.column = (int)column;
+    token.symbol = 0;
     return token;
 }
 
+// Keywords and reserved words live in a perfect hash table. The slot of a word is computed
+// from its first, middle and last characters and its length; the multiplier was chosen so
+// that no two words share a slot. KEYWORD_SLOT evaluates at compile time, so a new word that
+// collides shows up as an overridden initializer (-Woverride-init).
+#define KEYWORD_MAX_LENGTH 12
+#define KEYWORD_SLOT(first, middle, last, length) \
+    ((((unsigned)(unsigned char)(first) << 24 | (unsigned)(unsigned char)(middle) << 16 | \
+       (unsigned)(unsigned char)(last) << 8 | (unsigned)(length)) * 0xB46FDDADu) >> 24)
+
+typedef struct {
+    const char* word;
+    int length;
+    Ttype type; // TOKEN_UNKNOWN marks a reserved word that cannot be used as an identifier
+} KeywordEntry;
+
+static const KeywordEntry keyword_table[256] = {
+    [KEYWORD_SLOT('l', 'e', 't', 3)] = {"let", 3, TOKEN_LET},
+    [KEYWORD_SLOT('r', 'e', 't', 3)] = {"ret", 3, TOKEN_RETURN},
+    [KEYWORD_SLOT('i', 'f', 'f', 2)] = {"if", 2, TOKEN_IF},
+    [KEYWORD_SLOT('e', 'l', 's', 3)] = {"els", 3, TOKEN_ELSE},
+    [KEYWORD_SLOT('a', 'n', 'd', 3)] = {"and", 3, TOKEN_AND},
+    [KEYWORD_SLOT('o', 'r', 'r', 2)] = {"or", 2, TOKEN_OR},
+    [KEYWORD_SLOT('o', 'u', 't', 3)] = {"out", 3, TOKEN_OUT},
+    [KEYWORD_SLOT('w', 'i', 'e', 5)] = {"while", 5, TOKEN_WHILE},
+    [KEYWORD_SLOT('i', 'n', 'n', 2)] = {"in", 2, TOKEN_IN},
+    [KEYWORD_SLOT('b', 'r', 'k', 3)] = {"brk", 3, TOKEN_BREAK},
+    [KEYWORD_SLOT('c', 'o', 'n', 3)] = {"con", 3, TOKEN_CONTINUE},
+    [KEYWORD_SLOT('r', 'u', 'n', 6)] = {"return", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('i', 'n', 't', 3)] = {"int", 3, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('l', 'n', 'g', 4)] = {"long", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('c', 'a', 'r', 4)] = {"char", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('s', 'o', 't', 5)] = {"short", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('f', 'o', 't', 5)] = {"float", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('d', 'b', 'e', 6)] = {"double", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('v', 'i', 'd', 4)] = {"void", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('f', 'o', 'r', 3)] = {"for", 3, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('s', 't', 'h', 6)] = {"switch", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('c', 's', 'e', 4)] = {"case", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('d', 'a', 't', 7)] = {"default", 7, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('b', 'e', 'k', 5)] = {"break", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('c', 'i', 'e', 8)] = {"continue", 8, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('g', 't', 'o', 4)] = {"goto", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('s', 'e', 'f', 6)] = {"sizeof", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('s', 'u', 't', 6)] = {"struct", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('u', 'i', 'n', 5)] = {"union", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('t', 'e', 'f', 7)] = {"typedef", 7, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('s', 't', 'c', 6)] = {"static", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('e', 'e', 'n', 6)] = {"extern", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('c', 'n', 't', 5)] = {"const", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('v', 't', 'e', 8)] = {"volatile", 8, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('r', 's', 'r', 8)] = {"register", 8, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('i', 'i', 'e', 6)] = {"inline", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('a', 's', 'm', 3)] = {"asm", 3, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('a', 't', 'o', 4)] = {"auto", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('s', 'n', 'd', 6)] = {"signed", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('u', 'g', 'd', 8)] = {"unsigned", 8, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('t', 'u', 'e', 4)] = {"true", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('f', 'l', 'e', 5)] = {"false", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('n', 'l', 'l', 4)] = {"null", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('c', 'a', 's', 5)] = {"class", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('p', 'l', 'c', 6)] = {"public", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('p', 'v', 'e', 7)] = {"private", 7, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('p', 'e', 'd', 9)] = {"protected", 9, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('t', 'i', 's', 4)] = {"this", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('n', 's', 'e', 9)] = {"namespace", 9, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('u', 'i', 'g', 5)] = {"using", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('t', 'l', 'e', 8)] = {"template", 8, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('n', 'e', 'w', 3)] = {"new", 3, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('d', 'e', 'e', 6)] = {"delete", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('t', 'r', 'y', 3)] = {"try", 3, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('c', 't', 'h', 5)] = {"catch", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('t', 'r', 'w', 5)] = {"throw", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('i', 'o', 't', 6)] = {"import", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('e', 'o', 't', 6)] = {"export", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('a', 'e', 't', 6)] = {"assert", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('e', 'u', 'm', 4)] = {"enum", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('i', 'r', 'e', 9)] = {"interface", 9, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('f', 'n', 'l', 5)] = {"final", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('f', 'l', 'e', 8)] = {"finalize", 8, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('s', 'o', 'd', 12)] = {"synchronized", 12, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('e', 's', 'e', 4)] = {"else", 4, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('n', 'o', 't', 3)] = {"not", 3, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('x', 'o', 'r', 3)] = {"xor", 3, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('i', 'l', 'e', 7)] = {"include", 7, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('d', 'i', 'e', 6)] = {"define", 6, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('u', 'd', 'f', 5)] = {"undef", 5, TOKEN_UNKNOWN},
+    [KEYWORD_SLOT('p', 'g', 'a', 6)] = {"pragma", 6, TOKEN_UNKNOWN},
+};
+
+static Ttype classify_word(const char* word, const size_t length) {
+    if (length > KEYWORD_MAX_LENGTH) return TOKEN_IDENT;
+
+    const KeywordEntry* entry = &keyword_table[KEYWORD_SLOT(word[0], word[length / 2],
+                                                            word[length - 1], length)];
+    if ((size_t)entry->length == length && memcmp(entry->word, word, length) == 0) {
+        return entry->type;
+    }
+    return TOKEN_IDENT;
+}
+
 Token lexer_next_token() {
     skip_whitespace();
 
-    if (current_char == EOF) {
-        return create_token(TOKEN_EOF, nullptr);
+    const size_t start = position;
+    const int line = current_line;
+    const size_t column = position - line_start;
+
+    if (position >= source_length) {
+        return create_token(TOKEN_EOF, start, 0, line, column);
     }
 
+    const char current_char = source[position];
+
     if (current_char == '"') {
         advance(); // Consume the opening quote
-        char buffer[256];
-        int i = 0;
-        while (current_char != EOF && current_char != '"' && i < 255) {
-            buffer[i++] = current_char;
-            advance();
-        }
-        buffer[i] = '\0';
+        position = scan_string(source, position, source_length, &current_line, &line_start);
 
-        if (current_char != '"') {
-            fprintf(stderr, "Syntax error: Unterminated string literal at line %d\n", current_line);
+        if (position >= source_length) {
+            fprintf(stderr, "Syntax error: Unterminated string literal at line %d\n", line);
             exit(EXIT_FAILURE);
         }
         advance(); // Consume the closing quote
 
-        return create_token(TOKEN_STRING, allocate_string(buffer));
+        return create_token(TOKEN_STRING, start + 1, position - start - 2, line, column);
     }
 
-    if (isalpha(current_char)) {
-        char buffer[256];
-        int i = 0;
-
-        while (current_char != EOF && (isalnum(current_char) || current_char == '_') && i < 31) {
-            buffer[i++] = current_char;
-            advance();
-        }
-        buffer[i] = '\0';
+    if (isalpha((unsigned char)current_char)) {
+        position = scan_identifier(source, position, source_length);
+        const size_t length = position - start;
 
-        // Check for keywords
-        if (strcmp(buffer, "let") == 0) {
-            return create_token(TOKEN_LET, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "ret") == 0) {
-            return create_token(TOKEN_RETURN, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "if") == 0) {
-            return create_token(TOKEN_IF, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "els") == 0) {
-            return create_token(TOKEN_ELSE, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "and") == 0) {
-            return create_token(TOKEN_AND, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "or") == 0) {
-            return create_token(TOKEN_OR, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "out") == 0) {
-            return create_token(TOKEN_OUT, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "while") == 0){
-            return create_token(TOKEN_WHILE, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "in") == 0) {
-            return create_token(TOKEN_IN, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "brk") == 0) {
-            return create_token(TOKEN_BREAK, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "con") == 0) {
-            return create_token(TOKEN_CONTINUE, allocate_string(buffer));
-        }
-        if (strcmp(buffer, "return") == 0 ||
-            strcmp(buffer, "int") == 0    ||
-            strcmp(buffer, "long") == 0   ||
-            strcmp(buffer, "char") == 0   ||
-            strcmp(buffer, "short") == 0  ||
-            strcmp(buffer, "float") == 0  ||
-            strcmp(buffer, "double") == 0 ||
-            strcmp(buffer, "void") == 0   ||
-            strcmp(buffer, "for") == 0    ||
-            strcmp(buffer, "switch") == 0 ||
-            strcmp(buffer, "case") == 0   ||
-            strcmp(buffer, "default") == 0||
-            strcmp(buffer, "break") == 0  ||
-            strcmp(buffer, "continue") == 0 ||
-            strcmp(buffer, "goto") == 0   ||
-            strcmp(buffer, "sizeof") == 0 ||
-            strcmp(buffer, "struct") == 0 ||
-            strcmp(buffer, "union") == 0  ||
-            strcmp(buffer, "typedef") == 0||
-            strcmp(buffer, "static") == 0 ||
-            strcmp(buffer, "extern") == 0 ||
-            strcmp(buffer, "const") == 0  ||
-            strcmp(buffer, "volatile") == 0 ||
-            strcmp(buffer, "register") == 0 ||
-            strcmp(buffer, "inline") == 0 ||
-            strcmp(buffer, "asm") == 0    ||
-            strcmp(buffer, "auto") == 0   ||
-            strcmp(buffer, "signed") == 0 ||
-            strcmp(buffer, "unsigned") == 0||
-            strcmp(buffer, "true") == 0   ||
-            strcmp(buffer, "false") == 0  ||
-            strcmp(buffer, "null") == 0   ||
-            strcmp(buffer, "class") == 0  ||
-            strcmp(buffer, "public") == 0 ||
-            strcmp(buffer, "private") == 0||
-            strcmp(buffer, "protected") == 0 ||
-            strcmp(buffer, "this") == 0   ||
-            strcmp(buffer, "namespace") == 0 ||
-            strcmp(buffer, "using") == 0  ||
-            strcmp(buffer, "template") == 0 ||
-            strcmp(buffer, "new") == 0    ||
-            strcmp(buffer, "delete") == 0 ||
-            strcmp(buffer, "try") == 0    ||
-            strcmp(buffer, "catch") == 0  ||
-            strcmp(buffer, "throw") == 0  ||
-            strcmp(buffer, "import") == 0 ||
-            strcmp(buffer, "export") == 0 ||
-            strcmp(buffer, "assert") == 0 ||
-            strcmp(buffer, "enum") == 0   ||
-            strcmp(buffer, "interface") == 0 ||
-            strcmp(buffer, "final") == 0  ||
-            strcmp(buffer, "finalize") == 0 ||
-            strcmp(buffer, "synchronized") == 0 ||
-            strcmp(buffer, "else") == 0   ||
-            strcmp(buffer, "not") == 0    ||
-            strcmp(buffer, "xor") == 0    ||
-            strcmp(buffer, "include") == 0||
-            strcmp(buffer, "define") == 0 ||
-            strcmp(buffer, "undef") == 0  ||
-            strcmp(buffer, "pragma") == 0
-        )
-        {
+        const Ttype type = classify_word(source + start, length);
+        if (type == TOKEN_UNKNOWN) {
             fprintf(stderr, "Syntax error: Cannot use reserved keyword at line %d, column %d\n",
-                    current_line, current_column);
+                    line, (int)column);
             exit(EXIT_FAILURE);
         }
-        return create_token(TOKEN_IDENT, allocate_string(buffer));
+        Token token = create_token(type, start, length, line, column);
+        if (type == TOKEN_IDENT) {
+            token.symbol = intern(source + start, (int)length);
+        }
+        return token;
     }
 
     // Check for numbers
-    if (isdigit(current_char) || (current_char == '.' && isdigit(fgetc(source)))) {
-        ungetc(current_char == '.' ? '.' : fgetc(source), source); // put back the peeked char
-        if (current_char != '.') {
-            ungetc(current_char, source); // also put back current if it wasn't the dot
-            current_char = (char)fgetc(source);
-        }
-
-
-        char buffer[64]; // Increased buffer size for doubles
-        int i = 0;
-
+    if (isdigit((unsigned char)current_char) ||
+        (current_char == '.' && isdigit((unsigned char)peek_at(1)))) {
         // Read the integer part
-        while (current_char != EOF && isdigit(current_char) && i < 63) {
-            buffer[i++] = current_char;
-            advance();
+        while (position < source_length && isdigit((unsigned char)source[position])) {
+            position++;
         }
 
         // Read the fractional part
-        if (current_char == '.' && i < 63) {
-            buffer[i++] = current_char;
-            advance();
-            while (current_char != EOF && isdigit(current_char) && i < 63) {
-                buffer[i++] = current_char;
-                advance();
+        if (position < source_length && source[position] == '.') {
+            position++;
+            while (position < source_length && isdigit((unsigned char)source[position])) {
+                position++;
             }
         }
-        buffer[i] = '\0';
 
-        return create_token(TOKEN_NUMBER, allocate_string(buffer));
+        return create_token(TOKEN_NUMBER, start, position - start, line, column);
     }
 
     //Operators and delimiters
-    if (current_char == '+' ||
-        current_char == '-' ||
-        current_char == '*' ||
-        current_char == '/' ||
-        current_char == '%' ||
-        current_char == '(' ||
-        current_char == ')' ||
-        current_char == ';' ||
-        current_char == '=' ||
-        current_char == '<' ||
-        current_char == '>' ||
-        current_char == '!' ||
-        current_char == '{' ||
-        current_char == '}' ||
-        current_char == '&' ||
-        current_char == '|' ||
-        current_char == '^' ||
-        current_char == '~' ||
-        current_char == ':') {
-
-        bool advanced = false;
-        char buffer[3];
-        buffer[0] = current_char;
-        buffer[1] = '\0';
-
-        Ttype type;
-        switch (buffer[0]) {
-            case '+': type = TOKEN_PLUS; break;
-            case '-': type = TOKEN_MINUS; break;
-            case '*': type = TOKEN_MUL; break;
-            case '/': type = TOKEN_DIV; break;
-            case '%': type = TOKEN_MOD; break;
-            case '(': type = TOKEN_LPAREN; break;
-            case ')': type = TOKEN_RPAREN; break;
-            case ';': type = TOKEN_SEMICOLON; break;
-            case '{': type = TOKEN_LBRACE; break;
-            case '}': type = TOKEN_RBRACE; break;
-            case '&': type = TOKEN_BITWISE_AND; break;
-            case '|': type = TOKEN_BITWISE_OR; break;
-            case '^': type = TOKEN_XOR; break;
-            case '~': type = TOKEN_BITWISE_NOT; break;
-            case ':': type = TOKEN_COLON; break;
-            case '=':
-                advance();
-                if (current_char == '=') {
-                    buffer[1] = current_char;
-                    buffer[2] = '\0';
-                    type = TOKEN_EQEQ;
-                    advance();
-                } else {
-                    type = TOKEN_EQ;
-                    advanced = true;
-                }
-                break;
-            case '<':
-                advance();
-                if (current_char == '=') {
-                    buffer[1] = current_char;
-                    buffer[2] = '\0';
-                    type = TOKEN_LTE;
-                    advance();
-                } else if (current_char == '<') {
-                    buffer[1] = current_char;
-                    buffer[2] = '\0';
-                    type = TOKEN_LSHIFT;
-                    advance();
-                } else {
-                    type = TOKEN_LT;
-                    advanced = true;
-                }
-                break;
-            case '>':
-                advance();
-                if (current_char == '=') {
-                    buffer[1] = current_char;
-                    buffer[2] = '\0';
-                    type = TOKEN_GTE;
-                    advance();
-                } else if (current_char == '>') {
-                    buffer[1] = current_char;
-                    buffer[2] = '\0';
-                    type = TOKEN_RSHIFT;
-                    advance();
-                } else {
-                    type = TOKEN_GT;
-                    advanced = true;
-                }
-                break;
-            case '!':
-                advance();
-                if (current_char == '=') {
-                    buffer[1] = current_char;
-                    buffer[2] = '\0';
-                    type = TOKEN_NEQ;
-                    advance();
-                } else {
-                    type = TOKEN_NOT;
-                    advanced = true;
-                }
-                break;
-            default: type = TOKEN_UNKNOWN;
-        }
+    Ttype type;
+    size_t length = 1;
+    switch (current_char) {
+        case '+': type = TOKEN_PLUS; break;
+        case '-': type = TOKEN_MINUS; break;
+        case '*': type = TOKEN_MUL; break;
+        case '/': type = TOKEN_DIV; break;
+        case '%': type = TOKEN_MOD; break;
+        case '(': type = TOKEN_LPAREN; break;
+        case ')': type = TOKEN_RPAREN; break;
+        case ';': type = TOKEN_SEMICOLON; break;
+        case '{': type = TOKEN_LBRACE; break;
+        case '}': type = TOKEN_RBRACE; break;
+        case '&': type = TOKEN_BITWISE_AND; break;
+        case '|': type = TOKEN_BITWISE_OR; break;
+        case '^': type = TOKEN_XOR; break;
+        case '~': type = TOKEN_BITWISE_NOT; break;
+        case ':': type = TOKEN_COLON; break;
+        case ',': type = TOKEN_COMMA; break;
+        case '[': type = TOKEN_LBRACKET; break;
+        case ']': type = TOKEN_RBRACKET; break;
+        case '=':
+            if (peek_at(1) == '=') {
+                type = TOKEN_EQEQ;
+                length = 2;
+            } else {
+                type = TOKEN_EQ;
+            }
+            break;
+        case '<':
+            if (peek_at(1) == '=') {
+                type = TOKEN_LTE;
+                length = 2;
+            } else if (peek_at(1) == '<') {
+                type = TOKEN_LSHIFT;
+                length = 2;
+            } else {
+                type = TOKEN_LT;
+            }
+            break;
+        case '>':
+            if (peek_at(1) == '=') {
+                type = TOKEN_GTE;
+                length = 2;
+            } else if (peek_at(1) == '>') {
+                type = TOKEN_RSHIFT;
+                length = 2;
+            } else {
+                type = TOKEN_GT;
+            }
+            break;
+        case '!':
+            if (peek_at(1) == '=') {
+                type = TOKEN_NEQ;
+                length = 2;
+            } else {
+                type = TOKEN_NOT;
+            }
+            break;
+        default:
+            // Unknown token
+            type = TOKEN_UNKNOWN;
+            advance();
+            return create_token(type, start, 1, line, column);
+    }
+
+    position += length;
+    return create_token(type, start, length, line, column);
+}
+
 
-        if (!advanced) advance();
-        return create_token(type, allocate_string(buffer));
+static_assert(TOKEN_RBRACKET <= UINT8_MAX, "token types must fit the packed token stream");
+
+static void token_stream_grow(TokenStream* stream, Arena* arena) {
+    const size_t old = (size_t)stream->capacity;
+    const size_t grown = old ? old * 2 : 1024;
+    stream->types = arena_grow(arena, stream->types, old * sizeof(uint8_t), grown * sizeof(uint8_t));
+    stream->offsets = arena_grow(arena, stream->offsets, old * sizeof(uint32_t), grown * sizeof(uint32_t));
+    stream->lengths = arena_grow(arena, stream->lengths, old * sizeof(uint32_t), grown * sizeof(uint32_t));
+    stream->lines = arena_grow(arena, stream->lines, old * sizeof(uint32_t), grown * sizeof(uint32_t));
+    stream->columns = arena_grow(arena, stream->columns, old * sizeof(uint32_t), grown * sizeof(uint32_t));
+    stream->symbols = arena_grow(arena, stream->symbols, old * sizeof(uint32_t), grown * sizeof(uint32_t));
+    stream->capacity = (int)grown;
+}
+
+TokenStream lexer_tokenize(Arena* arena) {
+    if (source_length > UINT32_MAX) {
+        fprintf(stderr, "Error: Source files larger than 4 GiB are not supported\n");
+        exit(EXIT_FAILURE);
     }
 
-    // Unknown token
-    char value[2];
-    value[0] = current_char;
-    value[1] = '\0';
-    advance();
-    return create_token(TOKEN_UNKNOWN, allocate_string(value));
+    TokenStream stream = {0};
+    Token token;
+    do {
+        token = lexer_next_token();
+        if (stream.count == stream.capacity) {
+            token_stream_grow(&stream, arena);
+        }
+        stream.types[stream.count] = (uint8_t)token.type;
+        stream.offsets[stream.count] = (uint32_t)token.offset;
+        stream.lengths[stream.count] = (uint32_t)token.length;
+        stream.lines[stream.count] = (uint32_t)token.line;
+        stream.columns[stream.count] = (uint32_t)token.column;
+        stream.symbols[stream.count] = token.symbol;
+        stream.count++;
+    } while (token.type != TOKEN_EOF);
+
+    return stream;
 }
 
+Token token_stream_at(const TokenStream* stream, const int index) {
+    Token token;
+    token.type = (Ttype)stream->types[index];
+    token.offset = stream->offsets[index];
+    token.length = (int)stream->lengths[index];
+    token.line = (int)stream->lines[index];
+    token.column = (int)stream->columns[index];
+    token.symbol = stream->symbols[index];
+    return token;
+}
+
+Lexeme token_stream_lexeme(const TokenStream* stream, const int index) {
+    Lexeme lexeme;
+    lexeme.text = source + stream->offsets[index];
+    lexeme.length = (int)stream->lengths[index];
+    return lexeme;
+}
 
 const char* token_type_to_string(const Ttype type) {
     switch (type) {
@@ -384,14 +513,62 @@ const char* token_type_to_string(const Ttype type) {
         case TOKEN_COLON: return "COLON";
         case TOKEN_BREAK: return "BREAK";
         case TOKEN_CONTINUE: return "CONTINUE";
+        case TOKEN_COMMA: return "COMMA";
+        case TOKEN_LBRACKET: return "LBRACKET";
+        case TOKEN_RBRACKET: return "RBRACKET";
 
         default: return "UNDEFINED";
     }
 }
 
-void token_free(Token* token) {
-    if (token->value != NULL) {
-        free(token->value);
-        token->value = nullptr;
+Lexeme token_lexeme(const Token* token) {
+    Lexeme lexeme;
+    lexeme.text = source + token->offset;
+    lexeme.length = token->length;
+    return lexeme;
+}
+
+bool lexeme_equals(const Lexeme a, const Lexeme b) {
+    return a.length == b.length && memcmp(a.text, b.text, (size_t)a.length) == 0;
+}
+
+size_t lexeme_decode_string(const Lexeme text, char* decoded) {
+    size_t count = 0;
+    for (int i = 0; i < text.length; i++) {
+        int c = (unsigned char)text.text[i];
+        if (c == '\\' && i + 1 < text.length) {
+            c = (unsigned char)text.text[++i];
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'a': c = '\a'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'v': c = '\v'; break;
+                case 'x': {
+                    int value = 0;
+                    while (i + 1 < text.length && isxdigit((unsigned char)text.text[i + 1])) {
+                        const char digit = text.text[++i];
+                        value = value * 16 + (digit <= '9' ? digit - '0' : (digit | 0x20) - 'a' + 10);
+                    }
+                    c = value & 0xFF;
+                    break;
+                }
+                default:
+                    if (c >= '0' && c <= '7') {
+                        int value = c - '0';
+                        for (int digits = 1; digits < 3 && i + 1 < text.length && text.text[i + 1] >= '0' &&
+                                             text.text[i + 1] <= '7'; digits++) {
+                            value = value * 8 + text.text[++i] - '0';
+                        }
+                        c = value & 0xFF;
+                    }
+                    break;
+            }
+        }
+        decoded[count++] = (char)c;
     }
+    decoded[count] = '\0';
+    return count;
 }
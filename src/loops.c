@@ -0,0 +1,634 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "loops.h"
+#include "cfg.h"
+#include "induction.h"
+
+// Partial unrolling never makes more copies of a loop than this
+#define MAX_UNROLL_FACTOR 8
+
+// A use outside an unrolled loop of a value defined inside it
+typedef struct {
+    int value;
+    int block;          // Block at whose end the value is needed
+    int inst;           // Using instruction, or -1 for the block's condition
+    int arg;            // Operand; phi arguments are found by block, as edges move
+} Use;
+
+static IrProgram* ir;
+static Cfg cfg;
+
+// Unrolling state: the loop's blocks, and the instructions and blocks that
+// existed before it was copied
+static bool* in_loop;
+static int original_insts;
+static int original_blocks;
+
+// SSA repair state for the value being repaired, by block
+static int* defined;        // Version the block defines, or -1
+static int* available;      // Version available at the end of the block, or -1
+
+static int* new_map(const int count) {
+    int* map = ir_allocate((size_t)count, sizeof(int));
+    for (int i = 0; i < count; i++) map[i] = -1;
+    return map;
+}
+
+static bool same_value(const int a, const int b) {
+    return a == b ||
+           (ir_is_const(ir, a) && ir_is_const(ir, b) && ir->insts[a].value.integer == ir->insts[b].value.integer);
+}
+
+// The only predecessor of the header inside the loop
+static int latch_of(const int loop) {
+    const IrBlock* header = &ir->blocks[cfg.loops[loop].header];
+    for (int p = 0; p < header->pred_count; p++) {
+        if (cfg_in_loop(&cfg, header->preds[p], loop)) return header->preds[p];
+    }
+    return -1;
+}
+
+static int pred_index(const int block, const int pred) {
+    const IrBlock* target = &ir->blocks[block];
+    for (int p = 0; p < target->pred_count; p++) {
+        if (target->preds[p] == pred) return p;
+    }
+    return -1;
+}
+
+static void retarget(const int block, const int from, const int to) {
+    IrBlock* source = &ir->blocks[block];
+    for (int s = 0; s < ir_succ_count(source); s++) {
+        if (source->succ[s] == from) source->succ[s] = to;
+    }
+}
+
+static bool is_innermost(const int loop) {
+    for (int l = 0; l < cfg.loop_count; l++) {
+        if (cfg.loops[l].parent == loop) return false;
+    }
+    return true;
+}
+
+static bool has_effect(const IrInst* inst) {
+    return ir_has_side_effect(inst->op) || ir_may_trap(ir, inst);
+}
+
+// Instructions the loop runs per iteration, not counting phis and constants
+static int loop_size(const int loop) {
+    int size = 0;
+    for (int i = 0; i < cfg.loops[loop].block_count; i++) {
+        for (int id = ir->blocks[cfg.loops[loop].blocks[i]].first; id >= 0; id = ir->insts[id].next) {
+            const IrOp op = ir->insts[id].op;
+            if (op != IR_PHI && op != IR_CONST && op != IR_COPY) size++;
+        }
+    }
+    return size;
+}
+
+// ---------------------------------------------------------------------------
+// Unrolling
+
+static bool defined_in_loop(const int value) {
+    return value >= 0 && value < original_insts && in_loop[ir->insts[value].block];
+}
+
+// The value in a copy of the loop that stands for an original value; map is
+// nullptr for the original loop itself
+static int copied_value(const int* map, int value) {
+    value = ir_resolve(ir, value);
+    if (map == nullptr || !defined_in_loop(value)) return value;
+    return map[value];
+}
+
+static int clone_inst(const int block, const int original) {
+    const IrInst* source = &ir->insts[original];
+    const int id = ir_append(ir, block, source->op, source->type, source->args[0], source->args[1]);
+    source = &ir->insts[original];
+    IrInst* copy = &ir->insts[id];
+    copy->value = source->value;
+    copy->slot = source->slot;
+    copy->source = source->source;
+    copy->text = source->text;
+    copy->other = source->other;
+    copy->other_text = source->other_text;
+    copy->line = source->line;
+    copy->in_bounds = source->in_bounds;
+    return id;
+}
+
+// A copy of a loop block leaving the loop adds an edge to the exit, whose
+// phis take the copy's values
+static void add_exit_edge(const int exit, const int original, const int copy, const int* map) {
+    const int index = pred_index(exit, original);
+    ir_add_pred(ir, exit, copy);
+    for (int id = ir->blocks[exit].first; id >= 0 && ir->insts[id].op == IR_PHI; id = ir->insts[id].next) {
+        IrInst* phi = &ir->insts[id];
+        int* args = arena_alloc(ir->arena, sizeof(int) * (size_t)(phi->phi_count + 1));
+        memcpy(args, phi->phi_args, sizeof(int) * (size_t)phi->phi_count);
+        args[phi->phi_count] = copied_value(map, args[index]);
+        phi->phi_args = args;
+        phi->phi_count++;
+    }
+}
+
+// Copy every block of the loop. The copy's header has a single entry, the
+// previous copy's latch, so its phis become that latch's values
+static void copy_loop(const int loop, const int latch, const int* previous, int* current, int* block_map) {
+    const IrLoop* info = &cfg.loops[loop];
+    const int header = info->header;
+    const int latch_index = pred_index(header, latch);
+
+    for (int i = 0; i < info->block_count; i++) {
+        const int b = info->blocks[i];
+        const int copy = ir_new_block(ir);
+        ir->blocks[copy].loop_depth = ir->blocks[b].loop_depth;
+        ir->blocks[copy].line = ir->blocks[b].line;
+        ir->blocks[copy].sealed = true;
+        block_map[b] = copy;
+    }
+    for (int id = ir->blocks[header].first; id >= 0 && ir->insts[id].op == IR_PHI; id = ir->insts[id].next) {
+        current[id] = copied_value(previous, ir->insts[id].phi_args[latch_index]);
+    }
+    for (int i = 0; i < info->block_count; i++) {
+        const int b = info->blocks[i];
+        for (int id = ir->blocks[b].first; id >= 0; id = ir->insts[id].next) {
+            if (b == header && ir->insts[id].op == IR_PHI) continue;
+            current[id] = clone_inst(block_map[b], id);
+        }
+    }
+
+    for (int i = 0; i < info->block_count; i++) {
+        const int b = info->blocks[i];
+        const int copy = block_map[b];
+        for (int id = ir->blocks[b].first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            if (b == header && inst->op == IR_PHI) continue;
+            IrInst* clone = &ir->insts[current[id]];
+            for (int a = 0; a < 2; a++) {
+                if (inst->args[a] >= 0) clone->args[a] = copied_value(current, inst->args[a]);
+            }
+            if (inst->op == IR_PHI) {
+                clone->phi_args = arena_alloc(ir->arena, sizeof(int) * (size_t)inst->phi_count);
+                clone->phi_count = inst->phi_count;
+                for (int a = 0; a < inst->phi_count; a++) {
+                    clone->phi_args[a] = copied_value(current, inst->phi_args[a]);
+                }
+            }
+        }
+
+        // Blocks inside the loop other than the header are only entered from
+        // the loop; the header's entry is linked later
+        for (int p = 0; b != header && p < ir->blocks[b].pred_count; p++) {
+            ir_add_pred(ir, copy, block_map[ir->blocks[b].preds[p]]);
+        }
+
+        const IrBlock* source = &ir->blocks[b];
+        IrBlock* target = &ir->blocks[copy];
+        target->term = source->term;
+        target->cond = source->cond >= 0 ? copied_value(current, source->cond) : -1;
+        for (int s = 0; s < ir_succ_count(source); s++) {
+            const int succ = source->succ[s];
+            if (succ == header) {
+                // Linked to the next copy's header once every copy exists
+                target->succ[s] = header;
+            } else if (in_loop[succ]) {
+                target->succ[s] = block_map[succ];
+            } else {
+                target->succ[s] = succ;
+                add_exit_edge(succ, b, copy, current);
+            }
+            source = &ir->blocks[b];
+            target = &ir->blocks[copy];
+        }
+    }
+}
+
+// Replace a block's test with a jump to one of its successors
+static void resolve_test(const int block, const int taken) {
+    IrBlock* source = &ir->blocks[block];
+    const int target = source->succ[taken];
+    ir_remove_edge(ir, block, source->succ[1 - taken]);
+    source->term = TERM_JUMP;
+    source->succ[0] = target;
+    source->succ[1] = -1;
+    source->cond = -1;
+}
+
+static void add_use(Use** uses, int* count, int* capacity, const Use use) {
+    if (*count >= *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        *uses = realloc(*uses, sizeof(Use) * (size_t)*capacity);
+        if (*uses == NULL) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(1);
+        }
+    }
+    (*uses)[(*count)++] = use;
+}
+
+// Uses outside the loop of values defined inside it; phi arguments on edges
+// leaving the loop are handled by copying the edge instead
+static Use* escaping_uses(int* count) {
+    Use* uses = nullptr;
+    int capacity = 0;
+    *count = 0;
+    for (int i = 0; i < cfg.order_count; i++) {
+        const int b = cfg.order[i];
+        if (in_loop[b]) continue;
+        const IrBlock* block = &ir->blocks[b];
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            for (int a = 0; a < 2; a++) {
+                const int value = ir_resolve(ir, inst->args[a]);
+                if (defined_in_loop(value)) add_use(&uses, count, &capacity, (Use){value, b, id, a});
+            }
+            for (int a = 0; a < inst->phi_count; a++) {
+                const int value = ir_resolve(ir, inst->phi_args[a]);
+                if (!in_loop[block->preds[a]] && defined_in_loop(value)) {
+                    add_use(&uses, count, &capacity, (Use){value, block->preds[a], id, a});
+                }
+            }
+        }
+        const int cond = ir_resolve(ir, block->cond);
+        if ((block->term == TERM_BRANCH || block->term == TERM_EXIT) && defined_in_loop(cond)) {
+            add_use(&uses, count, &capacity, (Use){cond, b, -1, 0});
+        }
+    }
+    return uses;
+}
+
+static int compare_uses(const void* a, const void* b) {
+    const int x = ((const Use*)a)->value;
+    const int y = ((const Use*)b)->value;
+    return (x > y) - (x < y);
+}
+
+// The version of the value being repaired that reaches the end of a block,
+// merging the versions of several predecessors in a new phi
+static int value_at_end(const int block, const int original, int* touched, int* touched_count) {
+    if (defined[block] >= 0) return defined[block];
+    if (available[block] >= 0) return available[block];
+
+    const IrBlock* target = &ir->blocks[block];
+    touched[(*touched_count)++] = block;
+    if (target->pred_count == 1) {
+        available[block] = value_at_end(target->preds[0], original, touched, touched_count);
+        return available[block];
+    }
+
+    // The phi is recorded first, so a cycle back to this block ends at it
+    const VarType type = ir->insts[original].type;
+    const int phi = target->first >= 0 ? ir_insert_before(ir, target->first, IR_PHI, type, -1, -1)
+                                       : ir_append(ir, block, IR_PHI, type, -1, -1);
+    ir->insts[phi].line = ir->insts[original].line;
+    available[block] = phi;
+    const int count = ir->blocks[block].pred_count;
+    int* args = arena_alloc(ir->arena, sizeof(int) * (size_t)count);
+    for (int p = 0; p < count; p++) {
+        args[p] = value_at_end(ir->blocks[block].preds[p], original, touched, touched_count);
+    }
+    ir->insts[phi].phi_args = args;
+    ir->insts[phi].phi_count = count;
+    return phi;
+}
+
+// Point uses outside the loop at the version from the copy they come from
+static void repair_uses(Use* uses, const int use_count, const int* version_block, const int* version_value,
+                        const int versions) {
+    defined = new_map(ir->block_count);
+    available = new_map(ir->block_count);
+    int* touched = ir_allocate((size_t)ir->block_count, sizeof(int));
+
+    for (int start = 0, value = 0; start < use_count; value++) {
+        int end = start;
+        while (end < use_count && uses[end].value == uses[start].value) end++;
+        for (int k = 0; k < versions; k++) {
+            defined[version_block[value * versions + k]] = version_value[value * versions + k];
+        }
+
+        int touched_count = 0;
+        for (int u = start; u < end; u++) {
+            const Use* use = &uses[u];
+            const int version = value_at_end(use->block, uses[start].value, touched, &touched_count);
+            if (use->inst < 0) {
+                ir->blocks[use->block].cond = version;
+            } else if (ir->insts[use->inst].op == IR_PHI) {
+                ir->insts[use->inst].phi_args[pred_index(ir->insts[use->inst].block, use->block)] = version;
+            } else {
+                ir->insts[use->inst].args[use->arg] = version;
+            }
+        }
+
+        for (int k = 0; k < versions; k++) defined[version_block[value * versions + k]] = -1;
+        for (int t = 0; t < touched_count; t++) available[touched[t]] = -1;
+        start = end;
+    }
+
+    free(touched);
+    free(defined);
+    free(available);
+    defined = available = nullptr;
+}
+
+// Chain copies more copies of the loop after it. When the loop is unrolled
+// completely, copies is its trip count and the last copy's header only leaves
+static void unroll_loop(const int loop, const int copies, const bool complete) {
+    const int header = cfg.loops[loop].header;
+    const int latch = latch_of(loop);
+    original_insts = ir->inst_count;
+    original_blocks = ir->block_count;
+    in_loop = calloc((size_t)original_blocks, sizeof(bool));
+    if (in_loop == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    for (int i = 0; i < cfg.loops[loop].block_count; i++) in_loop[cfg.loops[loop].blocks[i]] = true;
+
+    int use_count;
+    Use* uses = escaping_uses(&use_count);
+    if (use_count > 0) qsort(uses, (size_t)use_count, sizeof(Use), compare_uses);
+    int escaping = 0;
+    for (int u = 0; u < use_count; u++) {
+        if (u == 0 || uses[u].value != uses[u - 1].value) escaping++;
+    }
+    const int versions = copies + 1;
+    int* version_block = ir_allocate((size_t)escaping * (size_t)versions, sizeof(int));
+    int* version_value = ir_allocate((size_t)escaping * (size_t)versions, sizeof(int));
+
+    int* headers = ir_allocate((size_t)versions, sizeof(int));
+    int* latches = ir_allocate((size_t)versions, sizeof(int));
+    int* previous = new_map(original_insts);
+    int* current = new_map(original_insts);
+    int* block_map = new_map(original_blocks);
+    headers[0] = header;
+    latches[0] = latch;
+
+    for (int k = 0; k < versions; k++) {
+        if (k > 0) {
+            copy_loop(loop, latch, k > 1 ? previous : nullptr, current, block_map);
+            headers[k] = block_map[header];
+            latches[k] = block_map[latch];
+            ir_add_pred(ir, headers[k], latches[k - 1]);
+        }
+        for (int u = 0, value = -1; u < use_count; u++) {
+            if (u > 0 && uses[u].value == uses[u - 1].value) continue;
+            value++;
+            const int original = uses[u].value;
+            const int block = ir->insts[original].block;
+            version_block[value * versions + k] = k > 0 ? block_map[block] : block;
+            version_value[value * versions + k] = k > 0 ? current[original] : original;
+        }
+        if (k > 0) {
+            int* swap = previous;
+            previous = current;
+            current = swap;
+        }
+    }
+
+    // Each copy's latch goes on to the next copy, and the last one back to
+    // the original header, whose phis take its values
+    IrBlock* block = &ir->blocks[header];
+    const int latch_index = pred_index(header, latch);
+    for (int id = block->first; id >= 0 && ir->insts[id].op == IR_PHI; id = ir->insts[id].next) {
+        IrInst* phi = &ir->insts[id];
+        phi->phi_args[latch_index] = copied_value(copies > 0 ? previous : nullptr, phi->phi_args[latch_index]);
+    }
+    block->preds[latch_index] = latches[copies];
+    for (int k = 0; k < copies; k++) retarget(latches[k], header, headers[k + 1]);
+
+    if (complete) {
+        for (int k = 0; k < copies; k++) resolve_test(headers[k], 0);
+        resolve_test(headers[copies], 1);
+    } else {
+        for (int k = 1; k < versions; k++) resolve_test(headers[k], 0);
+    }
+
+    repair_uses(uses, use_count, version_block, version_value, versions);
+
+    free(uses);
+    free(version_block);
+    free(version_value);
+    free(headers);
+    free(latches);
+    free(previous);
+    free(current);
+    free(block_map);
+    free(in_loop);
+    in_loop = nullptr;
+}
+
+// Unroll the first loop that qualifies; the CFG must be analyzed again after
+static bool unroll_next(const int limit, FILE* report) {
+    for (int loop = 0; loop < cfg.loop_count; loop++) {
+        LoopCounter counter;
+        if (!is_innermost(loop) || !induction_find_counter(ir, &cfg, loop, &counter)) continue;
+        const int64_t trips = induction_trip_count(ir, &counter);
+        if (trips < 0) continue;
+        const int size = loop_size(loop) > 0 ? loop_size(loop) : 1;
+        const int header = cfg.loops[loop].header;
+
+        if (trips <= limit / size) {
+            if (report != nullptr) {
+                fprintf(report, "line %d: unrolled the loop completely, %" PRId64 " iterations\n",
+                        ir->blocks[header].line, trips);
+            }
+            unroll_loop(loop, (int)trips, true);
+            return true;
+        }
+
+        int factor = MAX_UNROLL_FACTOR;
+        while (factor > 1 && (trips % factor != 0 || factor > limit / size)) factor--;
+        if (factor < 2) continue;
+        if (report != nullptr) fprintf(report, "line %d: unrolled the loop by %d\n", ir->blocks[header].line, factor);
+        unroll_loop(loop, factor - 1, false);
+        return true;
+    }
+    return false;
+}
+
+void loops_unroll(IrProgram* program, const int limit, FILE* report) {
+    if (limit <= 0) return;
+    ir = program;
+    bool unrolled;
+    do {
+        cfg = cfg_analyze(ir);
+        unrolled = unroll_next(limit, report);
+        cfg_free(&cfg);
+    } while (unrolled);
+    ir = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Fusion
+
+// Whether the loop can only be left through its header's test
+static bool only_header_exits(const int loop) {
+    const int header = cfg.loops[loop].header;
+    for (int i = 0; i < cfg.loops[loop].block_count; i++) {
+        const int b = cfg.loops[loop].blocks[i];
+        if (b == header) continue;
+        for (int s = 0; s < ir_succ_count(&ir->blocks[b]); s++) {
+            if (!cfg_in_loop(&cfg, ir->blocks[b].succ[s], loop)) return false;
+        }
+    }
+    return true;
+}
+
+static bool loop_has_effects(const int loop) {
+    for (int i = 0; i < cfg.loops[loop].block_count; i++) {
+        for (int id = ir->blocks[cfg.loops[loop].blocks[i]].first; id >= 0; id = ir->insts[id].next) {
+            if (has_effect(&ir->insts[id])) return true;
+        }
+    }
+    return false;
+}
+
+// Whether an operand is computed by the first loop, or by what stays between
+// the loops
+static bool from_first(const int value, const int first, const bool* stays) {
+    if (value < 0) return false;
+    const int resolved = ir_resolve(ir, value);
+    return stays[resolved] || cfg_in_loop(&cfg, ir->insts[resolved].block, first);
+}
+
+static bool reads_first(const int second, const int first, const bool* stays) {
+    for (int i = 0; i < cfg.loops[second].block_count; i++) {
+        const IrBlock* block = &ir->blocks[cfg.loops[second].blocks[i]];
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            if (from_first(inst->args[0], first, stays) || from_first(inst->args[1], first, stays)) return true;
+            for (int a = 0; a < inst->phi_count; a++) {
+                if (from_first(inst->phi_args[a], first, stays)) return true;
+            }
+        }
+        if (from_first(block->cond, first, stays)) return true;
+    }
+    return false;
+}
+
+// The second loop's blocks run in the first loop's iterations, after the
+// first loop's blocks. Its header phis join the first header's, its header
+// test goes, and what ran between the loops runs before the first one, or
+// after the fused loop when it depends on the first loop.
+static void fuse(const int first, const int second, const int between, const bool* stays,
+                 const LoopCounter* first_counter, const LoopCounter* second_counter) {
+    const int header = cfg.loops[first].header;
+    const int other = cfg.loops[second].header;
+    const int first_latch = latch_of(first);
+    const int second_latch = latch_of(second);
+    const int exit = ir->blocks[other].succ[1];
+    const int preheader = cfg_preheader(ir, &cfg, first);
+    const int entry_index = pred_index(header, preheader);
+    const int latch_index = pred_index(header, first_latch);
+    const int other_entry = pred_index(other, between);
+    const int other_latch = pred_index(other, second_latch);
+
+    for (int id = ir->blocks[between].first, next; id >= 0; id = next) {
+        next = ir->insts[id].next;
+        if (!stays[id]) ir_move(ir, id, preheader);
+    }
+
+    int position = ir->blocks[header].first;
+    while (ir->insts[position].op == IR_PHI) position = ir->insts[position].next;
+    while (ir->blocks[other].first >= 0 && ir->insts[ir->blocks[other].first].op == IR_PHI) {
+        const int id = ir->blocks[other].first;
+        int value = first_counter->phi;
+        if (id != second_counter->phi) {
+            value = ir_insert_before(ir, position, IR_PHI, ir->insts[id].type, -1, -1);
+            int* args = arena_alloc(ir->arena, sizeof(int) * 2);
+            args[entry_index] = ir->insts[id].phi_args[other_entry];
+            args[latch_index] = ir->insts[id].phi_args[other_latch];
+            ir->insts[value].phi_args = args;
+            ir->insts[value].phi_count = 2;
+            ir->insts[value].line = ir->insts[id].line;
+        }
+        ir_replace(ir, id, value);
+        ir_remove(ir, id);
+    }
+    while (ir->blocks[other].first >= 0) ir_move(ir, ir->blocks[other].first, header);
+
+    retarget(first_latch, header, other);
+    retarget(second_latch, other, header);
+    ir->blocks[header].preds[latch_index] = second_latch;
+    IrBlock* block = &ir->blocks[other];
+    ir->blocks[exit].preds[pred_index(exit, other)] = between;
+    block->term = TERM_JUMP;
+    block->cond = -1;
+    block->succ[1] = -1;
+    block->preds[0] = first_latch;
+    block->pred_count = 1;
+    retarget(between, other, exit);
+}
+
+// Fuse the first pair of loops that qualifies; the CFG must be analyzed again after
+static bool fuse_next(FILE* report) {
+    bool* stays = calloc((size_t)ir->inst_count, sizeof(bool));
+    if (stays == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+
+    bool fused = false;
+    for (int first = 0; first < cfg.loop_count && !fused; first++) {
+        LoopCounter first_counter, second_counter;
+        if (!induction_find_counter(ir, &cfg, first, &first_counter) || !only_header_exits(first)) continue;
+        const int header = cfg.loops[first].header;
+
+        // The first loop's exit only leads on to the second loop's header
+        const int between = ir->blocks[header].succ[1];
+        const IrBlock* block = &ir->blocks[between];
+        if (block->pred_count != 1 || block->term != TERM_JUMP) continue;
+        if (block->first >= 0 && ir->insts[block->first].op == IR_PHI) continue;
+        const int other = block->succ[0];
+        const int second = cfg.loop_of[other];
+        if (second < 0 || cfg.loops[second].header != other) continue;
+        if (!induction_find_counter(ir, &cfg, second, &second_counter) || !only_header_exits(second)) continue;
+
+        // Both run the same iterations
+        if (!same_value(first_counter.init, second_counter.init) ||
+            !same_value(first_counter.bound, second_counter.bound) || first_counter.op != second_counter.op ||
+            first_counter.step != second_counter.step) {
+            continue;
+        }
+
+        // What runs between the loops moves before the first unless it
+        // depends on it or has effects
+        bool effects_between = false;
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            stays[id] = has_effect(inst) || from_first(inst->args[0], first, stays) ||
+                        from_first(inst->args[1], first, stays);
+            effects_between |= has_effect(inst);
+        }
+
+        // Effects keep their order as long as only one side has any
+        const bool second_effects = loop_has_effects(second);
+        const bool allowed = !reads_first(second, first, stays) && !(second_effects && effects_between) &&
+                             !(second_effects && loop_has_effects(first));
+        if (allowed) {
+            if (report != nullptr) {
+                fprintf(report, "line %d: fused with the loop at line %d\n", ir->blocks[other].line,
+                        ir->blocks[header].line);
+            }
+            fuse(first, second, between, stays, &first_counter, &second_counter);
+            fused = true;
+        }
+        for (int id = ir->blocks[between].first; id >= 0; id = ir->insts[id].next) stays[id] = false;
+    }
+
+    free(stays);
+    return fused;
+}
+
+void loops_fuse(IrProgram* program, FILE* report) {
+    ir = program;
+    bool fused;
+    do {
+        cfg = cfg_analyze(ir);
+        fused = fuse_next(report);
+        cfg_free(&cfg);
+    } while (fused);
+    ir = nullptr;
+}
@@ -1,10 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "lexer.h"
 #include "parser.h"
 #include "codegen.h"
 #include "semantic.h"
+#include "intern.h"
+#include "arena.h"
+#include "ir.h"
+#include "optimize.h"
+#include "evaluate.h"
+#include "x86.h"
+#include "object.h"
+#include "jit.h"
+#include "bytecode.h"
+#include "vm.h"
 void print_version() {
     printf("SILC v1.2.1\n");
     printf("A Simple Imperative Language Compiler.\n");
@@ -16,9 +27,50 @@ void print_help() {
     printf("A Simple Imperative Language Compiler.\n\n");
     printf("Options:\n");
     printf("  -v, --version    Print compiler version and exit.\n");
-    printf("  -h, --help       Print this help message and exit.\n\n");
+    printf("  -h, --help       Print this help message and exit.\n");
+    printf("  --time-phases    Report the time spent in each compiler phase.\n");
+    printf("  --alloc-stats    Report front-end allocations per compiler phase.\n");
+    printf("  -O<level>        Optimization level. -O0 (default) translates the program directly;\n");
+    printf("                   -O1 and above optimize it in SSA form first, and -O2 also\n");
+    printf("                   hoists loop-invariant code, strength-reduces loop counters,\n");
+    printf("                   fuses adjacent loops and unrolls short inner loops.\n");
+    printf("  --dump-ir        Print the optimized IR (with -O1 and above).\n");
+    printf("  --opt-report     List the optimizations applied, by source line.\n");
+    printf("  --eval-budget=N  Steps the compiler may spend running the input-free start of\n");
+    printf("                   the program at -O1 and above (default 1000000, 0 disables).\n");
+    printf("  --unroll-limit=N Instructions an unrolled loop may grow to at -O2\n");
+    printf("                   (default 64, 0 disables unrolling).\n");
+    printf("  --no-fusion      Keep adjacent loops over the same range separate at -O2.\n");
+    printf("  --native         Generate x86-64 code and only link it, without compiling C\n");
+    printf("                   (x86-64 Linux).\n");
+    printf("  --interp         Run the program in the bytecode interpreter instead of compiling it.\n\n");
     printf("To compile a file:\n");
-    printf("  SILC path/to/your/file.slc\n");
+    printf("  SILC [options] path/to/your/file.slc [output]\n");
+    printf("To compile a file into memory and run it at once (x86-64 Linux):\n");
+    printf("  SILC run [options] path/to/your/file.slc\n");
+    printf("To run a file in the interpreter, on any platform and without GCC:\n");
+    printf("  SILC --interp [options] path/to/your/file.slc\n");
+}
+
+static double now_ms() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec * 1e-6;
+}
+
+static void report_phase(const bool enabled, const char* phase, const double start) {
+    if (enabled) {
+        printf("%-10s %10.3f ms\n", phase, now_ms() - start);
+    }
+}
+
+// Print the allocations made by a phase since the previous snapshot, then take a new one
+static void report_allocations(const bool enabled, const char* phase, const Arena* arena, Arena* snapshot) {
+    if (enabled) {
+        printf("%-10s %12zu allocations %14zu bytes\n", phase,
+               arena->allocations - snapshot->allocations, arena->bytes - snapshot->bytes);
+    }
+    *snapshot = *arena;
 }
 
 int main(const int argc, const char** argv) {
@@ -27,89 +79,250 @@ int main(const int argc, const char** argv) {
         return 1;
     }
 
-    const char* arg = argv[1];
+    // `SILC run` compiles into memory and runs the program in this process
+    const double compile_start = now_ms();
+    const bool run = strcmp(argv[1], "run") == 0;
+    const char* input_file = nullptr;
+    const char* exe_file = "a.exe"; // Default output name
+    bool time_phases = false;
+    bool alloc_stats = false;
+    bool dump_ir = false;
+    bool native = run;
+    bool interp = false;
+    OptimizeOptions options = {.unroll_limit = 64, .fuse_loops = true};
+    int64_t eval_budget = 1000000;
 
-    if (strcmp(arg, "-v") == 0 || strcmp(arg, "--version") == 0) {
-        print_version();
-        return 0;
-    }
+    for (int i = run ? 2 : 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "-v") == 0 || strcmp(arg, "--version") == 0) {
+            print_version();
+            return 0;
+        }
 
-    if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
-        print_help();
-        return 0;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_help();
+            return 0;
+        }
+
+        if (strcmp(arg, "--time-phases") == 0) {
+            time_phases = true;
+        } else if (strcmp(arg, "--alloc-stats") == 0) {
+            alloc_stats = true;
+        } else if (strcmp(arg, "--dump-ir") == 0) {
+            dump_ir = true;
+        } else if (strcmp(arg, "--opt-report") == 0) {
+            options.report = stdout;
+        } else if (strncmp(arg, "--eval-budget=", 14) == 0) {
+            char* end;
+            eval_budget = strtoll(arg + 14, &end, 10);
+            if (end == arg + 14 || *end != '\0' || eval_budget < 0) {
+                fprintf(stderr, "Error: Invalid evaluation budget %s. Use 'SILC -h' for help.\n", arg + 14);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strncmp(arg, "--unroll-limit=", 15) == 0) {
+            char* end;
+            const long limit = strtol(arg + 15, &end, 10);
+            if (end == arg + 15 || *end != '\0' || limit < 0 || limit > 100000) {
+                fprintf(stderr, "Error: Invalid unroll limit %s. Use 'SILC -h' for help.\n", arg + 15);
+                exit(EXIT_FAILURE);
+            }
+            options.unroll_limit = (int)limit;
+        } else if (strcmp(arg, "--no-fusion") == 0) {
+            options.fuse_loops = false;
+        } else if (strcmp(arg, "--native") == 0) {
+            native = true;
+        } else if (strcmp(arg, "--interp") == 0) {
+            interp = true;
+        } else if (arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '9' && arg[3] == '\0') {
+            options.level = arg[2] - '0';
+        } else if (arg[0] == '-') {
+            fprintf(stderr, "Error: Unknown option %s. Use 'SILC -h' for help.\n", arg);
+            exit(EXIT_FAILURE);
+        } else if (input_file == NULL) {
+            // The first non-option argument is the input file, the second the executable name
+            input_file = arg;
+        } else {
+            exe_file = arg;
+        }
     }
 
-    // After checking for flags, the first argument must be the input file.
-    const char* input_file = arg;
+    if (input_file == NULL) {
+        fprintf(stderr, "Error: No input file provided. Use 'SILC -h' for help.\n");
+        return 1;
+    }
+    if (interp && native) {
+        fprintf(stderr, "Error: --interp cannot be combined with --native or run.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (run && !jit_supported()) {
+        fprintf(stderr, "Error: SILC run needs an x86-64 Linux build.\n");
+        exit(EXIT_FAILURE);
+    }
     if (strstr(input_file, ".slc") == NULL) {
         fprintf(stderr, "Error: Input file must have a .slc extension. Got: %s\n", input_file);
         exit(EXIT_FAILURE);
     }
 
-    // Check if input file exists
-    FILE* source = fopen(input_file, "r");
-    if (source == NULL) {
+    // Map the input file into memory for the lexer
+    if (!lexer_init_mapped(input_file)) {
         fprintf(stderr, "Error: Could not open input file %s\n", input_file);
         exit(EXIT_FAILURE);
     }
 
     // Check if GCC is installed before proceeding
-    if (system("gcc --version > nul 2>&1") != 0) {
+    if (!run && !interp && system("gcc --version > nul 2>&1") != 0) {
         fprintf(stderr, "Error: GCC is not installed or not in the system's PATH. Aborting.\n");
-        fclose(source);
+        lexer_cleanup();
         exit(EXIT_FAILURE);
     }
 
-    const char* c_file = "a.c";
-    const char* exe_file = "a.exe"; // Default output name
+    // The C source, or the object file of the native backend
+    const char* c_file = native ? "a.o" : "a.c";
 
-    if (argc > 2) {
-        exe_file = argv[2];
-    }
+    // Every front-end allocation lives in this arena until compilation ends
+    Arena arena;
+    arena_init(&arena);
+    Arena snapshot = arena;
+    intern_init(&arena);
+
+    // Tokenize the whole input up front
+    double phase_start = now_ms();
+    const TokenStream tokens = lexer_tokenize(&arena);
+    report_phase(time_phases, "lex", phase_start);
+    report_allocations(alloc_stats, "lex", &arena, &snapshot);
 
     // Initialize the compiler components
-    lexer_init(source);
-    parser_init();
-    semantic_init();  // Add this line
-    codegen_init(c_file);
+    parser_init(&tokens, &arena);
+    if (!native && !interp) codegen_init(c_file);
+    X86Code code = {0};
+    Bytecode bytecode = {0};
 
     // Parse the input
+    phase_start = now_ms();
     Program program = parser_parse();
+    report_phase(time_phases, "parse", phase_start);
+    report_allocations(alloc_stats, "parse", &arena, &snapshot);
 
-    // Perform semantic analysis
+    // Perform semantic analysis; its tables count toward this phase
+    phase_start = now_ms();
+    semantic_init(&arena);
     SemanticResult semantic_result = semantic_analyze(&program);
+    report_phase(time_phases, "semantic", phase_start);
+    report_allocations(alloc_stats, "semantic", &arena, &snapshot);
     if (semantic_result != SEMANTIC_OK) {
         fprintf(stderr, "Semantic analysis failed. Compilation aborted.\n");
         semantic_cleanup();
         codegen_cleanup();
-        program_free(&program);
         parser_cleanup();
-        fclose(source);
+        intern_cleanup();
+        arena_release(&arena);
+        lexer_cleanup();
         exit(EXIT_FAILURE);
     }
 
-    // Generate C code
-    codegen_generate(program);
+    // Run what does not depend on input now, and keep only its output
+    Evaluation evaluation = {0};
+    if (options.level >= 1 && eval_budget > 0) {
+        phase_start = now_ms();
+        evaluation = evaluate_program(&program, &arena, eval_budget);
+        report_phase(time_phases, "evaluate", phase_start);
+        report_allocations(alloc_stats, "evaluate", &arena, &snapshot);
+        codegen_precomputed_output(evaluation.text, evaluation.length);
+        if (options.report != nullptr && evaluation.evaluated > 0) {
+            printf("evaluated %d top-level statement%s at compile time, %zu bytes of output%s\n",
+                   evaluation.evaluated, evaluation.evaluated == 1 ? "" : "s", evaluation.length,
+                   evaluation.finished ? "; nothing is left to run" : "");
+        }
+    }
+
+    if (options.level >= 1 || native || interp) {
+        // Lower to SSA, optimize, and generate C, machine code or bytecode from the IR
+        phase_start = now_ms();
+        IrProgram ir = ir_lower(&program, &arena);
+        report_phase(time_phases, "lower", phase_start);
+        report_allocations(alloc_stats, "lower", &arena, &snapshot);
+
+        phase_start = now_ms();
+        optimize_program(&ir, &options);
+        report_phase(time_phases, "optimize", phase_start);
+        report_allocations(alloc_stats, "optimize", &arena, &snapshot);
+        if (dump_ir) {
+            ir_dump(&ir, stdout);
+        }
+
+        phase_start = now_ms();
+        if (interp) {
+            bytecode = bytecode_compile(&ir, evaluation.text, evaluation.length);
+        } else if (native) {
+            code = x86_generate(&ir, evaluation.text, evaluation.length);
+            if (!run) {
+                const bool written = object_write_elf(c_file, &code);
+                x86_free(&code);
+                if (!written) {
+                    fprintf(stderr, "Error: Could not write object file %s\n", c_file);
+                    exit(EXIT_FAILURE);
+                }
+            }
+        } else {
+            codegen_generate_ir(&ir);
+        }
+        report_phase(time_phases, "codegen", phase_start);
+    } else {
+        // Generate C code
+        phase_start = now_ms();
+        codegen_generate(program);
+        report_phase(time_phases, "codegen", phase_start);
+    }
+
+    if (alloc_stats) {
+        printf("%-10s %12zu allocations %14zu bytes (%zu reserved)\n", "total",
+               arena.allocations, arena.bytes, arena.reserved);
+    }
 
     // Cleanup compiler components
-    semantic_cleanup();  // Add this line
+    evaluate_cleanup(&evaluation);
+    semantic_cleanup();
     codegen_cleanup();
-    program_free(&program);
     parser_cleanup();
-    fclose(source);
+    intern_cleanup();
+    arena_release(&arena);
+    lexer_cleanup();
+
+    if (interp) {
+        const int status = vm_run(&bytecode);
+        bytecode_free(&bytecode);
+        return status;
+    }
+
+    if (run) {
+        JitProgram jitted;
+        const bool loaded = jit_load(&code, &jitted);
+        x86_free(&code);
+        if (!loaded) {
+            fprintf(stderr, "Error: Could not map executable memory. Aborting.\n");
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stderr, "Compiled in %.0f us\n", (now_ms() - compile_start) * 1000.0);
+        const int status = jit_run(&jitted);
+        jit_free(&jitted);
+        return status;
+    }
 
-    // Compile the generated C code
+    // Compile the generated C code, or only link the object file
     char command[256];
     sprintf(command, "gcc %s -o %s", c_file, exe_file);
+    phase_start = now_ms();
     const int ret = system(command);
+    report_phase(time_phases, native ? "link" : "gcc", phase_start);
 
     if (ret != 0) {
-        fprintf(stderr, "Error: C compilation failed. Aborting.\n");
-        // Keep a.c for debugging
+        fprintf(stderr, native ? "Error: Linking failed. Aborting.\n" : "Error: C compilation failed. Aborting.\n");
+        // Keep a.c or a.o for debugging
         exit(EXIT_FAILURE);
     }
 
-    // Clean up intermediate C file
+    // Clean up intermediate file
     remove(c_file);
 
     printf("Compilation completed successfully. Executable created: %s\n", exe_file);
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "object.h"
+
+// The ELF64 structures, spelled out so the compiler builds where the system
+// has no <elf.h>
+
+typedef struct {
+    uint8_t ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint64_t entry;
+    uint64_t program_offset;
+    uint64_t section_offset;
+    uint32_t flags;
+    uint16_t header_size;
+    uint16_t program_entry_size;
+    uint16_t program_count;
+    uint16_t section_entry_size;
+    uint16_t section_count;
+    uint16_t names_section;
+} ElfHeader;
+
+typedef struct {
+    uint32_t name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t address;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t alignment;
+    uint64_t entry_size;
+} ElfSection;
+
+typedef struct {
+    uint32_t name;
+    uint8_t info;
+    uint8_t other;
+    uint16_t section;
+    uint64_t value;
+    uint64_t size;
+} ElfSymbol;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t info;
+    int64_t addend;
+} ElfRela;
+
+enum {
+    SECTION_NULL, SECTION_TEXT, SECTION_BSS, SECTION_RELA, SECTION_SYMTAB, SECTION_STRTAB, SECTION_SHSTRTAB,
+    SECTION_NOTE, SECTION_COUNT
+};
+
+// Symbols: the two section symbols are local, then main and the C library
+enum { SYMBOL_TEXT = 1, SYMBOL_BSS = 2, SYMBOL_MAIN = 3, SYMBOL_FIRST_EXTERN = 4 };
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+#define SHT_NOBITS 8
+#define SHF_WRITE 0x1
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_INFO_LINK 0x40
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_FUNC 2
+#define STT_SECTION 3
+#define R_X86_64_PC32 2
+#define R_X86_64_GOTPCREL 9
+
+// A string table under construction
+typedef struct {
+    char text[256];
+    uint32_t length;
+} Names;
+
+static uint32_t add_name(Names* names, const char* name) {
+    const uint32_t offset = names->length;
+    const size_t length = strlen(name) + 1;
+    memcpy(names->text + offset, name, length);
+    names->length += (uint32_t)length;
+    return offset;
+}
+
+static uint64_t aligned(const uint64_t offset, const uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool object_write_elf(const char* path, const X86Code* code) {
+    Names names = {.length = 1};
+    Names section_names = {.length = 1};
+
+    ElfSymbol symbols[SYMBOL_FIRST_EXTERN + X86_EXTERN_COUNT] = {0};
+    symbols[SYMBOL_TEXT] = (ElfSymbol){0, STB_LOCAL << 4 | STT_SECTION, 0, SECTION_TEXT, 0, 0};
+    symbols[SYMBOL_BSS] = (ElfSymbol){0, STB_LOCAL << 4 | STT_SECTION, 0, SECTION_BSS, 0, 0};
+    symbols[SYMBOL_MAIN] = (ElfSymbol){add_name(&names, "main"), STB_GLOBAL << 4 | STT_FUNC, 0, SECTION_TEXT, 0,
+                                       code->main_size};
+    for (int i = 0; i < X86_EXTERN_COUNT; i++) {
+        symbols[SYMBOL_FIRST_EXTERN + i] = (ElfSymbol){add_name(&names, x86_extern_name(i)),
+                                                      STB_GLOBAL << 4 | STT_NOTYPE, 0, 0, 0, 0};
+    }
+
+    ElfRela* relocations = malloc(sizeof(ElfRela) * (size_t)(code->reloc_count > 0 ? code->reloc_count : 1));
+    if (relocations == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    for (int i = 0; i < code->reloc_count; i++) {
+        const X86Reloc* reloc = &code->relocs[i];
+        if (reloc->kind == X86_RELOC_BSS) {
+            relocations[i] = (ElfRela){reloc->offset, (uint64_t)SYMBOL_BSS << 32 | R_X86_64_PC32, reloc->addend - 4};
+        } else {
+            relocations[i] = (ElfRela){reloc->offset,
+                                       (uint64_t)(SYMBOL_FIRST_EXTERN + reloc->symbol) << 32 | R_X86_64_GOTPCREL, -4};
+        }
+    }
+
+    // Layout: header, code, relocations, symbols, names, section headers
+    const uint64_t text_offset = sizeof(ElfHeader);
+    const uint64_t rela_offset = aligned(text_offset + code->length, 8);
+    const uint64_t rela_size = sizeof(ElfRela) * (uint64_t)code->reloc_count;
+    const uint64_t symtab_offset = rela_offset + rela_size;
+    const uint64_t strtab_offset = symtab_offset + sizeof(symbols);
+
+    ElfSection sections[SECTION_COUNT] = {0};
+    sections[SECTION_TEXT] = (ElfSection){add_name(&section_names, ".text"), SHT_PROGBITS,
+                                          SHF_ALLOC | SHF_EXECINSTR, 0, text_offset, code->length, 0, 0, 16, 0};
+    sections[SECTION_BSS] = (ElfSection){add_name(&section_names, ".bss"), SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 0,
+                                         text_offset + code->length, code->bss_size, 0, 0, 16, 0};
+    sections[SECTION_RELA] = (ElfSection){add_name(&section_names, ".rela.text"), SHT_RELA, SHF_INFO_LINK, 0,
+                                          rela_offset, rela_size, SECTION_SYMTAB, SECTION_TEXT, 8, sizeof(ElfRela)};
+    sections[SECTION_SYMTAB] = (ElfSection){add_name(&section_names, ".symtab"), SHT_SYMTAB, 0, 0, symtab_offset,
+                                            sizeof(symbols), SECTION_STRTAB, SYMBOL_MAIN, 8, sizeof(ElfSymbol)};
+    sections[SECTION_STRTAB] = (ElfSection){add_name(&section_names, ".strtab"), SHT_STRTAB, 0, 0, strtab_offset,
+                                            names.length, 0, 0, 1, 0};
+    // An empty .note.GNU-stack keeps the stack from being made executable
+    const uint32_t note_name = add_name(&section_names, ".note.GNU-stack");
+    sections[SECTION_SHSTRTAB] = (ElfSection){add_name(&section_names, ".shstrtab"), SHT_STRTAB, 0, 0,
+                                              strtab_offset + names.length, 0, 0, 0, 1, 0};
+    sections[SECTION_SHSTRTAB].size = section_names.length;
+    const uint64_t note_offset = strtab_offset + names.length + section_names.length;
+    sections[SECTION_NOTE] = (ElfSection){note_name, SHT_PROGBITS, 0, 0, note_offset, 0, 0, 0, 1, 0};
+    const uint64_t section_offset = aligned(note_offset, 8);
+
+    ElfHeader header = {
+        .ident = {0x7F, 'E', 'L', 'F', 2, 1, 1},   // 64-bit, little endian, version 1
+        .type = 1,                                  // Relocatable
+        .machine = 62,                              // x86-64
+        .version = 1,
+        .section_offset = section_offset,
+        .header_size = sizeof(ElfHeader),
+        .section_entry_size = sizeof(ElfSection),
+        .section_count = SECTION_COUNT,
+        .names_section = SECTION_SHSTRTAB,
+    };
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        free(relocations);
+        return false;
+    }
+    static const uint8_t padding[8] = {0};
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(code->code, 1, code->length, file);
+    fwrite(padding, 1, rela_offset - (text_offset + code->length), file);
+    fwrite(relocations, sizeof(ElfRela), (size_t)code->reloc_count, file);
+    fwrite(symbols, sizeof(symbols), 1, file);
+    fwrite(names.text, 1, names.length, file);
+    fwrite(section_names.text, 1, section_names.length, file);
+    fwrite(padding, 1, section_offset - note_offset, file);
+    fwrite(sections, sizeof(sections), 1, file);
+    free(relocations);
+    return fclose(file) == 0;
+}
@@ -0,0 +1,895 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "optimize.h"
+#include "cfg.h"
+#include "induction.h"
+#include "loops.h"
+
+static IrProgram* ir;
+static bool changed;
+
+static int64_t int_of(const int value) {
+    return ir->insts[value].value.integer;
+}
+
+static double real_of(const int value) {
+    return ir->insts[value].value.real;
+}
+
+static bool is_int_const(const int value, const int64_t expected) {
+    return ir_is_const(ir, value) && ir->insts[value].type == TYPE_INT && int_of(value) == expected;
+}
+
+// Turn an instruction into a constant in place
+static void set_int(const int id, const int64_t value) {
+    IrInst* inst = &ir->insts[id];
+    inst->op = IR_CONST;
+    inst->type = TYPE_INT;
+    inst->args[0] = inst->args[1] = -1;
+    inst->value.integer = value;
+    changed = true;
+}
+
+static void set_real(const int id, const double value) {
+    IrInst* inst = &ir->insts[id];
+    inst->op = IR_CONST;
+    inst->args[0] = inst->args[1] = -1;
+    inst->value.real = value;
+    changed = true;
+}
+
+static void replace(const int id, const int value) {
+    ir_replace(ir, id, value);
+    ir_remove(ir, id);
+    changed = true;
+}
+
+// Evaluate a comparison of two constants of the same type
+static bool compare(const IrOp op, const int a, const int b) {
+    if (ir->insts[a].type == TYPE_INT) {
+        const int64_t x = int_of(a);
+        const int64_t y = int_of(b);
+        switch (op) {
+            case IR_EQ: return x == y;
+            case IR_NE: return x != y;
+            case IR_LT: return x < y;
+            case IR_GT: return x > y;
+            case IR_LE: return x <= y;
+            default: return x >= y;
+        }
+    }
+    const double x = real_of(a);
+    const double y = real_of(b);
+    switch (op) {
+        case IR_EQ: return x == y;
+        case IR_NE: return x != y;
+        case IR_LT: return x < y;
+        case IR_GT: return x > y;
+        case IR_LE: return x <= y;
+        default: return x >= y;
+    }
+}
+
+// Fold an operation on constants, following C semantics; operations C leaves
+// undefined (division by zero, oversized shifts, out-of-range conversions) are
+// left for run time
+static void fold_constant(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int a = inst->args[0];
+    const int b = inst->args[1];
+    const bool is_int = inst->type == TYPE_INT;
+
+    switch (inst->op) {
+        case IR_NEG:
+            if (is_int && int_of(a) != INT64_MIN) set_int(id, -int_of(a));
+            else if (!is_int) set_real(id, -real_of(a));
+            return;
+        case IR_NOT:
+            set_int(id, ir->insts[a].type == TYPE_INT ? int_of(a) == 0 : real_of(a) == 0.0);
+            return;
+        case IR_BITNOT:
+            set_int(id, ~int_of(a));
+            return;
+        case IR_TO_DOUBLE:
+            set_real(id, (double)int_of(a));
+            return;
+        case IR_TO_INT:
+            if (real_of(a) >= -9223372036854775808.0 && real_of(a) < 9223372036854775808.0) {
+                set_int(id, (int64_t)real_of(a));
+            }
+            return;
+        case IR_ADD:
+            if (is_int) set_int(id, (int64_t)((uint64_t)int_of(a) + (uint64_t)int_of(b)));
+            else set_real(id, real_of(a) + real_of(b));
+            return;
+        case IR_SUB:
+            if (is_int) set_int(id, (int64_t)((uint64_t)int_of(a) - (uint64_t)int_of(b)));
+            else set_real(id, real_of(a) - real_of(b));
+            return;
+        case IR_MUL:
+            if (is_int) set_int(id, (int64_t)((uint64_t)int_of(a) * (uint64_t)int_of(b)));
+            else set_real(id, real_of(a) * real_of(b));
+            return;
+        case IR_DIV:
+            set_real(id, real_of(a) / real_of(b));
+            return;
+        case IR_MOD:
+            if (int_of(b) != 0 && !(int_of(a) == INT64_MIN && int_of(b) == -1)) set_int(id, int_of(a) % int_of(b));
+            return;
+        case IR_AND:
+            set_int(id, int_of(a) & int_of(b));
+            return;
+        case IR_OR:
+            set_int(id, int_of(a) | int_of(b));
+            return;
+        case IR_XOR:
+            set_int(id, int_of(a) ^ int_of(b));
+            return;
+        case IR_SHL:
+            set_int(id, (int64_t)((uint64_t)int_of(a) << (int_of(b) & 63)));
+            return;
+        case IR_SHR:
+            set_int(id, int_of(a) >> (int_of(b) & 63));
+            return;
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_GT:
+        case IR_LE:
+        case IR_GE:
+            set_int(id, compare(inst->op, a, b));
+            return;
+        default:
+            return;
+    }
+}
+
+// Split an integer value into base + offset when it adds or subtracts a constant
+static bool constant_offset(const int value, int* base, int64_t* offset) {
+    const IrInst* inst = &ir->insts[value];
+    if (inst->type != TYPE_INT || (inst->op != IR_ADD && inst->op != IR_SUB)) return false;
+    const int a = ir_resolve(ir, inst->args[0]);
+    const int b = ir_resolve(ir, inst->args[1]);
+    if (ir_is_const(ir, b) && (inst->op == IR_ADD || int_of(b) != INT64_MIN)) {
+        *base = a;
+        *offset = inst->op == IR_ADD ? int_of(b) : -int_of(b);
+        return true;
+    }
+    if (ir_is_const(ir, a) && inst->op == IR_ADD) {
+        *base = b;
+        *offset = int_of(a);
+        return true;
+    }
+    return false;
+}
+
+// (x + c) + d becomes x + (c + d), so the copies of an unrolled counter each
+// step from the counter itself
+static void reassociate(const int id) {
+    int base, inner_base;
+    int64_t offset, inner;
+    if (!constant_offset(id, &base, &offset) || !constant_offset(base, &inner_base, &inner)) return;
+    if ((inner > 0 && offset > INT64_MAX - inner) || (inner < 0 && offset < INT64_MIN - inner)) return;
+    const int64_t total = offset + inner;
+    if (total == 0) {
+        replace(id, inner_base);
+        return;
+    }
+
+    const int constant = ir_insert_before(ir, id, IR_CONST, TYPE_INT, -1, -1);
+    ir->insts[constant].value.integer = total > 0 || total == INT64_MIN ? total : -total;
+    ir->insts[constant].line = ir->insts[id].line;
+    IrInst* inst = &ir->insts[id];
+    inst->op = total > 0 || total == INT64_MIN ? IR_ADD : IR_SUB;
+    inst->args[0] = inner_base;
+    inst->args[1] = constant;
+    changed = true;
+}
+
+// Integer identities with one constant operand
+static void simplify(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    if (inst->type != TYPE_INT || inst->args[1] < 0) return;
+    const int a = inst->args[0];
+    const int b = inst->args[1];
+
+    switch (inst->op) {
+        case IR_ADD:
+            if (is_int_const(b, 0)) replace(id, a);
+            else if (is_int_const(a, 0)) replace(id, b);
+            else reassociate(id);
+            return;
+        case IR_OR:
+        case IR_XOR:
+            if (is_int_const(b, 0)) replace(id, a);
+            else if (is_int_const(a, 0)) replace(id, b);
+            return;
+        case IR_SUB:
+            if (is_int_const(b, 0)) replace(id, a);
+            else if (a == b) set_int(id, 0);
+            else reassociate(id);
+            return;
+        case IR_SHL:
+        case IR_SHR:
+            if (is_int_const(b, 0)) replace(id, a);
+            return;
+        case IR_MUL:
+            if (is_int_const(b, 1)) replace(id, a);
+            else if (is_int_const(a, 1)) replace(id, b);
+            else if (is_int_const(a, 0) || is_int_const(b, 0)) set_int(id, 0);
+            return;
+        case IR_AND:
+            if (is_int_const(a, 0) || is_int_const(b, 0)) set_int(id, 0);
+            return;
+        default:
+            return;
+    }
+}
+
+static bool same_constant(const int a, const int b) {
+    return ir_is_const(ir, a) && ir_is_const(ir, b) && ir->insts[a].type == ir->insts[b].type &&
+           memcmp(&ir->insts[a].value, &ir->insts[b].value, sizeof(ir->insts[a].value)) == 0;
+}
+
+// A phi whose arguments are all one value (or the phi itself) is that value
+static void simplify_phi(const int id) {
+    const IrInst* phi = &ir->insts[id];
+    int same = -1;
+    for (int i = 0; i < phi->phi_count; i++) {
+        const int arg = phi->phi_args[i];
+        if (arg == id || arg == same) continue;
+        if (same >= 0 && !same_constant(arg, same)) return;
+        if (same < 0) same = arg;
+    }
+    if (same >= 0) replace(id, same);
+}
+
+// Resolve the operands of every instruction and fold what is constant
+static void fold_constants() {
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        if (block->removed) continue;
+
+        for (int id = block->first, next; id >= 0; id = next) {
+            next = ir->insts[id].next;
+            IrInst* inst = &ir->insts[id];
+            if (inst->op == IR_PHI) {
+                for (int i = 0; i < inst->phi_count; i++) {
+                    inst->phi_args[i] = ir_resolve(ir, inst->phi_args[i]);
+                }
+                simplify_phi(id);
+                continue;
+            }
+
+            for (int i = 0; i < 2; i++) {
+                if (inst->args[i] >= 0) inst->args[i] = ir_resolve(ir, inst->args[i]);
+            }
+            if (inst->op == IR_CONST || ir_has_side_effect(inst->op) || inst->args[0] < 0) continue;
+            if (ir_is_const(ir, inst->args[0]) && (inst->args[1] < 0 || ir_is_const(ir, inst->args[1]))) {
+                fold_constant(id);
+            } else {
+                simplify(id);
+            }
+        }
+
+        if (block->cond >= 0) block->cond = ir_resolve(ir, block->cond);
+        if (block->term == TERM_BRANCH && ir_is_const(ir, block->cond)) {
+            const int c = block->cond;
+            const bool taken = ir->insts[c].type == TYPE_INT ? int_of(c) != 0 : real_of(c) != 0.0;
+            const int target = block->succ[taken ? 0 : 1];
+            ir_remove_edge(ir, b, block->succ[taken ? 1 : 0]);
+            block->term = TERM_JUMP;
+            block->succ[0] = target;
+            block->succ[1] = -1;
+            block->cond = -1;
+            changed = true;
+        }
+    }
+}
+
+static void remove_block(const int b) {
+    IrBlock* block = &ir->blocks[b];
+    for (int i = 0; i < ir_succ_count(block); i++) {
+        ir_remove_edge(ir, b, block->succ[i]);
+    }
+    while (block->first >= 0) {
+        ir_remove(ir, block->first);
+    }
+    block->removed = true;
+    block->term = TERM_NONE;
+    block->pred_count = 0;
+    changed = true;
+}
+
+// Drop every block that the entry cannot reach
+static void remove_unreachable_blocks() {
+    bool* reached = calloc((size_t)ir->block_count, sizeof(bool));
+    int* stack = malloc(sizeof(int) * (size_t)ir->block_count);
+    if (reached == NULL || stack == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+
+    int top = 0;
+    stack[top++] = 0;
+    reached[0] = true;
+    while (top > 0) {
+        const IrBlock* block = &ir->blocks[stack[--top]];
+        for (int i = 0; i < ir_succ_count(block); i++) {
+            const int succ = block->succ[i];
+            if (!reached[succ]) {
+                reached[succ] = true;
+                stack[top++] = succ;
+            }
+        }
+    }
+
+    for (int b = 0; b < ir->block_count; b++) {
+        if (!reached[b] && !ir->blocks[b].removed) remove_block(b);
+    }
+    free(reached);
+    free(stack);
+}
+
+static bool has_phis(const IrBlock* block) {
+    return block->first >= 0 && ir->insts[block->first].op == IR_PHI;
+}
+
+static void replace_pred(const int block, const int old_pred, const int new_pred) {
+    IrBlock* target = &ir->blocks[block];
+    for (int i = 0; i < target->pred_count; i++) {
+        if (target->preds[i] == old_pred) {
+            target->preds[i] = new_pred;
+            return;
+        }
+    }
+}
+
+// Merge a block into its only predecessor when that predecessor only jumps to it
+static bool merge_into_pred(const int b) {
+    IrBlock* block = &ir->blocks[b];
+    if (b == 0 || block->pred_count != 1) return false;
+    const int p = block->preds[0];
+    IrBlock* pred = &ir->blocks[p];
+    if (p == b || pred->term != TERM_JUMP) return false;
+
+    while (has_phis(block)) {
+        replace(block->first, ir->insts[block->first].phi_args[0]);
+    }
+    for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+        ir->insts[id].block = p;
+    }
+    if (block->first >= 0) {
+        if (pred->last >= 0) {
+            ir->insts[pred->last].next = block->first;
+            ir->insts[block->first].prev = pred->last;
+        } else {
+            pred->first = block->first;
+        }
+        pred->last = block->last;
+    }
+
+    pred->term = block->term;
+    pred->cond = block->cond;
+    pred->succ[0] = block->succ[0];
+    pred->succ[1] = block->succ[1];
+    for (int i = 0; i < ir_succ_count(pred); i++) {
+        replace_pred(pred->succ[i], b, p);
+    }
+
+    block->first = block->last = -1;
+    block->term = TERM_NONE;
+    block->pred_count = 0;
+    block->removed = true;
+    return true;
+}
+
+// Send the predecessors of an empty block straight to its target
+static bool bypass_empty_block(const int b) {
+    IrBlock* block = &ir->blocks[b];
+    if (b == 0 || block->first >= 0 || block->term != TERM_JUMP) return false;
+    const int target = block->succ[0];
+    if (target == b || has_phis(&ir->blocks[target])) return false;
+
+    while (block->pred_count > 0) {
+        const int p = block->preds[0];
+        IrBlock* pred = &ir->blocks[p];
+        for (int i = 0; i < ir_succ_count(pred); i++) {
+            if (pred->succ[i] == b) pred->succ[i] = target;
+        }
+        ir_remove_edge(ir, p, b);
+        ir_add_pred(ir, target, p);
+    }
+    remove_block(b);
+    return true;
+}
+
+// A branch to the same block either way is a jump
+static bool simplify_branch(const int b) {
+    IrBlock* block = &ir->blocks[b];
+    if (block->term != TERM_BRANCH || block->succ[0] != block->succ[1] || has_phis(&ir->blocks[block->succ[0]])) {
+        return false;
+    }
+    ir_remove_edge(ir, b, block->succ[1]);
+    block->term = TERM_JUMP;
+    block->succ[1] = -1;
+    block->cond = -1;
+    return true;
+}
+
+static void simplify_cfg() {
+    for (int b = 0; b < ir->block_count; b++) {
+        if (ir->blocks[b].removed) continue;
+        if (simplify_branch(b) || merge_into_pred(b) || bypass_empty_block(b)) changed = true;
+    }
+}
+
+static void mark_live(const int value, bool* live, int* worklist, int* count) {
+    if (value >= 0 && !live[value]) {
+        live[value] = true;
+        worklist[(*count)++] = value;
+    }
+}
+
+// Remove instructions whose values never reach a side effect or a terminator
+static void remove_dead_code() {
+    bool* live = calloc((size_t)ir->inst_count, sizeof(bool));
+    int* worklist = malloc(sizeof(int) * (size_t)ir->inst_count);
+    if (live == NULL || worklist == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+
+    int count = 0;
+    for (int b = 0; b < ir->block_count; b++) {
+        const IrBlock* block = &ir->blocks[b];
+        if (block->removed) continue;
+        mark_live(block->cond, live, worklist, &count);
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            if (ir_has_side_effect(ir->insts[id].op)) mark_live(id, live, worklist, &count);
+        }
+    }
+
+    while (count > 0) {
+        const IrInst* inst = &ir->insts[worklist[--count]];
+        for (int i = 0; i < 2; i++) mark_live(inst->args[i], live, worklist, &count);
+        for (int i = 0; i < inst->phi_count; i++) mark_live(inst->phi_args[i], live, worklist, &count);
+    }
+
+    for (int b = 0; b < ir->block_count; b++) {
+        const IrBlock* block = &ir->blocks[b];
+        if (block->removed) continue;
+        for (int id = block->first, next; id >= 0; id = next) {
+            next = ir->insts[id].next;
+            if (!live[id]) ir_remove(ir, id);
+        }
+    }
+    free(live);
+    free(worklist);
+}
+
+// Point every operand at the value it resolves to, so no copies are left
+static void propagate_copies() {
+    for (int b = 0; b < ir->block_count; b++) {
+        IrBlock* block = &ir->blocks[b];
+        if (block->removed) continue;
+        if (block->cond >= 0) block->cond = ir_resolve(ir, block->cond);
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            IrInst* inst = &ir->insts[id];
+            for (int i = 0; i < 2; i++) {
+                if (inst->args[i] >= 0) inst->args[i] = ir_resolve(ir, inst->args[i]);
+            }
+            for (int i = 0; i < inst->phi_count; i++) {
+                inst->phi_args[i] = ir_resolve(ir, inst->phi_args[i]);
+            }
+        }
+    }
+}
+
+static bool is_invariant(const Cfg* cfg, const int loop, const int value) {
+    return value < 0 || ir_is_const(ir, value) || !cfg_in_loop(cfg, ir->insts[value].block, loop);
+}
+
+// Whether an instruction computes the same value on every iteration and may
+// run before the loop: it must be pure, and an instruction that can trap must
+// already run on entry, in the header before any side effect
+static bool can_hoist(const Cfg* cfg, const int loop, const int id) {
+    const IrInst* inst = &ir->insts[id];
+    if (inst->op == IR_PHI || inst->op == IR_COPY || ir_has_side_effect(inst->op)) return false;
+    if (!is_invariant(cfg, loop, inst->args[0]) || !is_invariant(cfg, loop, inst->args[1])) return false;
+    if (!ir_may_trap(ir, inst)) return true;
+
+    if (inst->block != cfg->loops[loop].header) return false;
+    for (int prev = inst->prev; prev >= 0; prev = ir->insts[prev].prev) {
+        if (ir_has_side_effect(ir->insts[prev].op)) return false;
+    }
+    return true;
+}
+
+typedef struct {
+    int inst;
+    int loop_line;
+} Hoisted;
+
+static int compare_hoisted(const void* a, const void* b) {
+    const Hoisted* x = a;
+    const Hoisted* y = b;
+    const int x_line = ir->insts[x->inst].line;
+    const int y_line = ir->insts[y->inst].line;
+    if (x_line != y_line) return x_line < y_line ? -1 : 1;
+    return x->inst < y->inst ? -1 : x->inst > y->inst;
+}
+
+// Loop-invariant code motion: move invariant values of each loop, innermost
+// loops first, to the loop's preheader, so that values hoisted out of an inner
+// loop can leave the enclosing loop too
+static void hoist_invariants(FILE* report) {
+    Cfg cfg = cfg_analyze(ir);
+    Hoisted* hoisted = nullptr;
+    int hoisted_count = 0;
+    int hoisted_capacity = 0;
+    // Entry of each reported instruction, so one that leaves several loops is
+    // listed once, with the outermost
+    int* entry = malloc(sizeof(int) * (size_t)ir->inst_count);
+    if (entry == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    for (int id = 0; id < ir->inst_count; id++) entry[id] = -1;
+
+    for (int loop = cfg.loop_count - 1; loop >= 0; loop--) {
+        const int header = cfg.loops[loop].header;
+        if (header == 0) continue;
+        int preheader = -1;
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            for (int i = 0; i < cfg.loops[loop].block_count; i++) {
+                for (int id = ir->blocks[cfg.loops[loop].blocks[i]].first, next; id >= 0; id = next) {
+                    next = ir->insts[id].next;
+                    if (!can_hoist(&cfg, loop, id)) continue;
+                    if (preheader < 0) preheader = cfg_preheader(ir, &cfg, loop);
+                    ir_move(ir, id, preheader);
+                    moved = true;
+                    if (report == nullptr || ir_is_const(ir, id)) continue;
+                    if (entry[id] >= 0) {
+                        hoisted[entry[id]].loop_line = ir->blocks[header].line;
+                        continue;
+                    }
+
+                    if (hoisted_count >= hoisted_capacity) {
+                        hoisted_capacity = hoisted_capacity ? hoisted_capacity * 2 : 16;
+                        hoisted = realloc(hoisted, sizeof(Hoisted) * (size_t)hoisted_capacity);
+                        if (hoisted == NULL) {
+                            fprintf(stderr, "Memory allocation error\n");
+                            exit(1);
+                        }
+                    }
+                    entry[id] = hoisted_count;
+                    hoisted[hoisted_count++] = (Hoisted){id, ir->blocks[header].line};
+                }
+            }
+        }
+    }
+
+    if (hoisted_count > 0) {
+        qsort(hoisted, (size_t)hoisted_count, sizeof(Hoisted), compare_hoisted);
+        for (int i = 0; i < hoisted_count; i++) {
+            fprintf(report, "line %d: hoisted ", ir->insts[hoisted[i].inst].line);
+            ir_dump_inst(ir, hoisted[i].inst, report);
+            fprintf(report, " out of the loop at line %d\n", hoisted[i].loop_line);
+        }
+    }
+    free(hoisted);
+    free(entry);
+    cfg_free(&cfg);
+}
+
+static bool is_commutative(const IrOp op) {
+    switch (op) {
+        case IR_ADD: case IR_MUL: case IR_AND: case IR_OR: case IR_XOR: case IR_EQ: case IR_NE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// First constant of each type and bit pattern, by constant
+static int* constant_number;
+
+// The operand a value is numbered by: constants by their first equal constant
+static int operand_key(const int value) {
+    if (value < 0) return -1;
+    const int resolved = ir_resolve(ir, value);
+    return ir_is_const(ir, resolved) ? constant_number[resolved] : resolved;
+}
+
+// The operation and operands a value is numbered by: commutative operands in
+// order, and > and >= as < and <= with the operands swapped
+static void value_key(const IrInst* inst, IrOp* op, int* a, int* b) {
+    *op = inst->op;
+    *a = operand_key(inst->args[0]);
+    *b = operand_key(inst->args[1]);
+    bool swap = is_commutative(*op) && *a > *b;
+    if (*op == IR_GT || *op == IR_GE) {
+        *op = *op == IR_GT ? IR_LT : IR_LE;
+        swap = true;
+    }
+    if (swap) {
+        const int t = *a;
+        *a = *b;
+        *b = t;
+    }
+}
+
+static unsigned hash_key(const IrOp op, const VarType type, const int a, const int b) {
+    unsigned hash = (unsigned)op * 31u + (unsigned)type;
+    hash = hash * 2654435761u + (unsigned)a;
+    return hash * 2654435761u + (unsigned)b;
+}
+
+static bool is_numbered(const IrOp op) {
+    return op != IR_CONST && op != IR_PHI && op != IR_COPY && !ir_has_side_effect(op);
+}
+
+// Number constants by type and bit pattern, using the buckets as scratch
+static void number_constants(int* buckets, const int bucket_count) {
+    constant_number = malloc(sizeof(int) * (size_t)(ir->inst_count + 1));
+    if (constant_number == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    for (int id = 0; id < ir->inst_count; id++) {
+        const IrInst* inst = &ir->insts[id];
+        constant_number[id] = id;
+        if (inst->removed || inst->op != IR_CONST) continue;
+        uint64_t bits;
+        memcpy(&bits, &inst->value, sizeof(bits));
+        unsigned bucket = (unsigned)(bits ^ (bits >> 32)) * 2654435761u + (unsigned)inst->type;
+        bucket &= (unsigned)(bucket_count - 1);
+        while (buckets[bucket] >= 0) {
+            const IrInst* other = &ir->insts[buckets[bucket]];
+            if (other->type == inst->type && memcmp(&other->value, &inst->value, sizeof(bits)) == 0) {
+                constant_number[id] = buckets[bucket];
+                break;
+            }
+            bucket = (bucket + 1) & (unsigned)(bucket_count - 1);
+        }
+        if (buckets[bucket] < 0) buckets[bucket] = id;
+    }
+    for (int i = 0; i < bucket_count; i++) buckets[i] = -1;
+}
+
+// Global value numbering over the dominator tree: a pure value computed again
+// where an equal one dominates it becomes a copy of that one. Values are
+// numbered in a hash table scoped to the dominator subtree being walked, so
+// only dominating values are found. SSA gives every assignment and `in` a new
+// value, so nothing has to be invalidated.
+static void number_values(FILE* report) {
+    Cfg cfg = cfg_analyze(ir);
+    const int block_count = ir->block_count;
+    int bucket_count = 64;
+    while (bucket_count < ir->inst_count * 2) bucket_count *= 2;
+    int* buckets = malloc(sizeof(int) * (size_t)bucket_count);
+    int* entry_next = malloc(sizeof(int) * (size_t)(ir->inst_count + 1));
+    int* entry_value = malloc(sizeof(int) * (size_t)(ir->inst_count + 1));
+    int* entry_bucket = malloc(sizeof(int) * (size_t)(ir->inst_count + 1));
+    int* first_child = malloc(sizeof(int) * (size_t)block_count);
+    int* next_sibling = malloc(sizeof(int) * (size_t)block_count);
+    int* mark = malloc(sizeof(int) * (size_t)block_count);
+    int* stack = malloc(sizeof(int) * (size_t)(block_count * 2 + 1));
+    if (buckets == NULL || entry_next == NULL || entry_value == NULL || entry_bucket == NULL || first_child == NULL ||
+        next_sibling == NULL || mark == NULL || stack == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    for (int i = 0; i < bucket_count; i++) buckets[i] = -1;
+    for (int b = 0; b < block_count; b++) first_child[b] = -1;
+    number_constants(buckets, bucket_count);
+    // Children in reverse so that they come off the stack in reverse postorder
+    for (int i = cfg.order_count - 1; i > 0; i--) {
+        const int b = cfg.order[i];
+        next_sibling[b] = first_child[cfg.idom[b]];
+        first_child[cfg.idom[b]] = b;
+    }
+
+    int entry_count = 0;
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const int item = stack[--top];
+        if (item < 0) {
+            // Leaving a subtree: forget its values, latest first
+            while (entry_count > mark[~item]) {
+                entry_count--;
+                buckets[entry_bucket[entry_count]] = entry_next[entry_count];
+            }
+            continue;
+        }
+
+        mark[item] = entry_count;
+        for (int id = ir->blocks[item].first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            if (!is_numbered(inst->op)) continue;
+            IrOp op;
+            int a, b;
+            value_key(inst, &op, &a, &b);
+            const unsigned bucket = hash_key(op, inst->type, a, b) & (unsigned)(bucket_count - 1);
+
+            int found = -1;
+            for (int e = buckets[bucket]; e >= 0 && found < 0; e = entry_next[e]) {
+                const IrInst* other = &ir->insts[entry_value[e]];
+                IrOp other_op;
+                int other_a, other_b;
+                value_key(other, &other_op, &other_a, &other_b);
+                if (other_op == op && other->type == inst->type && other_a == a && other_b == b) {
+                    found = entry_value[e];
+                }
+            }
+            if (found >= 0) {
+                if (report != nullptr) {
+                    fprintf(report, "line %d: reused v%d for ", inst->line, found);
+                    ir_dump_inst(ir, id, report);
+                    fprintf(report, "\n");
+                }
+                ir_replace(ir, id, found);
+                changed = true;
+                continue;
+            }
+            entry_value[entry_count] = id;
+            entry_bucket[entry_count] = (int)bucket;
+            entry_next[entry_count] = buckets[bucket];
+            buckets[bucket] = entry_count++;
+        }
+
+        stack[top++] = ~item;
+        for (int child = first_child[item]; child >= 0; child = next_sibling[child]) {
+            stack[top++] = child;
+        }
+    }
+
+    free(buckets);
+    free(entry_next);
+    free(entry_value);
+    free(entry_bucket);
+    free(first_child);
+    free(next_sibling);
+    free(mark);
+    free(stack);
+    free(constant_number);
+    constant_number = nullptr;
+    cfg_free(&cfg);
+}
+
+static void simplify_program(FILE* report) {
+    do {
+        changed = false;
+        fold_constants();
+        remove_unreachable_blocks();
+        simplify_cfg();
+        number_values(report);
+    } while (changed);
+
+    propagate_copies();
+    remove_dead_code();
+}
+
+// ---------------------------------------------------------------------------
+// String moves
+
+// Walking backwards, turn the string slots live after an instruction into
+// those live before it; index numbers the string slots densely
+static void string_transfer(const IrInst* inst, const int* index, uint64_t* live) {
+    const int set = inst->slot >= 0 ? index[inst->slot] : -1;
+    const int read = inst->source >= 0 ? index[inst->source] : -1;
+    const int other = inst->other >= 0 ? index[inst->other] : -1;
+    if (set >= 0 && (inst->op == IR_SET_STRING || inst->op == IR_MOVE_STRING)) {
+        live[set / 64] &= ~(UINT64_C(1) << set % 64);
+    }
+    // Appending reads the slot, and failed input leaves it as it was
+    if (set >= 0 && (inst->op == IR_APPEND_STRING || inst->op == IR_IN_STRING)) {
+        live[set / 64] |= UINT64_C(1) << set % 64;
+    }
+    if (read >= 0) live[read / 64] |= UINT64_C(1) << read % 64;
+    if (other >= 0) live[other / 64] |= UINT64_C(1) << other % 64;
+}
+
+// Turn a copy from a string that is set again before any read into a move,
+// which hands its buffer over instead of copying the text. Strings that the
+// builtins slice keep their buffers, since a view may still point into one.
+static void move_last_uses() {
+    int* index = malloc(sizeof(int) * (size_t)(ir->symbol_count > 0 ? ir->symbol_count : 1));
+    if (index == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    int strings = 0;
+    for (int slot = 0; slot < ir->symbol_count; slot++) {
+        index[slot] = ir->symbols[slot].type == TYPE_STRING ? strings++ : -1;
+    }
+    if (strings == 0) {
+        free(index);
+        return;
+    }
+    for (int id = 0; id < ir->inst_count; id++) {
+        const IrInst* inst = &ir->insts[id];
+        if ((inst->op == IR_SLICE_STRING || inst->op == IR_SPLIT_STRING) && inst->source >= 0 &&
+            index[inst->source] >= 0) {
+            index[inst->source] = -2;
+        }
+    }
+
+    const int words = (strings + 63) / 64;
+    uint64_t* live_in = calloc((size_t)ir->block_count * (size_t)words, sizeof(uint64_t));
+    uint64_t* live = malloc(sizeof(uint64_t) * (size_t)words);
+    if (live_in == NULL || live == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+
+    bool grew;
+    do {
+        grew = false;
+        for (int b = ir->block_count - 1; b >= 0; b--) {
+            const IrBlock* block = &ir->blocks[b];
+            if (block->removed) continue;
+            memset(live, 0, sizeof(uint64_t) * (size_t)words);
+            for (int i = 0; i < ir_succ_count(block); i++) {
+                const uint64_t* succ = &live_in[(size_t)block->succ[i] * (size_t)words];
+                for (int w = 0; w < words; w++) live[w] |= succ[w];
+            }
+            for (int id = block->last; id >= 0; id = ir->insts[id].prev) {
+                string_transfer(&ir->insts[id], index, live);
+            }
+            uint64_t* in = &live_in[(size_t)b * (size_t)words];
+            for (int w = 0; w < words; w++) {
+                if ((live[w] & ~in[w]) != 0) grew = true;
+                in[w] |= live[w];
+            }
+        }
+    } while (grew);
+
+    for (int b = 0; b < ir->block_count; b++) {
+        const IrBlock* block = &ir->blocks[b];
+        if (block->removed) continue;
+        memset(live, 0, sizeof(uint64_t) * (size_t)words);
+        for (int i = 0; i < ir_succ_count(block); i++) {
+            const uint64_t* succ = &live_in[(size_t)block->succ[i] * (size_t)words];
+            for (int w = 0; w < words; w++) live[w] |= succ[w];
+        }
+        for (int id = block->last; id >= 0; id = ir->insts[id].prev) {
+            IrInst* inst = &ir->insts[id];
+            if (inst->op == IR_SET_STRING && inst->source >= 0 && inst->source != inst->slot &&
+                index[inst->source] >= 0) {
+                const int read = index[inst->source];
+                if ((live[read / 64] >> read % 64 & 1) == 0) inst->op = IR_MOVE_STRING;
+            }
+            string_transfer(inst, index, live);
+        }
+    }
+
+    free(live);
+    free(live_in);
+    free(index);
+}
+
+void optimize_program(IrProgram* program, const OptimizeOptions* options) {
+    if (options->level < 1) return;
+    ir = program;
+
+    simplify_program(options->report);
+    if (options->level >= 2) {
+        hoist_invariants(options->report);
+        if (options->fuse_loops) loops_fuse(ir, options->report);
+        induction_reduce_strength(ir, options->report);
+        // Fold the new preheader arithmetic and drop the replaced multiplications
+        simplify_program(nullptr);
+        loops_unroll(ir, options->unroll_limit, options->report);
+        // Merge the copies into straight-line code and combine their counter steps
+        simplify_program(nullptr);
+        induction_mark_counted_loops(ir, options->report);
+    }
+    move_last_uses();
+    ir = nullptr;
+}
@@ -3,104 +3,241 @@
 #include <stdbool.h>
 #include "parser.h"
 
-static Token current_token;
+static const TokenStream* tokens;
+static int cursor;
+static Arena* arena;
 static bool is_in_loop = false;
 
-void parser_init() {
-    current_token = lexer_next_token();
+void parser_init(const TokenStream* stream, Arena* owner) {
+    tokens = stream;
+    cursor = 0;
+    arena = owner;
+}
+
+static Ttype current_type() {
+    return (Ttype)tokens->types[cursor];
+}
+
+static int current_line() {
+    return (int)tokens->lines[cursor];
+}
+
+static int current_column() {
+    return (int)tokens->columns[cursor];
 }
 
 static void eat(const Ttype type) {
-    if (current_token.type == type) {
-        token_free(&current_token);
-        current_token = lexer_next_token();
+    if (current_type() == type) {
+        // The stream ends with TOKEN_EOF, which is never consumed past
+        if (cursor < tokens->count - 1) cursor++;
     } else {
         fprintf(stderr, "Syntax error: Expected %s but got %s at line %d, column %d\n",
                 token_type_to_string(type),
-                token_type_to_string(current_token.type),
-                current_token.line,
-                current_token.column);
+                token_type_to_string(current_type()),
+                current_line(),
+                current_column());
         exit(EXIT_FAILURE);
     }
 }
-static Expression* parse_expression() {
-    Expression* expr = malloc(sizeof(Expression));
-    expr->token_types = malloc(32 * sizeof(Ttype));
-    expr->token_values = malloc(32 * sizeof(char*));
-    expr->len = 0;
-    int paren_count = 0;
-
-    // Handle empty expressions
-    if (current_token.type == TOKEN_SEMICOLON) {
-        return expr;
+static Expression* new_expression(const ExpressionKind kind, const int line) {
+    Expression* expr = arena_alloc(arena, sizeof(Expression));
+    expr->kind = kind;
+    expr->op = TOKEN_UNKNOWN;
+    expr->type = TYPE_DOUBLE;
+    expr->line = line;
+    return expr;
+}
+
+// Binding power of an infix operator, or -1 if the token does not continue an expression
+static int infix_precedence(const Ttype type) {
+    switch (type) {
+        case TOKEN_EQ:          return 1;
+        case TOKEN_OR:          return 2;
+        case TOKEN_AND:         return 3;
+        case TOKEN_BITWISE_OR:  return 4;
+        case TOKEN_XOR:         return 5;
+        case TOKEN_BITWISE_AND: return 6;
+        case TOKEN_EQEQ:
+        case TOKEN_NEQ:         return 7;
+        case TOKEN_LT:
+        case TOKEN_GT:
+        case TOKEN_LTE:
+        case TOKEN_GTE:         return 8;
+        case TOKEN_LSHIFT:
+        case TOKEN_RSHIFT:      return 9;
+        case TOKEN_PLUS:
+        case TOKEN_MINUS:       return 10;
+        case TOKEN_MUL:
+        case TOKEN_DIV:
+        case TOKEN_MOD:         return 11;
+        default:                return -1;
     }
+}
 
-    // Parse tokens until semicolon or unexpected token
-    while (current_token.type != TOKEN_SEMICOLON &&
-           current_token.type != TOKEN_EOF       &&
-           current_token.type != TOKEN_RBRACE    &&
-           current_token.type != TOKEN_COLON     &&
-           current_token.type != TOKEN_LBRACE) {
-
-        if (current_token.type == TOKEN_NUMBER ||
-            current_token.type == TOKEN_IDENT  ||
-            current_token.type == TOKEN_PLUS   ||
-            current_token.type == TOKEN_MINUS  ||
-            current_token.type == TOKEN_MUL    ||
-            current_token.type == TOKEN_DIV    ||
-            current_token.type == TOKEN_LPAREN ||
-            current_token.type == TOKEN_RPAREN ||
-            current_token.type == TOKEN_MOD    ||
-            current_token.type == TOKEN_EQ     ||
-            current_token.type == TOKEN_EQEQ   ||
-            current_token.type == TOKEN_NEQ    ||
-            current_token.type == TOKEN_LT     ||
-            current_token.type == TOKEN_GT     ||
-            current_token.type == TOKEN_LTE    ||
-            current_token.type == TOKEN_GTE    ||
-            current_token.type == TOKEN_AND    ||
-            current_token.type == TOKEN_OR     ||
-            current_token.type == TOKEN_NOT    ||
-            current_token.type == TOKEN_STRING ||
-            current_token.type == TOKEN_XOR    ||
-            current_token.type == TOKEN_BITWISE_OR ||
-            current_token.type == TOKEN_BITWISE_AND||
-            current_token.type == TOKEN_LSHIFT ||
-            current_token.type == TOKEN_RSHIFT ||
-            current_token.type == TOKEN_BITWISE_NOT) {
-
-            // Track parentheses balance
-                if (current_token.type == TOKEN_LPAREN) {
-                    paren_count++;
-                } else if (current_token.type == TOKEN_RPAREN) {
-                    paren_count--;
-                    if (paren_count < 0) {
-                        fprintf(stderr, "Syntax error: Unbalanced parentheses at line %d, column %d\n",
-                               current_token.line, current_token.column);
-                        exit(EXIT_FAILURE);
-                    }
-                }
-
-                // Store token information
-                expr->token_types[expr->len] = current_token.type;
-                expr->token_values[expr->len] = strdup(current_token.value);
-                expr->len++;
-
-                // Get next token
-                eat(current_token.type);
-            }
-        else break;
+// Number tokens are views into the source, which is not NUL-terminated
+static double number_value(const Lexeme text) {
+    char local[64];
+    char* buffer = text.length < (int)sizeof(local) ? local : arena_alloc(arena, (size_t)text.length + 1);
+    memcpy(buffer, text.text, (size_t)text.length);
+    buffer[text.length] = '\0';
+    return strtod(buffer, NULL);
+}
+
+static Expression* parse_binary(int min_precedence);
+
+// name(argument, ...); semantic analysis checks the name and the arguments
+static Expression* parse_call() {
+    Expression* expr = new_expression(EXPR_CALL, current_line());
+    expr->call.name = tokens->symbols[cursor];
+    eat(TOKEN_IDENT);
+    eat(TOKEN_LPAREN);
+    int capacity = 4;
+    expr->call.args = arena_alloc(arena, sizeof(Expression*) * capacity);
+    expr->call.count = 0;
+    while (current_type() != TOKEN_RPAREN) {
+        if (expr->call.count > 0) eat(TOKEN_COMMA);
+        if (expr->call.count == capacity) {
+            expr->call.args = arena_grow(arena, expr->call.args, sizeof(Expression*) * capacity,
+                                         sizeof(Expression*) * capacity * 2);
+            capacity *= 2;
+        }
+        expr->call.args[expr->call.count++] = parse_binary(0);
     }
+    eat(TOKEN_RPAREN);
+    return expr;
+}
 
-    // Check for balanced parentheses
-    if (paren_count != 0) {
-        fprintf(stderr, "Syntax error: Unbalanced parentheses\n");
-        exit(EXIT_FAILURE);
+// [element, ...]
+static Expression* parse_array() {
+    Expression* expr = new_expression(EXPR_ARRAY, current_line());
+    eat(TOKEN_LBRACKET);
+    int capacity = 4;
+    expr->array.elements = arena_alloc(arena, sizeof(Expression*) * capacity);
+    expr->array.count = 0;
+    while (current_type() != TOKEN_RBRACKET) {
+        if (expr->array.count > 0) eat(TOKEN_COMMA);
+        if (expr->array.count == capacity) {
+            expr->array.elements = arena_grow(arena, expr->array.elements, sizeof(Expression*) * capacity,
+                                              sizeof(Expression*) * capacity * 2);
+            capacity *= 2;
+        }
+        expr->array.elements[expr->array.count++] = parse_binary(0);
     }
+    eat(TOKEN_RBRACKET);
+    return expr;
+}
 
+// name[index]; only variables are indexed
+static Expression* parse_index() {
+    Expression* expr = new_expression(EXPR_INDEX, current_line());
+    expr->index.array = tokens->symbols[cursor];
+    eat(TOKEN_IDENT);
+    eat(TOKEN_LBRACKET);
+    expr->index.index = parse_binary(0);
+    expr->index.value = nullptr;
+    expr->index.in_bounds = false;
+    eat(TOKEN_RBRACKET);
     return expr;
 }
 
+static Expression* parse_unary() {
+    const int line = current_line();
+    Expression* expr;
+
+    switch (current_type()) {
+        case TOKEN_MINUS:
+        case TOKEN_NOT:
+        case TOKEN_BITWISE_NOT:
+            expr = new_expression(EXPR_UNARY, line);
+            expr->op = current_type();
+            eat(current_type());
+            expr->unary.operand = parse_unary();
+            return expr;
+        case TOKEN_NUMBER:
+            expr = new_expression(EXPR_NUMBER, line);
+            expr->number.text = token_stream_lexeme(tokens, cursor);
+            expr->number.value = number_value(expr->number.text);
+            eat(TOKEN_NUMBER);
+            return expr;
+        case TOKEN_STRING:
+            expr = new_expression(EXPR_STRING, line);
+            expr->type = TYPE_STRING;
+            expr->string = token_stream_lexeme(tokens, cursor);
+            eat(TOKEN_STRING);
+            return expr;
+        case TOKEN_IDENT:
+            if (tokens->types[cursor + 1] == TOKEN_LPAREN) return parse_call();
+            if (tokens->types[cursor + 1] == TOKEN_LBRACKET) return parse_index();
+            expr = new_expression(EXPR_IDENT, line);
+            expr->ident.symbol = tokens->symbols[cursor];
+            eat(TOKEN_IDENT);
+            return expr;
+        case TOKEN_LPAREN:
+            eat(TOKEN_LPAREN);
+            expr = parse_binary(0);
+            eat(TOKEN_RPAREN);
+            return expr;
+        case TOKEN_LBRACKET:
+            return parse_array();
+        case TOKEN_LBRACE:
+            // Maps start out empty and are filled with put
+            expr = new_expression(EXPR_MAP, line);
+            eat(TOKEN_LBRACE);
+            eat(TOKEN_RBRACE);
+            return expr;
+        default:
+            fprintf(stderr, "Syntax error: Expected expression but got %s at line %d, column %d\n",
+                    token_type_to_string(current_type()), current_line(), current_column());
+            exit(EXIT_FAILURE);
+    }
+}
+
+// Precedence climbing: operators bind at least as tightly as min_precedence
+static Expression* parse_binary(const int min_precedence) {
+    Expression* left = parse_unary();
+
+    for (;;) {
+        const Ttype op = current_type();
+        const int precedence = infix_precedence(op);
+        if (precedence < min_precedence) break;
+
+        const int line = current_line();
+        const int column = current_column();
+        eat(op);
+
+        if (op == TOKEN_EQ) {
+            // Assignment is right-associative and only targets variables and their elements
+            if (left->kind == EXPR_INDEX) {
+                left->kind = EXPR_STORE;
+                left->line = line;
+                left->index.value = parse_binary(precedence);
+                continue;
+            }
+            if (left->kind != EXPR_IDENT) {
+                fprintf(stderr, "Syntax error: Invalid assignment target at line %d, column %d\n", line, column);
+                exit(EXIT_FAILURE);
+            }
+            Expression* assign = new_expression(EXPR_ASSIGN, line);
+            assign->assign.target = left->ident.symbol;
+            assign->assign.value = parse_binary(precedence);
+            left = assign;
+            continue;
+        }
+
+        Expression* binary = new_expression(EXPR_BINARY, line);
+        binary->op = op;
+        binary->binary.left = left;
+        binary->binary.right = parse_binary(precedence + 1);
+        left = binary;
+    }
+
+    return left;
+}
+
+static Expression* parse_expression() {
+    return parse_binary(0);
+}
+
 static Statement parse_return_statement() {
     Statement stmt;
     stmt.type = STMT_RETURN;
@@ -112,11 +249,11 @@ static Statement parse_return_statement() {
     eat(TOKEN_RETURN);
 
 
-    if (current_token.type != TOKEN_SEMICOLON) {
+    if (current_type() != TOKEN_SEMICOLON) {
         // Forbid returning a string literal directly
-        if (current_token.type == TOKEN_STRING) {
+        if (current_type() == TOKEN_STRING) {
             fprintf(stderr, "Syntax error: Cannot return a string at line %d, column %d\n",
-                    current_token.line, current_token.column);
+                    current_line(), current_column());
             exit(EXIT_FAILURE);
         }
         stmt.ret_stmt.expr = parse_expression();
@@ -131,11 +268,11 @@ static Statement parse_let_statement() {
     stmt.type = STMT_LET;
     stmt.let_stmt.expr = NULL; // Default to no expression
     eat(TOKEN_LET);
-    stmt.let_stmt.ident = strdup(current_token.value);
+    stmt.let_stmt.ident = tokens->symbols[cursor];
     eat(TOKEN_IDENT);
 
     // If there is an equals sign, parse the expression
-    if (current_token.type == TOKEN_EQ) {
+    if (current_type() == TOKEN_EQ) {
         eat(TOKEN_EQ);
         stmt.let_stmt.expr = parse_expression();
     }
@@ -192,12 +329,14 @@ static Program parser_parse_block() {
     Program block;
     block.count = 0;
     block.capacity = 10;
-    block.statements = malloc(block.capacity * sizeof(Statement));
+    block.statements = arena_alloc(arena, block.capacity * sizeof(Statement));
+    block.symbols = nullptr;
+    block.symbol_count = 0;
 
-    while (current_token.type != TOKEN_RBRACE && current_token.type != TOKEN_EOF) {
+    while (current_type() != TOKEN_RBRACE && current_type() != TOKEN_EOF) {
         Statement stmt;
 
-        switch (current_token.type) {
+        switch (current_type()) {
             case TOKEN_RETURN:
                 stmt = parse_return_statement();
                 break;
@@ -229,21 +368,16 @@ static Program parser_parse_block() {
                 break;
             default:
                 fprintf(stderr, "Syntax error: Unexpected token %s in block at line %d, column %d\n",
-                                        token_type_to_string(current_token.type),
-                                        current_token.line,
-                                        current_token.column);
+                                        token_type_to_string(current_type()),
+                                        current_line(),
+                                        current_column());
                 exit(EXIT_FAILURE);
         }
 
         if (block.count >= block.capacity) {
+            block.statements = arena_grow(arena, block.statements, block.capacity * sizeof(Statement),
+                                          block.capacity * 2 * sizeof(Statement));
             block.capacity *= 2;
-            Statement* tmp = realloc(block.statements, block.capacity * sizeof(Statement));
-            if (tmp == NULL) {
-                free(block.statements);
-                fprintf(stderr, "Memory allocation error\n");
-                exit(EXIT_FAILURE);
-            }
-            block.statements = tmp;
         }
 
         block.statements[block.count++] = stmt;
@@ -265,7 +399,7 @@ static Statement parse_if_statement() {
     stmt.if_stmt.if_count = true_block.count;
     eat(TOKEN_RBRACE);
 
-    if (current_token.type == TOKEN_ELSE) {
+    if (current_type() == TOKEN_ELSE) {
         eat(TOKEN_ELSE);
         eat(TOKEN_LBRACE);
         const Program false_block = parser_parse_block();
@@ -301,7 +435,7 @@ static Statement parse_in_statement() {
     stmt.type = STMT_IN;
 
     eat(TOKEN_IN);
-    stmt.in_stmt.ident = strdup(current_token.value);
+    stmt.in_stmt.ident = tokens->symbols[cursor];
     eat(TOKEN_IDENT);
     eat(TOKEN_SEMICOLON);
 
@@ -320,12 +454,14 @@ Program parser_parse() {
     Program program;
     program.count = 0;
     program.capacity = 10;
-    program.statements = malloc(program.capacity * sizeof(Statement));
+    program.statements = arena_alloc(arena, program.capacity * sizeof(Statement));
+    program.symbols = nullptr;
+    program.symbol_count = 0;
 
-    while (current_token.type != TOKEN_EOF) {
+    while (current_type() != TOKEN_EOF) {
         Statement stmt;
 
-        switch (current_token.type) {
+        switch (current_type()) {
             case TOKEN_RETURN:
                 stmt = parse_return_statement();
                 break;
@@ -357,21 +493,16 @@ Program parser_parse() {
                 break;
             default:
                 fprintf(stderr, "Syntax error: Unexpected token %s at line %d, column %d\n",
-                        token_type_to_string(current_token.type),
-                        current_token.line,
-                        current_token.column);
+                        token_type_to_string(current_type()),
+                        current_line(),
+                        current_column());
                 exit(EXIT_FAILURE);
         }
 
         if (program.count >= program.capacity) {
+            program.statements = arena_grow(arena, program.statements, program.capacity * sizeof(Statement),
+                                            program.capacity * 2 * sizeof(Statement));
             program.capacity *= 2;
-            Statement* tmp = realloc(program.statements, program.capacity * sizeof(Statement));
-            if (tmp == NULL) {
-                free(program.statements);
-                fprintf(stderr, "Memory allocation error\n");
-                exit(EXIT_FAILURE);
-            }
-            program.statements = tmp;
         }
 
         program.statements[program.count++] = stmt;
@@ -380,183 +511,8 @@ Program parser_parse() {
     return program;
 }
 
-void program_free(Program* program) {
-    for (int i = 0; i < program->count; i++) {
-        switch (program->statements[i].type) {
-            case STMT_RETURN:
-                if (program->statements[i].ret_stmt.expr)
-                    expression_free(program->statements[i].ret_stmt.expr);
-                break;
-            case STMT_LET:
-                if (program->statements[i].let_stmt.ident)
-                    free(program->statements[i].let_stmt.ident);
-                if (program->statements[i].let_stmt.expr)
-                    expression_free(program->statements[i].let_stmt.expr);
-                break;
-            case STMT_IF:
-                if_statement_free(&program->statements[i].if_stmt);
-                break;
-            case STMT_OUT:
-                if (program->statements[i].out_stmt.expr)
-                    expression_free(program->statements[i].out_stmt.expr);
-                break;
-            case STMT_EXPR:
-                if (program->statements[i].expr_stmt.expr)
-                    expression_free(program->statements[i].expr_stmt.expr);
-                break;
-            case STMT_WHILE:
-                while_statement_free(&program->statements[i].while_stmt);
-                break;
-            default: ;
-        }
-    }
-
-    free(program->statements);
-    program->statements = nullptr;
-    program->count = 0;
-    program->capacity = 0;
-}
-
-void expression_free(Expression* expr) {
-    if (!expr) return;
-
-    if (expr->token_values) {
-        for (int i = 0; i < expr->len; i++) {
-            if (expr->token_values[i] != NULL) {
-                free(expr->token_values[i]);
-            }
-        }
-        free(expr->token_values);
-    }
-
-    if (expr->token_types) {
-        free(expr->token_types);
-    }
-
-    free(expr);
-}
-
-void if_statement_free(const IfStatement* if_stmt) {
-    if (if_stmt->condition) {
-        expression_free(if_stmt->condition);
-    }
-
-    // Free if block statements
-    for (int i = 0; i < if_stmt->if_count; i++) {
-        switch (if_stmt->if_block[i].type) {
-            case STMT_RETURN:
-                if (if_stmt->if_block[i].ret_stmt.expr)
-                    expression_free(if_stmt->if_block[i].ret_stmt.expr);
-                break;
-            case STMT_LET:
-                if (if_stmt->if_block[i].let_stmt.ident)
-                    free(if_stmt->if_block[i].let_stmt.ident);
-                if (if_stmt->if_block[i].let_stmt.expr)
-                    expression_free(if_stmt->if_block[i].let_stmt.expr);
-                break;
-            case STMT_IF:
-                if_statement_free(&if_stmt->if_block[i].if_stmt);
-                break;
-            case STMT_OUT:
-                if (if_stmt->if_block[i].out_stmt.expr)
-                    expression_free(if_stmt->if_block[i].out_stmt.expr);
-                break;
-            case STMT_IN:
-                if (if_stmt->if_block[i].in_stmt.ident)
-                    free(if_stmt->if_block[i].in_stmt.ident);
-                break;
-            case STMT_EXPR:
-                if (if_stmt->if_block[i].expr_stmt.expr)
-                    expression_free(if_stmt->if_block[i].expr_stmt.expr);
-                break;
-            case STMT_WHILE:
-                while_statement_free(&if_stmt->if_block[i].while_stmt);
-                break;
-
-            default: ;
-        }
-    }
-    free(if_stmt->if_block);
-
-    // Free else block statements - same changes as above
-    for (int i = 0; i < if_stmt->else_count; i++) {
-        switch (if_stmt->else_block[i].type) {
-            case STMT_RETURN:
-                if (if_stmt->else_block[i].ret_stmt.expr)
-                    expression_free(if_stmt->else_block[i].ret_stmt.expr);
-                break;
-            case STMT_LET:
-                if (if_stmt->else_block[i].let_stmt.ident)
-                    free(if_stmt->else_block[i].let_stmt.ident);
-                if (if_stmt->else_block[i].let_stmt.expr)
-                    expression_free(if_stmt->else_block[i].let_stmt.expr);
-                break;
-            case STMT_IF:
-                if_statement_free(&if_stmt->else_block[i].if_stmt);
-                break;
-            case STMT_OUT:
-                if (if_stmt->else_block[i].out_stmt.expr)
-                    expression_free(if_stmt->else_block[i].out_stmt.expr);
-                break;
-            case STMT_IN:
-                if (if_stmt->else_block[i].in_stmt.ident)
-                    free(if_stmt->else_block[i].in_stmt.ident);
-                break;
-            case STMT_EXPR:
-                if (if_stmt->else_block[i].expr_stmt.expr)
-                    expression_free(if_stmt->else_block[i].expr_stmt.expr);
-                break;
-            case STMT_WHILE:
-                while_statement_free(&if_stmt->else_block[i].while_stmt);
-                break;
-            default: ;
-        }
-    }
-    free(if_stmt->else_block);
-}
-void while_statement_free(const WhileStatement* while_stmt) {
-    if (while_stmt->condition) {
-        expression_free(while_stmt->condition);
-    }
-
-    // Free body statements
-    for (int i = 0; i < while_stmt->body_count; i++) {
-        switch (while_stmt->body[i].type) {
-            case STMT_RETURN:
-                if (while_stmt->body[i].ret_stmt.expr)
-                    expression_free(while_stmt->body[i].ret_stmt.expr);
-                break;
-            case STMT_LET:
-                if (while_stmt->body[i].let_stmt.ident)
-                    free(while_stmt->body[i].let_stmt.ident);
-                if (while_stmt->body[i].let_stmt.expr)
-                    expression_free(while_stmt->body[i].let_stmt.expr);
-                break;
-            case STMT_IF:
-                if_statement_free(&while_stmt->body[i].if_stmt);
-                break;
-            case STMT_OUT:
-                if (while_stmt->body[i].out_stmt.expr)
-                    expression_free(while_stmt->body[i].out_stmt.expr);
-                break;
-            case STMT_IN:
-                if (while_stmt->body[i].in_stmt.ident)
-                    free(while_stmt->body[i].in_stmt.ident);
-                break;
-            case STMT_EXPR:
-                if (while_stmt->body[i].expr_stmt.expr)
-                    expression_free(while_stmt->body[i].expr_stmt.expr);
-                break;
-            case STMT_WHILE:
-                while_statement_free(&while_stmt->body[i].while_stmt);
-                break;
-
-            default: ;
-        }
-    }
-    free(while_stmt->body);
-}
-
 void parser_cleanup() {
-    token_free(&current_token);
+    tokens = nullptr;
+    cursor = 0;
+    arena = nullptr;
 }
\ No newline at end of file
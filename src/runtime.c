@@ -0,0 +1,962 @@
+#include "runtime.h"
+
+// Kept as source text: the code generator copies it to the top of every C file
+const char runtime_source[] =
+    "// SILC runtime: output goes through one large buffer, written out when it\n"
+    "// fills, at exit, and after every out when stdout is a terminal. Input is\n"
+    "// read from stdin in large blocks, or mapped whole when it is a file.\n"
+    "#include <stdio.h>\n"
+    "#include <stdint.h>\n"
+    "#include <inttypes.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include <float.h>\n"
+    "#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))\n"
+    "#define SILC_SIMD 1\n"
+    "#include <immintrin.h>\n"
+    "#else\n"
+    "#define SILC_SIMD 0\n"
+    "#endif\n"
+    "// Programs use only some of the helpers\n"
+    "#if defined(__GNUC__)\n"
+    "#define SILC_UNUSED __attribute__((unused))\n"
+    "#else\n"
+    "#define SILC_UNUSED\n"
+    "#endif\n"
+    "#if defined(_WIN32)\n"
+    "#include <io.h>\n"
+    "#define silc_isatty(fd) _isatty(fd)\n"
+    "#define silc_read(fd, data, size) _read(fd, data, (unsigned)(size))\n"
+    "#else\n"
+    "#include <unistd.h>\n"
+    "#include <sys/mman.h>\n"
+    "#include <sys/stat.h>\n"
+    "#define silc_isatty(fd) isatty(fd)\n"
+    "#define silc_read(fd, data, size) read(fd, data, size)\n"
+    "#endif\n"
+    "\n"
+    "#define SILC_OUT_SIZE 65536\n"
+    "static char silc_out_buffer[SILC_OUT_SIZE];\n"
+    "static size_t silc_out_length;\n"
+    "static int silc_out_interactive;\n"
+    "\n"
+    "static SILC_UNUSED void silc_flush(void) {\n"
+    "    fwrite(silc_out_buffer, 1, silc_out_length, stdout);\n"
+    "    silc_out_length = 0;\n"
+    "    fflush(stdout);\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_out_init(void) {\n"
+    "    silc_out_interactive = silc_isatty(fileno(stdout));\n"
+    "    atexit(silc_flush);\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_out_text(const char* text, size_t length) {\n"
+    "    if (silc_out_length + length > SILC_OUT_SIZE) {\n"
+    "        silc_flush();\n"
+    "        if (length > SILC_OUT_SIZE) {\n"
+    "            fwrite(text, 1, length, stdout);\n"
+    "            return;\n"
+    "        }\n"
+    "    }\n"
+    "    memcpy(silc_out_buffer + silc_out_length, text, length);\n"
+    "    silc_out_length += length;\n"
+    "    if (silc_out_interactive) silc_flush();\n"
+    "}\n"
+    "\n"
+    "static const char silc_digit_pairs[] =\n"
+    "    \"00010203040506070809101112131415161718192021222324252627282930313233343536373839\"\n"
+    "    \"40414243444546474849505152535455565758596061626364656667686970717273747576777879\"\n"
+    "    \"8081828384858687888990919293949596979899\";\n"
+    "\n"
+    "// Write the decimal digits of value so that they end at end; return where they start\n"
+    "static SILC_UNUSED char* silc_digits(char* end, uint64_t value) {\n"
+    "    while (value >= 100) {\n"
+    "        end -= 2;\n"
+    "        memcpy(end, silc_digit_pairs + value % 100 * 2, 2);\n"
+    "        value /= 100;\n"
+    "    }\n"
+    "    if (value >= 10) {\n"
+    "        end -= 2;\n"
+    "        memcpy(end, silc_digit_pairs + value * 2, 2);\n"
+    "    } else {\n"
+    "        *--end = (char)('0' + value);\n"
+    "    }\n"
+    "    return end;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_out_int(int64_t value) {\n"
+    "    char text[24];\n"
+    "    char* end = text + sizeof(text) - 1;\n"
+    "    *end = '\\n';\n"
+    "    char* start = silc_digits(end, value < 0 ? 0 - (uint64_t)value : (uint64_t)value);\n"
+    "    if (value < 0) *--start = '-';\n"
+    "    silc_out_text(start, (size_t)(text + sizeof(text) - start));\n"
+    "}\n"
+    "\n"
+    "// The text of printf(\"%.0f\\n\") when floor(value) == ceil(value), else of\n"
+    "// printf(\"%f\\n\"). The six decimals are rounded from the exact binary value,\n"
+    "// half to even, as printf rounds them; values outside 64 bits, and fractions\n"
+    "// of 2^44 and above, infinities and NaN, go to printf itself.\n"
+    "static SILC_UNUSED void silc_out_double(double value) {\n"
+    "    uint64_t bits;\n"
+    "    memcpy(&bits, &value, sizeof(bits));\n"
+    "    const int exponent = (int)(bits >> 52 & 0x7FF);\n"
+    "    const uint64_t mantissa = (bits & 0xFFFFFFFFFFFFFull) | (uint64_t)(exponent != 0) << 52;\n"
+    "    const int shift = 1075 - (exponent != 0 ? exponent : 1);    // |value| = mantissa / 2^shift\n"
+    "    char text[32];\n"
+    "    char* end = text + sizeof(text) - 1;\n"
+    "    *end = '\\n';\n"
+    "    char* start;\n"
+    "    if (exponent == 0x7FF || shift < -10) {\n"
+    "        char fallback[320];\n"
+    "        const int length = snprintf(fallback, sizeof(fallback), value != value ? \"%f\\n\" : \"%.0f\\n\", value);\n"
+    "        silc_out_text(fallback, (size_t)length);\n"
+    "        return;\n"
+    "    } else if (shift <= 0) {\n"
+    "        start = silc_digits(end, mantissa << -shift);\n"
+    "    } else if (mantissa == 0 || (shift < 64 && (mantissa & ((1ull << shift) - 1)) == 0)) {\n"
+    "        start = silc_digits(end, shift < 64 ? mantissa >> shift : 0);\n"
+    "    } else if (shift < 9) {\n"
+    "        char fallback[48];\n"
+    "        const int length = snprintf(fallback, sizeof(fallback), \"%f\\n\", value);\n"
+    "        silc_out_text(fallback, (size_t)length);\n"
+    "        return;\n"
+    "    } else {\n"
+    "        uint64_t scaled = 0;    // |value| * 10^6, rounded\n"
+    "        if (shift < 75) {       // Else below a quarter of the last decimal\n"
+    "            const unsigned __int128 product = (unsigned __int128)mantissa * 1000000u;\n"
+    "            const unsigned __int128 half = (unsigned __int128)1 << (shift - 1);\n"
+    "            const unsigned __int128 rest = product & ((half << 1) - 1);\n"
+    "            scaled = (uint64_t)(product >> shift);\n"
+    "            if (rest > half || (rest == half && (scaled & 1))) scaled++;\n"
+    "        }\n"
+    "        uint64_t fraction = scaled % 1000000;\n"
+    "        for (int pair = 0; pair < 3; pair++) {\n"
+    "            end -= 2;\n"
+    "            memcpy(end, silc_digit_pairs + fraction % 100 * 2, 2);\n"
+    "            fraction /= 100;\n"
+    "        }\n"
+    "        *--end = '.';\n"
+    "        start = silc_digits(end, scaled / 1000000);\n"
+    "    }\n"
+    "    if (bits >> 63) *--start = '-';\n"
+    "    silc_out_text(start, (size_t)(text + sizeof(text) - start));\n"
+    "}\n"
+    "\n"
+    "// Strings keep their length. Up to 15 bytes are stored in the struct itself,\n"
+    "// longer text on the heap, whose size at least doubles each time it grows, so\n"
+    "// appending is amortised O(1). The text is always followed by a NUL, and a\n"
+    "// zeroed struct is the empty string.\n"
+    "typedef struct {\n"
+    "    size_t length;\n"
+    "    size_t capacity;        // Bytes on the heap, or 0 while the text is in small\n"
+    "    union {\n"
+    "        char* heap;\n"
+    "        char small[16];\n"
+    "    };\n"
+    "} SilcString;\n"
+    "\n"
+    "static SILC_UNUSED char* silc_string_data(SilcString* string) {\n"
+    "    return string->capacity != 0 ? string->heap : string->small;\n"
+    "}\n"
+    "\n"
+    "// Make room for length bytes and the NUL after them\n"
+    "static SILC_UNUSED void silc_string_reserve(SilcString* string, size_t length) {\n"
+    "    if (length < (string->capacity != 0 ? string->capacity : sizeof(string->small))) return;\n"
+    "    size_t capacity = string->capacity != 0 ? string->capacity * 2 : 32;\n"
+    "    while (capacity <= length) capacity *= 2;\n"
+    "    char* heap;\n"
+    "    if (string->capacity != 0) {\n"
+    "        heap = realloc(string->heap, capacity);\n"
+    "    } else {\n"
+    "        heap = malloc(capacity);\n"
+    "        if (heap != NULL) memcpy(heap, string->small, string->length + 1);\n"
+    "    }\n"
+    "    if (heap == NULL) {\n"
+    "        fprintf(stderr, \"Memory allocation error\\n\");\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    string->heap = heap;\n"
+    "    string->capacity = capacity;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_string_set_text(SilcString* string, const char* text, size_t length) {\n"
+    "    char* data;\n"
+    "    if (length < string->capacity) {\n"
+    "        data = string->heap;\n"
+    "    } else if (string->capacity == 0 && length < sizeof(string->small)) {\n"
+    "        data = string->small;\n"
+    "    } else {\n"
+    "        silc_string_reserve(string, length);\n"
+    "        data = silc_string_data(string);\n"
+    "    }\n"
+    "    memmove(data, text, length);    // The text may be a slice of the string itself\n"
+    "    data[length] = '\\0';\n"
+    "    string->length = length;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_string_set(SilcString* string, SilcString* source) {\n"
+    "    if (string != source) silc_string_set_text(string, silc_string_data(source), source->length);\n"
+    "}\n"
+    "\n"
+    "// Assignment from a string that is not read again: the two swap buffers\n"
+    "static SILC_UNUSED void silc_string_move(SilcString* string, SilcString* source) {\n"
+    "    const SilcString old = *string;\n"
+    "    *string = *source;\n"
+    "    *source = old;\n"
+    "}\n"
+    "\n"
+    "// The text may be the string's own, so it is found again after the buffer grows\n"
+    "static SILC_UNUSED void silc_string_append_text(SilcString* string, const char* text, size_t length) {\n"
+    "    const size_t offset = (size_t)((uintptr_t)text - (uintptr_t)silc_string_data(string));\n"
+    "    silc_string_reserve(string, string->length + length);\n"
+    "    char* data = silc_string_data(string);\n"
+    "    if (offset <= string->length) text = data + offset;\n"
+    "    memcpy(data + string->length, text, length);\n"
+    "    string->length += length;\n"
+    "    data[string->length] = '\\0';\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_string_append(SilcString* string, SilcString* source) {\n"
+    "    silc_string_append_text(string, silc_string_data(source), source->length);\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_out_string(SilcString* string) {\n"
+    "    silc_out_text(silc_string_data(string), string->length);\n"
+    "    silc_out_text(\"\\n\", 1);\n"
+    "}\n"
+    "\n"
+    "// Byte searches and comparisons take 16 bytes at a time with SSE2 or 32 with\n"
+    "// AVX2, whichever the CPU has, and one at a time elsewhere. Each returns the\n"
+    "// offset it stops at, or length when it finds nothing.\n"
+    "static int silc_simd_level = -1;    // 0 scalar, 1 SSE2, 2 AVX2\n"
+    "\n"
+    "static SILC_UNUSED int silc_simd(void) {\n"
+    "    if (silc_simd_level < 0) {\n"
+    "        silc_simd_level = 0;\n"
+    "#if SILC_SIMD\n"
+    "        __builtin_cpu_init();\n"
+    "        if (__builtin_cpu_supports(\"avx2\")) {\n"
+    "            silc_simd_level = 2;\n"
+    "        } else if (__builtin_cpu_supports(\"sse2\")) {\n"
+    "            silc_simd_level = 1;\n"
+    "        }\n"
+    "#endif\n"
+    "    }\n"
+    "    return silc_simd_level;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED size_t silc_find_byte_scalar(const char* text, size_t length, char c) {\n"
+    "    size_t i = 0;\n"
+    "    while (i < length && text[i] != c) i++;\n"
+    "    return i;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED size_t silc_nth_byte_scalar(const char* text, size_t length, char c, size_t n) {\n"
+    "    for (size_t i = 0; i < length; i++) {\n"
+    "        if (text[i] == c && n-- == 0) return i;\n"
+    "    }\n"
+    "    return length;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED size_t silc_mismatch_scalar(const char* a, const char* b, size_t length) {\n"
+    "    size_t i = 0;\n"
+    "    while (i < length && a[i] == b[i]) i++;\n"
+    "    return i;\n"
+    "}\n"
+    "\n"
+    "#if SILC_SIMD\n"
+    "__attribute__((target(\"sse2\")))\n"
+    "static SILC_UNUSED size_t silc_find_byte_sse2(const char* text, size_t length, char c) {\n"
+    "    const __m128i wanted = _mm_set1_epi8(c);\n"
+    "    size_t i = 0;\n"
+    "    for (; i + 16 <= length; i += 16) {\n"
+    "        const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + i));\n"
+    "        const unsigned found = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, wanted));\n"
+    "        if (found) return i + (size_t)__builtin_ctz(found);\n"
+    "    }\n"
+    "    return i + silc_find_byte_scalar(text + i, length - i, c);\n"
+    "}\n"
+    "\n"
+    "// Chunks with n or fewer copies of c are skipped by their count alone\n"
+    "__attribute__((target(\"sse2\")))\n"
+    "static SILC_UNUSED size_t silc_nth_byte_sse2(const char* text, size_t length, char c, size_t n) {\n"
+    "    const __m128i wanted = _mm_set1_epi8(c);\n"
+    "    size_t i = 0;\n"
+    "    for (; i + 16 <= length; i += 16) {\n"
+    "        const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + i));\n"
+    "        unsigned found = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, wanted));\n"
+    "        const size_t count = (size_t)__builtin_popcount(found);\n"
+    "        if (n < count) {\n"
+    "            for (; n > 0; n--) found &= found - 1;\n"
+    "            return i + (size_t)__builtin_ctz(found);\n"
+    "        }\n"
+    "        n -= count;\n"
+    "    }\n"
+    "    return i + silc_nth_byte_scalar(text + i, length - i, c, n);\n"
+    "}\n"
+    "\n"
+    "__attribute__((target(\"sse2\")))\n"
+    "static SILC_UNUSED size_t silc_mismatch_sse2(const char* a, const char* b, size_t length) {\n"
+    "    size_t i = 0;\n"
+    "    for (; i + 16 <= length; i += 16) {\n"
+    "        const __m128i same = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)),\n"
+    "                                            _mm_loadu_si128((const __m128i*)(b + i)));\n"
+    "        const unsigned differ = ~(unsigned)_mm_movemask_epi8(same) & 0xFFFF;\n"
+    "        if (differ) return i + (size_t)__builtin_ctz(differ);\n"
+    "    }\n"
+    "    return i + silc_mismatch_scalar(a + i, b + i, length - i);\n"
+    "}\n"
+    "\n"
+    "__attribute__((target(\"avx2\")))\n"
+    "static SILC_UNUSED size_t silc_find_byte_avx2(const char* text, size_t length, char c) {\n"
+    "    const __m256i wanted = _mm256_set1_epi8(c);\n"
+    "    size_t i = 0;\n"
+    "    for (; i + 32 <= length; i += 32) {\n"
+    "        const __m256i chunk = _mm256_loadu_si256((const __m256i*)(text + i));\n"
+    "        const unsigned found = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, wanted));\n"
+    "        if (found) return i + (size_t)__builtin_ctz(found);\n"
+    "    }\n"
+    "    return i + silc_find_byte_sse2(text + i, length - i, c);\n"
+    "}\n"
+    "\n"
+    "__attribute__((target(\"avx2,popcnt\")))\n"
+    "static SILC_UNUSED size_t silc_nth_byte_avx2(const char* text, size_t length, char c, size_t n) {\n"
+    "    const __m256i wanted = _mm256_set1_epi8(c);\n"
+    "    size_t i = 0;\n"
+    "    for (; i + 32 <= length; i += 32) {\n"
+    "        const __m256i chunk = _mm256_loadu_si256((const __m256i*)(text + i));\n"
+    "        unsigned found = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, wanted));\n"
+    "        const size_t count = (size_t)__builtin_popcount(found);\n"
+    "        if (n < count) {\n"
+    "            for (; n > 0; n--) found &= found - 1;\n"
+    "            return i + (size_t)__builtin_ctz(found);\n"
+    "        }\n"
+    "        n -= count;\n"
+    "    }\n"
+    "    return i + silc_nth_byte_sse2(text + i, length - i, c, n);\n"
+    "}\n"
+    "\n"
+    "__attribute__((target(\"avx2\")))\n"
+    "static SILC_UNUSED size_t silc_mismatch_avx2(const char* a, const char* b, size_t length) {\n"
+    "    size_t i = 0;\n"
+    "    for (; i + 32 <= length; i += 32) {\n"
+    "        const __m256i same = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)),\n"
+    "                                               _mm256_loadu_si256((const __m256i*)(b + i)));\n"
+    "        const unsigned differ = ~(unsigned)_mm256_movemask_epi8(same);\n"
+    "        if (differ) return i + (size_t)__builtin_ctz(differ);\n"
+    "    }\n"
+    "    return i + silc_mismatch_sse2(a + i, b + i, length - i);\n"
+    "}\n"
+    "#endif\n"
+    "\n"
+    "static SILC_UNUSED size_t silc_find_byte(const char* text, size_t length, char c) {\n"
+    "    switch (silc_simd()) {\n"
+    "#if SILC_SIMD\n"
+    "        case 2: return silc_find_byte_avx2(text, length, c);\n"
+    "        case 1: return silc_find_byte_sse2(text, length, c);\n"
+    "#endif\n"
+    "        default: return silc_find_byte_scalar(text, length, c);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED size_t silc_nth_byte(const char* text, size_t length, char c, size_t n) {\n"
+    "    switch (silc_simd()) {\n"
+    "#if SILC_SIMD\n"
+    "        case 2: return silc_nth_byte_avx2(text, length, c, n);\n"
+    "        case 1: return silc_nth_byte_sse2(text, length, c, n);\n"
+    "#endif\n"
+    "        default: return silc_nth_byte_scalar(text, length, c, n);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED size_t silc_mismatch(const char* a, const char* b, size_t length) {\n"
+    "    switch (silc_simd()) {\n"
+    "#if SILC_SIMD\n"
+    "        case 2: return silc_mismatch_avx2(a, b, length);\n"
+    "        case 1: return silc_mismatch_sse2(a, b, length);\n"
+    "#endif\n"
+    "        default: return silc_mismatch_scalar(a, b, length);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// A match needs the pattern's first and last bytes in place, which the\n"
+    "// vector loops test at 16 or 32 starting offsets at once; only those\n"
+    "// candidates compare the bytes in between\n"
+    "static SILC_UNUSED size_t silc_search_scalar(const char* text, size_t length, const char* pattern, size_t size, size_t i) {\n"
+    "    const size_t last = length - size;\n"
+    "    while (i <= last) {\n"
+    "        i += silc_find_byte(text + i, last + 1 - i, pattern[0]);\n"
+    "        if (i > last) break;\n"
+    "        if (silc_mismatch(text + i + 1, pattern + 1, size - 1) == size - 1) return i;\n"
+    "        i++;\n"
+    "    }\n"
+    "    return length;\n"
+    "}\n"
+    "\n"
+    "#if SILC_SIMD\n"
+    "__attribute__((target(\"sse2\")))\n"
+    "static SILC_UNUSED size_t silc_search_sse2(const char* text, size_t length, const char* pattern, size_t size) {\n"
+    "    const __m128i first = _mm_set1_epi8(pattern[0]);\n"
+    "    const __m128i final = _mm_set1_epi8(pattern[size - 1]);\n"
+    "    size_t i = 0;\n"
+    "    for (; i + 16 <= length - size + 1; i += 16) {\n"
+    "        const __m128i starts = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(text + i)), first);\n"
+    "        const __m128i ends = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(text + i + size - 1)), final);\n"
+    "        unsigned candidates = (unsigned)_mm_movemask_epi8(_mm_and_si128(starts, ends));\n"
+    "        while (candidates) {\n"
+    "            const size_t at = i + (size_t)__builtin_ctz(candidates);\n"
+    "            if (silc_mismatch(text + at + 1, pattern + 1, size - 2) == size - 2) return at;\n"
+    "            candidates &= candidates - 1;\n"
+    "        }\n"
+    "    }\n"
+    "    return silc_search_scalar(text, length, pattern, size, i);\n"
+    "}\n"
+    "\n"
+    "__attribute__((target(\"avx2\")))\n"
+    "static SILC_UNUSED size_t silc_search_avx2(const char* text, size_t length, const char* pattern, size_t size) {\n"
+    "    const __m256i first = _mm256_set1_epi8(pattern[0]);\n"
+    "    const __m256i final = _mm256_set1_epi8(pattern[size - 1]);\n"
+    "    size_t i = 0;\n"
+    "    for (; i + 32 <= length - size + 1; i += 32) {\n"
+    "        const __m256i starts = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(text + i)), first);\n"
+    "        const __m256i ends = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(text + i + size - 1)), final);\n"
+    "        unsigned candidates = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(starts, ends));\n"
+    "        while (candidates) {\n"
+    "            const size_t at = i + (size_t)__builtin_ctz(candidates);\n"
+    "            if (silc_mismatch(text + at + 1, pattern + 1, size - 2) == size - 2) return at;\n"
+    "            candidates &= candidates - 1;\n"
+    "        }\n"
+    "    }\n"
+    "    return silc_search_scalar(text, length, pattern, size, i);\n"
+    "}\n"
+    "#endif\n"
+    "\n"
+    "// Offset of the first occurrence of a non-empty pattern, or length\n"
+    "static SILC_UNUSED size_t silc_search(const char* text, size_t length, const char* pattern, size_t size) {\n"
+    "    if (size > length) return length;\n"
+    "    if (size == 1) return silc_find_byte(text, length, pattern[0]);\n"
+    "    switch (silc_simd()) {\n"
+    "#if SILC_SIMD\n"
+    "        case 2: return silc_search_avx2(text, length, pattern, size);\n"
+    "        case 1: return silc_search_sse2(text, length, pattern, size);\n"
+    "#endif\n"
+    "        default: return silc_search_scalar(text, length, pattern, size, 0);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// A view of the text of a string or a literal. slice and split return\n"
+    "// views, so they copy nothing; a view is used up before anything can change\n"
+    "// the text it points into.\n"
+    "typedef struct {\n"
+    "    const char* data;\n"
+    "    size_t length;\n"
+    "} SilcView;\n"
+    "\n"
+    "static SILC_UNUSED SilcView silc_view(SilcString* string) {\n"
+    "    SilcView view = {silc_string_data(string), string->length};\n"
+    "    return view;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED SilcView silc_view_text(const char* text, size_t length) {\n"
+    "    SilcView view = {text, length};\n"
+    "    return view;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED size_t silc_clamp(int64_t value, size_t limit) {\n"
+    "    if (value < 0) return 0;\n"
+    "    return (uint64_t)value < limit ? (size_t)value : limit;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED SilcView silc_slice(SilcView text, int64_t start, int64_t count) {\n"
+    "    const size_t from = silc_clamp(start, text.length);\n"
+    "    return silc_view_text(text.data + from, silc_clamp(count, text.length - from));\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED int64_t silc_find(SilcView text, SilcView pattern, int64_t from) {\n"
+    "    const size_t start = silc_clamp(from, text.length);\n"
+    "    if (pattern.length == 0) return (int64_t)start;\n"
+    "    const size_t found = start + silc_search(text.data + start, text.length - start, pattern.data, pattern.length);\n"
+    "    return found < text.length ? (int64_t)found : -1;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED SilcView silc_split(SilcView text, SilcView separator, int64_t n) {\n"
+    "    const SilcView none = {text.data, 0};\n"
+    "    if (n < 0) return none;\n"
+    "    if (separator.length == 0) return n == 0 ? text : none;\n"
+    "    size_t start = 0;\n"
+    "    if (separator.length == 1 && n > 0) {\n"
+    "        // Piece n starts after separator n - 1, which one pass counts to\n"
+    "        const size_t found = silc_nth_byte(text.data, text.length, separator.data[0], (size_t)n - 1);\n"
+    "        if (found == text.length) return none;\n"
+    "        start = found + 1;\n"
+    "        n = 0;\n"
+    "    }\n"
+    "    for (; n > 0; n--) {\n"
+    "        const size_t found = start + silc_search(text.data + start, text.length - start, separator.data,\n"
+    "                                                 separator.length);\n"
+    "        if (found == text.length) return none;\n"
+    "        start = found + separator.length;\n"
+    "    }\n"
+    "    const size_t end = start + silc_search(text.data + start, text.length - start, separator.data,\n"
+    "                                           separator.length);\n"
+    "    return silc_view_text(text.data + start, end - start);\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED int64_t silc_compare(SilcView a, SilcView b) {\n"
+    "    const size_t shorter = a.length < b.length ? a.length : b.length;\n"
+    "    const size_t i = silc_mismatch(a.data, b.data, shorter);\n"
+    "    if (i < shorter) return (unsigned char)a.data[i] < (unsigned char)b.data[i] ? -1 : 1;\n"
+    "    return a.length < b.length ? -1 : a.length > b.length;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED int silc_equal(SilcView a, SilcView b) {\n"
+    "    return a.length == b.length && silc_mismatch(a.data, b.data, a.length) == a.length;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_string_set_view(SilcString* string, SilcView view) {\n"
+    "    silc_string_set_text(string, view.data, view.length);\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_string_append_view(SilcString* string, SilcView view) {\n"
+    "    silc_string_append_text(string, view.data, view.length);\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_out_view(SilcView view) {\n"
+    "    silc_out_text(view.data, view.length);\n"
+    "    silc_out_text(\"\\n\", 1);\n"
+    "}\n"
+    "\n"
+    "// Arrays keep their elements contiguous, in storage that at least doubles\n"
+    "// each time it grows, so push is amortised O(1). A zeroed struct is the\n"
+    "// empty array. Indexes are checked unless the compiler proved them in range.\n"
+    "static SILC_UNUSED void* silc_array_reserve(void* data, int64_t* capacity, int64_t length, size_t size) {\n"
+    "    if (length <= *capacity) return data;\n"
+    "    int64_t grown = *capacity > 0 ? *capacity * 2 : 8;\n"
+    "    while (grown < length) grown *= 2;\n"
+    "    data = realloc(data, (size_t)grown * size);\n"
+    "    if (data == NULL) {\n"
+    "        fprintf(stderr, \"Memory allocation error\\n\");\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    *capacity = grown;\n"
+    "    return data;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_index_error(int64_t index, int64_t length, int line) {\n"
+    "    silc_flush();\n"
+    "    fprintf(stderr, \"Runtime Error: Index %\" PRId64 \" is out of range for %\" PRId64 \" elements at line %d\\n\",\n"
+    "            index, length, line);\n"
+    "    exit(1);\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED int64_t silc_index(int64_t index, int64_t length, int line) {\n"
+    "    if ((uint64_t)index >= (uint64_t)length) silc_index_error(index, length, line);\n"
+    "    return index;\n"
+    "}\n"
+    "\n"
+    "#define SILC_ARRAY(Array, array, Element) \\\n"
+    "    typedef struct { \\\n"
+    "        Element* data; \\\n"
+    "        int64_t length; \\\n"
+    "        int64_t capacity; \\\n"
+    "    } Array; \\\n"
+    "    \\\n"
+    "    static SILC_UNUSED void array##_set_items(Array* target, const Element* items, int64_t length) { \\\n"
+    "        target->data = silc_array_reserve(target->data, &target->capacity, length, sizeof(Element)); \\\n"
+    "        if (length > 0) memcpy(target->data, items, (size_t)length * sizeof(Element)); \\\n"
+    "        target->length = length; \\\n"
+    "    } \\\n"
+    "    \\\n"
+    "    static SILC_UNUSED void array##_set(Array* target, Array* source) { \\\n"
+    "        if (target != source) array##_set_items(target, source->data, source->length); \\\n"
+    "    } \\\n"
+    "    \\\n"
+    "    static SILC_UNUSED int64_t array##_push(Array* target, Element value) { \\\n"
+    "        if (target->length == target->capacity) { \\\n"
+    "            target->data = silc_array_reserve(target->data, &target->capacity, target->length + 1, sizeof(Element)); \\\n"
+    "        } \\\n"
+    "        target->data[target->length] = value; \\\n"
+    "        return ++target->length; \\\n"
+    "    }\n"
+    "\n"
+    "SILC_ARRAY(SilcIntArray, silc_int_array, int64_t)\n"
+    "SILC_ARRAY(SilcDoubleArray, silc_double_array, double)\n"
+    "\n"
+    "// Maps are Swiss tables: open addressing over aligned groups of 16 slots,\n"
+    "// each with a control byte that holds 7 bits of its key's hash, so a single\n"
+    "// SSE2 compare finds a group's candidates. A zeroed struct is the empty map.\n"
+    "#define SILC_MAP_GROUP 16\n"
+    "#define SILC_MAP_EMPTY 0x80\n"
+    "#define SILC_MAP_DELETED 0xFE\n"
+    "\n"
+    "typedef struct {\n"
+    "    uint64_t hash;\n"
+    "    char* text;         // A copy of a string key\n"
+    "    size_t length;\n"
+    "    double value;\n"
+    "} SilcMapEntry;\n"
+    "\n"
+    "typedef struct {\n"
+    "    uint8_t* control;\n"
+    "    SilcMapEntry* entries;\n"
+    "    int64_t count;      // Keys\n"
+    "    int64_t used;       // Keys and deleted slots\n"
+    "    int64_t capacity;   // A power of two, and a multiple of the group\n"
+    "} SilcMap;\n"
+    "\n"
+    "// Number keys hash one to one, so equal hashes mean equal keys; -0 is 0, and\n"
+    "// every NaN is one key\n"
+    "static SILC_UNUSED uint64_t silc_hash_double(double key) {\n"
+    "    uint64_t bits = UINT64_C(0x7FF8000000000000);\n"
+    "    if (key == 0) key = 0;\n"
+    "    if (key == key) memcpy(&bits, &key, sizeof(bits));\n"
+    "    bits ^= bits >> 32;\n"
+    "    bits *= UINT64_C(0x9E3779B97F4A7C15);\n"
+    "    return bits ^ bits >> 32;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED uint64_t silc_hash_text(const char* text, size_t length) {\n"
+    "    uint64_t hash = length * UINT64_C(0x9E3779B97F4A7C15);\n"
+    "    size_t i = 0;\n"
+    "    for (; i + 8 <= length; i += 8) {\n"
+    "        uint64_t word;\n"
+    "        memcpy(&word, text + i, sizeof(word));\n"
+    "        hash = (hash ^ word) * UINT64_C(0xFF51AFD7ED558CCD);\n"
+    "        hash ^= hash >> 32;\n"
+    "    }\n"
+    "    if (i < length) {\n"
+    "        uint64_t word = 0;\n"
+    "        memcpy(&word, text + i, length - i);\n"
+    "        hash = (hash ^ word) * UINT64_C(0xFF51AFD7ED558CCD);\n"
+    "        hash ^= hash >> 32;\n"
+    "    }\n"
+    "    return hash;\n"
+    "}\n"
+    "\n"
+    "// Bit i is set when control byte i of the group is byte\n"
+    "static SILC_UNUSED unsigned silc_map_match(const uint8_t* group, uint8_t byte) {\n"
+    "#if SILC_SIMD && defined(__SSE2__)\n"
+    "    const __m128i control = _mm_loadu_si128((const __m128i*)group);\n"
+    "    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));\n"
+    "#else\n"
+    "    unsigned bits = 0;\n"
+    "    for (int i = 0; i < SILC_MAP_GROUP; i++) bits |= (unsigned)(group[i] == byte) << i;\n"
+    "    return bits;\n"
+    "#endif\n"
+    "}\n"
+    "\n"
+    "// Bit i is set when slot i of the group is empty or deleted\n"
+    "static SILC_UNUSED unsigned silc_map_free(const uint8_t* group) {\n"
+    "#if SILC_SIMD && defined(__SSE2__)\n"
+    "    return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));\n"
+    "#else\n"
+    "    unsigned bits = 0;\n"
+    "    for (int i = 0; i < SILC_MAP_GROUP; i++) bits |= (unsigned)(group[i] >> 7) << i;\n"
+    "    return bits;\n"
+    "#endif\n"
+    "}\n"
+    "\n"
+    "// Groups are probed triangularly from the one the hash picks, which visits\n"
+    "// every group; a lookup stops at the first group with an empty slot. key is\n"
+    "// NULL for a number.\n"
+    "static SILC_UNUSED SilcMapEntry* silc_map_find(SilcMap* map, uint64_t hash, const SilcView* key) {\n"
+    "    if (map->capacity == 0) return NULL;\n"
+    "    const size_t mask = (size_t)map->capacity / SILC_MAP_GROUP - 1;\n"
+    "    size_t group = (size_t)(hash >> 7) & mask;\n"
+    "    for (size_t step = 1;; step++) {\n"
+    "        const uint8_t* control = map->control + group * SILC_MAP_GROUP;\n"
+    "        unsigned matches = silc_map_match(control, (uint8_t)(hash & 0x7F));\n"
+    "        while (matches) {\n"
+    "            SilcMapEntry* entry = &map->entries[group * SILC_MAP_GROUP + (size_t)__builtin_ctz(matches)];\n"
+    "            if (entry->hash == hash &&\n"
+    "                (key == NULL ||\n"
+    "                 (entry->length == key->length && (key->length == 0 || memcmp(entry->text, key->data, key->length) == 0)))) {\n"
+    "                return entry;\n"
+    "            }\n"
+    "            matches &= matches - 1;\n"
+    "        }\n"
+    "        if (silc_map_match(control, SILC_MAP_EMPTY)) return NULL;\n"
+    "        group = (group + step) & mask;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED size_t silc_map_slot(SilcMap* map, uint64_t hash) {\n"
+    "    const size_t mask = (size_t)map->capacity / SILC_MAP_GROUP - 1;\n"
+    "    size_t group = (size_t)(hash >> 7) & mask;\n"
+    "    for (size_t step = 1;; step++) {\n"
+    "        const unsigned open = silc_map_free(map->control + group * SILC_MAP_GROUP);\n"
+    "        if (open) return group * SILC_MAP_GROUP + (size_t)__builtin_ctz(open);\n"
+    "        group = (group + step) & mask;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// Rebuilds the table without its deleted slots, twice as large if it is at\n"
+    "// least half full\n"
+    "static SILC_UNUSED void silc_map_rehash(SilcMap* map) {\n"
+    "    SilcMap old = *map;\n"
+    "    int64_t capacity = old.capacity > 0 ? old.capacity : SILC_MAP_GROUP;\n"
+    "    if ((old.count + 1) * 2 > capacity) capacity *= 2;\n"
+    "    map->control = malloc((size_t)capacity);\n"
+    "    map->entries = malloc((size_t)capacity * sizeof(SilcMapEntry));\n"
+    "    if (map->control == NULL || map->entries == NULL) {\n"
+    "        fprintf(stderr, \"Memory allocation error\\n\");\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    memset(map->control, SILC_MAP_EMPTY, (size_t)capacity);\n"
+    "    map->capacity = capacity;\n"
+    "    map->used = old.count;\n"
+    "    for (int64_t i = 0; i < old.capacity; i++) {\n"
+    "        if (old.control[i] & 0x80) continue;\n"
+    "        const size_t slot = silc_map_slot(map, old.entries[i].hash);\n"
+    "        map->control[slot] = old.control[i];\n"
+    "        map->entries[slot] = old.entries[i];\n"
+    "    }\n"
+    "    free(old.control);\n"
+    "    free(old.entries);\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED int64_t silc_map_put(SilcMap* map, uint64_t hash, const SilcView* key, double value) {\n"
+    "    SilcMapEntry* entry = silc_map_find(map, hash, key);\n"
+    "    if (entry != NULL) {\n"
+    "        entry->value = value;\n"
+    "        return map->count;\n"
+    "    }\n"
+    "    if ((map->used + 1) * 8 > map->capacity * 7) silc_map_rehash(map);\n"
+    "    const size_t slot = silc_map_slot(map, hash);\n"
+    "    if (map->control[slot] == SILC_MAP_EMPTY) map->used++;\n"
+    "    map->control[slot] = (uint8_t)(hash & 0x7F);\n"
+    "    entry = &map->entries[slot];\n"
+    "    entry->hash = hash;\n"
+    "    entry->text = NULL;\n"
+    "    entry->length = 0;\n"
+    "    entry->value = value;\n"
+    "    if (key != NULL) {\n"
+    "        entry->text = malloc(key->length > 0 ? key->length : 1);\n"
+    "        if (entry->text == NULL) {\n"
+    "            fprintf(stderr, \"Memory allocation error\\n\");\n"
+    "            exit(1);\n"
+    "        }\n"
+    "        if (key->length > 0) memcpy(entry->text, key->data, key->length);\n"
+    "        entry->length = key->length;\n"
+    "    }\n"
+    "    return ++map->count;\n"
+    "}\n"
+    "\n"
+    "// A slot in a group that still has an empty one can be emptied too: no\n"
+    "// probe has ever passed that group\n"
+    "static SILC_UNUSED int64_t silc_map_del(SilcMap* map, uint64_t hash, const SilcView* key) {\n"
+    "    SilcMapEntry* entry = silc_map_find(map, hash, key);\n"
+    "    if (entry == NULL) return 0;\n"
+    "    const size_t slot = (size_t)(entry - map->entries);\n"
+    "    free(entry->text);\n"
+    "    if (silc_map_match(map->control + (slot & ~(size_t)(SILC_MAP_GROUP - 1)), SILC_MAP_EMPTY)) {\n"
+    "        map->control[slot] = SILC_MAP_EMPTY;\n"
+    "        map->used--;\n"
+    "    } else {\n"
+    "        map->control[slot] = SILC_MAP_DELETED;\n"
+    "    }\n"
+    "    map->count--;\n"
+    "    return 1;\n"
+    "}\n"
+    "\n"
+    "static SILC_UNUSED void silc_map_clear(SilcMap* map) {\n"
+    "    for (int64_t i = 0; i < map->capacity; i++) {\n"
+    "        if (!(map->control[i] & 0x80)) free(map->entries[i].text);\n"
+    "    }\n"
+    "    if (map->capacity > 0) memset(map->control, SILC_MAP_EMPTY, (size_t)map->capacity);\n"
+    "    map->count = 0;\n"
+    "    map->used = 0;\n"
+    "}\n"
+    "\n"
+    "#define SILC_MAP_KEYS(map, Key, hash, text) \\\n"
+    "    static SILC_UNUSED double map##_get(SilcMap* target, Key key) { \\\n"
+    "        SilcMapEntry* entry = silc_map_find(target, hash, text); \\\n"
+    "        return entry != NULL ? entry->value : 0; \\\n"
+    "    } \\\n"
+    "    \\\n"
+    "    static SILC_UNUSED int64_t map##_has(SilcMap* target, Key key) { \\\n"
+    "        return silc_map_find(target, hash, text) != NULL; \\\n"
+    "    } \\\n"
+    "    \\\n"
+    "    static SILC_UNUSED int64_t map##_put(SilcMap* target, Key key, double value) { \\\n"
+    "        return silc_map_put(target, hash, text, value); \\\n"
+    "    } \\\n"
+    "    \\\n"
+    "    static SILC_UNUSED int64_t map##_del(SilcMap* target, Key key) { \\\n"
+    "        return silc_map_del(target, hash, text); \\\n"
+    "    }\n"
+    "\n"
+    "SILC_MAP_KEYS(silc_double_map, double, silc_hash_double(key), NULL)\n"
+    "SILC_MAP_KEYS(silc_string_map, SilcView, silc_hash_text(key.data, key.length), &key)\n"
+    "\n"
+    "#define SILC_IN_SIZE 65536\n"
+    "static char* silc_in_data;\n"
+    "static size_t silc_in_length;\n"
+    "static size_t silc_in_position;\n"
+    "static size_t silc_in_capacity;     // 0 once the data is all there, mapped or read to the end\n"
+    "static int silc_in_opened;\n"
+    "\n"
+    "static SILC_UNUSED void silc_in_open(void) {\n"
+    "    silc_in_opened = 1;\n"
+    "#if !defined(_WIN32)\n"
+    "    struct stat info;\n"
+    "    if (fstat(0, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {\n"
+    "        const off_t offset = lseek(0, 0, SEEK_CUR);\n"
+    "        void* map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, 0, 0);\n"
+    "        if (map != MAP_FAILED) {\n"
+    "            silc_in_data = map;\n"
+    "            silc_in_length = (size_t)info.st_size;\n"
+    "            silc_in_position = offset <= 0 ? 0 : offset < info.st_size ? (size_t)offset : silc_in_length;\n"
+    "            return;\n"
+    "        }\n"
+    "    }\n"
+    "#endif\n"
+    "    silc_in_capacity = SILC_IN_SIZE;\n"
+    "    silc_in_data = malloc(silc_in_capacity);\n"
+    "    if (silc_in_data == NULL) {\n"
+    "        fprintf(stderr, \"Memory allocation error\\n\");\n"
+    "        exit(1);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// Read the next block after the unread data, which moves to the front of the\n"
+    "// buffer; return 0 at the end of input. Output is flushed first, so a prompt\n"
+    "// is on screen before the program waits.\n"
+    "static SILC_UNUSED int silc_in_more(void) {\n"
+    "    if (!silc_in_opened) {\n"
+    "        silc_in_open();\n"
+    "        if (silc_in_capacity == 0) return silc_in_length > 0;\n"
+    "    }\n"
+    "    if (silc_in_capacity == 0) return 0;\n"
+    "    silc_flush();\n"
+    "    silc_in_length -= silc_in_position;\n"
+    "    memmove(silc_in_data, silc_in_data + silc_in_position, silc_in_length);\n"
+    "    silc_in_position = 0;\n"
+    "    if (silc_in_length == silc_in_capacity) {\n"
+    "        silc_in_capacity *= 2;\n"
+    "        silc_in_data = realloc(silc_in_data, silc_in_capacity);\n"
+    "        if (silc_in_data == NULL) {\n"
+    "            fprintf(stderr, \"Memory allocation error\\n\");\n"
+    "            exit(1);\n"
+    "        }\n"
+    "    }\n"
+    "    const long count = (long)silc_read(0, silc_in_data + silc_in_length, silc_in_capacity - silc_in_length);\n"
+    "    if (count <= 0) {\n"
+    "        silc_in_capacity = 0;\n"
+    "        return 0;\n"
+    "    }\n"
+    "    silc_in_length += (size_t)count;\n"
+    "    return 1;\n"
+    "}\n"
+    "\n"
+    "// The characters isspace() accepts in the C locale\n"
+    "static SILC_UNUSED int silc_is_space(char c) {\n"
+    "    return c == ' ' || (c >= '\\t' && c <= '\\r');\n"
+    "}\n"
+    "\n"
+    "// Skip whitespace, as scanf does; return 0 when the input ends first\n"
+    "static SILC_UNUSED int silc_in_skip(void) {\n"
+    "    for (;;) {\n"
+    "        while (silc_in_position < silc_in_length && silc_is_space(silc_in_data[silc_in_position])) silc_in_position++;\n"
+    "        if (silc_in_position < silc_in_length) return 1;\n"
+    "        if (!silc_in_more()) return 0;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// Buffer the whole word at the read position and return where it ends\n"
+    "static SILC_UNUSED size_t silc_in_word(void) {\n"
+    "    size_t end = silc_in_position;\n"
+    "    for (;;) {\n"
+    "        while (end < silc_in_length && !silc_is_space(silc_in_data[end])) end++;\n"
+    "        if (end < silc_in_length) return end;\n"
+    "        const size_t offset = end - silc_in_position;\n"
+    "        if (!silc_in_more()) return silc_in_length;\n"
+    "        end = silc_in_position + offset;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static const double silc_powers_of_ten[] = {\n"
+    "    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,\n"
+    "    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22\n"
+    "};\n"
+    "\n"
+    "// scanf(\"%lf\"): value is left alone when there is no number to read. A word\n"
+    "// that is all one plain decimal of at most 19 significant digits, whose\n"
+    "// digits fit in 53 bits and whose exponent is within 10^22, is exactly one\n"
+    "// multiplication or division of doubles, so it is rounded correctly;\n"
+    "// everything else (more digits, hexadecimal, inf, nan, text after the\n"
+    "// number) goes to strtod.\n"
+    "static SILC_UNUSED void silc_in_double(double* value) {\n"
+    "    if (!silc_in_skip()) return;\n"
+    "    const size_t end = silc_in_word();\n"
+    "    const char* p = silc_in_data + silc_in_position;\n"
+    "    const char* const stop = silc_in_data + end;\n"
+    "    const int negative = *p == '-';\n"
+    "    if (*p == '-' || *p == '+') p++;\n"
+    "    uint64_t mantissa = 0;\n"
+    "    int digits = 0;\n"
+    "    int significant = 0;\n"
+    "    int exponent = 0;\n"
+    "    for (; p < stop && (unsigned)(*p - '0') < 10; p++, digits++) {\n"
+    "        if (mantissa != 0 || *p != '0') significant++;\n"
+    "        mantissa = mantissa * 10 + (uint64_t)(*p - '0');\n"
+    "    }\n"
+    "    if (p < stop && *p == '.') {\n"
+    "        for (p++; p < stop && (unsigned)(*p - '0') < 10; p++, digits++, exponent--) {\n"
+    "            if (mantissa != 0 || *p != '0') significant++;\n"
+    "            mantissa = mantissa * 10 + (uint64_t)(*p - '0');\n"
+    "        }\n"
+    "    }\n"
+    "    if (p < stop && digits > 0 && (*p == 'e' || *p == 'E')) {\n"
+    "        p++;\n"
+    "        const int negative_exponent = p < stop && *p == '-';\n"
+    "        if (p < stop && (*p == '-' || *p == '+')) p++;\n"
+    "        int power = 0;\n"
+    "        int power_digits = 0;\n"
+    "        for (; p < stop && (unsigned)(*p - '0') < 10; p++, power_digits++) {\n"
+    "            if (power < 10000) power = power * 10 + (*p - '0');\n"
+    "        }\n"
+    "        exponent += negative_exponent ? -power : power;\n"
+    "        if (power_digits == 0) digits = 0;\n"
+    "    }\n"
+    "    if (FLT_EVAL_METHOD == 0 && p == stop && digits > 0 && significant <= 19\n"
+    "        && (mantissa == 0 || (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22))) {\n"
+    "        double result = (double)mantissa;\n"
+    "        if (exponent < 0) result /= silc_powers_of_ten[-exponent];\n"
+    "        else if (exponent > 0) result *= silc_powers_of_ten[exponent];\n"
+    "        *value = negative ? -result : result;\n"
+    "        silc_in_position = end;\n"
+    "        return;\n"
+    "    }\n"
+    "    const size_t length = end - silc_in_position;\n"
+    "    char small[128];\n"
+    "    char* word = length < sizeof(small) ? small : malloc(length + 1);\n"
+    "    if (word == NULL) {\n"
+    "        fprintf(stderr, \"Memory allocation error\\n\");\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    memcpy(word, silc_in_data + silc_in_position, length);\n"
+    "    word[length] = '\\0';\n"
+    "    char* rest;\n"
+    "    const double result = strtod(word, &rest);\n"
+    "    if (rest != word) {\n"
+    "        *value = result;\n"
+    "        silc_in_position += (size_t)(rest - word);\n"
+    "    }\n"
+    "    if (word != small) free(word);\n"
+    "}\n"
+    "\n"
+    "// scanf(\"%s\") without its limit: string is left alone when the input ends first\n"
+    "static SILC_UNUSED void silc_in_string(SilcString* string) {\n"
+    "    if (!silc_in_skip()) return;\n"
+    "    string->length = 0;\n"
+    "    for (;;) {\n"
+    "        size_t end = silc_in_position;\n"
+    "        while (end < silc_in_length && !silc_is_space(silc_in_data[end])) end++;\n"
+    "        silc_string_append_text(string, silc_in_data + silc_in_position, end - silc_in_position);\n"
+    "        silc_in_position = end;\n"
+    "        if (end < silc_in_length || !silc_in_more()) return;\n"
+    "    }\n"
+    "}\n";
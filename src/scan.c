@@ -0,0 +1,528 @@
+#include <stdint.h>
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#else
+#define SCAN_X86 0
+#endif
+
+static int active_level = -1;
+
+static bool is_space(const unsigned char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= 4; // \t \n \v \f \r
+}
+
+static bool is_ident(const unsigned char c) {
+    return (unsigned char)((c | 0x20) - 'a') <= 25 || (unsigned char)(c - '0') <= 9 || c == '_';
+}
+
+static size_t whitespace_scalar(const char* text, size_t position, const size_t length,
+                                int* line, size_t* line_start) {
+    while (position < length && is_space((unsigned char)text[position])) {
+        if (text[position] == '\n') {
+            (*line)++;
+            *line_start = position + 1;
+        }
+        position++;
+    }
+    return position;
+}
+
+static size_t identifier_scalar(const char* text, size_t position, const size_t length) {
+    while (position < length && is_ident((unsigned char)text[position])) {
+        position++;
+    }
+    return position;
+}
+
+static size_t string_scalar(const char* text, size_t position, const size_t length,
+                            int* line, size_t* line_start) {
+    while (position < length && text[position] != '"') {
+        if (text[position] == '\n') {
+            (*line)++;
+            *line_start = position + 1;
+        }
+        position++;
+    }
+    return position;
+}
+
+static size_t find_byte_scalar(const char* text, const size_t length, const char c) {
+    size_t position = 0;
+    while (position < length && text[position] != c) position++;
+    return position;
+}
+
+static size_t nth_byte_scalar(const char* text, const size_t length, const char c, size_t n) {
+    for (size_t position = 0; position < length; position++) {
+        if (text[position] == c && n-- == 0) return position;
+    }
+    return length;
+}
+
+static size_t mismatch_scalar(const char* a, const char* b, const size_t length) {
+    size_t position = 0;
+    while (position < length && a[position] == b[position]) position++;
+    return position;
+}
+
+// Candidates from position on, each found by its first byte and checked whole
+static size_t find_scalar(const char* text, size_t position, const size_t length, const char* pattern,
+                          const size_t size) {
+    const size_t last = length - size;
+    while (position <= last) {
+        position += scan_find_byte(text + position, last + 1 - position, pattern[0]);
+        if (position > last) break;
+        if (scan_mismatch(text + position + 1, pattern + 1, size - 1) == size - 1) return position;
+        position++;
+    }
+    return length;
+}
+
+#if SCAN_X86
+
+// Account for the newlines whose bits are set in mask, relative to base
+static inline void count_lines(const uint32_t mask, const size_t base, int* line, size_t* line_start) {
+    if (mask) {
+        *line += __builtin_popcount(mask);
+        *line_start = base + (size_t)(31 - __builtin_clz(mask)) + 1;
+    }
+}
+
+// Bits below the lowest set bit of stop, or every bit when stop is empty
+static inline uint32_t bits_before(const uint32_t stop, const uint32_t all) {
+    return stop ? (stop & -stop) - 1 : all;
+}
+
+__attribute__((target("sse2")))
+static size_t whitespace_sse2(const char* text, size_t position, const size_t length,
+                              int* line, size_t* line_start) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while (position + 16 <= length) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + position));
+        const __m128i control = _mm_sub_epi8(chunk, tab);
+        const __m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(control, four), control);
+        const __m128i spaces = _mm_or_si128(is_control, _mm_cmpeq_epi8(chunk, space));
+        const uint32_t stop = ~(uint32_t)_mm_movemask_epi8(spaces) & 0xFFFF;
+        const uint32_t lines = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+
+        count_lines(lines & bits_before(stop, 0xFFFF), position, line, line_start);
+        if (stop) return position + (size_t)__builtin_ctz(stop);
+        position += 16;
+    }
+    return whitespace_scalar(text, position, length, line, line_start);
+}
+
+__attribute__((target("sse2")))
+static size_t identifier_sse2(const char* text, size_t position, const size_t length) {
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i lower_a = _mm_set1_epi8('a');
+    const __m128i letters = _mm_set1_epi8(25);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i digits = _mm_set1_epi8(9);
+    const __m128i underscore = _mm_set1_epi8('_');
+
+    while (position + 16 <= length) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + position));
+        const __m128i alpha = _mm_sub_epi8(_mm_or_si128(chunk, case_bit), lower_a);
+        const __m128i digit = _mm_sub_epi8(chunk, zero);
+        const __m128i idents = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(alpha, letters), alpha),
+                         _mm_cmpeq_epi8(_mm_min_epu8(digit, digits), digit)),
+            _mm_cmpeq_epi8(chunk, underscore));
+        const uint32_t stop = ~(uint32_t)_mm_movemask_epi8(idents) & 0xFFFF;
+
+        if (stop) return position + (size_t)__builtin_ctz(stop);
+        position += 16;
+    }
+    return identifier_scalar(text, position, length);
+}
+
+__attribute__((target("sse2")))
+static size_t string_sse2(const char* text, size_t position, const size_t length,
+                          int* line, size_t* line_start) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while (position + 16 <= length) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + position));
+        const uint32_t stop = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote));
+        const uint32_t lines = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+
+        count_lines(lines & bits_before(stop, 0xFFFF), position, line, line_start);
+        if (stop) return position + (size_t)__builtin_ctz(stop);
+        position += 16;
+    }
+    return string_scalar(text, position, length, line, line_start);
+}
+
+__attribute__((target("avx2")))
+static size_t whitespace_avx2(const char* text, size_t position, const size_t length,
+                              int* line, size_t* line_start) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    while (position + 32 <= length) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)(text + position));
+        const __m256i control = _mm256_sub_epi8(chunk, tab);
+        const __m256i is_control = _mm256_cmpeq_epi8(_mm256_min_epu8(control, four), control);
+        const __m256i spaces = _mm256_or_si256(is_control, _mm256_cmpeq_epi8(chunk, space));
+        const uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(spaces);
+        const uint32_t lines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+
+        count_lines(lines & bits_before(stop, 0xFFFFFFFF), position, line, line_start);
+        if (stop) return position + (size_t)__builtin_ctz(stop);
+        position += 32;
+    }
+    return whitespace_sse2(text, position, length, line, line_start);
+}
+
+__attribute__((target("avx2")))
+static size_t identifier_avx2(const char* text, size_t position, const size_t length) {
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i lower_a = _mm256_set1_epi8('a');
+    const __m256i letters = _mm256_set1_epi8(25);
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i digits = _mm256_set1_epi8(9);
+    const __m256i underscore = _mm256_set1_epi8('_');
+
+    while (position + 32 <= length) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)(text + position));
+        const __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(chunk, case_bit), lower_a);
+        const __m256i digit = _mm256_sub_epi8(chunk, zero);
+        const __m256i idents = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(alpha, letters), alpha),
+                            _mm256_cmpeq_epi8(_mm256_min_epu8(digit, digits), digit)),
+            _mm256_cmpeq_epi8(chunk, underscore));
+        const uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(idents);
+
+        if (stop) return position + (size_t)__builtin_ctz(stop);
+        position += 32;
+    }
+    return identifier_sse2(text, position, length);
+}
+
+__attribute__((target("avx2")))
+static size_t string_avx2(const char* text, size_t position, const size_t length,
+                          int* line, size_t* line_start) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    while (position + 32 <= length) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)(text + position));
+        const uint32_t stop = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote));
+        const uint32_t lines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+
+        count_lines(lines & bits_before(stop, 0xFFFFFFFF), position, line, line_start);
+        if (stop) return position + (size_t)__builtin_ctz(stop);
+        position += 32;
+    }
+    return string_sse2(text, position, length, line, line_start);
+}
+
+__attribute__((target("sse2")))
+static size_t find_byte_sse2(const char* text, const size_t length, const char c) {
+    const __m128i wanted = _mm_set1_epi8(c);
+    size_t position = 0;
+
+    while (position + 16 <= length) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + position));
+        const uint32_t found = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, wanted));
+
+        if (found) return position + (size_t)__builtin_ctz(found);
+        position += 16;
+    }
+    return position + find_byte_scalar(text + position, length - position, c);
+}
+
+// Whole chunks with n or fewer copies of c are skipped by their count alone
+__attribute__((target("sse2")))
+static size_t nth_byte_sse2(const char* text, const size_t length, const char c, size_t n) {
+    const __m128i wanted = _mm_set1_epi8(c);
+    size_t position = 0;
+
+    while (position + 16 <= length) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + position));
+        uint32_t found = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, wanted));
+        const size_t count = (size_t)__builtin_popcount(found);
+
+        if (n < count) {
+            for (; n > 0; n--) found &= found - 1;
+            return position + (size_t)__builtin_ctz(found);
+        }
+        n -= count;
+        position += 16;
+    }
+    return position + nth_byte_scalar(text + position, length - position, c, n);
+}
+
+__attribute__((target("sse2")))
+static size_t mismatch_sse2(const char* a, const char* b, const size_t length) {
+    size_t position = 0;
+
+    while (position + 16 <= length) {
+        const __m128i same = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + position)),
+                                            _mm_loadu_si128((const __m128i*)(b + position)));
+        const uint32_t differ = ~(uint32_t)_mm_movemask_epi8(same) & 0xFFFF;
+
+        if (differ) return position + (size_t)__builtin_ctz(differ);
+        position += 16;
+    }
+    return position + mismatch_scalar(a + position, b + position, length - position);
+}
+
+// A match has the pattern's first and last bytes in place; 16 starting
+// offsets are tested for both at once, and only those candidates compare the
+// bytes in between
+__attribute__((target("sse2")))
+static size_t find_sse2(const char* text, const size_t length, const char* pattern, const size_t size) {
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[size - 1]);
+    size_t position = 0;
+
+    while (position + 16 <= length - size + 1) {
+        const __m128i starts = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(text + position)), first);
+        const __m128i ends = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(text + position + size - 1)), last);
+        uint32_t candidates = (uint32_t)_mm_movemask_epi8(_mm_and_si128(starts, ends));
+
+        while (candidates) {
+            const size_t match = position + (size_t)__builtin_ctz(candidates);
+            if (scan_mismatch(text + match + 1, pattern + 1, size - 2) == size - 2) return match;
+            candidates &= candidates - 1;
+        }
+        position += 16;
+    }
+    return find_scalar(text, position, length, pattern, size);
+}
+
+__attribute__((target("avx2")))
+static size_t find_byte_avx2(const char* text, const size_t length, const char c) {
+    const __m256i wanted = _mm256_set1_epi8(c);
+    size_t position = 0;
+
+    while (position + 32 <= length) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)(text + position));
+        const uint32_t found = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, wanted));
+
+        if (found) return position + (size_t)__builtin_ctz(found);
+        position += 32;
+    }
+    return position + find_byte_sse2(text + position, length - position, c);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t nth_byte_avx2(const char* text, const size_t length, const char c, size_t n) {
+    const __m256i wanted = _mm256_set1_epi8(c);
+    size_t position = 0;
+
+    while (position + 32 <= length) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)(text + position));
+        uint32_t found = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, wanted));
+        const size_t count = (size_t)__builtin_popcount(found);
+
+        if (n < count) {
+            for (; n > 0; n--) found &= found - 1;
+            return position + (size_t)__builtin_ctz(found);
+        }
+        n -= count;
+        position += 32;
+    }
+    return position + nth_byte_sse2(text + position, length - position, c, n);
+}
+
+__attribute__((target("avx2")))
+static size_t mismatch_avx2(const char* a, const char* b, const size_t length) {
+    size_t position = 0;
+
+    while (position + 32 <= length) {
+        const __m256i same = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + position)),
+                                               _mm256_loadu_si256((const __m256i*)(b + position)));
+        const uint32_t differ = ~(uint32_t)_mm256_movemask_epi8(same);
+
+        if (differ) return position + (size_t)__builtin_ctz(differ);
+        position += 32;
+    }
+    return position + mismatch_sse2(a + position, b + position, length - position);
+}
+
+__attribute__((target("avx2")))
+static size_t find_avx2(const char* text, const size_t length, const char* pattern, const size_t size) {
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[size - 1]);
+    size_t position = 0;
+
+    while (position + 32 <= length - size + 1) {
+        const __m256i starts = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(text + position)), first);
+        const __m256i ends = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(text + position + size - 1)),
+                                               last);
+        uint32_t candidates = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(starts, ends));
+
+        while (candidates) {
+            const size_t match = position + (size_t)__builtin_ctz(candidates);
+            if (scan_mismatch(text + match + 1, pattern + 1, size - 2) == size - 2) return match;
+            candidates &= candidates - 1;
+        }
+        position += 32;
+    }
+    return find_scalar(text, position, length, pattern, size);
+}
+
+#endif // SCAN_X86
+
+static ScanLevel detect_level() {
+#if SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SCAN_AVX2;
+    if (__builtin_cpu_supports("sse2")) return SCAN_SSE2;
+#endif
+    return SCAN_SCALAR;
+}
+
+ScanLevel scan_level() {
+    if (active_level < 0) {
+        active_level = detect_level();
+    }
+    return (ScanLevel)active_level;
+}
+
+void scan_set_level(const ScanLevel level) {
+    const ScanLevel supported = detect_level();
+    active_level = level < supported ? level : supported;
+}
+
+const char* scan_level_to_string(const ScanLevel level) {
+    switch (level) {
+        case SCAN_SCALAR: return "scalar";
+        case SCAN_SSE2: return "sse2";
+        case SCAN_AVX2: return "avx2";
+        default: return "unknown";
+    }
+}
+
+size_t scan_whitespace(const char* text, const size_t position, const size_t length,
+                       int* line, size_t* line_start) {
+    switch (scan_level()) {
+#if SCAN_X86
+        case SCAN_AVX2: return whitespace_avx2(text, position, length, line, line_start);
+        case SCAN_SSE2: return whitespace_sse2(text, position, length, line, line_start);
+#endif
+        default: return whitespace_scalar(text, position, length, line, line_start);
+    }
+}
+
+size_t scan_identifier(const char* text, const size_t position, const size_t length) {
+    switch (scan_level()) {
+#if SCAN_X86
+        case SCAN_AVX2: return identifier_avx2(text, position, length);
+        case SCAN_SSE2: return identifier_sse2(text, position, length);
+#endif
+        default: return identifier_scalar(text, position, length);
+    }
+}
+
+size_t scan_string(const char* text, const size_t position, const size_t length,
+                   int* line, size_t* line_start) {
+    switch (scan_level()) {
+#if SCAN_X86
+        case SCAN_AVX2: return string_avx2(text, position, length, line, line_start);
+        case SCAN_SSE2: return string_sse2(text, position, length, line, line_start);
+#endif
+        default: return string_scalar(text, position, length, line, line_start);
+    }
+}
+
+size_t scan_find_byte(const char* text, const size_t length, const char c) {
+    switch (scan_level()) {
+#if SCAN_X86
+        case SCAN_AVX2: return find_byte_avx2(text, length, c);
+        case SCAN_SSE2: return find_byte_sse2(text, length, c);
+#endif
+        default: return find_byte_scalar(text, length, c);
+    }
+}
+
+size_t scan_nth_byte(const char* text, const size_t length, const char c, const size_t n) {
+    switch (scan_level()) {
+#if SCAN_X86
+        case SCAN_AVX2: return nth_byte_avx2(text, length, c, n);
+        case SCAN_SSE2: return nth_byte_sse2(text, length, c, n);
+#endif
+        default: return nth_byte_scalar(text, length, c, n);
+    }
+}
+
+size_t scan_mismatch(const char* a, const char* b, const size_t length) {
+    switch (scan_level()) {
+#if SCAN_X86
+        case SCAN_AVX2: return mismatch_avx2(a, b, length);
+        case SCAN_SSE2: return mismatch_sse2(a, b, length);
+#endif
+        default: return mismatch_scalar(a, b, length);
+    }
+}
+
+size_t scan_find(const char* text, const size_t length, const char* pattern, const size_t size) {
+    if (size > length) return length;
+    if (size == 1) return scan_find_byte(text, length, pattern[0]);
+    switch (scan_level()) {
+#if SCAN_X86
+        case SCAN_AVX2: return find_avx2(text, length, pattern, size);
+        case SCAN_SSE2: return find_sse2(text, length, pattern, size);
+#endif
+        default: return find_scalar(text, 0, length, pattern, size);
+    }
+}
+
+static size_t clamp(const int64_t value, const size_t limit) {
+    if (value < 0) return 0;
+    return (uint64_t)value < limit ? (size_t)value : limit;
+}
+
+ScanText scan_slice(const ScanText text, const int64_t start, const int64_t count) {
+    const size_t from = clamp(start, text.length);
+    return (ScanText){text.text + from, clamp(count, text.length - from)};
+}
+
+int64_t scan_find_from(const ScanText text, const ScanText pattern, const int64_t from) {
+    const size_t start = clamp(from, text.length);
+    if (pattern.length == 0) return (int64_t)start;
+    const size_t found = start + scan_find(text.text + start, text.length - start, pattern.text, pattern.length);
+    return found < text.length ? (int64_t)found : -1;
+}
+
+ScanText scan_split(const ScanText text, const ScanText separator, int64_t n) {
+    const ScanText none = {text.text, 0};
+    if (n < 0) return none;
+    if (separator.length == 0) return n == 0 ? text : none;
+    size_t start = 0;
+    if (separator.length == 1 && n > 0) {
+        // Piece n starts after separator n - 1, which one pass counts to
+        const size_t found = scan_nth_byte(text.text, text.length, separator.text[0], (size_t)n - 1);
+        if (found == text.length) return none;
+        start = found + 1;
+        n = 0;
+    }
+    for (; n > 0; n--) {
+        const size_t found = start + scan_find(text.text + start, text.length - start, separator.text,
+                                               separator.length);
+        if (found == text.length) return none;
+        start = found + separator.length;
+    }
+    const size_t end = start + scan_find(text.text + start, text.length - start, separator.text, separator.length);
+    return (ScanText){text.text + start, end - start};
+}
+
+int scan_compare(const ScanText a, const ScanText b) {
+    const size_t shorter = a.length < b.length ? a.length : b.length;
+    const size_t position = scan_mismatch(a.text, b.text, shorter);
+    if (position < shorter) return (unsigned char)a.text[position] < (unsigned char)b.text[position] ? -1 : 1;
+    return a.length < b.length ? -1 : a.length > b.length;
+}
@@ -2,22 +2,44 @@
 #include <stdlib.h>
 #include <string.h>
 #include "semantic.h"
+#include "intern.h"
 
 static ScopeStack scope_stack;
 static int in_loop_depth = 0;
+static Arena* arena;
+
+// Variables by slot, in declaration order; integers are widened to doubles as inference finds double values
+static Symbol* slots;
+static int slot_count;
+static int slot_capacity;
+static int declared;
+static bool types_widened;
+static const Expression* update_site;  // The one call that may be a push, put or del, as a whole statement or assigned value
+// Value of the number, negation or arithmetic analyzed last, when it is built from integer literals
+static bool literal_known;
+static int64_t literal_value;
 
 static void push_scope();
 static void pop_scope();
-static SymbolEntry* find_symbol(const char* name);
-static SemanticResult add_symbol(const char* name, const VarType type);
-static VarType get_expression_type(const Expression* expr);
+static SymbolEntry* find_symbol(uint32_t symbol);
+static SemanticResult add_symbol(uint32_t symbol, const VarType type);
 static SemanticResult analyze_expression(Expression* expr);
 static SemanticResult analyze_statement(Statement* stmt);
 
-void semantic_init() {
-    scope_stack.scope_capacity = 10;
-    scope_stack.scope_count = 0;
-    scope_stack.scopes = malloc(sizeof(Scope) * scope_stack.scope_capacity);
+void semantic_init(Arena* owner) {
+    arena = owner;
+    scope_stack.symbol_count = intern_count();
+    scope_stack.visible = arena_alloc(arena, sizeof(int) * (scope_stack.symbol_count + 1));
+    memset(scope_stack.visible, 0xFF, sizeof(int) * (scope_stack.symbol_count + 1)); // All -1
+    scope_stack.binding_capacity = 64;
+    scope_stack.binding_count = 0;
+    scope_stack.bindings = arena_alloc(arena, sizeof(SymbolEntry) * scope_stack.binding_capacity);
+    scope_stack.mark_capacity = 16;
+    scope_stack.depth = 0;
+    scope_stack.marks = arena_alloc(arena, sizeof(int) * scope_stack.mark_capacity);
+    slot_capacity = 64;
+    slot_count = 0;
+    slots = arena_alloc(arena, sizeof(Symbol) * slot_capacity);
     in_loop_depth = 0;
 
     // Create global scope
@@ -25,138 +47,529 @@ void semantic_init() {
 }
 
 void semantic_cleanup() {
-    // Pop all scopes
-    while (scope_stack.scope_count > 0) {
-        pop_scope();
-    }
-
-    if (scope_stack.scopes) {
-        free(scope_stack.scopes);
-        scope_stack.scopes = NULL;
-    }
-    scope_stack.scope_capacity = 0;
+    // Scope storage belongs to the arena
+    scope_stack = (ScopeStack){0};
+    // The slots stay with the analyzed program, in the arena
+    slots = NULL;
+    slot_count = 0;
+    slot_capacity = 0;
+    arena = nullptr;
 }
 
 static void push_scope() {
-    if (scope_stack.scope_count >= scope_stack.scope_capacity) {
-        scope_stack.scope_capacity *= 2;
-        scope_stack.scopes = realloc(scope_stack.scopes,
-                                   sizeof(Scope) * scope_stack.scope_capacity);
-        if (!scope_stack.scopes) {
-            fprintf(stderr, "Memory allocation error in push_scope\n");
-            exit(EXIT_FAILURE);
-        }
+    if (scope_stack.depth >= scope_stack.mark_capacity) {
+        scope_stack.marks = arena_grow(arena, scope_stack.marks, sizeof(int) * scope_stack.mark_capacity,
+                                       sizeof(int) * scope_stack.mark_capacity * 2);
+        scope_stack.mark_capacity *= 2;
     }
+    scope_stack.marks[scope_stack.depth++] = scope_stack.binding_count;
+}
+
+static void pop_scope() {
+    if (scope_stack.depth == 0) return;
 
-    Scope* new_scope = &scope_stack.scopes[scope_stack.scope_count];
-    new_scope->capacity = 100;
-    new_scope->count = 0;
-    new_scope->entries = malloc(sizeof(SymbolEntry) * new_scope->capacity);
-    if (!new_scope->entries) {
-        fprintf(stderr, "Memory allocation error in push_scope\n");
-        exit(EXIT_FAILURE);
+    // Unwind the declarations of the scope, uncovering the bindings they shadowed
+    const int mark = scope_stack.marks[--scope_stack.depth];
+    while (scope_stack.binding_count > mark) {
+        const SymbolEntry* entry = &scope_stack.bindings[--scope_stack.binding_count];
+        scope_stack.visible[entry->symbol] = entry->shadowed;
     }
+}
 
-    scope_stack.scope_count++;
+static SymbolEntry* find_symbol(const uint32_t symbol) {
+    if (symbol >= scope_stack.symbol_count) return NULL;
+    const int binding = scope_stack.visible[symbol];
+    return binding >= 0 ? &scope_stack.bindings[binding] : NULL;
 }
 
-static void pop_scope() {
-    if (scope_stack.scope_count > 0) {
-        scope_stack.scope_count--;
-        Scope* scope = &scope_stack.scopes[scope_stack.scope_count];
+static bool is_numeric(const VarType type) {
+    return type == TYPE_INT || type == TYPE_DOUBLE;
+}
+
+static bool is_array(const VarType type) {
+    return type == TYPE_INT_ARRAY || type == TYPE_DOUBLE_ARRAY;
+}
+
+static bool is_map(const VarType type) {
+    return type == TYPE_DOUBLE_MAP || type == TYPE_STRING_MAP;
+}
+
+static VarType element_type(const VarType array) {
+    return array == TYPE_INT_ARRAY ? TYPE_INT : TYPE_DOUBLE;
+}
 
-        if (scope->entries) {
-            free(scope->entries);
-            scope->entries = NULL;
+// Let a variable also hold values of type; fails if that would mix strings,
+// numbers, arrays and maps. Arrays of integers widen to arrays of doubles, and
+// maps take string keys once one is used: a map value is always empty, so the
+// two map types only differ in the keys that are put into it.
+static bool widen_variable(const int slot, const VarType type) {
+    VarType* current = &slots[slot].type;
+    if (*current == type) return true;
+    if (is_map(*current) && is_map(type)) {
+        if (type == TYPE_STRING_MAP) {
+            *current = TYPE_STRING_MAP;
+            types_widened = true;
         }
-        scope->count = 0;
-        scope->capacity = 0;
+        return true;
     }
+    if (is_array(*current) && is_array(type)) {
+        if (*current == TYPE_INT_ARRAY) {
+            *current = TYPE_DOUBLE_ARRAY;
+            types_widened = true;
+        }
+        return true;
+    }
+    if (!is_numeric(*current) || !is_numeric(type)) return false;
+    if (*current == TYPE_INT) {
+        *current = TYPE_DOUBLE;
+        types_widened = true;
+    }
+    return true;
 }
 
-static SymbolEntry* find_symbol(const char* name) {
-    // Search from current scope back to global scope
-    for (int scope_idx = scope_stack.scope_count - 1; scope_idx >= 0; scope_idx--) {
-        const Scope* scope = &scope_stack.scopes[scope_idx];
-        for (int i = 0; i < scope->count; i++) {
-            if (strcmp(scope->entries[i].name, name) == 0) {
-                return &scope->entries[i];
-            }
-        }
+// Arrays are copied whole, so the arrays an array value is copied from widen
+// along with the variable it is assigned to
+static void widen_array_source(const Expression* expr, const VarType type) {
+    if (expr->kind == EXPR_IDENT) {
+        widen_variable(expr->ident.slot, type);
+    } else if (expr->kind == EXPR_ASSIGN) {
+        widen_variable(expr->assign.slot, type);
+        widen_array_source(expr->assign.value, type);
     }
-    return NULL;
 }
 
-static SemanticResult add_symbol(const char* name, const VarType type) {
-    if (scope_stack.scope_count == 0) {
-        push_scope(); // Create global scope if none exists
+// Give the next declaration its slot; later passes revisit the same declarations in the same order
+static int declare_variable(const uint32_t symbol, const VarType type) {
+    if (declared < slot_count) {
+        widen_variable(declared, type);
+        return declared++;
     }
+    if (slot_count >= slot_capacity) {
+        slots = arena_grow(arena, slots, sizeof(Symbol) * slot_capacity, sizeof(Symbol) * slot_capacity * 2);
+        slot_capacity *= 2;
+    }
+    slots[slot_count].symbol = symbol;
+    slots[slot_count].type = type;
+    slot_count++;
+    return declared++;
+}
 
-    Scope* current_scope = &scope_stack.scopes[scope_stack.scope_count - 1];
+static SemanticResult add_symbol(const uint32_t symbol, const VarType type) {
+    if (scope_stack.depth == 0) {
+        push_scope(); // Create global scope if none exists
+    }
 
     // Check if variable already exists in current scope only
-    for (int i = 0; i < current_scope->count; i++) {
-        if (strcmp(current_scope->entries[i].name, name) == 0) {
-            fprintf(stderr, "Semantic Error: Variable '%s' already declared in current scope\n", name);
-            return SEMANTIC_ERROR_REDECLARED_VAR;
-        }
+    const SymbolEntry* existing = find_symbol(symbol);
+    if (existing && existing->depth == scope_stack.depth) {
+        const Lexeme name = intern_name(symbol);
+        fprintf(stderr, "Semantic Error: Variable '%.*s' already declared in current scope\n",
+                name.length, name.text);
+        return SEMANTIC_ERROR_REDECLARED_VAR;
     }
 
-    if (current_scope->count >= current_scope->capacity) {
-        current_scope->capacity *= 2;
-        current_scope->entries = realloc(current_scope->entries,
-                                       sizeof(SymbolEntry) * current_scope->capacity);
-        if (!current_scope->entries) {
-            fprintf(stderr, "Memory allocation error in add_symbol\n");
-            exit(EXIT_FAILURE);
-        }
+    if (scope_stack.binding_count >= scope_stack.binding_capacity) {
+        scope_stack.bindings = arena_grow(arena, scope_stack.bindings,
+                                          sizeof(SymbolEntry) * scope_stack.binding_capacity,
+                                          sizeof(SymbolEntry) * scope_stack.binding_capacity * 2);
+        scope_stack.binding_capacity *= 2;
     }
 
-    strncpy(current_scope->entries[current_scope->count].name, name, 255);
-    current_scope->entries[current_scope->count].name[255] = '\0';
-    current_scope->entries[current_scope->count].type = type;
-    current_scope->entries[current_scope->count].is_declared = 1;
-    current_scope->count++;
+    SymbolEntry* entry = &scope_stack.bindings[scope_stack.binding_count];
+    entry->symbol = symbol;
+    entry->slot = declare_variable(symbol, type);
+    entry->depth = scope_stack.depth;
+    entry->shadowed = scope_stack.visible[symbol];
+    scope_stack.visible[symbol] = scope_stack.binding_count++;
 
     return SEMANTIC_OK;
 }
 
-static VarType get_expression_type(const Expression* expr) {
-    if (expr->len == 0) return TYPE_DOUBLE;
+static SemanticResult undeclared(const uint32_t symbol) {
+    const Lexeme name = intern_name(symbol);
+    fprintf(stderr, "Semantic Error: Undeclared variable '%.*s'\n", name.length, name.text);
+    return SEMANTIC_ERROR_UNDECLARED_VAR;
+}
+
+// Integer literals that a double holds exactly are typed as integers
+static bool is_integer_literal(const Lexeme text) {
+    return text.length <= 15 && memchr(text.text, '.', text.length) == NULL;
+}
+
+// Whether analyzing the expression sets literal_known for it
+static bool is_arithmetic(const Expression* expr) {
+    return expr->kind == EXPR_NUMBER || expr->kind == EXPR_UNARY || expr->kind == EXPR_BINARY;
+}
+
+// Integer + - * of two values, when the result stays in the int64 range
+static bool fold_in_range(const Ttype op, const int64_t left, const int64_t right, int64_t* result) {
+    switch (op) {
+        case TOKEN_PLUS:
+            if ((right > 0 && left > INT64_MAX - right) || (right < 0 && left < INT64_MIN - right)) return false;
+            *result = left + right;
+            return true;
+        case TOKEN_MINUS:
+            if ((right < 0 && left > INT64_MAX + right) || (right > 0 && left < INT64_MIN + right)) return false;
+            *result = left - right;
+            return true;
+        case TOKEN_MUL:
+            if ((left == -1 && right == INT64_MIN) || (right == -1 && left == INT64_MIN)) return false;
+            *result = (int64_t)((uint64_t)left * (uint64_t)right);
+            return left == 0 || *result / left == right;
+        default:
+            return false;
+    }
+}
+
+// Type of a binary operation on numbers
+static VarType binary_type(const Ttype op, const VarType left, const VarType right) {
+    switch (op) {
+        case TOKEN_PLUS:
+        case TOKEN_MINUS:
+        case TOKEN_MUL:
+            return left == TYPE_INT && right == TYPE_INT ? TYPE_INT : TYPE_DOUBLE;
+        case TOKEN_DIV:
+            return TYPE_DOUBLE;
+        default:
+            // Comparisons, logical and integer operators
+            return TYPE_INT;
+    }
+}
+
+typedef struct {
+    const char* name;
+    int min_args;
+    int max_args;
+    VarType args[3];    // TYPE_STRING, or TYPE_INT for any number
+    VarType result;
+} BuiltinSignature;
+
+static const BuiltinSignature builtins[] = {
+    [BUILTIN_LEN] = {"len", 1, 1, {TYPE_STRING}, TYPE_INT},
+    [BUILTIN_SLICE] = {"slice", 3, 3, {TYPE_STRING, TYPE_INT, TYPE_INT}, TYPE_STRING},
+    [BUILTIN_FIND] = {"find", 2, 3, {TYPE_STRING, TYPE_STRING, TYPE_INT}, TYPE_INT},
+    [BUILTIN_SPLIT] = {"split", 3, 3, {TYPE_STRING, TYPE_STRING, TYPE_INT}, TYPE_STRING},
+    [BUILTIN_COMPARE] = {"compare", 2, 2, {TYPE_STRING, TYPE_STRING}, TYPE_INT},
+    // TYPE_INT_ARRAY for an array variable
+    [BUILTIN_PUSH] = {"push", 2, 2, {TYPE_INT_ARRAY, TYPE_INT}, TYPE_INT},
+    // TYPE_DOUBLE_MAP for a map variable, and TYPE_DOUBLE for a key of its key type
+    [BUILTIN_GET] = {"get", 2, 2, {TYPE_DOUBLE_MAP, TYPE_DOUBLE}, TYPE_DOUBLE},
+    [BUILTIN_PUT] = {"put", 3, 3, {TYPE_DOUBLE_MAP, TYPE_DOUBLE, TYPE_INT}, TYPE_INT},
+    [BUILTIN_HAS] = {"has", 2, 2, {TYPE_DOUBLE_MAP, TYPE_DOUBLE}, TYPE_INT},
+    [BUILTIN_DEL] = {"del", 2, 2, {TYPE_DOUBLE_MAP, TYPE_DOUBLE}, TYPE_INT},
+};
+
+// The builtins that change their array or map
+static bool is_update(const Builtin builtin) {
+    return builtin == BUILTIN_PUSH || builtin == BUILTIN_PUT || builtin == BUILTIN_DEL;
+}
+
+// Whether an expression changes a variable; push, put and del change their array or map
+static bool has_assignment(const Expression* expr) {
+    switch (expr->kind) {
+        case EXPR_ASSIGN:
+        case EXPR_STORE:
+            return true;
+        case EXPR_UNARY:
+            return has_assignment(expr->unary.operand);
+        case EXPR_BINARY:
+            return has_assignment(expr->binary.left) || has_assignment(expr->binary.right);
+        case EXPR_CALL:
+            if (is_update(expr->call.builtin)) return true;
+            for (int i = 0; i < expr->call.count; i++) {
+                if (has_assignment(expr->call.args[i])) return true;
+            }
+            return false;
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->array.count; i++) {
+                if (has_assignment(expr->array.elements[i])) return true;
+            }
+            return false;
+        case EXPR_INDEX:
+            return has_assignment(expr->index.index);
+        default:
+            return false;
+    }
+}
+
+// A key of a map variable; the first string key makes it a map of strings,
+// and it cannot then have number keys, nor the other way around
+static SemanticResult analyze_key(const Expression* map, const Expression* key, const char* builtin,
+                                  const int line) {
+    if (key->type != TYPE_STRING && !is_numeric(key->type)) {
+        fprintf(stderr, "Semantic Error: Argument 2 of '%s' must be a string or a number at line %d\n", builtin, line);
+        return SEMANTIC_ERROR_TYPE_MISMATCH;
+    }
+    const int slot = map->ident.slot;
+    if (key->type == TYPE_STRING) widen_variable(slot, TYPE_STRING_MAP);
+    if ((key->type == TYPE_STRING) != (slots[slot].type == TYPE_STRING_MAP)) {
+        const Lexeme name = intern_name(map->ident.symbol);
+        fprintf(stderr, "Semantic Error: Map '%.*s' cannot have both string and number keys at line %d\n",
+                name.length, name.text, line);
+        return SEMANTIC_ERROR_TYPE_MISMATCH;
+    }
+    return SEMANTIC_OK;
+}
 
-    // Simple type inference based on first token
-    if (expr->token_types[0] == TOKEN_NUMBER) {
-        return TYPE_DOUBLE;
+// Arguments may not assign, so a view taken of one argument still holds when
+// the next is evaluated, and their order cannot matter
+static SemanticResult analyze_call(Expression* expr) {
+    const Lexeme name = intern_name(expr->call.name);
+    int builtin = 0;
+    const int builtin_count = (int)(sizeof(builtins) / sizeof(builtins[0]));
+    while (builtin < builtin_count && !(strlen(builtins[builtin].name) == (size_t)name.length &&
+                                        memcmp(builtins[builtin].name, name.text, (size_t)name.length) == 0)) {
+        builtin++;
+    }
+    if (builtin == builtin_count) {
+        fprintf(stderr, "Semantic Error: Unknown function '%.*s' at line %d\n", name.length, name.text, expr->line);
+        return SEMANTIC_ERROR_INVALID_CALL;
     }
-    if (expr->token_types[0] == TOKEN_STRING) {
-        return TYPE_STRING;
+    const BuiltinSignature* signature = &builtins[builtin];
+    expr->call.builtin = (Builtin)builtin;
+    // Growing an array moves its elements, and a map changes under put and
+    // del, so no other part of the expression may be reading them
+    if (is_update(expr->call.builtin) && expr != update_site) {
+        fprintf(stderr, "Semantic Error: '%s' must be a statement of its own or an assigned value at line %d\n",
+                signature->name, expr->line);
+        return SEMANTIC_ERROR_INVALID_CALL;
+    }
+    if (expr->call.count < signature->min_args || expr->call.count > signature->max_args) {
+        if (signature->min_args == signature->max_args) {
+            fprintf(stderr, "Semantic Error: '%s' takes %d argument%s at line %d\n", signature->name,
+                    signature->min_args, signature->min_args == 1 ? "" : "s", expr->line);
+        } else {
+            fprintf(stderr, "Semantic Error: '%s' takes %d to %d arguments at line %d\n", signature->name,
+                    signature->min_args, signature->max_args, expr->line);
+        }
+        return SEMANTIC_ERROR_INVALID_CALL;
     }
-    if (expr->token_types[0] == TOKEN_IDENT) {
-        const SymbolEntry* symbol = find_symbol(expr->token_values[0]);
-        if (symbol) {
-            return symbol->type;
+    for (int i = 0; i < expr->call.count; i++) {
+        Expression* arg = expr->call.args[i];
+        const SemanticResult result = analyze_expression(arg);
+        if (result != SEMANTIC_OK) return result;
+        if (has_assignment(arg)) {
+            fprintf(stderr, "Semantic Error: Arguments of '%s' cannot assign variables at line %d\n",
+                    signature->name, expr->line);
+            return SEMANTIC_ERROR_INVALID_CALL;
+        }
+        // len also counts the elements of an array variable
+        const bool wants_array = signature->args[i] == TYPE_INT_ARRAY ||
+                                 (expr->call.builtin == BUILTIN_LEN && is_array(arg->type));
+        if (wants_array) {
+            if (arg->kind != EXPR_IDENT || !is_array(arg->type)) {
+                fprintf(stderr, "Semantic Error: Argument %d of '%s' must be an array variable at line %d\n",
+                        i + 1, signature->name, expr->line);
+                return SEMANTIC_ERROR_TYPE_MISMATCH;
+            }
+            continue;
+        }
+        // len also counts the keys of a map variable
+        const bool wants_map = signature->args[i] == TYPE_DOUBLE_MAP ||
+                               (expr->call.builtin == BUILTIN_LEN && is_map(arg->type));
+        if (wants_map) {
+            if (arg->kind != EXPR_IDENT || !is_map(arg->type)) {
+                fprintf(stderr, "Semantic Error: Argument %d of '%s' must be a map variable at line %d\n",
+                        i + 1, signature->name, expr->line);
+                return SEMANTIC_ERROR_TYPE_MISMATCH;
+            }
+            continue;
+        }
+        if (signature->args[i] == TYPE_DOUBLE) {
+            const SemanticResult key = analyze_key(expr->call.args[0], arg, signature->name, expr->line);
+            if (key != SEMANTIC_OK) return key;
+            continue;
         }
-        return TYPE_DOUBLE; // Default fallback
+        const bool wants_string = signature->args[i] == TYPE_STRING;
+        if (wants_string ? arg->type != TYPE_STRING : !is_numeric(arg->type)) {
+            fprintf(stderr, "Semantic Error: Argument %d of '%s' must be a %s at line %d\n", i + 1,
+                    signature->name, wants_string ? "string" : "number", expr->line);
+            return SEMANTIC_ERROR_TYPE_MISMATCH;
+        }
+    }
+    if (expr->call.builtin == BUILTIN_PUSH && expr->call.args[1]->type == TYPE_DOUBLE) {
+        widen_variable(expr->call.args[0]->ident.slot, TYPE_DOUBLE_ARRAY);
+    }
+    expr->type = signature->result;
+    return SEMANTIC_OK;
+}
+
+// A number that an array holds or is indexed by, which may not assign: the
+// element is read or written in place once the operands are known
+static SemanticResult analyze_array_operand(Expression* expr, const char* role, const int line) {
+    const SemanticResult result = analyze_expression(expr);
+    if (result != SEMANTIC_OK) return result;
+    if (!is_numeric(expr->type)) {
+        fprintf(stderr, "Semantic Error: Array %s must be numbers at line %d\n", role, line);
+        return SEMANTIC_ERROR_TYPE_MISMATCH;
+    }
+    if (has_assignment(expr)) {
+        fprintf(stderr, "Semantic Error: Array %s cannot assign variables at line %d\n", role, line);
+        return SEMANTIC_ERROR_TYPE_MISMATCH;
+    }
+    return SEMANTIC_OK;
+}
+
+// array[index], and array[index] = value
+static SemanticResult analyze_index(Expression* expr) {
+    const SymbolEntry* symbol = find_symbol(expr->index.array);
+    if (!symbol) return undeclared(expr->index.array);
+    expr->index.slot = symbol->slot;
+    if (!is_array(slots[symbol->slot].type)) {
+        const Lexeme name = intern_name(expr->index.array);
+        fprintf(stderr, "Semantic Error: '%.*s' is not an array at line %d\n", name.length, name.text, expr->line);
+        return SEMANTIC_ERROR_TYPE_MISMATCH;
+    }
+    SemanticResult result = analyze_array_operand(expr->index.index, "indexes", expr->line);
+    if (result != SEMANTIC_OK) return result;
+    if (expr->kind == EXPR_STORE) {
+        result = analyze_array_operand(expr->index.value, "elements", expr->line);
+        if (result != SEMANTIC_OK) return result;
+        if (expr->index.value->type == TYPE_DOUBLE) widen_variable(symbol->slot, TYPE_DOUBLE_ARRAY);
     }
+    expr->type = element_type(slots[symbol->slot].type);
+    return SEMANTIC_OK;
+}
 
-    return TYPE_DOUBLE;
+// Maps are never copied: a map variable is only ever given an empty map
+static SemanticResult check_map_value(const Expression* value) {
+    if (value == nullptr || !is_map(value->type) || value->kind == EXPR_MAP) return SEMANTIC_OK;
+    fprintf(stderr, "Semantic Error: A map cannot be copied at line %d\n", value->line);
+    return SEMANTIC_ERROR_TYPE_MISMATCH;
 }
 
+// Check an expression tree and record the type of every node
 static SemanticResult analyze_expression(Expression* expr) {
     if (!expr) return SEMANTIC_OK;
 
-    for (int i = 0; i < expr->len; i++) {
-        if (expr->token_types[i] == TOKEN_IDENT) {
-            SymbolEntry* symbol = find_symbol(expr->token_values[i]);
-            if (!symbol) {
-                fprintf(stderr, "Semantic Error: Undeclared variable '%s'\n",
-                       expr->token_values[i]);
-                return SEMANTIC_ERROR_UNDECLARED_VAR;
+    SemanticResult result;
+    switch (expr->kind) {
+        case EXPR_NUMBER:
+            expr->type = is_integer_literal(expr->number.text) ? TYPE_INT : TYPE_DOUBLE;
+            literal_known = expr->type == TYPE_INT;
+            literal_value = (int64_t)expr->number.value;
+            return SEMANTIC_OK;
+        case EXPR_STRING:
+            expr->type = TYPE_STRING;
+            return SEMANTIC_OK;
+        case EXPR_IDENT: {
+            const SymbolEntry* symbol = find_symbol(expr->ident.symbol);
+            if (!symbol) return undeclared(expr->ident.symbol);
+            expr->ident.slot = symbol->slot;
+            expr->type = slots[symbol->slot].type;
+            return SEMANTIC_OK;
+        }
+        case EXPR_UNARY:
+            result = analyze_expression(expr->unary.operand);
+            if (result != SEMANTIC_OK) return result;
+            if (!is_numeric(expr->unary.operand->type)) {
+                fprintf(stderr, "Semantic Error: Operator '%s' needs a number at line %d\n",
+                        token_type_to_string(expr->op), expr->line);
+                return SEMANTIC_ERROR_TYPE_MISMATCH;
             }
+            expr->type = expr->op == TOKEN_MINUS ? expr->unary.operand->type : TYPE_INT;
+            literal_known = literal_known && is_arithmetic(expr->unary.operand) && expr->op == TOKEN_MINUS &&
+                            literal_value != INT64_MIN;
+            if (literal_known) literal_value = -literal_value;
+            return SEMANTIC_OK;
+        case EXPR_BINARY: {
+            result = analyze_expression(expr->binary.left);
+            if (result != SEMANTIC_OK) return result;
+            const bool left_known = literal_known && is_arithmetic(expr->binary.left);
+            const int64_t left_value = literal_value;
+            result = analyze_expression(expr->binary.right);
+            if (result != SEMANTIC_OK) return result;
+            const bool right_known = literal_known && is_arithmetic(expr->binary.right);
+            literal_known = false;
+            // + joins two strings, and == and != compare them
+            if (expr->binary.left->type == TYPE_STRING && expr->binary.right->type == TYPE_STRING) {
+                if (expr->op == TOKEN_PLUS) {
+                    expr->type = TYPE_STRING;
+                    return SEMANTIC_OK;
+                }
+                if (expr->op == TOKEN_EQEQ || expr->op == TOKEN_NEQ) {
+                    // Compared in place, like the arguments of a call
+                    if (has_assignment(expr->binary.left) || has_assignment(expr->binary.right)) {
+                        fprintf(stderr, "Semantic Error: Compared strings cannot assign variables at line %d\n",
+                                expr->line);
+                        return SEMANTIC_ERROR_TYPE_MISMATCH;
+                    }
+                    expr->type = TYPE_INT;
+                    return SEMANTIC_OK;
+                }
+            }
+            if (!is_numeric(expr->binary.left->type) || !is_numeric(expr->binary.right->type)) {
+                fprintf(stderr, "Semantic Error: Operator '%s' needs numbers at line %d\n",
+                        token_type_to_string(expr->op), expr->line);
+                return SEMANTIC_ERROR_TYPE_MISMATCH;
+            }
+            expr->type = binary_type(expr->op, expr->binary.left->type, expr->binary.right->type);
+            // Literals whose sum or product leaves the int64 range are added
+            // or multiplied as doubles, as every number was before integers
+            // were inferred
+            if (expr->type == TYPE_INT && left_known && right_known) {
+                literal_known = fold_in_range(expr->op, left_value, literal_value, &literal_value);
+                if (!literal_known && (expr->op == TOKEN_PLUS || expr->op == TOKEN_MINUS || expr->op == TOKEN_MUL)) {
+                    expr->type = TYPE_DOUBLE;
+                }
+            }
+            return SEMANTIC_OK;
+        }
+        case EXPR_ASSIGN: {
+            const SymbolEntry* symbol = find_symbol(expr->assign.target);
+            if (!symbol) return undeclared(expr->assign.target);
+            result = analyze_expression(expr->assign.value);
+            if (result != SEMANTIC_OK) return result;
+            expr->assign.slot = symbol->slot;
+            if (!widen_variable(symbol->slot, expr->assign.value->type)) {
+                const Lexeme name = intern_name(expr->assign.target);
+                fprintf(stderr, "Semantic Error: Type mismatch assigning to '%.*s' at line %d\n",
+                        name.length, name.text, expr->line);
+                return SEMANTIC_ERROR_TYPE_MISMATCH;
+            }
+            if (is_array(slots[symbol->slot].type)) widen_array_source(expr->assign.value, slots[symbol->slot].type);
+            result = check_map_value(expr->assign.value);
+            if (result != SEMANTIC_OK) return result;
+            expr->type = slots[symbol->slot].type;
+            return SEMANTIC_OK;
         }
+        case EXPR_CALL:
+            return analyze_call(expr);
+        case EXPR_ARRAY:
+            // An array of integers until an element is a double
+            expr->type = TYPE_INT_ARRAY;
+            for (int i = 0; i < expr->array.count; i++) {
+                result = analyze_array_operand(expr->array.elements[i], "elements", expr->line);
+                if (result != SEMANTIC_OK) return result;
+                if (expr->array.elements[i]->type == TYPE_DOUBLE) expr->type = TYPE_DOUBLE_ARRAY;
+            }
+            return SEMANTIC_OK;
+        case EXPR_INDEX:
+        case EXPR_STORE:
+            return analyze_index(expr);
+        case EXPR_MAP:
+            // Keyed by numbers until a string key is put into its variable
+            expr->type = TYPE_DOUBLE_MAP;
+            return SEMANTIC_OK;
+        default:
+            return SEMANTIC_OK;
     }
+}
 
-    return SEMANTIC_OK;
+// Arrays are only declared, assigned, indexed and counted, and maps only
+// declared, emptied and passed to their builtins
+static SemanticResult reject_container(const Expression* expr, const char* use) {
+    if (expr == nullptr || (!is_array(expr->type) && !is_map(expr->type))) return SEMANTIC_OK;
+    fprintf(stderr, "Semantic Error: %s cannot be %s at line %d\n", is_map(expr->type) ? "A map" : "An array", use,
+            expr->line);
+    return SEMANTIC_ERROR_TYPE_MISMATCH;
+}
+
+// The expression a statement assigns a push to, if any
+static const Expression* assigned_call(const Expression* expr) {
+    if (expr == nullptr) return nullptr;
+    if (expr->kind == EXPR_ASSIGN) expr = expr->assign.value;
+    return expr->kind == EXPR_CALL ? expr : nullptr;
 }
 
 static SemanticResult analyze_statement(Statement* stmt) {
@@ -164,22 +577,33 @@ static SemanticResult analyze_statement(Statement* stmt) {
 
     switch (stmt->type) {
         case STMT_LET: {
-            const LetStatement* let_stmt = &stmt->let_stmt;
+            LetStatement* let_stmt = &stmt->let_stmt;
             SemanticResult result = SEMANTIC_OK;
 
             if (let_stmt->expr) {
+                update_site = assigned_call(let_stmt->expr);
                 result = analyze_expression(let_stmt->expr);
+                update_site = nullptr;
+                if (result != SEMANTIC_OK) return result;
+                result = check_map_value(let_stmt->expr);
                 if (result != SEMANTIC_OK) return result;
             }
 
-            const VarType var_type = let_stmt->expr ? get_expression_type(let_stmt->expr) : TYPE_DOUBLE;
-            return add_symbol(let_stmt->ident, var_type);
+            // A variable declared without a value is numeric, and integral until shown otherwise
+            const VarType var_type = let_stmt->expr ? let_stmt->expr->type : TYPE_INT;
+            result = add_symbol(let_stmt->ident, var_type);
+            if (result != SEMANTIC_OK) return result;
+            let_stmt->slot = find_symbol(let_stmt->ident)->slot;
+            if (is_array(slots[let_stmt->slot].type)) widen_array_source(let_stmt->expr, slots[let_stmt->slot].type);
+            return SEMANTIC_OK;
         }
 
         case STMT_IF: {
             const IfStatement* if_stmt = &stmt->if_stmt;
             SemanticResult result = analyze_expression(if_stmt->condition);
             if (result != SEMANTIC_OK) return result;
+            result = reject_container(if_stmt->condition, "tested");
+            if (result != SEMANTIC_OK) return result;
 
             // Push scope for if block
             push_scope();
@@ -212,6 +636,8 @@ static SemanticResult analyze_statement(Statement* stmt) {
             const WhileStatement* while_stmt = &stmt->while_stmt;
             SemanticResult result = analyze_expression(while_stmt->condition);
             if (result != SEMANTIC_OK) return result;
+            result = reject_container(while_stmt->condition, "tested");
+            if (result != SEMANTIC_OK) return result;
 
             in_loop_depth++;
             push_scope(); // Push scope for while body
@@ -230,15 +656,37 @@ static SemanticResult analyze_statement(Statement* stmt) {
             return SEMANTIC_OK;
         }
 
-        case STMT_EXPR:
-            return analyze_expression(stmt->expr_stmt.expr);
-        case STMT_OUT:
-            return analyze_expression(stmt->out_stmt.expr);
+        case STMT_EXPR: {
+            Expression* expr = stmt->expr_stmt.expr;
+            update_site = assigned_call(expr);
+            const SemanticResult result = analyze_expression(expr);
+            update_site = nullptr;
+            if (result != SEMANTIC_OK) return result;
+            if (expr->kind == EXPR_ARRAY || expr->kind == EXPR_MAP) {
+                fprintf(stderr, "Semantic Error: %s literal must be assigned at line %d\n",
+                        expr->kind == EXPR_MAP ? "A map" : "An array", expr->line);
+                return SEMANTIC_ERROR_TYPE_MISMATCH;
+            }
+            return SEMANTIC_OK;
+        }
+        case STMT_OUT: {
+            const SemanticResult result = analyze_expression(stmt->out_stmt.expr);
+            if (result != SEMANTIC_OK) return result;
+            return reject_container(stmt->out_stmt.expr, "printed");
+        }
         case STMT_IN: {
-            SymbolEntry* symbol = find_symbol(stmt->in_stmt.ident);
-            if (!symbol) {
-                fprintf(stderr, "Semantic Error: Undeclared variable '%s'\n", stmt->in_stmt.ident);
-                return SEMANTIC_ERROR_UNDECLARED_VAR;
+            const SymbolEntry* symbol = find_symbol(stmt->in_stmt.ident);
+            if (!symbol) return undeclared(stmt->in_stmt.ident);
+            stmt->in_stmt.slot = symbol->slot;
+            if (is_array(slots[symbol->slot].type) || is_map(slots[symbol->slot].type)) {
+                const Lexeme name = intern_name(stmt->in_stmt.ident);
+                fprintf(stderr, "Semantic Error: Cannot read input into %s '%.*s'\n",
+                        is_map(slots[symbol->slot].type) ? "map" : "array", name.length, name.text);
+                return SEMANTIC_ERROR_TYPE_MISMATCH;
+            }
+            // Input is read as a double
+            if (slots[symbol->slot].type != TYPE_STRING) {
+                widen_variable(symbol->slot, TYPE_DOUBLE);
             }
             return SEMANTIC_OK;
         }
@@ -256,22 +704,491 @@ static SemanticResult analyze_statement(Statement* stmt) {
             }
             return SEMANTIC_OK;
         }
-        case STMT_RETURN:
-            return stmt->ret_stmt.expr ? analyze_expression(stmt->ret_stmt.expr) : SEMANTIC_OK;
+        case STMT_RETURN: {
+            if (!stmt->ret_stmt.expr) return SEMANTIC_OK;
+            const SemanticResult result = analyze_expression(stmt->ret_stmt.expr);
+            if (result != SEMANTIC_OK) return result;
+            return reject_container(stmt->ret_stmt.expr, "returned");
+        }
         default:
             return SEMANTIC_OK;
     }
 }
 
+// ---------------------------------------------------------------------------
+// Bounds proofs
+//
+// A counter is an integer variable that is only ever set to a literal or
+// grown: it is declared with an integer literal, and every assignment to it
+// is an integer literal or the counter plus a literal, each at most
+// COUNTER_LITERAL_MAX. Literals have no sign, and a counter is never read
+// from input, so it starts non-negative and only grows; wrapping past
+// INT64_MAX would take 2^47 steps. In `while i < len(a)` on a counter i, a[i]
+// is in bounds until the body changes i or assigns a, since push only grows
+// an array. When the condition writes nothing, the body's last statement is
+// its only assignment to i, and the body never assigns a, every a[i] before
+// that statement is marked in bounds.
+
+#define COUNTER_LITERAL_MAX 65535
+
+static bool* counters;      // By slot
+
+static bool is_counter_literal(const Expression* value) {
+    return value->kind == EXPR_NUMBER && value->type == TYPE_INT && value->number.value <= COUNTER_LITERAL_MAX;
+}
+
+static bool is_counter_step(const int slot, const Expression* value) {
+    if (value->kind == EXPR_NUMBER) return is_counter_literal(value);
+    if (value->kind != EXPR_BINARY || value->op != TOKEN_PLUS) return false;
+    const Expression* left = value->binary.left;
+    const Expression* right = value->binary.right;
+    if (right->kind == EXPR_IDENT) {
+        const Expression* swap = left;
+        left = right;
+        right = swap;
+    }
+    return left->kind == EXPR_IDENT && left->ident.slot == slot && is_counter_literal(right);
+}
+
+static void visit_expression(Expression* expr, void (*visit)(Expression*, void*), void* context) {
+    if (expr == nullptr) return;
+    visit(expr, context);
+    switch (expr->kind) {
+        case EXPR_UNARY:
+            visit_expression(expr->unary.operand, visit, context);
+            break;
+        case EXPR_BINARY:
+            visit_expression(expr->binary.left, visit, context);
+            visit_expression(expr->binary.right, visit, context);
+            break;
+        case EXPR_ASSIGN:
+            visit_expression(expr->assign.value, visit, context);
+            break;
+        case EXPR_CALL:
+            for (int i = 0; i < expr->call.count; i++) visit_expression(expr->call.args[i], visit, context);
+            break;
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->array.count; i++) visit_expression(expr->array.elements[i], visit, context);
+            break;
+        case EXPR_INDEX:
+        case EXPR_STORE:
+            visit_expression(expr->index.index, visit, context);
+            visit_expression(expr->index.value, visit, context);
+            break;
+        default:
+            break;
+    }
+}
+
+// Every expression of the statements, nested blocks included
+static void visit_statements(const Statement* statements, const int count,
+                             void (*visit)(Expression*, void*), void* context) {
+    for (int i = 0; i < count; i++) {
+        const Statement* stmt = &statements[i];
+        switch (stmt->type) {
+            case STMT_LET: visit_expression(stmt->let_stmt.expr, visit, context); break;
+            case STMT_EXPR: visit_expression(stmt->expr_stmt.expr, visit, context); break;
+            case STMT_OUT: visit_expression(stmt->out_stmt.expr, visit, context); break;
+            case STMT_RETURN: visit_expression(stmt->ret_stmt.expr, visit, context); break;
+            case STMT_IF:
+                visit_expression(stmt->if_stmt.condition, visit, context);
+                visit_statements(stmt->if_stmt.if_block, stmt->if_stmt.if_count, visit, context);
+                visit_statements(stmt->if_stmt.else_block, stmt->if_stmt.else_count, visit, context);
+                break;
+            case STMT_WHILE:
+                visit_expression(stmt->while_stmt.condition, visit, context);
+                visit_statements(stmt->while_stmt.body, stmt->while_stmt.body_count, visit, context);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void check_counter_step(Expression* expr, void* context) {
+    (void)context;
+    if (expr->kind == EXPR_ASSIGN && !is_counter_step(expr->assign.slot, expr->assign.value)) {
+        counters[expr->assign.slot] = false;
+    }
+}
+
+// Clear the counters that a let or in gives another value, or that a let
+// leaves without one
+static void find_counters(const Statement* statements, const int count) {
+    for (int i = 0; i < count; i++) {
+        const Statement* stmt = &statements[i];
+        switch (stmt->type) {
+            case STMT_LET: {
+                const Expression* init = stmt->let_stmt.expr;
+                if (init == nullptr || !is_counter_step(stmt->let_stmt.slot, init)) counters[stmt->let_stmt.slot] = false;
+                break;
+            }
+            case STMT_IN:
+                counters[stmt->in_stmt.slot] = false;
+                break;
+            case STMT_IF:
+                find_counters(stmt->if_stmt.if_block, stmt->if_stmt.if_count);
+                find_counters(stmt->if_stmt.else_block, stmt->if_stmt.else_count);
+                break;
+            case STMT_WHILE:
+                find_counters(stmt->while_stmt.body, stmt->while_stmt.body_count);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+typedef struct {
+    int slot;
+    bool found;
+} SlotSearch;
+
+static void find_assignment(Expression* expr, void* context) {
+    SlotSearch* search = context;
+    if (expr->kind == EXPR_ASSIGN && expr->assign.slot == search->slot) search->found = true;
+}
+
+static bool assigns_slot(const Statement* statements, const int count, const int slot) {
+    SlotSearch search = {slot, false};
+    visit_statements(statements, count, find_assignment, &search);
+    return search.found;
+}
+
+static void find_write(Expression* expr, void* context) {
+    bool* found = context;
+    if (expr->kind == EXPR_ASSIGN || expr->kind == EXPR_STORE) *found = true;
+    if (expr->kind == EXPR_CALL && (expr->call.builtin == BUILTIN_PUSH || expr->call.builtin == BUILTIN_PUT ||
+                                    expr->call.builtin == BUILTIN_DEL)) {
+        *found = true;
+    }
+}
+
+// Whether evaluating the expression can change a variable
+static bool writes(Expression* expr) {
+    bool found = false;
+    visit_expression(expr, find_write, &found);
+    return found;
+}
+
+typedef struct {
+    int array;
+    int counter;
+} BoundsProof;
+
+static void mark_in_bounds(Expression* expr, void* context) {
+    const BoundsProof* proof = context;
+    if ((expr->kind == EXPR_INDEX || expr->kind == EXPR_STORE) && expr->index.slot == proof->array &&
+        expr->index.index->kind == EXPR_IDENT && expr->index.index->ident.slot == proof->counter) {
+        expr->index.in_bounds = true;
+    }
+}
+
+// Mark the indexing proven by one test of a loop condition, or by each test
+// of a conjunction
+static void prove_loop(const Expression* condition, const WhileStatement* loop) {
+    if (condition->kind != EXPR_BINARY) return;
+    if (condition->op == TOKEN_AND) {
+        prove_loop(condition->binary.left, loop);
+        prove_loop(condition->binary.right, loop);
+        return;
+    }
+    const Expression* counter = condition->binary.left;
+    const Expression* length = condition->binary.right;
+    if (condition->op != TOKEN_LT || counter->kind != EXPR_IDENT || length->kind != EXPR_CALL ||
+        length->call.builtin != BUILTIN_LEN || length->call.args[0]->kind != EXPR_IDENT ||
+        !is_array(length->call.args[0]->type)) {
+        return;
+    }
+    const int i = counter->ident.slot;
+    const int a = length->call.args[0]->ident.slot;
+    if (!counters[i] || slots[i].type != TYPE_INT || loop->body_count == 0) return;
+    const Statement* last = &loop->body[loop->body_count - 1];
+    if (last->type != STMT_EXPR || last->expr_stmt.expr->kind != EXPR_ASSIGN ||
+        last->expr_stmt.expr->assign.slot != i) {
+        return;
+    }
+    if (assigns_slot(loop->body, loop->body_count - 1, i) || assigns_slot(loop->body, loop->body_count, a)) return;
+    BoundsProof proof = {a, i};
+    visit_statements(loop->body, loop->body_count - 1, mark_in_bounds, &proof);
+}
+
+static void prove_bounds(const Statement* statements, const int count) {
+    for (int i = 0; i < count; i++) {
+        const Statement* stmt = &statements[i];
+        if (stmt->type == STMT_IF) {
+            prove_bounds(stmt->if_stmt.if_block, stmt->if_stmt.if_count);
+            prove_bounds(stmt->if_stmt.else_block, stmt->if_stmt.else_count);
+        } else if (stmt->type == STMT_WHILE) {
+            // A write in the condition could move the counter past the test
+            if (!writes(stmt->while_stmt.condition)) prove_loop(stmt->while_stmt.condition, &stmt->while_stmt);
+            prove_bounds(stmt->while_stmt.body, stmt->while_stmt.body_count);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Growth
+//
+// Integer + - * wrap around at 64 bits, where every number used to be a
+// double. A variable that only ever adds an amount to its old value takes an
+// impractical number of steps to leave the int64 range, but one that
+// multiplies its old value, or adds it to itself, grows geometrically and
+// would wrap within a few dozen. Such variables are widened to double.
+//
+// A variable depends on the integer variables and array elements that it is
+// assigned from through + - * and negation; % & | ^ << >>, comparisons and
+// calls bound or reshape a value, so they end the chain. Variables that
+// depend on each other in a cycle form a component. An assignment grows
+// geometrically when its value multiplies a member of the target's
+// component by anything but a literal -1, 0 or 1, or counts members twice.
+
+typedef struct {
+    int target;
+    const Expression* value;
+} Assignment;
+
+static Assignment* assignments;
+static int assignment_count;
+static int assignment_capacity;
+static int* dependencies;       // Slot of each dependency, grouped by assignment
+static int dependency_count;
+static int dependency_capacity;
+static int* components;         // By slot
+
+static bool is_integral(const VarType type) {
+    return type == TYPE_INT || type == TYPE_INT_ARRAY;
+}
+
+static void add_assignment(const int target, const Expression* value) {
+    if (!is_integral(slots[target].type)) return;
+    if (assignment_count >= assignment_capacity) {
+        assignments = arena_grow(arena, assignments, sizeof(Assignment) * assignment_capacity,
+                                 sizeof(Assignment) * assignment_capacity * 2);
+        assignment_capacity *= 2;
+    }
+    assignments[assignment_count++] = (Assignment){target, value};
+}
+
+static void find_assignment_value(Expression* expr, void* context) {
+    (void)context;
+    if (expr->kind == EXPR_ASSIGN) add_assignment(expr->assign.slot, expr->assign.value);
+    if (expr->kind == EXPR_STORE) add_assignment(expr->index.slot, expr->index.value);
+    if (expr->kind == EXPR_CALL && expr->call.builtin == BUILTIN_PUSH && expr->call.args[0]->kind == EXPR_IDENT) {
+        add_assignment(expr->call.args[0]->ident.slot, expr->call.args[1]);
+    }
+}
+
+static void find_let_values(const Statement* statements, const int count) {
+    for (int i = 0; i < count; i++) {
+        const Statement* stmt = &statements[i];
+        if (stmt->type == STMT_LET && stmt->let_stmt.expr != nullptr) {
+            add_assignment(stmt->let_stmt.slot, stmt->let_stmt.expr);
+        } else if (stmt->type == STMT_IF) {
+            find_let_values(stmt->if_stmt.if_block, stmt->if_stmt.if_count);
+            find_let_values(stmt->if_stmt.else_block, stmt->if_stmt.else_count);
+        } else if (stmt->type == STMT_WHILE) {
+            find_let_values(stmt->while_stmt.body, stmt->while_stmt.body_count);
+        }
+    }
+}
+
+// The variable an integer value or array element read comes from, or -1
+static int read_slot(const Expression* expr) {
+    if (!is_integral(expr->type)) return -1;
+    if (expr->kind == EXPR_IDENT) return expr->ident.slot;
+    if (expr->kind == EXPR_INDEX) return expr->index.slot;
+    return -1;
+}
+
+static void add_dependencies(const Expression* expr) {
+    const int slot = read_slot(expr);
+    if (slot >= 0) {
+        if (dependency_count >= dependency_capacity) {
+            dependencies = arena_grow(arena, dependencies, sizeof(int) * dependency_capacity,
+                                      sizeof(int) * dependency_capacity * 2);
+            dependency_capacity *= 2;
+        }
+        dependencies[dependency_count++] = slot;
+        return;
+    }
+    switch (expr->kind) {
+        case EXPR_UNARY:
+            if (expr->op == TOKEN_MINUS) add_dependencies(expr->unary.operand);
+            break;
+        case EXPR_BINARY:
+            if (expr->op == TOKEN_PLUS || expr->op == TOKEN_MINUS || expr->op == TOKEN_MUL) {
+                add_dependencies(expr->binary.left);
+                add_dependencies(expr->binary.right);
+            }
+            break;
+        case EXPR_ASSIGN:
+            add_dependencies(expr->assign.value);
+            break;
+        case EXPR_ARRAY:
+            for (int i = 0; i < expr->array.count; i++) add_dependencies(expr->array.elements[i]);
+            break;
+        default:
+            break;
+    }
+}
+
+// Tarjan's algorithm over the dependencies of each slot, with explicit
+// stacks so that a long chain of variables cannot overflow the C stack
+static void find_components(const int* first, const int* edges) {
+    int* index = arena_alloc(arena, sizeof(int) * slot_count);
+    int* low = arena_alloc(arena, sizeof(int) * slot_count);
+    int* next_edge = arena_alloc(arena, sizeof(int) * slot_count);
+    int* path = arena_alloc(arena, sizeof(int) * slot_count);
+    int* open = arena_alloc(arena, sizeof(int) * slot_count);
+    for (int slot = 0; slot < slot_count; slot++) {
+        index[slot] = -1;
+        components[slot] = -1;
+    }
+    int visited = 0;
+    int found = 0;
+    int open_count = 0;
+    for (int root = 0; root < slot_count; root++) {
+        if (index[root] >= 0) continue;
+        int depth = 0;
+        path[depth++] = root;
+        index[root] = low[root] = visited++;
+        next_edge[root] = first[root];
+        open[open_count++] = root;
+        while (depth > 0) {
+            const int slot = path[depth - 1];
+            if (next_edge[slot] < first[slot + 1]) {
+                const int other = edges[next_edge[slot]++];
+                if (index[other] < 0) {
+                    index[other] = low[other] = visited++;
+                    next_edge[other] = first[other];
+                    open[open_count++] = other;
+                    path[depth++] = other;
+                } else if (components[other] < 0 && index[other] < low[slot]) {
+                    low[slot] = index[other];
+                }
+                continue;
+            }
+            depth--;
+            if (depth > 0 && low[slot] < low[path[depth - 1]]) low[path[depth - 1]] = low[slot];
+            if (low[slot] == index[slot]) {
+                int member;
+                do {
+                    member = open[--open_count];
+                    components[member] = found;
+                } while (member != slot);
+                found++;
+            }
+        }
+    }
+}
+
+static bool is_unit_factor(const Expression* expr) {
+    if (expr->kind == EXPR_UNARY && expr->op == TOKEN_MINUS) expr = expr->unary.operand;
+    return expr->kind == EXPR_NUMBER && expr->type == TYPE_INT && expr->number.value <= 1;
+}
+
+// How many times a value counts members of the component, 2 standing for
+// twice or more and for any product of one
+static int growth(const Expression* expr, const int component) {
+    const int slot = read_slot(expr);
+    if (slot >= 0) return components[slot] == component;
+    switch (expr->kind) {
+        case EXPR_UNARY:
+            return expr->op == TOKEN_MINUS ? growth(expr->unary.operand, component) : 0;
+        case EXPR_BINARY: {
+            if (expr->op != TOKEN_PLUS && expr->op != TOKEN_MINUS && expr->op != TOKEN_MUL) return 0;
+            const int left = growth(expr->binary.left, component);
+            const int right = growth(expr->binary.right, component);
+            if (expr->op != TOKEN_MUL) return left + right < 2 ? left + right : 2;
+            if (left == 0 && (right == 0 || is_unit_factor(expr->binary.left))) return right;
+            if (right == 0 && is_unit_factor(expr->binary.right)) return left;
+            return 2;
+        }
+        case EXPR_ASSIGN:
+            return growth(expr->assign.value, component);
+        case EXPR_ARRAY: {
+            int most = 0;
+            for (int i = 0; i < expr->array.count; i++) {
+                const int element = growth(expr->array.elements[i], component);
+                if (element > most) most = element;
+            }
+            return most;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Widen the integer variables and arrays that an assignment grows
+// geometrically
+static void widen_growing(const Program* program) {
+    assignment_count = 0;
+    assignment_capacity = 64;
+    assignments = arena_alloc(arena, sizeof(Assignment) * assignment_capacity);
+    find_let_values(program->statements, program->count);
+    visit_statements(program->statements, program->count, find_assignment_value, nullptr);
+
+    // Each slot's dependencies, from every assignment to it
+    int* starts = arena_alloc(arena, sizeof(int) * (assignment_count + 1));
+    dependency_count = 0;
+    dependency_capacity = 64;
+    dependencies = arena_alloc(arena, sizeof(int) * dependency_capacity);
+    for (int i = 0; i < assignment_count; i++) {
+        starts[i] = dependency_count;
+        add_dependencies(assignments[i].value);
+    }
+    starts[assignment_count] = dependency_count;
+    int* first = arena_alloc_zeroed(arena, sizeof(int) * (slot_count + 1));
+    for (int i = 0; i < assignment_count; i++) first[assignments[i].target + 1] += starts[i + 1] - starts[i];
+    for (int slot = 0; slot < slot_count; slot++) first[slot + 1] += first[slot];
+    int* filled = arena_alloc(arena, sizeof(int) * (slot_count + 1));
+    memcpy(filled, first, sizeof(int) * (slot_count + 1));
+    int* edges = arena_alloc(arena, sizeof(int) * (dependency_count > 0 ? dependency_count : 1));
+    for (int i = 0; i < assignment_count; i++) {
+        for (int d = starts[i]; d < starts[i + 1]; d++) edges[filled[assignments[i].target]++] = dependencies[d];
+    }
+
+    components = arena_alloc(arena, sizeof(int) * (slot_count > 0 ? slot_count : 1));
+    find_components(first, edges);
+    for (int i = 0; i < assignment_count; i++) {
+        const int target = assignments[i].target;
+        if (growth(assignments[i].value, components[target]) < 2) continue;
+        widen_variable(target, slots[target].type == TYPE_INT ? TYPE_DOUBLE : TYPE_DOUBLE_ARRAY);
+    }
+    components = nullptr;
+    assignments = nullptr;
+    dependencies = nullptr;
+}
+
 SemanticResult semantic_analyze(Program* program) {
     if (!program) return SEMANTIC_OK;
 
-    for (int i = 0; i < program->count; i++) {
-        const SemanticResult result = analyze_statement(&program->statements[i]);
-        if (result != SEMANTIC_OK) {
-            return result;
+    // Each pass sees the types widened by the one before it, so repeat until
+    // no variable changes and every node carries its final type
+    do {
+        types_widened = false;
+        declared = 0;
+        while (scope_stack.depth > 0) pop_scope();
+        push_scope();
+
+        for (int i = 0; i < program->count; i++) {
+            const SemanticResult result = analyze_statement(&program->statements[i]);
+            if (result != SEMANTIC_OK) {
+                return result;
+            }
         }
-    }
+        if (!types_widened) widen_growing(program);
+    } while (types_widened);
+
+    counters = arena_alloc(arena, sizeof(bool) * (slot_count > 0 ? slot_count : 1));
+    for (int slot = 0; slot < slot_count; slot++) counters[slot] = true;
+    visit_statements(program->statements, program->count, check_counter_step, nullptr);
+    find_counters(program->statements, program->count);
+    prove_bounds(program->statements, program->count);
+    counters = nullptr;
 
+    program->symbols = slots;
+    program->symbol_count = slot_count;
     return SEMANTIC_OK;
-}
\ No newline at end of file
+}
@@ -0,0 +1,583 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include "vm.h"
+#include "scan.h"
+
+// Each handler reads its operands from the words after the opcode and jumps
+// straight to the next handler. With GCC and Clang the jump goes through a
+// table of label addresses, one indirect branch per handler, which predicts
+// far better than the single one of a switch; other compilers get the switch.
+// Integer arithmetic wraps and shift counts are taken modulo 64, as in the
+// code the other backends generate.
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// A string slot; data is allocated on the first write and kept NUL-terminated
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} VmString;
+
+// An array slot, of register values
+typedef struct {
+    BytecodeValue* data;
+    int64_t length;
+    int64_t capacity;
+} VmArray;
+
+// A map slot: a Swiss table, as in the runtime of the generated C. Groups of
+// 16 slots each have 16 control bytes, empty, deleted, or 7 bits of the
+// hash of the slot's key, which one SSE2 compare checks at once.
+#define MAP_GROUP 16
+#define MAP_EMPTY 0x80
+#define MAP_DELETED 0xFE
+
+typedef struct {
+    uint64_t hash;
+    char* text;         // A copy of a string key
+    size_t length;
+    double value;
+} VmMapEntry;
+
+typedef struct {
+    uint8_t* control;
+    VmMapEntry* entries;
+    int64_t count;      // Keys
+    int64_t used;       // Keys and deleted slots
+    int64_t capacity;   // A power of two, and a multiple of the group
+} VmMap;
+
+// Whether printf should print a double without decimals, as floor(x) == ceil(x)
+static bool is_whole(const double value) {
+    if (value != value) return false;
+    if (value >= 4503599627370496.0 || value <= -4503599627370496.0) return true;
+    return (double)(int64_t)value == value;
+}
+
+// Make room for length bytes and a NUL, at least doubling the buffer
+static void string_reserve(VmString* string, const size_t length) {
+    if (length < string->capacity) return;
+    size_t capacity = string->capacity > 0 ? string->capacity * 2 : 32;
+    while (capacity <= length) capacity *= 2;
+    char* data = realloc(string->data, capacity);
+    if (data == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    string->data = data;
+    string->capacity = capacity;
+}
+
+static void string_append(VmString* string, const char* text, const size_t length) {
+    string_reserve(string, string->length + length);
+    if (length > 0) memcpy(string->data + string->length, text, length);
+    string->length += length;
+    string->data[string->length] = '\0';
+}
+
+// A view may point into the string itself, so it is copied with memmove and
+// found again after the buffer grows
+static void string_set_view(VmString* string, const ScanText view) {
+    string_reserve(string, view.length);
+    if (view.length > 0) memmove(string->data, view.text, view.length);
+    string->length = view.length;
+    string->data[string->length] = '\0';
+}
+
+static void string_append_view(VmString* string, ScanText view) {
+    const size_t offset = (size_t)((uintptr_t)view.text - (uintptr_t)string->data);
+    string_reserve(string, string->length + view.length);
+    if (string->data != NULL && offset <= string->length) view.text = string->data + offset;
+    string_append(string, view.text, view.length);
+}
+
+// scanf("%s") without a limit; the string is kept when input ends first
+static void read_word(VmString* string) {
+    int c;
+    do {
+        c = getchar();
+    } while (c != EOF && isspace(c));
+    if (c == EOF) return;
+    string->length = 0;
+    while (c != EOF && !isspace(c)) {
+        const char byte = (char)c;
+        string_append(string, &byte, 1);
+        c = getchar();
+    }
+    if (c != EOF) ungetc(c, stdin);
+}
+
+static void array_reserve(VmArray* array, const int64_t length) {
+    if (length <= array->capacity) return;
+    int64_t capacity = array->capacity > 0 ? array->capacity * 2 : 8;
+    while (capacity < length) capacity *= 2;
+    BytecodeValue* data = realloc(array->data, sizeof(BytecodeValue) * (size_t)capacity);
+    if (data == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
+    }
+    array->data = data;
+    array->capacity = capacity;
+}
+
+// The index, when it is in range; the error follows the output so far, as in the generated C
+static int64_t array_index(const VmArray* array, const int64_t index, const int line) {
+    if ((uint64_t)index < (uint64_t)array->length) return index;
+    fflush(stdout);
+    fprintf(stderr, "Runtime Error: Index %" PRId64 " is out of range for %" PRId64 " elements at line %d\n", index,
+            array->length, line);
+    exit(1);
+}
+
+// Number keys hash one to one, so equal hashes mean equal keys; -0 is 0, and
+// every NaN is one key
+static uint64_t hash_double(double key) {
+    uint64_t bits = UINT64_C(0x7FF8000000000000);
+    if (key == 0) key = 0;
+    if (key == key) memcpy(&bits, &key, sizeof(bits));
+    bits ^= bits >> 32;
+    bits *= UINT64_C(0x9E3779B97F4A7C15);
+    return bits ^ bits >> 32;
+}
+
+static uint64_t hash_text(const ScanText key) {
+    uint64_t hash = key.length * UINT64_C(0x9E3779B97F4A7C15);
+    for (size_t i = 0; i < key.length; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, key.text + i, key.length - i < 8 ? key.length - i : 8);
+        hash = (hash ^ word) * UINT64_C(0xFF51AFD7ED558CCD);
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+// Bit i is set when control byte i of the group is byte
+static unsigned map_match(const uint8_t* group, const uint8_t byte) {
+#if defined(__SSE2__)
+    const __m128i control = _mm_loadu_si128((const __m128i*)group);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+#else
+    unsigned bits = 0;
+    for (int i = 0; i < MAP_GROUP; i++) bits |= (unsigned)(group[i] == byte) << i;
+    return bits;
+#endif
+}
+
+// Bit i is set when slot i of the group is empty or deleted
+static unsigned map_free_slots(const uint8_t* group) {
+#if defined(__SSE2__)
+    return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+    unsigned bits = 0;
+    for (int i = 0; i < MAP_GROUP; i++) bits |= (unsigned)(group[i] >> 7) << i;
+    return bits;
+#endif
+}
+
+// Groups are probed triangularly from the one the hash picks; a lookup stops
+// at the first group with an empty slot. key is NULL for a number.
+static VmMapEntry* map_find(const VmMap* map, const uint64_t hash, const ScanText* key) {
+    if (map->capacity == 0) return NULL;
+    const size_t mask = (size_t)map->capacity / MAP_GROUP - 1;
+    size_t group = (size_t)(hash >> 7) & mask;
+    for (size_t step = 1;; step++) {
+        const uint8_t* control = map->control + group * MAP_GROUP;
+        unsigned matches = map_match(control, (uint8_t)(hash & 0x7F));
+        while (matches) {
+            VmMapEntry* entry = &map->entries[group * MAP_GROUP + (size_t)__builtin_ctz(matches)];
+            if (entry->hash == hash &&
+                (key == NULL || (entry->length == key->length &&
+                                 scan_mismatch(entry->text, key->text, key->length) == key->length))) {
+                return entry;
+            }
+            matches &= matches - 1;
+        }
+        if (map_match(control, MAP_EMPTY)) return NULL;
+        group = (group + step) & mask;
+    }
+}
+
+static size_t map_slot(const VmMap* map, const uint64_t hash) {
+    const size_t mask = (size_t)map->capacity / MAP_GROUP - 1;
+    size_t group = (size_t)(hash >> 7) & mask;
+    for (size_t step = 1;; step++) {
+        const unsigned open = map_free_slots(map->control + group * MAP_GROUP);
+        if (open) return group * MAP_GROUP + (size_t)__builtin_ctz(open);
+        group = (group + step) & mask;
+    }
+}
+
+// Rebuild the table without its deleted slots, twice as large if it is at least half full
+static void map_rehash(VmMap* map) {
+    const VmMap old = *map;
+    int64_t capacity = old.capacity > 0 ? old.capacity : MAP_GROUP;
+    if ((old.count + 1) * 2 > capacity) capacity *= 2;
+    map->control = ir_allocate((size_t)capacity, 1);
+    map->entries = ir_allocate((size_t)capacity, sizeof(VmMapEntry));
+    memset(map->control, MAP_EMPTY, (size_t)capacity);
+    map->capacity = capacity;
+    map->used = old.count;
+    for (int64_t i = 0; i < old.capacity; i++) {
+        if (old.control[i] & 0x80) continue;
+        const size_t slot = map_slot(map, old.entries[i].hash);
+        map->control[slot] = old.control[i];
+        map->entries[slot] = old.entries[i];
+    }
+    free(old.control);
+    free(old.entries);
+}
+
+static void map_put(VmMap* map, const uint64_t hash, const ScanText* key, const double value) {
+    VmMapEntry* entry = map_find(map, hash, key);
+    if (entry != NULL) {
+        entry->value = value;
+        return;
+    }
+    if ((map->used + 1) * 8 > map->capacity * 7) map_rehash(map);
+    const size_t slot = map_slot(map, hash);
+    if (map->control[slot] == MAP_EMPTY) map->used++;
+    map->control[slot] = (uint8_t)(hash & 0x7F);
+    entry = &map->entries[slot];
+    *entry = (VmMapEntry){hash, NULL, 0, value};
+    if (key != NULL) {
+        entry->text = ir_allocate(key->length, 1);
+        if (key->length > 0) memcpy(entry->text, key->text, key->length);
+        entry->length = key->length;
+    }
+    map->count++;
+}
+
+// A slot in a group that still has an empty one can be emptied too: no probe has passed that group
+static int64_t map_del(VmMap* map, const uint64_t hash, const ScanText* key) {
+    VmMapEntry* entry = map_find(map, hash, key);
+    if (entry == NULL) return 0;
+    const size_t slot = (size_t)(entry - map->entries);
+    free(entry->text);
+    if (map_match(map->control + (slot & ~(size_t)(MAP_GROUP - 1)), MAP_EMPTY)) {
+        map->control[slot] = MAP_EMPTY;
+        map->used--;
+    } else {
+        map->control[slot] = MAP_DELETED;
+    }
+    map->count--;
+    return 1;
+}
+
+static void map_clear(VmMap* map) {
+    for (int64_t i = 0; i < map->capacity; i++) {
+        if (!(map->control[i] & 0x80)) free(map->entries[i].text);
+    }
+    if (map->capacity > 0) memset(map->control, MAP_EMPTY, (size_t)map->capacity);
+    map->count = 0;
+    map->used = 0;
+}
+
+static double map_get(const VmMap* map, const uint64_t hash, const ScanText* key) {
+    const VmMapEntry* entry = map_find(map, hash, key);
+    return entry != NULL ? entry->value : 0;
+}
+
+#define I(n) r[pc[n]].i
+#define D(n) r[pc[n]].d
+#define U(n) ((uint64_t)r[pc[n]].i)
+#define K(n) ((int64_t)pc[n])
+
+#if VM_COMPUTED_GOTO
+#define CASE(name) op_##name:
+#define DISPATCH() goto *handlers[*pc]
+#else
+#define CASE(name) case BC_##name:
+#define DISPATCH() continue
+#endif
+
+#define BINARY(name, expression) CASE(name) expression; pc += 4; DISPATCH();
+#define UNARY(name, expression) CASE(name) expression; pc += 3; DISPATCH();
+#define JUMP_IF(name, condition, words) CASE(name) pc = (condition) ? code + pc[(words) - 1] : pc + (words); DISPATCH();
+
+int vm_run(const Bytecode* bytecode) {
+    const int32_t* const code = bytecode->code;
+    const char* const text = bytecode->text;
+    BytecodeValue* r = ir_allocate((size_t)bytecode->register_count, sizeof(BytecodeValue));
+    memcpy(r, bytecode->registers, sizeof(BytecodeValue) * (size_t)bytecode->register_count);
+    VmString* strings = ir_allocate((size_t)bytecode->string_count, sizeof(VmString));
+    ScanText* views = ir_allocate((size_t)bytecode->view_count, sizeof(ScanText));
+    VmArray* arrays = ir_allocate((size_t)bytecode->array_count, sizeof(VmArray));
+    VmMap* maps = ir_allocate((size_t)bytecode->map_count, sizeof(VmMap));
+    fwrite(text, 1, bytecode->precomputed_length, stdout);
+
+    int status = 0;
+    const int32_t* pc = code;
+#if VM_COMPUTED_GOTO
+#define HANDLER_ADDRESS(name, words) &&op_##name,
+    static void* const handlers[BC_OP_COUNT] = {BYTECODE_OPS(HANDLER_ADDRESS)};
+#undef HANDLER_ADDRESS
+    DISPATCH();
+#else
+    for (;;) {
+        switch ((BytecodeOp)*pc) {
+#endif
+
+    UNARY(MOV, r[pc[1]] = r[pc[2]])
+
+    BINARY(ADD_I, I(1) = (int64_t)(U(2) + U(3)))
+    BINARY(SUB_I, I(1) = (int64_t)(U(2) - U(3)))
+    BINARY(MUL_I, I(1) = (int64_t)(U(2) * U(3)))
+    BINARY(MOD_I, I(1) = I(2) % I(3))
+    BINARY(AND_I, I(1) = I(2) & I(3))
+    BINARY(OR_I, I(1) = I(2) | I(3))
+    BINARY(XOR_I, I(1) = I(2) ^ I(3))
+    BINARY(SHL_I, I(1) = (int64_t)(U(2) << (I(3) & 63)))
+    BINARY(SHR_I, I(1) = I(2) >> (I(3) & 63))
+    BINARY(ADD_IK, I(1) = (int64_t)(U(2) + (uint64_t)K(3)))
+
+    BINARY(ADD_D, D(1) = D(2) + D(3))
+    BINARY(SUB_D, D(1) = D(2) - D(3))
+    BINARY(MUL_D, D(1) = D(2) * D(3))
+    BINARY(DIV_D, D(1) = D(2) / D(3))
+
+    UNARY(NEG_I, I(1) = (int64_t)(0 - U(2)))
+    UNARY(BITNOT_I, I(1) = ~I(2))
+    UNARY(NOT_I, I(1) = I(2) == 0)
+    UNARY(NEG_D, D(1) = -D(2))
+    UNARY(NOT_D, I(1) = D(2) == 0.0)
+
+    BINARY(EQ_I, I(1) = I(2) == I(3))
+    BINARY(NE_I, I(1) = I(2) != I(3))
+    BINARY(LT_I, I(1) = I(2) < I(3))
+    BINARY(GT_I, I(1) = I(2) > I(3))
+    BINARY(LE_I, I(1) = I(2) <= I(3))
+    BINARY(GE_I, I(1) = I(2) >= I(3))
+    BINARY(EQ_D, I(1) = D(2) == D(3))
+    BINARY(NE_D, I(1) = D(2) != D(3))
+    BINARY(LT_D, I(1) = D(2) < D(3))
+    BINARY(GT_D, I(1) = D(2) > D(3))
+    BINARY(LE_D, I(1) = D(2) <= D(3))
+    BINARY(GE_D, I(1) = D(2) >= D(3))
+
+    UNARY(TO_D, D(1) = (double)I(2))
+    UNARY(TO_I, I(1) = (int64_t)D(2))
+
+    // The register keeps the old value when input fails
+    UNARY(IN_D, r[pc[1]] = r[pc[2]]; scanf("%lf", &D(1)))
+
+    CASE(OUT_I)
+        printf("%" PRId64 "\n", I(1));
+        pc += 2;
+        DISPATCH();
+    CASE(OUT_D)
+        printf(is_whole(D(1)) ? "%.0f\n" : "%f\n", D(1));
+        pc += 2;
+        DISPATCH();
+    CASE(IN_S)
+        read_word(&strings[pc[1]]);
+        pc += 2;
+        DISPATCH();
+    CASE(OUT_S)
+        if (strings[pc[1]].length > 0) fwrite(strings[pc[1]].data, 1, strings[pc[1]].length, stdout);
+        putchar('\n');
+        pc += 2;
+        DISPATCH();
+    CASE(OUT_TEXT)
+        fputs(text + pc[1], stdout);
+        pc += 2;
+        DISPATCH();
+    CASE(SET_S)
+        strings[pc[1]].length = 0;
+        string_append(&strings[pc[1]], strings[pc[2]].data, strings[pc[2]].length);
+        pc += 3;
+        DISPATCH();
+    CASE(SET_TEXT)
+        strings[pc[1]].length = 0;
+        string_append(&strings[pc[1]], text + pc[2], (size_t)pc[3]);
+        pc += 4;
+        DISPATCH();
+    CASE(APPEND_S) {
+        // The slot may be appended to itself, so the text is found after the buffer grows
+        VmString* string = &strings[pc[1]];
+        const size_t length = strings[pc[2]].length;
+        string_reserve(string, string->length + length);
+        string_append(string, strings[pc[2]].data, length);
+        pc += 3;
+        DISPATCH();
+    }
+    CASE(APPEND_TEXT)
+        string_append(&strings[pc[1]], text + pc[2], (size_t)pc[3]);
+        pc += 4;
+        DISPATCH();
+    CASE(MOVE_S) {
+        const VmString old = strings[pc[1]];
+        strings[pc[1]] = strings[pc[2]];
+        strings[pc[2]] = old;
+        pc += 3;
+        DISPATCH();
+    }
+    CASE(VIEW_S)
+        views[pc[1]] = (ScanText){strings[pc[2]].data != NULL ? strings[pc[2]].data : "", strings[pc[2]].length};
+        pc += 3;
+        DISPATCH();
+    CASE(VIEW_TEXT)
+        views[pc[1]] = (ScanText){text + pc[2], (size_t)pc[3]};
+        pc += 4;
+        DISPATCH();
+    CASE(SLICE)
+        views[pc[1]] = scan_slice(views[pc[2]], I(3), I(4));
+        pc += 5;
+        DISPATCH();
+    CASE(SPLIT)
+        views[pc[1]] = scan_split(views[pc[2]], views[pc[3]], I(4));
+        pc += 5;
+        DISPATCH();
+    CASE(LEN)
+        I(1) = (int64_t)views[pc[2]].length;
+        pc += 3;
+        DISPATCH();
+    CASE(FIND)
+        I(1) = scan_find_from(views[pc[2]], views[pc[3]], I(4));
+        pc += 5;
+        DISPATCH();
+    CASE(CMP)
+        I(1) = scan_compare(views[pc[2]], views[pc[3]]);
+        pc += 4;
+        DISPATCH();
+    CASE(EQ_S)
+        I(1) = views[pc[2]].length == views[pc[3]].length &&
+               scan_mismatch(views[pc[2]].text, views[pc[3]].text, views[pc[2]].length) == views[pc[2]].length;
+        pc += 4;
+        DISPATCH();
+    CASE(SET_V)
+        string_set_view(&strings[pc[1]], views[pc[2]]);
+        pc += 3;
+        DISPATCH();
+    CASE(APPEND_V)
+        string_append_view(&strings[pc[1]], views[pc[2]]);
+        pc += 3;
+        DISPATCH();
+    CASE(OUT_V)
+        fwrite(views[pc[1]].text, 1, views[pc[1]].length, stdout);
+        putchar('\n');
+        pc += 2;
+        DISPATCH();
+
+    CASE(A_CLEAR)
+        arrays[pc[1]].length = 0;
+        pc += 2;
+        DISPATCH();
+    CASE(A_PUSH) {
+        VmArray* array = &arrays[pc[1]];
+        array_reserve(array, array->length + 1);
+        array->data[array->length++] = r[pc[2]];
+        pc += 3;
+        DISPATCH();
+    }
+    CASE(A_SET) {
+        VmArray* array = &arrays[pc[1]];
+        const VmArray* source = &arrays[pc[2]];
+        array_reserve(array, source->length);
+        if (source->length > 0) memcpy(array->data, source->data, sizeof(BytecodeValue) * (size_t)source->length);
+        array->length = source->length;
+        pc += 3;
+        DISPATCH();
+    }
+    CASE(A_LEN)
+        I(1) = arrays[pc[2]].length;
+        pc += 3;
+        DISPATCH();
+    CASE(A_LOAD)
+        r[pc[1]] = arrays[pc[2]].data[I(3)];
+        pc += 4;
+        DISPATCH();
+    CASE(A_LOAD_CHECKED)
+        r[pc[1]] = arrays[pc[2]].data[array_index(&arrays[pc[2]], I(3), pc[4])];
+        pc += 5;
+        DISPATCH();
+    CASE(A_STORE)
+        arrays[pc[1]].data[I(2)] = r[pc[3]];
+        pc += 4;
+        DISPATCH();
+    CASE(A_STORE_CHECKED)
+        arrays[pc[1]].data[array_index(&arrays[pc[1]], I(2), pc[4])] = r[pc[3]];
+        pc += 5;
+        DISPATCH();
+
+    CASE(M_CLEAR)
+        map_clear(&maps[pc[1]]);
+        pc += 2;
+        DISPATCH();
+    CASE(M_LEN)
+        I(1) = maps[pc[2]].count;
+        pc += 3;
+        DISPATCH();
+    BINARY(M_GET_D, D(1) = map_get(&maps[pc[2]], hash_double(D(3)), NULL))
+    BINARY(M_GET_S, D(1) = map_get(&maps[pc[2]], hash_text(views[pc[3]]), &views[pc[3]]))
+    BINARY(M_HAS_D, I(1) = map_find(&maps[pc[2]], hash_double(D(3)), NULL) != NULL)
+    BINARY(M_HAS_S, I(1) = map_find(&maps[pc[2]], hash_text(views[pc[3]]), &views[pc[3]]) != NULL)
+    BINARY(M_DEL_D, I(1) = map_del(&maps[pc[2]], hash_double(D(3)), NULL))
+    BINARY(M_DEL_S, I(1) = map_del(&maps[pc[2]], hash_text(views[pc[3]]), &views[pc[3]]))
+    BINARY(M_PUT_D, map_put(&maps[pc[1]], hash_double(D(2)), NULL, D(3)))
+    BINARY(M_PUT_S, map_put(&maps[pc[1]], hash_text(views[pc[2]]), &views[pc[2]], D(3)))
+
+    CASE(JMP)
+        pc = code + pc[1];
+        DISPATCH();
+    JUMP_IF(JNZ_I, I(1) != 0, 3)
+    JUMP_IF(JZ_I, I(1) == 0, 3)
+    JUMP_IF(JNZ_D, D(1) != 0.0, 3)
+    JUMP_IF(JZ_D, D(1) == 0.0, 3)
+    JUMP_IF(JEQ_I, I(1) == I(2), 4)
+    JUMP_IF(JNE_I, I(1) != I(2), 4)
+    JUMP_IF(JLT_I, I(1) < I(2), 4)
+    JUMP_IF(JGT_I, I(1) > I(2), 4)
+    JUMP_IF(JLE_I, I(1) <= I(2), 4)
+    JUMP_IF(JGE_I, I(1) >= I(2), 4)
+    JUMP_IF(JEQ_IK, I(1) == K(2), 4)
+    JUMP_IF(JNE_IK, I(1) != K(2), 4)
+    JUMP_IF(JLT_IK, I(1) < K(2), 4)
+    JUMP_IF(JGT_IK, I(1) > K(2), 4)
+    JUMP_IF(JLE_IK, I(1) <= K(2), 4)
+    JUMP_IF(JGE_IK, I(1) >= K(2), 4)
+
+    CASE(EXIT_I)
+        status = (int)I(1);
+        goto done;
+    CASE(EXIT_D)
+        status = (int)D(1);
+        goto done;
+    CASE(RETURN)
+        goto done;
+
+#if !VM_COMPUTED_GOTO
+            default:
+                fprintf(stderr, "Error: Invalid bytecode operator %d\n", *pc);
+                exit(EXIT_FAILURE);
+        }
+    }
+#endif
+
+done:
+    fflush(stdout);
+    for (int i = 0; i < bytecode->string_count; i++) free(strings[i].data);
+    free(strings);
+    free(views);
+    for (int i = 0; i < bytecode->array_count; i++) free(arrays[i].data);
+    free(arrays);
+    for (int i = 0; i < bytecode->map_count; i++) {
+        map_clear(&maps[i]);
+        free(maps[i].control);
+        free(maps[i].entries);
+    }
+    free(maps);
+    free(r);
+    return status;
+}
@@ -0,0 +1,2802 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "x86.h"
+#include "cfg.h"
+
+// Values get a general register, an SSE register or a frame slot from a linear
+// scan over the blocks in reverse postorder, each value covering one interval
+// from its first to its last point of life. Values live across a call only get
+// callee-saved registers, and doubles live across a call always get a slot.
+// rax, rcx, rdx and r11, and xmm0 and xmm1, are never allocated: instructions
+// use them as scratch.
+
+typedef enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+} Register;
+
+enum { XMM0, XMM1, XMM2 };
+
+typedef enum {
+    CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7,
+    CC_P = 0xA, CC_NP = 0xB, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+} Condition;
+
+// Opcode extensions of the integer ALU group; op r64, r/m64 is 0x03 | op << 3
+typedef enum {
+    ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7
+} AluOp;
+
+typedef enum {
+    OPERAND_REGISTER,
+    OPERAND_MEMORY,     // [base + disp]
+    OPERAND_LABEL,      // [rip + label]
+    OPERAND_BSS,        // [rip + bss offset]
+    OPERAND_EXTERN      // [rip + word holding the symbol's address]
+} OperandKind;
+
+typedef struct {
+    OperandKind kind;
+    int reg;            // Register, or base register
+    int32_t disp;       // Displacement, label, bss offset or symbol
+} Operand;
+
+typedef enum {
+    LOCATION_NONE,
+    LOCATION_GPR,
+    LOCATION_XMM,
+    LOCATION_FRAME
+} LocationKind;
+
+typedef struct {
+    LocationKind kind;
+    int where;          // Register, or frame slot
+} Location;
+
+typedef struct {
+    int value;
+    int start;
+    int end;
+} Interval;
+
+typedef struct {
+    size_t offset;
+    int label;
+} LabelUse;
+
+typedef struct {
+    int label;
+    uint64_t bits;
+} PoolDouble;
+
+typedef struct {
+    int label;
+    char* text;
+    size_t length;
+    bool owned;
+} PoolString;
+
+// A copy on a control-flow edge, from a constant or a location
+typedef struct {
+    int constant;       // Constant value, or -1
+    Location from;
+    Location to;
+    VarType type;
+} Move;
+
+static const Register caller_saved[] = {RSI, RDI, R8, R9, R10};
+static const Register callee_saved[] = {RBX, R12, R13, R14, R15};
+#define CALLER_SAVED_COUNT 5
+#define CALLEE_SAVED_COUNT 5
+#define FIRST_XMM XMM2
+#define LAST_XMM 15
+
+static X86Code out;
+static const IrProgram* ir;
+static Cfg cfg;
+
+static int* label_offsets;
+static int label_count;
+static int label_capacity;
+static LabelUse* label_uses;
+static int label_use_count;
+static int label_use_capacity;
+
+static PoolDouble* pool_doubles;
+static int pool_double_count;
+static int pool_double_capacity;
+static PoolString* pool_strings;
+static int pool_string_count;
+static int pool_string_capacity;
+static int sign_mask = -1;
+static int abs_mask = -1;
+
+// Liveness and allocation, by value and by block
+static int* block_start;    // Position where the block's phis are defined, or -1 when unreachable
+static int* block_end;      // Position of the terminator and the edge copies
+static int* position;
+static int* uses;
+static bool* fused;         // Compare evaluated by the branch that uses it
+static Location* locations;
+static int* call_positions;
+static int call_count;
+static int frame_slots;
+static bool saved[16];      // Callee-saved registers main uses
+static int saved_count;
+static int* bss_offsets;    // By string, view, array and map slot
+
+// Runtime routines
+static int out_int_label;
+static int out_double_label;
+static int in_double_label;
+static int out_string_label;
+static int in_string_label;
+static int set_string_label;
+static int append_string_label;
+static int out_view_label;
+static int split_label;
+static int find_label;
+static int compare_label;
+static int equal_label;
+static int push_array_label;
+static int set_array_label;
+static int index_error_label;
+static int out_of_memory_label;
+static int hash_double_label;
+static int hash_text_label;
+static int map_find_label;
+static int map_slot_label;
+static int map_rehash_label;
+static int map_put_label;
+static int map_delete_label;
+static int map_clear_label;
+
+// --- Encoding ---------------------------------------------------------------
+
+static void emit_byte(const int byte) {
+    if (out.length == out.capacity) {
+        out.capacity = out.capacity > 0 ? out.capacity * 2 : 4096;
+        uint8_t* grown = realloc(out.code, out.capacity);
+        if (grown == NULL) {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(1);
+        }
+        out.code = grown;
+    }
+    out.code[out.length++] = (uint8_t)byte;
+}
+
+static void emit32(const uint32_t value) {
+    for (int i = 0; i < 4; i++) emit_byte((int)(value >> (8 * i)) & 0xFF);
+}
+
+static void emit64(const uint64_t value) {
+    for (int i = 0; i < 8; i++) emit_byte((int)(value >> (8 * i)) & 0xFF);
+}
+
+static void patch32(const size_t offset, const uint32_t value) {
+    for (int i = 0; i < 4; i++) out.code[offset + i] = (uint8_t)(value >> (8 * i));
+}
+
+static void add_reloc(const X86RelocKind kind, const X86Extern symbol, const int64_t addend) {
+    out.relocs = ir_grow(out.relocs, out.reloc_count, &out.reloc_capacity, sizeof(X86Reloc));
+    out.relocs[out.reloc_count++] = (X86Reloc){kind, out.length, symbol, addend};
+}
+
+static int new_label() {
+    label_offsets = ir_grow(label_offsets, label_count, &label_capacity, sizeof(int));
+    label_offsets[label_count] = -1;
+    return label_count++;
+}
+
+static void bind(const int label) {
+    label_offsets[label] = (int)out.length;
+}
+
+// A 32-bit field relative to its end, resolved once every label is bound
+static void emit_label_field(const int label) {
+    label_uses = ir_grow(label_uses, label_use_count, &label_use_capacity, sizeof(LabelUse));
+    label_uses[label_use_count++] = (LabelUse){out.length, label};
+    emit32(0);
+}
+
+static Operand reg(const int r) {
+    return (Operand){OPERAND_REGISTER, r, 0};
+}
+
+static Operand memory(const int base, const int32_t disp) {
+    return (Operand){OPERAND_MEMORY, base, disp};
+}
+
+static Operand label_operand(const int label) {
+    return (Operand){OPERAND_LABEL, 0, label};
+}
+
+static Operand bss_operand(const int32_t offset) {
+    return (Operand){OPERAND_BSS, 0, offset};
+}
+
+static Operand extern_operand(const X86Extern symbol) {
+    return (Operand){OPERAND_EXTERN, 0, (int32_t)symbol};
+}
+
+static bool fits_int8(const int64_t value) {
+    return value >= INT8_MIN && value <= INT8_MAX;
+}
+
+static bool fits_int32(const int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// [prefix] [REX] opcode ModRM [SIB] [displacement]; opcodes above 0xFF are
+// two bytes. Anything that follows, such as an immediate, is up to the caller.
+static void encode(const int prefix, const bool wide, const int opcode, const int field, const Operand rm) {
+    if (prefix != 0) emit_byte(prefix);
+    int rex = 0x40 | (wide ? 8 : 0) | ((field & 8) ? 4 : 0);
+    if ((rm.kind == OPERAND_REGISTER || rm.kind == OPERAND_MEMORY) && (rm.reg & 8)) rex |= 1;
+    if (rex != 0x40) emit_byte(rex);
+    if (opcode > 0xFF) emit_byte(opcode >> 8);
+    emit_byte(opcode & 0xFF);
+
+    switch (rm.kind) {
+        case OPERAND_REGISTER:
+            emit_byte(0xC0 | (field & 7) << 3 | (rm.reg & 7));
+            break;
+        case OPERAND_MEMORY:
+            emit_byte((fits_int8(rm.disp) ? 0x40 : 0x80) | (field & 7) << 3 | (rm.reg & 7));
+            if ((rm.reg & 7) == RSP) emit_byte(0x24);
+            if (fits_int8(rm.disp)) {
+                emit_byte(rm.disp & 0xFF);
+            } else {
+                emit32((uint32_t)rm.disp);
+            }
+            break;
+        case OPERAND_LABEL:
+            emit_byte((field & 7) << 3 | 5);
+            emit_label_field(rm.disp);
+            break;
+        case OPERAND_BSS:
+            emit_byte((field & 7) << 3 | 5);
+            add_reloc(X86_RELOC_BSS, 0, rm.disp);
+            emit32(0);
+            break;
+        case OPERAND_EXTERN:
+            emit_byte((field & 7) << 3 | 5);
+            add_reloc(X86_RELOC_EXTERN, (X86Extern)rm.disp, 0);
+            emit32(0);
+            break;
+    }
+}
+
+static void mov_load(const int dst, const Operand src) {
+    if (src.kind == OPERAND_REGISTER && src.reg == dst) return;
+    encode(0, true, 0x8B, dst, src);
+}
+
+static void mov_store(const Operand dst, const int src) {
+    encode(0, true, 0x89, src, dst);
+}
+
+static void mov_imm(const int dst, const int64_t value) {
+    if (value >= 0 && value <= UINT32_MAX) {
+        if (dst & 8) emit_byte(0x41);
+        emit_byte(0xB8 + (dst & 7));
+        emit32((uint32_t)value);
+    } else if (fits_int32(value)) {
+        encode(0, true, 0xC7, 0, reg(dst));
+        emit32((uint32_t)value);
+    } else {
+        emit_byte((dst & 8) ? 0x49 : 0x48);
+        emit_byte(0xB8 + (dst & 7));
+        emit64((uint64_t)value);
+    }
+}
+
+static void lea(const int dst, const Operand src) {
+    encode(0, true, 0x8D, dst, src);
+}
+
+static void alu(const AluOp op, const int dst, const Operand src) {
+    encode(0, true, 0x03 | op << 3, dst, src);
+}
+
+// dst must not be relative to rip, as the immediate follows it
+static void alu_imm(const AluOp op, const Operand dst, const int32_t imm) {
+    if (fits_int8(imm)) {
+        encode(0, true, 0x83, op, dst);
+        emit_byte(imm & 0xFF);
+    } else {
+        encode(0, true, 0x81, op, dst);
+        emit32((uint32_t)imm);
+    }
+}
+
+static void setcc(const Condition cc, const int dst) {
+    encode(0, false, 0x0F90 | cc, 0, reg(dst));
+}
+
+static void cmov(const Condition cc, const int dst, const int src) {
+    encode(0, true, 0x0F40 | cc, dst, reg(src));
+}
+
+// Zero-extend al into a whole register
+static void movzx_al(const int dst) {
+    encode(0, false, 0x0FB6, dst, reg(RAX));
+}
+
+static void push(const int r) {
+    if (r & 8) emit_byte(0x41);
+    emit_byte(0x50 + (r & 7));
+}
+
+static void pop(const int r) {
+    if (r & 8) emit_byte(0x41);
+    emit_byte(0x58 + (r & 7));
+}
+
+static void jump(const int label) {
+    emit_byte(0xE9);
+    emit_label_field(label);
+}
+
+static void jump_if(const Condition cc, const int label) {
+    emit_byte(0x0F);
+    emit_byte(0x80 | cc);
+    emit_label_field(label);
+}
+
+static void call(const int label) {
+    emit_byte(0xE8);
+    emit_label_field(label);
+}
+
+static void call_extern(const X86Extern symbol) {
+    encode(0, false, 0xFF, 2, extern_operand(symbol));
+}
+
+// Scalar double instructions: prefix 0xF2 for movsd and arithmetic, 0x66 for
+// compares and bitwise operations
+static void sse(const int prefix, const int opcode, const int xmm, const Operand src) {
+    encode(prefix, false, opcode, xmm, src);
+}
+
+static void movsd_load(const int xmm, const Operand src) {
+    if (src.kind == OPERAND_REGISTER) {
+        if (src.reg != xmm) sse(0x66, 0x0F28, xmm, src);
+        return;
+    }
+    sse(0xF2, 0x0F10, xmm, src);
+}
+
+static void movsd_store(const Operand dst, const int xmm) {
+    sse(0xF2, 0x0F11, xmm, dst);
+}
+
+static void zero_xmm(const int xmm) {
+    sse(0x66, 0x0F57, xmm, reg(xmm));
+}
+
+static void shl_imm(const int r, const int count) {
+    encode(0, true, 0xC1, 4, reg(r));
+    emit_byte(count);
+}
+
+static void shr_imm(const int r, const int count) {
+    encode(0, true, 0xC1, 5, reg(r));
+    emit_byte(count);
+}
+
+// --- Constant pool ----------------------------------------------------------
+
+static int pool_double(const double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < pool_double_count; i++) {
+        if (pool_doubles[i].bits == bits) return pool_doubles[i].label;
+    }
+    pool_doubles = ir_grow(pool_doubles, pool_double_count, &pool_double_capacity, sizeof(PoolDouble));
+    pool_doubles[pool_double_count++] = (PoolDouble){new_label(), bits};
+    return pool_doubles[pool_double_count - 1].label;
+}
+
+static int pool_string(char* text, const size_t length, const bool owned) {
+    pool_strings = ir_grow(pool_strings, pool_string_count, &pool_string_capacity, sizeof(PoolString));
+    pool_strings[pool_string_count++] = (PoolString){new_label(), text, length, owned};
+    return pool_strings[pool_string_count - 1].label;
+}
+
+static int pool_text(const char* text) {
+    return pool_string((char*)text, strlen(text), false);
+}
+
+// A string literal with its escapes resolved the way the C compiler reads them
+static int pool_literal(const Lexeme text) {
+    char* decoded = ir_allocate((size_t)text.length + 1, 1);
+    return pool_string(decoded, lexeme_decode_string(text, decoded), true);
+}
+
+// A 16-byte mask for the packed operations, which need aligned memory
+static int mask_label(int* label) {
+    if (*label < 0) *label = new_label();
+    return *label;
+}
+
+static void align(const size_t alignment) {
+    while (out.length % alignment != 0) emit_byte(0);
+}
+
+static void emit_pool() {
+    align(16);
+    if (sign_mask >= 0) {
+        bind(sign_mask);
+        emit64(0x8000000000000000u);
+        emit64(0);
+    }
+    if (abs_mask >= 0) {
+        bind(abs_mask);
+        emit64(0x7FFFFFFFFFFFFFFFu);
+        emit64(0);
+    }
+    for (int i = 0; i < pool_double_count; i++) {
+        bind(pool_doubles[i].label);
+        emit64(pool_doubles[i].bits);
+    }
+    for (int i = 0; i < pool_string_count; i++) {
+        bind(pool_strings[i].label);
+        for (size_t c = 0; c < pool_strings[i].length; c++) emit_byte((unsigned char)pool_strings[i].text[c]);
+        emit_byte(0);
+    }
+}
+
+// --- Liveness and register allocation ---------------------------------------
+
+static bool is_call(const IrInst* inst) {
+    switch (inst->op) {
+        case IR_IN: case IR_OUT: case IR_IN_STRING: case IR_OUT_STRING: case IR_APPEND_STRING:
+        case IR_SPLIT_STRING: case IR_FIND_STRING: case IR_COMPARE_STRING: case IR_EQUAL_STRING:
+        case IR_PUSH_ARRAY: case IR_GET_MAP: case IR_HAS_MAP: case IR_DEL_MAP: case IR_CLEAR_MAP: case IR_PUT_MAP:
+            return true;
+        case IR_SET_STRING: case IR_SET_ARRAY:
+            return inst->source != inst->slot;
+        default:
+            return false;
+    }
+}
+
+// Whether an instruction's value needs a location
+static bool has_location(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    switch (inst->op) {
+        case IR_CONST: case IR_COPY: case IR_OUT: case IR_IN_STRING: case IR_OUT_STRING: case IR_SET_STRING:
+        case IR_APPEND_STRING: case IR_MOVE_STRING: case IR_SLICE_STRING: case IR_SPLIT_STRING:
+        case IR_CLEAR_ARRAY: case IR_PUSH_ARRAY: case IR_SET_ARRAY: case IR_STORE_ARRAY:
+        case IR_CLEAR_MAP: case IR_PUT_MAP:
+            return false;
+        default:
+            return uses[id] > 0 && !fused[id];
+    }
+}
+
+static bool is_compare(const IrOp op) {
+    return op >= IR_EQ && op <= IR_GE;
+}
+
+// Count the uses of every value in reachable code, and find the integer
+// compares that the branch ending their block can evaluate itself
+static void count_uses() {
+    for (int i = 0; i < cfg.order_count; i++) {
+        const IrBlock* block = &ir->blocks[cfg.order[i]];
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            for (int a = 0; a < 2; a++) {
+                if (inst->args[a] >= 0) uses[ir_resolve(ir, inst->args[a])]++;
+            }
+            for (int p = 0; p < inst->phi_count; p++) {
+                const int value = ir_resolve(ir, inst->phi_args[p]);
+                if (value != id) uses[value]++;
+            }
+        }
+        if (block->term == TERM_BRANCH || block->term == TERM_EXIT) uses[ir_resolve(ir, block->cond)]++;
+    }
+    for (int i = 0; i < cfg.order_count; i++) {
+        const int b = cfg.order[i];
+        const IrBlock* block = &ir->blocks[b];
+        if (block->term != TERM_BRANCH) continue;
+        const int cond = ir_resolve(ir, block->cond);
+        const IrInst* inst = &ir->insts[cond];
+        if (!is_compare(inst->op) || inst->block != b || block->last != cond || uses[cond] != 1) continue;
+        if (ir->insts[ir_resolve(ir, inst->args[0])].type != TYPE_INT) continue;
+        fused[cond] = true;
+    }
+}
+
+static void number_positions() {
+    int next = 0;
+    for (int i = 0; i < cfg.order_count; i++) {
+        const int b = cfg.order[i];
+        block_start[b] = next++;
+        for (int id = ir->blocks[b].first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            position[id] = inst->op == IR_PHI ? block_start[b] : next++;
+            if (is_call(inst)) call_positions[call_count++] = position[id];
+        }
+        block_end[b] = next++;
+    }
+}
+
+// A use of a value in a block, at a position
+typedef struct {
+    int block;
+    int at;
+} UsePoint;
+
+static void add_use(UsePoint* points, int* fill, const int value, const int block, const int at) {
+    const int resolved = ir_resolve(ir, value);
+    if (!has_location(resolved)) return;
+    points[fill[resolved]++] = (UsePoint){block, at};
+}
+
+static void extend(Interval* interval, const int at) {
+    if (at < interval->start) interval->start = at;
+    if (at > interval->end) interval->end = at;
+}
+
+// Cover every point where each value is live: from each use, walk back through
+// predecessors until the defining block
+static Interval* build_intervals(int* count) {
+    const int insts = ir->inst_count;
+    int* first = ir_allocate((size_t)insts + 1, sizeof(int));
+    for (int id = 0; id < insts; id++) {
+        first[id + 1] = first[id] + (has_location(id) ? uses[id] : 0);
+    }
+    UsePoint* points = ir_allocate((size_t)first[insts], sizeof(UsePoint));
+    int* fill = ir_allocate((size_t)insts, sizeof(int));
+    memcpy(fill, first, sizeof(int) * (size_t)insts);
+
+    for (int i = 0; i < cfg.order_count; i++) {
+        const int b = cfg.order[i];
+        const IrBlock* block = &ir->blocks[b];
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            const IrInst* inst = &ir->insts[id];
+            for (int a = 0; a < 2; a++) {
+                if (inst->args[a] >= 0) add_use(points, fill, inst->args[a], b, position[id]);
+            }
+            for (int p = 0; p < inst->phi_count; p++) {
+                const int pred = block->preds[p];
+                if (block_start[pred] < 0 || ir_resolve(ir, inst->phi_args[p]) == id) continue;
+                add_use(points, fill, inst->phi_args[p], pred, block_end[pred]);
+            }
+        }
+        if (block->term == TERM_BRANCH || block->term == TERM_EXIT) add_use(points, fill, block->cond, b, block_end[b]);
+    }
+
+    Interval* intervals = ir_allocate((size_t)insts, sizeof(Interval));
+    int* seen = ir_allocate((size_t)ir->block_count, sizeof(int));
+    int* stack = ir_allocate((size_t)ir->block_count, sizeof(int));
+    *count = 0;
+    for (int i = 0; i < cfg.order_count; i++) {
+        const IrBlock* block = &ir->blocks[cfg.order[i]];
+        for (int id = block->first; id >= 0; id = ir->insts[id].next) {
+            if (!has_location(id)) continue;
+            const IrInst* inst = &ir->insts[id];
+            Interval* interval = &intervals[(*count)++];
+            *interval = (Interval){id, position[id], position[id]};
+
+            // A phi is written by the copies at the end of its predecessors
+            for (int p = 0; p < inst->phi_count; p++) {
+                const int pred = block->preds[p];
+                if (block_start[pred] >= 0) extend(interval, block_end[pred]);
+            }
+
+            int top = 0;
+            for (int u = first[id]; u < fill[id]; u++) {
+                extend(interval, points[u].at);
+                if (points[u].block == inst->block) continue;
+                if (seen[points[u].block] != id + 1) {
+                    seen[points[u].block] = id + 1;
+                    stack[top++] = points[u].block;
+                }
+                while (top > 0) {
+                    // Live on entry to b, so at the end of its predecessors
+                    const int b = stack[--top];
+                    extend(interval, block_start[b]);
+                    const IrBlock* live = &ir->blocks[b];
+                    for (int p = 0; p < live->pred_count; p++) {
+                        const int pred = live->preds[p];
+                        if (block_start[pred] < 0) continue;
+                        extend(interval, block_end[pred]);
+                        if (pred == inst->block || seen[pred] == id + 1) continue;
+                        seen[pred] = id + 1;
+                        stack[top++] = pred;
+                    }
+                }
+            }
+        }
+    }
+    free(first);
+    free(points);
+    free(fill);
+    free(seen);
+    free(stack);
+    return intervals;
+}
+
+static int compare_intervals(const void* a, const void* b) {
+    const Interval* left = a;
+    const Interval* right = b;
+    if (left->start != right->start) return left->start - right->start;
+    return left->value - right->value;
+}
+
+// Whether a call happens strictly inside an interval
+static bool crosses_call(const Interval* interval) {
+    int low = 0;
+    int high = call_count;
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        if (call_positions[middle] <= interval->start) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < call_count && call_positions[low] < interval->end;
+}
+
+static bool is_callee_saved(const int r) {
+    for (int i = 0; i < CALLEE_SAVED_COUNT; i++) {
+        if ((int)callee_saved[i] == r) return true;
+    }
+    return false;
+}
+
+static void spill(const int value) {
+    locations[value] = (Location){LOCATION_FRAME, frame_slots++};
+}
+
+static void assign(const int value, const LocationKind kind, const int r) {
+    locations[value] = (Location){kind, r};
+    if (kind == LOCATION_GPR && is_callee_saved(r) && !saved[r]) {
+        saved[r] = true;
+        saved_count++;
+    }
+}
+
+static void allocate_registers(Interval* intervals, const int count) {
+    qsort(intervals, (size_t)count, sizeof(Interval), compare_intervals);
+    bool gpr_free[16] = {false};
+    bool xmm_free[16] = {false};
+    for (int i = 0; i < CALLER_SAVED_COUNT; i++) gpr_free[caller_saved[i]] = true;
+    for (int i = 0; i < CALLEE_SAVED_COUNT; i++) gpr_free[callee_saved[i]] = true;
+    for (int x = FIRST_XMM; x <= LAST_XMM; x++) xmm_free[x] = true;
+
+    // Intervals holding a register
+    Interval** active = ir_allocate(32, sizeof(Interval*));
+    int active_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        Interval* current = &intervals[i];
+        for (int a = 0; a < active_count; a++) {
+            const Interval* done = active[a];
+            if (done->end >= current->start) continue;
+            const Location location = locations[done->value];
+            if (location.kind == LOCATION_GPR) {
+                gpr_free[location.where] = true;
+            } else {
+                xmm_free[location.where] = true;
+            }
+            active[a--] = active[--active_count];
+        }
+
+        const bool is_double = ir->insts[current->value].type == TYPE_DOUBLE;
+        const bool across_call = crosses_call(current);
+        if (is_double && across_call) {
+            spill(current->value);
+            continue;
+        }
+
+        int chosen = -1;
+        if (is_double) {
+            for (int x = FIRST_XMM; x <= LAST_XMM && chosen < 0; x++) {
+                if (xmm_free[x]) chosen = x;
+            }
+        } else {
+            for (int r = 0; r < CALLER_SAVED_COUNT && chosen < 0 && !across_call; r++) {
+                if (gpr_free[caller_saved[r]]) chosen = caller_saved[r];
+            }
+            for (int r = 0; r < CALLEE_SAVED_COUNT && chosen < 0; r++) {
+                if (gpr_free[callee_saved[r]]) chosen = callee_saved[r];
+            }
+        }
+
+        if (chosen < 0) {
+            // Spill whichever interval that could give up its register ends last
+            int victim = -1;
+            for (int a = 0; a < active_count; a++) {
+                const Location location = locations[active[a]->value];
+                if ((location.kind == LOCATION_XMM) != is_double) continue;
+                if (!is_double && across_call && !is_callee_saved(location.where)) continue;
+                if (victim < 0 || active[a]->end > active[victim]->end) victim = a;
+            }
+            if (victim < 0 || active[victim]->end <= current->end) {
+                spill(current->value);
+                continue;
+            }
+            chosen = locations[active[victim]->value].where;
+            spill(active[victim]->value);
+            active[victim] = active[--active_count];
+        } else if (is_double) {
+            xmm_free[chosen] = false;
+        } else {
+            gpr_free[chosen] = false;
+        }
+        assign(current->value, is_double ? LOCATION_XMM : LOCATION_GPR, chosen);
+        active[active_count++] = current;
+    }
+    free(active);
+}
+
+// --- Instruction selection --------------------------------------------------
+
+// Frame slots sit below the saved registers
+static Operand location_operand(const Location location) {
+    if (location.kind == LOCATION_FRAME) return memory(RBP, -8 * (saved_count + location.where + 1));
+    return reg(location.where);
+}
+
+static Operand value_operand(const int value) {
+    return location_operand(locations[value]);
+}
+
+static void load_int(const int dst, const int value) {
+    if (ir_is_const(ir, value)) {
+        mov_imm(dst, ir->insts[value].value.integer);
+    } else {
+        mov_load(dst, value_operand(value));
+    }
+}
+
+// An integer operand in place, with constants loaded into scratch
+static Operand int_operand(const int value, const int scratch) {
+    if (ir_is_const(ir, value)) {
+        load_int(scratch, value);
+        return reg(scratch);
+    }
+    return value_operand(value);
+}
+
+static bool small_const(const int value) {
+    return ir_is_const(ir, value) && fits_int32(ir->insts[value].value.integer);
+}
+
+static void load_double(const int dst, const int value) {
+    if (!ir_is_const(ir, value)) {
+        movsd_load(dst, value_operand(value));
+        return;
+    }
+    const double real = ir->insts[value].value.real;
+    uint64_t bits;
+    memcpy(&bits, &real, sizeof(bits));
+    if (bits == 0) {
+        zero_xmm(dst);
+    } else {
+        movsd_load(dst, label_operand(pool_double(real)));
+    }
+}
+
+static Operand double_operand(const int value) {
+    if (ir_is_const(ir, value)) return label_operand(pool_double(ir->insts[value].value.real));
+    return value_operand(value);
+}
+
+// The register a value is computed in: its own, or scratch when it has a slot
+static int int_target(const int value) {
+    return locations[value].kind == LOCATION_GPR ? locations[value].where : RAX;
+}
+
+static int double_target(const int value) {
+    return locations[value].kind == LOCATION_XMM ? locations[value].where : XMM0;
+}
+
+static void store_int(const int value, const int src) {
+    if (locations[value].kind == LOCATION_GPR) {
+        mov_load(locations[value].where, reg(src));
+    } else if (locations[value].kind == LOCATION_FRAME) {
+        mov_store(value_operand(value), src);
+    }
+}
+
+static void store_double(const int value, const int src) {
+    if (locations[value].kind == LOCATION_XMM) {
+        movsd_load(locations[value].where, reg(src));
+    } else if (locations[value].kind == LOCATION_FRAME) {
+        movsd_store(value_operand(value), src);
+    }
+}
+
+static Condition int_condition(const IrOp op) {
+    switch (op) {
+        case IR_EQ: return CC_E;
+        case IR_NE: return CC_NE;
+        case IR_LT: return CC_L;
+        case IR_GT: return CC_G;
+        case IR_LE: return CC_LE;
+        default: return CC_GE;
+    }
+}
+
+// Set the flags for an integer compare and return the condition that holds
+// when it is true
+static Condition compare_ints(const IrInst* inst) {
+    const int a = ir_resolve(ir, inst->args[0]);
+    const int b = ir_resolve(ir, inst->args[1]);
+    int left = RAX;
+    if (locations[a].kind == LOCATION_GPR) {
+        left = locations[a].where;
+    } else {
+        load_int(RAX, a);
+    }
+    if (small_const(b)) {
+        alu_imm(ALU_CMP, reg(left), (int32_t)ir->insts[b].value.integer);
+    } else {
+        alu(ALU_CMP, left, int_operand(b, RCX));
+    }
+    return int_condition(inst->op);
+}
+
+// 1 in al when a double compare holds; NaN compares unordered, so only !=
+// holds for it
+static void compare_doubles(const IrOp op, const int a, const int b) {
+    switch (op) {
+        case IR_EQ:
+        case IR_NE: {
+            int left = XMM0;
+            if (locations[a].kind == LOCATION_XMM) {
+                left = locations[a].where;
+            } else {
+                load_double(XMM0, a);
+            }
+            if (b < 0) {
+                zero_xmm(XMM1);
+                sse(0x66, 0x0F2E, left, reg(XMM1));
+            } else {
+                sse(0x66, 0x0F2E, left, double_operand(b));
+            }
+            const bool equal = op == IR_EQ;
+            setcc(equal ? CC_E : CC_NE, RAX);
+            setcc(equal ? CC_NP : CC_P, RCX);
+            encode(0, false, equal ? 0x20 : 0x08, RCX, reg(RAX));
+            return;
+        }
+        default: {
+            // a < b and a <= b test b > a and b >= a, which fail when unordered
+            const bool swap = op == IR_LT || op == IR_LE;
+            const int left_value = swap ? b : a;
+            const int right_value = swap ? a : b;
+            int left = XMM0;
+            if (locations[left_value].kind == LOCATION_XMM) {
+                left = locations[left_value].where;
+            } else {
+                load_double(XMM0, left_value);
+            }
+            sse(0x66, 0x0F2E, left, double_operand(right_value));
+            setcc(op == IR_LT || op == IR_GT ? CC_A : CC_AE, RAX);
+            return;
+        }
+    }
+}
+
+static void generate_truth(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int a = ir_resolve(ir, inst->args[0]);
+    const int target = int_target(id);
+    if (ir->insts[a].type == TYPE_DOUBLE) {
+        if (inst->op == IR_NOT) {
+            compare_doubles(IR_EQ, a, -1);
+        } else {
+            compare_doubles(inst->op, a, ir_resolve(ir, inst->args[1]));
+        }
+    } else if (inst->op == IR_NOT) {
+        alu_imm(ALU_CMP, int_operand(a, RAX), 0);
+        setcc(CC_E, RAX);
+    } else {
+        setcc(compare_ints(inst), RAX);
+    }
+    movzx_al(target);
+    store_int(id, target);
+}
+
+// a % divisor without idiv: the quotient is the high half of a times a magic
+// multiplier, shifted and rounded toward zero (Hacker's Delight, 10-1). The
+// remainder takes the sign of a, so only the divisor's magnitude matters.
+static bool mod_by_constant(const int id, const int a, const int64_t divisor) {
+    if (divisor == 0 || divisor == INT64_MIN) return false;
+    const uint64_t d = divisor < 0 ? (uint64_t)-divisor : (uint64_t)divisor;
+    if (d == 1) {
+        mov_imm(int_target(id), 0);
+        store_int(id, int_target(id));
+        return true;
+    }
+
+    const uint64_t two63 = 1ull << 63;
+    const uint64_t anc = two63 - 1 - two63 % d;
+    int p = 63;
+    uint64_t q1 = two63 / anc, r1 = two63 - q1 * anc;
+    uint64_t q2 = two63 / d, r2 = two63 - q2 * d;
+    uint64_t delta;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= d) {
+            q2++;
+            r2 -= d;
+        }
+        delta = d - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    const int64_t magic = (int64_t)(q2 + 1);
+    const int shift = p - 64;
+
+    load_int(RCX, a);
+    mov_imm(RAX, magic);
+    encode(0, true, 0xF7, 5, reg(RCX));                 // rdx:rax = rax * rcx
+    if (magic < 0) alu(ALU_ADD, RDX, reg(RCX));
+    if (shift > 0) {
+        encode(0, true, 0xC1, 7, reg(RDX));
+        emit_byte(shift);
+    }
+    mov_load(RAX, reg(RCX));
+    encode(0, true, 0xC1, 5, reg(RAX));                 // Add 1 when a is negative
+    emit_byte(63);
+    alu(ALU_ADD, RDX, reg(RAX));
+    if (fits_int32((int64_t)d)) {
+        encode(0, true, fits_int8((int64_t)d) ? 0x6B : 0x69, RDX, reg(RDX));
+        if (fits_int8((int64_t)d)) {
+            emit_byte((int)d);
+        } else {
+            emit32((uint32_t)d);
+        }
+    } else {
+        mov_imm(RAX, (int64_t)d);
+        encode(0, true, 0x0FAF, RDX, reg(RAX));
+    }
+    alu(ALU_SUB, RCX, reg(RDX));
+    store_int(id, RCX);
+    return true;
+}
+
+static void generate_int(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int a = ir_resolve(ir, inst->args[0]);
+    const int b = inst->args[1] >= 0 ? ir_resolve(ir, inst->args[1]) : -1;
+    const int target = int_target(id);
+    switch (inst->op) {
+        case IR_ADD: case IR_SUB: case IR_AND: case IR_OR: case IR_XOR: {
+            const AluOp op = inst->op == IR_ADD ? ALU_ADD : inst->op == IR_SUB ? ALU_SUB
+                           : inst->op == IR_AND ? ALU_AND : inst->op == IR_OR ? ALU_OR : ALU_XOR;
+            load_int(target, a);
+            if (small_const(b)) {
+                alu_imm(op, reg(target), (int32_t)ir->insts[b].value.integer);
+            } else {
+                alu(op, target, int_operand(b, RCX));
+            }
+            break;
+        }
+        case IR_MUL:
+            if (small_const(b)) {
+                const int64_t imm = ir->insts[b].value.integer;
+                encode(0, true, fits_int8(imm) ? 0x6B : 0x69, target, int_operand(a, target));
+                if (fits_int8(imm)) {
+                    emit_byte((int)imm & 0xFF);
+                } else {
+                    emit32((uint32_t)imm);
+                }
+            } else {
+                load_int(target, a);
+                encode(0, true, 0x0FAF, target, int_operand(b, RCX));
+            }
+            break;
+        case IR_MOD:
+            if (ir_is_const(ir, b) && mod_by_constant(id, a, ir->insts[b].value.integer)) return;
+            load_int(RAX, a);
+            emit_byte(0x48);    // cqo
+            emit_byte(0x99);
+            encode(0, true, 0xF7, 7, int_operand(b, RCX));
+            store_int(id, RDX);
+            return;
+        case IR_SHL:
+        case IR_SHR: {
+            const int extension = inst->op == IR_SHL ? 4 : 7;
+            if (ir_is_const(ir, b)) {
+                load_int(target, a);
+                encode(0, true, 0xC1, extension, reg(target));
+                emit_byte((int)(ir->insts[b].value.integer & 63));
+            } else {
+                load_int(RCX, b);
+                load_int(target, a);
+                encode(0, true, 0xD3, extension, reg(target));
+            }
+            break;
+        }
+        case IR_NEG:
+        case IR_BITNOT:
+            load_int(target, a);
+            encode(0, true, 0xF7, inst->op == IR_NEG ? 3 : 2, reg(target));
+            break;
+        case IR_TO_INT:
+            encode(0xF2, true, 0x0F2C, target, double_operand(a));
+            break;
+        default:
+            fprintf(stderr, "Error: Invalid integer IR operator %s\n", ir_op_to_string(inst->op));
+            exit(EXIT_FAILURE);
+    }
+    store_int(id, target);
+}
+
+static void generate_double(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int a = ir_resolve(ir, inst->args[0]);
+    const int target = double_target(id);
+    switch (inst->op) {
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: {
+            const int opcode = inst->op == IR_ADD ? 0x0F58 : inst->op == IR_SUB ? 0x0F5C
+                             : inst->op == IR_MUL ? 0x0F59 : 0x0F5E;
+            load_double(target, a);
+            sse(0xF2, opcode, target, double_operand(ir_resolve(ir, inst->args[1])));
+            break;
+        }
+        case IR_NEG:
+            load_double(target, a);
+            sse(0x66, 0x0F57, target, label_operand(mask_label(&sign_mask)));
+            break;
+        case IR_TO_DOUBLE:
+            encode(0xF2, true, 0x0F2A, target, int_operand(a, RAX));
+            break;
+        default:
+            fprintf(stderr, "Error: Invalid double IR operator %s\n", ir_op_to_string(inst->op));
+            exit(EXIT_FAILURE);
+    }
+    store_double(id, target);
+}
+
+static bool is_view(const int slot) {
+    return slot >= 0 && ir->symbols[slot].type == TYPE_VIEW;
+}
+
+static size_t literal_length(const Lexeme text) {
+    char* decoded = ir_allocate((size_t)text.length + 1, 1);
+    const size_t length = lexeme_decode_string(text, decoded);
+    free(decoded);
+    return length;
+}
+
+// The text and length of a string operand: a string or view slot, whose first
+// two words are both, or a literal
+static void load_text(const int text, const int length, const int slot, const Lexeme literal) {
+    if (slot >= 0) {
+        mov_load(text, bss_operand(bss_offsets[slot]));
+        mov_load(length, bss_operand(bss_offsets[slot] + 8));
+    } else {
+        lea(text, label_operand(pool_literal(literal)));
+        mov_imm(length, (int64_t)pool_strings[pool_string_count - 1].length);
+    }
+}
+
+// Clamp the start and count in rax and rcx to the length in r11, and point the
+// view at the bytes they cover
+static void generate_slice(const IrInst* inst) {
+    load_int(RAX, ir_resolve(ir, inst->args[0]));
+    load_int(RCX, ir_resolve(ir, inst->args[1]));
+    if (inst->source >= 0) {
+        mov_load(R11, bss_operand(bss_offsets[inst->source] + 8));
+    } else {
+        mov_imm(R11, (int64_t)literal_length(inst->text));
+    }
+    encode(0, false, 0x31, RDX, reg(RDX));
+    encode(0, true, 0x85, RAX, reg(RAX));
+    cmov(CC_L, RAX, RDX);
+    alu(ALU_CMP, RAX, reg(R11));
+    cmov(CC_G, RAX, R11);
+    alu(ALU_SUB, R11, reg(RAX));
+    encode(0, true, 0x85, RCX, reg(RCX));
+    cmov(CC_L, RCX, RDX);
+    alu(ALU_CMP, RCX, reg(R11));
+    cmov(CC_G, RCX, R11);
+    mov_store(bss_operand(bss_offsets[inst->slot] + 8), RCX);
+    if (inst->source >= 0) {
+        mov_load(RDX, bss_operand(bss_offsets[inst->source]));
+    } else {
+        lea(RDX, label_operand(pool_literal(inst->text)));
+    }
+    alu(ALU_ADD, RDX, reg(RAX));
+    mov_store(bss_operand(bss_offsets[inst->slot]), RDX);
+}
+
+// The builtins that call the runtime take their strings in rdi and rsi, and
+// rdx and rcx, and their number in r8
+static void generate_builtin(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    if (inst->op != IR_SPLIT_STRING && locations[id].kind == LOCATION_NONE) return;
+    if (inst->args[0] >= 0) load_int(RAX, ir_resolve(ir, inst->args[0]));
+    load_text(RDI, RSI, inst->source, inst->text);
+    load_text(RDX, RCX, inst->other, inst->other_text);
+    if (inst->args[0] >= 0) mov_load(R8, reg(RAX));
+    switch (inst->op) {
+        case IR_SPLIT_STRING:
+            call(split_label);
+            mov_store(bss_operand(bss_offsets[inst->slot]), RAX);
+            mov_store(bss_operand(bss_offsets[inst->slot] + 8), RDX);
+            return;
+        case IR_FIND_STRING:
+            call(find_label);
+            break;
+        case IR_COMPARE_STRING:
+            call(compare_label);
+            break;
+        default:
+            call(equal_label);
+            break;
+    }
+    store_int(id, RAX);
+}
+
+// The address of element args[0] of an array in rcx, after checking the index
+// against the length unless it is proven in range
+static void element_address(const IrInst* inst) {
+    const int32_t array = bss_offsets[inst->slot];
+    load_int(RCX, ir_resolve(ir, inst->args[0]));
+    if (!inst->in_bounds) {
+        const int ok = new_label();
+        alu(ALU_CMP, RCX, bss_operand(array + 8));
+        jump_if(CC_B, ok);
+        mov_load(RDI, reg(RCX));
+        mov_load(RSI, bss_operand(array + 8));
+        mov_imm(RDX, inst->line);
+        call(index_error_label);
+        bind(ok);
+    }
+    encode(0, true, 0xC1, 4, reg(RCX));     // shl rcx, 3
+    emit_byte(3);
+    alu(ALU_ADD, RCX, bss_operand(array));
+}
+
+static void generate_array(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int32_t array = bss_offsets[inst->slot];
+    switch (inst->op) {
+        case IR_LOAD_ARRAY:
+            if (locations[id].kind == LOCATION_NONE) {
+                if (!inst->in_bounds) element_address(inst);
+                return;
+            }
+            element_address(inst);
+            if (inst->type == TYPE_INT) {
+                mov_load(int_target(id), memory(RCX, 0));
+                store_int(id, int_target(id));
+            } else {
+                movsd_load(double_target(id), memory(RCX, 0));
+                store_double(id, double_target(id));
+            }
+            return;
+        case IR_LENGTH_ARRAY:
+            if (locations[id].kind == LOCATION_NONE) return;
+            mov_load(int_target(id), bss_operand(array + 8));
+            store_int(id, int_target(id));
+            return;
+        case IR_CLEAR_ARRAY:
+            encode(0, false, 0x31, RAX, reg(RAX));
+            mov_store(bss_operand(array + 8), RAX);
+            return;
+        case IR_PUSH_ARRAY: {
+            // The value may be in rdi or rsi, so it is loaded before them
+            const int value = ir_resolve(ir, inst->args[0]);
+            if (inst->type == TYPE_INT) {
+                load_int(RAX, value);
+            } else {
+                load_double(XMM0, value);
+            }
+            lea(RDI, bss_operand(array));
+            if (inst->type == TYPE_INT) {
+                mov_load(RSI, reg(RAX));
+            } else {
+                encode(0x66, true, 0x0F7E, XMM0, reg(RSI));     // movq rsi, xmm0
+            }
+            call(push_array_label);
+            return;
+        }
+        case IR_SET_ARRAY:
+            if (inst->source == inst->slot) return;
+            lea(RDI, bss_operand(array));
+            lea(RSI, bss_operand(bss_offsets[inst->source]));
+            call(set_array_label);
+            return;
+        default: {
+            const int value = ir_resolve(ir, inst->args[1]);
+            element_address(inst);
+            if (inst->type == TYPE_INT) {
+                int src = RAX;
+                if (locations[value].kind == LOCATION_GPR) {
+                    src = locations[value].where;
+                } else {
+                    load_int(RAX, value);
+                }
+                mov_store(memory(RCX, 0), src);
+            } else {
+                load_double(XMM0, value);
+                movsd_store(memory(RCX, 0), XMM0);
+            }
+            return;
+        }
+    }
+}
+
+// The key of a map instruction hashed into rax, with a string key's text
+// and length in rsi and rdx; a number key has none
+static void map_key(const IrInst* inst) {
+    if (ir->symbols[inst->slot].type == TYPE_STRING_MAP) {
+        load_text(RSI, RDX, inst->source, inst->text);
+        call(hash_text_label);
+    } else {
+        load_double(XMM0, ir_resolve(ir, inst->args[0]));
+        call(hash_double_label);
+        encode(0, false, 0x31, RSI, reg(RSI));
+        encode(0, false, 0x31, RDX, reg(RDX));
+    }
+}
+
+// Maps are a control byte array, the number of keys, the entries, the
+// capacity and the slots used, keys or deleted, in 40 bytes of bss
+static void generate_map(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    const int32_t map = bss_offsets[inst->slot];
+    switch (inst->op) {
+        case IR_LENGTH_MAP:
+            if (locations[id].kind == LOCATION_NONE) return;
+            mov_load(int_target(id), bss_operand(map + 8));
+            store_int(id, int_target(id));
+            return;
+        case IR_CLEAR_MAP:
+            lea(RDI, bss_operand(map));
+            call(map_clear_label);
+            return;
+        case IR_PUT_MAP: {
+            // Hashing a string key keeps xmm0, and a number key is hashed from it
+            const int value = ir_resolve(ir, inst->args[1]);
+            const bool strings = ir->symbols[inst->slot].type == TYPE_STRING_MAP;
+            if (strings) load_double(XMM0, value);
+            map_key(inst);
+            if (!strings) load_double(XMM0, value);
+            lea(RDI, bss_operand(map));
+            call(map_put_label);
+            return;
+        }
+        case IR_DEL_MAP:
+            map_key(inst);
+            lea(RDI, bss_operand(map));
+            call(map_delete_label);
+            store_int(id, RAX);
+            return;
+        case IR_HAS_MAP:
+            if (locations[id].kind == LOCATION_NONE) return;
+            map_key(inst);
+            lea(RDI, bss_operand(map));
+            call(map_find_label);
+            encode(0, true, 0x85, RAX, reg(RAX));
+            setcc(CC_NE, RAX);
+            movzx_al(RAX);
+            store_int(id, RAX);
+            return;
+        default: {
+            if (locations[id].kind == LOCATION_NONE) return;
+            const int missing = new_label();
+            map_key(inst);
+            lea(RDI, bss_operand(map));
+            call(map_find_label);
+            zero_xmm(XMM0);
+            encode(0, true, 0x85, RAX, reg(RAX));
+            jump_if(CC_E, missing);
+            movsd_load(XMM0, memory(RAX, 24));
+            bind(missing);
+            store_double(id, XMM0);
+            return;
+        }
+    }
+}
+
+static void generate_instruction(const int id) {
+    const IrInst* inst = &ir->insts[id];
+    switch (inst->op) {
+        case IR_CONST:
+        case IR_PHI:
+        case IR_COPY:
+            return;
+        case IR_IN:
+            load_double(XMM0, ir_resolve(ir, inst->args[0]));
+            call(in_double_label);
+            store_double(id, XMM0);
+            return;
+        case IR_OUT: {
+            const int value = ir_resolve(ir, inst->args[0]);
+            if (ir->insts[value].type == TYPE_INT) {
+                load_int(RDI, value);
+                call(out_int_label);
+            } else {
+                load_double(XMM0, value);
+                call(out_double_label);
+            }
+            return;
+        }
+        case IR_IN_STRING:
+            lea(RDI, bss_operand(bss_offsets[inst->slot]));
+            call(in_string_label);
+            return;
+        case IR_OUT_STRING:
+            if (is_view(inst->source)) {
+                load_text(RDI, RSI, inst->source, inst->text);
+                call(out_view_label);
+            } else if (inst->source >= 0) {
+                lea(RDI, bss_operand(bss_offsets[inst->source]));
+                call(out_string_label);
+            } else {
+                // The literal is the format, as in the C the other backend writes
+                lea(RDI, label_operand(pool_literal(inst->text)));
+                encode(0, false, 0x31, RAX, reg(RAX));
+                call_extern(X86_PRINTF);
+            }
+            return;
+        case IR_SET_STRING:
+        case IR_APPEND_STRING:
+            if (inst->op == IR_SET_STRING && inst->source == inst->slot) return;
+            lea(RDI, bss_operand(bss_offsets[inst->slot]));
+            if (inst->source >= 0) {
+                mov_load(RSI, bss_operand(bss_offsets[inst->source]));
+                mov_load(RDX, bss_operand(bss_offsets[inst->source] + 8));
+            } else {
+                lea(RSI, label_operand(pool_literal(inst->text)));
+                mov_imm(RDX, (int64_t)strlen(pool_strings[pool_string_count - 1].text));
+            }
+            call(inst->op == IR_SET_STRING ? set_string_label : append_string_label);
+            return;
+        case IR_SLICE_STRING:
+            generate_slice(inst);
+            return;
+        case IR_LENGTH_STRING:
+            if (locations[id].kind == LOCATION_NONE) return;
+            if (inst->source >= 0) {
+                mov_load(int_target(id), bss_operand(bss_offsets[inst->source] + 8));
+            } else {
+                mov_imm(int_target(id), (int64_t)literal_length(inst->text));
+            }
+            store_int(id, int_target(id));
+            return;
+        case IR_SPLIT_STRING:
+        case IR_FIND_STRING:
+        case IR_COMPARE_STRING:
+        case IR_EQUAL_STRING:
+            generate_builtin(id);
+            return;
+        case IR_LOAD_ARRAY:
+        case IR_LENGTH_ARRAY:
+        case IR_CLEAR_ARRAY:
+        case IR_PUSH_ARRAY:
+        case IR_SET_ARRAY:
+        case IR_STORE_ARRAY:
+            generate_array(id);
+            return;
+        case IR_GET_MAP:
+        case IR_HAS_MAP:
+        case IR_DEL_MAP:
+        case IR_LENGTH_MAP:
+        case IR_CLEAR_MAP:
+        case IR_PUT_MAP:
+            generate_map(id);
+            return;
+        case IR_MOVE_STRING:
+            // Swap the two strings, a word at a time
+            for (int32_t word = 0; word < 24; word += 8) {
+                mov_load(RAX, bss_operand(bss_offsets[inst->slot] + word));
+                mov_load(RCX, bss_operand(bss_offsets[inst->source] + word));
+                mov_store(bss_operand(bss_offsets[inst->slot] + word), RCX);
+                mov_store(bss_operand(bss_offsets[inst->source] + word), RAX);
+            }
+            return;
+        default:
+            if (locations[id].kind == LOCATION_NONE) return;
+            if (is_compare(inst->op) || inst->op == IR_NOT) {
+                generate_truth(id);
+            } else if (inst->type == TYPE_INT) {
+                generate_int(id);
+            } else {
+                generate_double(id);
+            }
+            return;
+    }
+}
+
+static bool same_location(const Location a, const Location b) {
+    return a.kind == b.kind && a.where == b.where;
+}
+
+static void emit_move(const Move* move) {
+    const Location to = move->to;
+    const bool is_int = move->type == TYPE_INT;
+    if (to.kind == LOCATION_GPR) {
+        if (move->constant >= 0) {
+            load_int(to.where, move->constant);
+        } else {
+            mov_load(to.where, location_operand(move->from));
+        }
+    } else if (to.kind == LOCATION_XMM) {
+        if (move->constant >= 0) {
+            load_double(to.where, move->constant);
+        } else {
+            movsd_load(to.where, location_operand(move->from));
+        }
+    } else if (is_int) {
+        if (move->constant >= 0 && small_const(move->constant)) {
+            encode(0, true, 0xC7, 0, location_operand(to));
+            emit32((uint32_t)ir->insts[move->constant].value.integer);
+            return;
+        }
+        int src = R11;
+        if (move->constant >= 0) {
+            load_int(R11, move->constant);
+        } else if (move->from.kind == LOCATION_GPR) {
+            src = move->from.where;
+        } else {
+            mov_load(R11, location_operand(move->from));
+        }
+        mov_store(location_operand(to), src);
+    } else {
+        int src = XMM1;
+        if (move->constant >= 0) {
+            load_double(XMM1, move->constant);
+        } else if (move->from.kind == LOCATION_XMM) {
+            src = move->from.where;
+        } else {
+            movsd_load(XMM1, location_operand(move->from));
+        }
+        movsd_store(location_operand(to), src);
+    }
+}
+
+// Gather the copies into target's phis along the edge from block
+static int edge_moves(const int block, const int target, Move* moves) {
+    const IrBlock* succ = &ir->blocks[target];
+    int index = 0;
+    while (index < succ->pred_count && succ->preds[index] != block) index++;
+
+    int count = 0;
+    for (int id = succ->first; id >= 0 && ir->insts[id].op == IR_PHI; id = ir->insts[id].next) {
+        if (locations[id].kind == LOCATION_NONE) continue;
+        const int value = ir_resolve(ir, ir->insts[id].phi_args[index]);
+        if (value == id) continue;
+        Move move = {-1, locations[value], locations[id], ir->insts[id].type};
+        if (ir_is_const(ir, value)) {
+            move.constant = value;
+        } else if (same_location(move.from, move.to)) {
+            continue;
+        }
+        if (moves != nullptr) moves[count] = move;
+        count++;
+    }
+    return count;
+}
+
+static bool reads(const Move* moves, const int count, const Location location) {
+    for (int i = 0; i < count; i++) {
+        if (moves[i].constant < 0 && same_location(moves[i].from, location)) return true;
+    }
+    return false;
+}
+
+// Copy into the phis as if at once: write a location only once nothing
+// still reads it, and break cycles through a scratch register
+static void emit_edge_moves(const int block, const int target) {
+    const int total = edge_moves(block, target, nullptr);
+    if (total == 0) return;
+    Move* moves = ir_allocate((size_t)total, sizeof(Move));
+    int count = edge_moves(block, target, moves);
+    while (count > 0) {
+        bool progress = false;
+        for (int i = 0; i < count; i++) {
+            if (reads(moves, count, moves[i].to)) continue;
+            emit_move(&moves[i]);
+            moves[i--] = moves[--count];
+            progress = true;
+        }
+        if (progress) continue;
+
+        const Location blocked = moves[0].to;
+        const Location temp = moves[0].type == TYPE_INT ? (Location){LOCATION_GPR, RAX}
+                                                        : (Location){LOCATION_XMM, XMM0};
+        emit_move(&(Move){-1, blocked, temp, moves[0].type});
+        for (int i = 0; i < count; i++) {
+            if (moves[i].constant < 0 && same_location(moves[i].from, blocked)) moves[i].from = temp;
+        }
+    }
+    free(moves);
+}
+
+// Follow an edge; next is the block placed after this one, or -1
+static void emit_edge(const int block, const int target, const int next) {
+    emit_edge_moves(block, target);
+    if (target != next) jump(target);
+}
+
+static void emit_branch(const int b, const Condition cc, const int next) {
+    const IrBlock* block = &ir->blocks[b];
+    const int taken = block->succ[0];
+    const int other = block->succ[1];
+    const bool taken_moves = edge_moves(b, taken, nullptr) > 0;
+    const bool other_moves = edge_moves(b, other, nullptr) > 0;
+    const Condition inverse = (Condition)(cc ^ 1);
+
+    if (!taken_moves && !other_moves) {
+        if (taken == next) {
+            jump_if(inverse, other);
+        } else {
+            jump_if(cc, taken);
+            if (other != next) jump(other);
+        }
+    } else if (!taken_moves) {
+        jump_if(cc, taken);
+        emit_edge(b, other, next);
+    } else if (!other_moves) {
+        jump_if(inverse, other);
+        emit_edge(b, taken, next);
+    } else {
+        const int skip = new_label();
+        jump_if(inverse, skip);
+        emit_edge(b, taken, -1);
+        bind(skip);
+        emit_edge(b, other, next);
+    }
+}
+
+static void emit_epilogue() {
+    if (saved_count > 0) {
+        lea(RSP, memory(RBP, -8 * saved_count));
+    } else {
+        encode(0, true, 0x8B, RSP, reg(RBP));
+    }
+    for (int r = 15; r >= 0; r--) {
+        if (saved[r]) pop(r);
+    }
+    pop(RBP);
+    emit_byte(0xC3);
+}
+
+static void generate_terminator(const int b, const int next) {
+    const IrBlock* block = &ir->blocks[b];
+    switch (block->term) {
+        case TERM_JUMP:
+            emit_edge(b, block->succ[0], next);
+            return;
+        case TERM_BRANCH: {
+            const int cond = ir_resolve(ir, block->cond);
+            Condition cc = CC_NE;
+            if (fused[cond]) {
+                cc = compare_ints(&ir->insts[cond]);
+            } else if (ir->insts[cond].type == TYPE_DOUBLE) {
+                compare_doubles(IR_NE, cond, -1);
+                encode(0, false, 0x84, RAX, reg(RAX));  // test al, al
+            } else {
+                alu_imm(ALU_CMP, int_operand(cond, RAX), 0);
+            }
+            emit_branch(b, cc, next);
+            return;
+        }
+        case TERM_EXIT: {
+            const int status = ir_resolve(ir, block->cond);
+            if (ir->insts[status].type == TYPE_INT) {
+                load_int(RAX, status);
+            } else {
+                encode(0xF2, false, 0x0F2C, RAX, double_operand(status));
+            }
+            emit_epilogue();
+            return;
+        }
+        default:
+            encode(0, false, 0x31, RAX, reg(RAX));
+            emit_epilogue();
+            return;
+    }
+}
+
+static void emit_prologue(const char* precomputed, const size_t precomputed_length) {
+    push(RBP);
+    encode(0, true, 0x8B, RBP, reg(RSP));
+    for (int r = 0; r < 16; r++) {
+        if (saved[r]) push(r);
+    }
+    // Keep rsp 16-byte aligned for calls
+    int frame = 8 * frame_slots;
+    if ((8 * saved_count + frame) % 16 != 0) frame += 8;
+    if (frame > 0) alu_imm(ALU_SUB, reg(RSP), frame);
+
+    if (precomputed_length > 0) {
+        mov_load(RCX, extern_operand(X86_STDOUT));
+        mov_load(RCX, memory(RCX, 0));
+        lea(RDI, label_operand(pool_string((char*)precomputed, precomputed_length, false)));
+        mov_imm(RSI, 1);
+        mov_imm(RDX, (int64_t)precomputed_length);
+        call_extern(X86_FWRITE);
+    }
+}
+
+// --- Runtime ----------------------------------------------------------------
+
+// printf(format, value in rdi) or scanf; rsp is 8 off alignment on entry
+static void emit_call_with_format(const int label, const char* format, const X86Extern function) {
+    bind(label);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RSI, reg(RDI));
+    lea(RDI, label_operand(pool_text(format)));
+    encode(0, false, 0x31, RAX, reg(RAX));
+    call_extern(function);
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    emit_byte(0xC3);
+}
+
+// Print xmm0 as printf("%.0f\n") when floor(x) == ceil(x), else "%f\n"
+static void emit_out_double() {
+    const int fraction = new_label();
+    const int whole = new_label();
+    const int print = new_label();
+    bind(out_double_label);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    movsd_load(XMM1, reg(XMM0));
+    sse(0x66, 0x0F54, XMM1, label_operand(mask_label(&abs_mask)));
+    sse(0x66, 0x0F2E, XMM1, label_operand(pool_double(4503599627370496.0)));
+    jump_if(CC_P, fraction);
+    jump_if(CC_AE, whole);      // Beyond 2^52, and infinities, are whole
+    encode(0xF2, true, 0x0F2C, RAX, reg(XMM0));
+    encode(0xF2, true, 0x0F2A, XMM1, reg(RAX));
+    sse(0x66, 0x0F2E, XMM0, reg(XMM1));
+    jump_if(CC_NE, fraction);
+    bind(whole);
+    lea(RDI, label_operand(pool_text("%.0f\n")));
+    jump(print);
+    bind(fraction);
+    lea(RDI, label_operand(pool_text("%f\n")));
+    bind(print);
+    mov_imm(RAX, 1);
+    call_extern(X86_PRINTF);
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    emit_byte(0xC3);
+}
+
+// scanf("%lf") into a copy of xmm0, which keeps the value when input fails
+static void emit_in_double() {
+    bind(in_double_label);
+    alu_imm(ALU_SUB, reg(RSP), 24);
+    movsd_store(memory(RSP, 8), XMM0);
+    lea(RSI, memory(RSP, 8));
+    lea(RDI, label_operand(pool_text("%lf")));
+    encode(0, false, 0x31, RAX, reg(RAX));
+    call_extern(X86_SCANF);
+    movsd_load(XMM0, memory(RSP, 8));
+    alu_imm(ALU_ADD, reg(RSP), 24);
+    emit_byte(0xC3);
+}
+
+// Append rdx bytes at rsi to the string at rdi, growing its buffer by
+// doubling; the text may be the string's own, or a view into it. Setting
+// empties it first.
+static void emit_append_string() {
+    const int copy = new_label();
+    const int copied = new_label();
+    const int large = new_label();
+    const int sized = new_label();
+    const int other = new_label();
+    bind(set_string_label);
+    encode(0, true, 0xC7, 0, memory(RDI, 8));
+    emit32(0);
+    bind(append_string_label);
+    push(RBX);
+    push(R12);
+    push(R13);
+    push(R14);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RBX, reg(RDI));
+    mov_load(R12, reg(RSI));
+    mov_load(R13, reg(RDX));
+    mov_load(RAX, memory(RBX, 8));
+    lea(RDI, memory(RAX, 1));
+    alu(ALU_ADD, RDI, reg(R13));
+    alu(ALU_CMP, RDI, memory(RBX, 16));
+    jump_if(CC_BE, copy);
+    mov_load(RSI, memory(RBX, 16));
+    alu(ALU_ADD, RSI, reg(RSI));
+    alu(ALU_CMP, RSI, reg(RDI));
+    jump_if(CC_AE, large);
+    mov_load(RSI, reg(RDI));
+    bind(large);
+    alu_imm(ALU_CMP, reg(RSI), 32);
+    jump_if(CC_AE, sized);
+    mov_imm(RSI, 32);
+    bind(sized);
+    mov_store(memory(RBX, 16), RSI);
+    // Text from the string itself moves with it: r14 is its offset, or -1
+    mov_imm(R14, -1);
+    mov_load(RAX, reg(R12));
+    alu(ALU_SUB, RAX, memory(RBX, 0));
+    alu(ALU_CMP, RAX, memory(RBX, 8));
+    jump_if(CC_A, other);
+    mov_load(R14, reg(RAX));
+    bind(other);
+    mov_load(RDI, memory(RBX, 0));
+    call_extern(X86_REALLOC);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, out_of_memory_label);
+    mov_store(memory(RBX, 0), RAX);
+    encode(0, true, 0x85, R14, reg(R14));
+    jump_if(CC_L, copy);
+    mov_load(R12, reg(RAX));
+    alu(ALU_ADD, R12, reg(R14));
+    bind(copy);
+    encode(0, true, 0x85, R13, reg(R13));
+    jump_if(CC_E, copied);
+    mov_load(RDI, memory(RBX, 0));
+    alu(ALU_ADD, RDI, memory(RBX, 8));
+    mov_load(RSI, reg(R12));
+    mov_load(RDX, reg(R13));
+    call_extern(X86_MEMMOVE);
+    bind(copied);
+    mov_load(RAX, memory(RBX, 8));
+    alu(ALU_ADD, RAX, reg(R13));
+    mov_store(memory(RBX, 8), RAX);
+    alu(ALU_ADD, RAX, memory(RBX, 0));
+    encode(0, false, 0xC6, 0, memory(RAX, 0));
+    emit_byte(0);
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    pop(R14);
+    pop(R13);
+    pop(R12);
+    pop(RBX);
+    emit_byte(0xC3);
+
+    // Reached with rsp aligned for the calls
+    bind(out_of_memory_label);
+    const char* message = "Memory allocation error\n";
+    mov_load(RCX, extern_operand(X86_STDERR));
+    mov_load(RCX, memory(RCX, 0));
+    lea(RDI, label_operand(pool_text(message)));
+    mov_imm(RSI, 1);
+    mov_imm(RDX, (int64_t)strlen(message));
+    call_extern(X86_FWRITE);
+    mov_imm(RDI, 1);
+    call_extern(X86_EXIT);
+}
+
+// Append the 8 bytes in rsi to the array at rdi, doubling its buffer from 8
+// elements when it is full
+static void emit_push_array() {
+    const int store = new_label();
+    const int sized = new_label();
+    bind(push_array_label);
+    mov_load(RAX, memory(RDI, 8));
+    alu(ALU_CMP, RAX, memory(RDI, 16));
+    jump_if(CC_B, store);
+    push(RBX);
+    push(R12);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RBX, reg(RDI));
+    mov_load(R12, reg(RSI));
+    mov_load(RSI, memory(RBX, 16));
+    alu(ALU_ADD, RSI, reg(RSI));
+    alu_imm(ALU_CMP, reg(RSI), 8);
+    jump_if(CC_AE, sized);
+    mov_imm(RSI, 8);
+    bind(sized);
+    mov_store(memory(RBX, 16), RSI);
+    encode(0, true, 0xC1, 4, reg(RSI));     // shl rsi, 3
+    emit_byte(3);
+    mov_load(RDI, memory(RBX, 0));
+    call_extern(X86_REALLOC);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, out_of_memory_label);
+    mov_store(memory(RBX, 0), RAX);
+    mov_load(RDI, reg(RBX));
+    mov_load(RSI, reg(R12));
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    pop(R12);
+    pop(RBX);
+    mov_load(RAX, memory(RDI, 8));
+    bind(store);
+    mov_load(RDX, reg(RAX));
+    encode(0, true, 0xC1, 4, reg(RDX));     // shl rdx, 3
+    emit_byte(3);
+    alu(ALU_ADD, RDX, memory(RDI, 0));
+    mov_store(memory(RDX, 0), RSI);
+    alu_imm(ALU_ADD, reg(RAX), 1);
+    mov_store(memory(RDI, 8), RAX);
+    emit_byte(0xC3);
+}
+
+// Copy the elements of the array at rsi into the array at rdi, growing its
+// buffer to fit
+static void emit_set_array() {
+    const int copy = new_label();
+    const int done = new_label();
+    bind(set_array_label);
+    push(RBX);
+    push(R12);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RBX, reg(RDI));
+    mov_load(R12, reg(RSI));
+    mov_load(RSI, memory(R12, 8));
+    alu(ALU_CMP, RSI, memory(RBX, 16));
+    jump_if(CC_BE, copy);
+    mov_store(memory(RBX, 16), RSI);
+    encode(0, true, 0xC1, 4, reg(RSI));     // shl rsi, 3
+    emit_byte(3);
+    mov_load(RDI, memory(RBX, 0));
+    call_extern(X86_REALLOC);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, out_of_memory_label);
+    mov_store(memory(RBX, 0), RAX);
+    bind(copy);
+    mov_load(RDX, memory(R12, 8));
+    mov_store(memory(RBX, 8), RDX);
+    encode(0, true, 0x85, RDX, reg(RDX));
+    jump_if(CC_E, done);
+    encode(0, true, 0xC1, 4, reg(RDX));     // shl rdx, 3
+    emit_byte(3);
+    mov_load(RDI, memory(RBX, 0));
+    mov_load(RSI, memory(R12, 0));
+    call_extern(X86_MEMMOVE);
+    bind(done);
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    pop(R12);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// Report index rdi out of range for length rsi at line rdx, after the output
+// so far, and exit
+static void emit_index_error() {
+    bind(index_error_label);
+    push(RBX);
+    push(R12);
+    push(R13);
+    mov_load(RBX, reg(RDI));
+    mov_load(R12, reg(RSI));
+    mov_load(R13, reg(RDX));
+    mov_load(RDI, extern_operand(X86_STDOUT));
+    mov_load(RDI, memory(RDI, 0));
+    call_extern(X86_FFLUSH);
+    mov_load(RDI, extern_operand(X86_STDERR));
+    mov_load(RDI, memory(RDI, 0));
+    lea(RSI, label_operand(pool_text("Runtime Error: Index %ld is out of range for %ld elements at line %d\n")));
+    mov_load(RDX, reg(RBX));
+    mov_load(RCX, reg(R12));
+    mov_load(R8, reg(R13));
+    encode(0, false, 0x31, RAX, reg(RAX));
+    call_extern(X86_FPRINTF);
+    mov_imm(RDI, 1);
+    call_extern(X86_EXIT);
+}
+
+// Maps are Swiss tables, as in the runtime of the generated C: groups of 16
+// slots, each with a control byte that is empty (0x80), deleted (0xFE) or 7
+// bits of the hash of its key, so that SSE2 compares a whole group at once.
+// Entries are 32 bytes: the hash, the copied text of a string key, its
+// length, and the value. A number key has no text; number keys hash one to
+// one, so its hash alone identifies it.
+#define MAP_EMPTY 0x80
+#define MAP_DELETED 0xFE
+
+// Every byte of an SSE register set to the byte in rax, which is all of rax;
+// clobbers rcx
+static void broadcast_byte(const int xmm) {
+    mov_imm(RCX, 0x0101010101010101);
+    encode(0, true, 0x0FAF, RAX, reg(RCX));         // imul rax, rcx
+    encode(0x66, true, 0x0F6E, xmm, reg(RAX));      // movq xmm, rax
+    sse(0x66, 0x0F6C, xmm, reg(xmm));               // punpcklqdq xmm, xmm
+}
+
+// A bit in dst for each control byte of the group at src equal to those in
+// xmm1, which the compare overwrites
+static void match_group(const int dst, const Operand group) {
+    sse(0xF3, 0x0F6F, XMM0, group);                 // movdqu xmm0, group
+    sse(0x66, 0x0F74, XMM1, reg(XMM0));             // pcmpeqb xmm1, xmm0
+    encode(0x66, false, 0x0FD7, dst, reg(XMM1));    // pmovmskb dst, xmm1
+}
+
+// The groups of the map at base, less one, in dst
+static void group_mask(const int dst, const int base) {
+    mov_load(dst, memory(base, 24));
+    shr_imm(dst, 4);
+    alu_imm(ALU_SUB, reg(dst), 1);
+}
+
+// hash = (hash ^ word) * constant, folding the high half into the low one;
+// clobbers rcx
+static void mix_word(const int word) {
+    alu(ALU_XOR, RAX, reg(word));
+    mov_imm(RCX, (int64_t)UINT64_C(0xFF51AFD7ED558CCD));
+    encode(0, true, 0x0FAF, RAX, reg(RCX));
+    mov_load(RCX, reg(RAX));
+    shr_imm(RCX, 32);
+    alu(ALU_XOR, RAX, reg(RCX));
+}
+
+// The hash of the double in xmm0, in rax: -0 is 0 and every NaN is one key.
+// Clobbers rcx and xmm1.
+static void emit_hash_double() {
+    const int nan = new_label();
+    const int mix = new_label();
+    bind(hash_double_label);
+    encode(0x66, true, 0x0F7E, XMM0, reg(RAX));     // movq rax, xmm0
+    zero_xmm(XMM1);
+    sse(0x66, 0x0F2E, XMM0, reg(XMM1));
+    jump_if(CC_P, nan);
+    jump_if(CC_NE, mix);
+    encode(0, false, 0x31, RAX, reg(RAX));
+    jump(mix);
+    bind(nan);
+    mov_imm(RAX, 0x7FF8000000000000);
+    bind(mix);
+    mov_load(RCX, reg(RAX));
+    shr_imm(RCX, 32);
+    alu(ALU_XOR, RAX, reg(RCX));
+    mov_imm(RCX, (int64_t)UINT64_C(0x9E3779B97F4A7C15));
+    encode(0, true, 0x0FAF, RAX, reg(RCX));
+    mov_load(RCX, reg(RAX));
+    shr_imm(RCX, 32);
+    alu(ALU_XOR, RAX, reg(RCX));
+    emit_byte(0xC3);
+}
+
+// The hash of the rdx bytes at rsi in rax, a word at a time and then the
+// bytes left over as one word. Keeps rsi, rdx and xmm0; clobbers rcx, rdi, r8
+// and r11.
+static void emit_hash_text() {
+    const int words = new_label();
+    const int tail = new_label();
+    const int bytes = new_label();
+    const int done = new_label();
+    bind(hash_text_label);
+    mov_load(RAX, reg(RDX));
+    mov_imm(RCX, (int64_t)UINT64_C(0x9E3779B97F4A7C15));
+    encode(0, true, 0x0FAF, RAX, reg(RCX));
+    mov_load(RDI, reg(RSI));
+    mov_load(R8, reg(RDX));
+    bind(words);
+    alu_imm(ALU_CMP, reg(R8), 8);
+    jump_if(CC_B, tail);
+    mov_load(R11, memory(RDI, 0));
+    mix_word(R11);
+    alu_imm(ALU_ADD, reg(RDI), 8);
+    alu_imm(ALU_SUB, reg(R8), 8);
+    jump(words);
+    bind(tail);
+    encode(0, true, 0x85, R8, reg(R8));
+    jump_if(CC_E, done);
+    encode(0, false, 0x31, R11, reg(R11));
+    bind(bytes);
+    shl_imm(R11, 8);
+    mov_load(RCX, reg(RDI));
+    alu(ALU_ADD, RCX, reg(R8));
+    encode(0, false, 0x0FB6, RCX, memory(RCX, -1));
+    alu(ALU_OR, R11, reg(RCX));
+    alu_imm(ALU_SUB, reg(R8), 1);
+    jump_if(CC_NE, bytes);
+    mix_word(R11);
+    bind(done);
+    emit_byte(0xC3);
+}
+
+// The entry of the map at rdi with hash rax and the key of rdx bytes at rsi,
+// or 0, in rax. Groups are probed triangularly from the one the hash picks,
+// until one has an empty slot.
+static void emit_map_find() {
+    const int probe = new_label();
+    const int candidates = new_label();
+    const int vacant = new_label();
+    const int missing = new_label();
+    const int done = new_label();
+    bind(map_find_label);
+    push(RBX);
+    push(R12);
+    push(R13);
+    push(R14);
+    push(R15);
+    // The matches left and the entry while memcmp runs, and the probe step
+    alu_imm(ALU_SUB, reg(RSP), 32);
+    mov_load(RBX, reg(RDI));
+    mov_load(R12, reg(RAX));
+    mov_load(R13, reg(RSI));
+    mov_load(R14, reg(RDX));
+    encode(0, false, 0x31, RAX, reg(RAX));
+    alu_imm(ALU_CMP, memory(RBX, 24), 0);
+    jump_if(CC_E, done);
+    encode(0, true, 0xC7, 0, memory(RSP, 16));
+    emit32(1);
+    mov_load(R15, reg(R12));
+    shr_imm(R15, 7);
+    group_mask(RCX, RBX);
+    alu(ALU_AND, R15, reg(RCX));
+
+    bind(probe);
+    mov_load(R10, reg(R15));
+    shl_imm(R10, 4);
+    alu(ALU_ADD, R10, memory(RBX, 0));
+    mov_load(RAX, reg(R12));
+    alu_imm(ALU_AND, reg(RAX), 0x7F);
+    broadcast_byte(XMM1);
+    match_group(R9, memory(R10, 0));
+    bind(candidates);
+    encode(0, false, 0x85, R9, reg(R9));
+    jump_if(CC_E, vacant);
+    encode(0, true, 0x0FBC, RCX, reg(R9));         // bsf rcx, r9
+    lea(RAX, memory(R9, -1));
+    alu(ALU_AND, R9, reg(RAX));
+    mov_load(RAX, reg(R15));
+    shl_imm(RAX, 4);
+    alu(ALU_ADD, RAX, reg(RCX));
+    shl_imm(RAX, 5);
+    alu(ALU_ADD, RAX, memory(RBX, 16));
+    alu(ALU_CMP, R12, memory(RAX, 0));
+    jump_if(CC_NE, candidates);
+    alu(ALU_CMP, R14, memory(RAX, 16));
+    jump_if(CC_NE, candidates);
+    encode(0, true, 0x85, R14, reg(R14));
+    jump_if(CC_E, done);
+    mov_store(memory(RSP, 0), R9);
+    mov_store(memory(RSP, 8), RAX);
+    mov_load(RDI, memory(RAX, 8));
+    mov_load(RSI, reg(R13));
+    mov_load(RDX, reg(R14));
+    call_extern(X86_MEMCMP);
+    encode(0, false, 0x85, RAX, reg(RAX));
+    mov_load(RAX, memory(RSP, 8));
+    mov_load(R9, memory(RSP, 0));
+    jump_if(CC_E, done);
+    jump(candidates);
+
+    bind(vacant);
+    mov_load(R10, reg(R15));
+    shl_imm(R10, 4);
+    alu(ALU_ADD, R10, memory(RBX, 0));
+    mov_imm(RAX, MAP_EMPTY);
+    broadcast_byte(XMM1);
+    match_group(RAX, memory(R10, 0));
+    encode(0, false, 0x85, RAX, reg(RAX));
+    jump_if(CC_NE, missing);
+    alu(ALU_ADD, R15, memory(RSP, 16));
+    alu_imm(ALU_ADD, memory(RSP, 16), 1);
+    group_mask(RCX, RBX);
+    alu(ALU_AND, R15, reg(RCX));
+    jump(probe);
+    bind(missing);
+    encode(0, false, 0x31, RAX, reg(RAX));
+    bind(done);
+    alu_imm(ALU_ADD, reg(RSP), 32);
+    pop(R15);
+    pop(R14);
+    pop(R13);
+    pop(R12);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// The first empty or deleted slot on the probe of hash rax in the map at rdi,
+// in rax. Keeps rsi, rdi and r8; clobbers rcx, rdx, r9 to r11 and xmm0.
+static void emit_map_slot() {
+    const int probe = new_label();
+    const int found = new_label();
+    bind(map_slot_label);
+    group_mask(RCX, RDI);
+    mov_load(R9, reg(RAX));
+    shr_imm(R9, 7);
+    alu(ALU_AND, R9, reg(RCX));
+    mov_imm(R10, 1);
+    bind(probe);
+    mov_load(R11, reg(R9));
+    shl_imm(R11, 4);
+    alu(ALU_ADD, R11, memory(RDI, 0));
+    sse(0xF3, 0x0F6F, XMM0, memory(R11, 0));        // movdqu xmm0, [r11]
+    encode(0x66, false, 0x0FD7, RDX, reg(XMM0));    // pmovmskb edx, xmm0
+    encode(0, false, 0x85, RDX, reg(RDX));
+    jump_if(CC_NE, found);
+    alu(ALU_ADD, R9, reg(R10));
+    alu_imm(ALU_ADD, reg(R10), 1);
+    alu(ALU_AND, R9, reg(RCX));
+    jump(probe);
+    bind(found);
+    encode(0, true, 0x0FBC, RDX, reg(RDX));         // bsf rdx, rdx
+    mov_load(RAX, reg(R9));
+    shl_imm(RAX, 4);
+    alu(ALU_ADD, RAX, reg(RDX));
+    emit_byte(0xC3);
+}
+
+// Rebuild the map at rdi without its deleted slots, with twice the capacity
+// if it is at least half full, and 16 slots to start with
+static void emit_map_rehash() {
+    const int sized = new_label();
+    const int kept = new_label();
+    const int next = new_label();
+    const int skip = new_label();
+    const int moved = new_label();
+    bind(map_rehash_label);
+    push(RBX);
+    push(R12);
+    push(R13);
+    push(R14);
+    push(R15);
+    mov_load(RBX, reg(RDI));
+    mov_load(R12, memory(RBX, 0));
+    mov_load(R13, memory(RBX, 16));
+    mov_load(R14, memory(RBX, 24));
+    mov_load(R15, reg(R14));
+    encode(0, true, 0x85, R15, reg(R15));
+    jump_if(CC_NE, sized);
+    mov_imm(R15, 16);
+    bind(sized);
+    mov_load(RAX, memory(RBX, 8));
+    alu_imm(ALU_ADD, reg(RAX), 1);
+    alu(ALU_ADD, RAX, reg(RAX));
+    alu(ALU_CMP, RAX, reg(R15));
+    jump_if(CC_BE, kept);
+    alu(ALU_ADD, R15, reg(R15));
+    bind(kept);
+    encode(0, false, 0x31, RDI, reg(RDI));
+    mov_load(RSI, reg(R15));
+    call_extern(X86_REALLOC);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, out_of_memory_label);
+    mov_store(memory(RBX, 0), RAX);
+    mov_load(RDI, reg(RAX));
+    mov_imm(RAX, MAP_EMPTY);
+    mov_load(RCX, reg(R15));
+    emit_byte(0xF3);                                // rep stosb
+    emit_byte(0xAA);
+    encode(0, false, 0x31, RDI, reg(RDI));
+    mov_load(RSI, reg(R15));
+    shl_imm(RSI, 5);
+    call_extern(X86_REALLOC);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, out_of_memory_label);
+    mov_store(memory(RBX, 16), RAX);
+    mov_store(memory(RBX, 24), R15);
+    mov_load(RAX, memory(RBX, 8));
+    mov_store(memory(RBX, 32), RAX);
+
+    // r15 is the old slot, and r8 its entry
+    encode(0, false, 0x31, R15, reg(R15));
+    bind(next);
+    alu(ALU_CMP, R15, reg(R14));
+    jump_if(CC_AE, moved);
+    mov_load(RAX, reg(R12));
+    alu(ALU_ADD, RAX, reg(R15));
+    encode(0, false, 0x0FB6, RCX, memory(RAX, 0));
+    alu_imm(ALU_CMP, reg(RCX), MAP_EMPTY);
+    jump_if(CC_AE, skip);
+    mov_load(R8, reg(R15));
+    shl_imm(R8, 5);
+    alu(ALU_ADD, R8, reg(R13));
+    mov_load(RDI, reg(RBX));
+    mov_load(RAX, memory(R8, 0));
+    call(map_slot_label);
+    mov_load(RCX, reg(R12));
+    alu(ALU_ADD, RCX, reg(R15));
+    encode(0, false, 0x0FB6, RDX, memory(RCX, 0));
+    mov_load(RCX, memory(RBX, 0));
+    alu(ALU_ADD, RCX, reg(RAX));
+    encode(0, false, 0x88, RDX, memory(RCX, 0));    // mov [rcx], dl
+    shl_imm(RAX, 5);
+    alu(ALU_ADD, RAX, memory(RBX, 16));
+    for (int32_t half = 0; half < 32; half += 16) {
+        sse(0xF3, 0x0F6F, XMM0, memory(R8, half));  // movdqu
+        sse(0xF3, 0x0F7F, XMM0, memory(RAX, half));
+    }
+    bind(skip);
+    alu_imm(ALU_ADD, reg(R15), 1);
+    jump(next);
+    bind(moved);
+    mov_load(RDI, reg(R12));
+    call_extern(X86_FREE);
+    mov_load(RDI, reg(R13));
+    call_extern(X86_FREE);
+    pop(R15);
+    pop(R14);
+    pop(R13);
+    pop(R12);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// Set the key of hash rax and rdx bytes at rsi in the map at rdi to xmm0,
+// copying the text of a new key. Rebuilds the table first when a new key
+// would fill more than 7/8 of it with keys and deleted slots.
+static void emit_map_put() {
+    const int insert = new_label();
+    const int room = new_label();
+    const int reused = new_label();
+    const int counted = new_label();
+    const int done = new_label();
+    bind(map_put_label);
+    push(RBX);
+    push(R12);
+    push(R13);
+    push(R14);
+    push(R15);
+    alu_imm(ALU_SUB, reg(RSP), 16);
+    movsd_store(memory(RSP, 0), XMM0);
+    mov_load(RBX, reg(RDI));
+    mov_load(R12, reg(RAX));
+    mov_load(R13, reg(RSI));
+    mov_load(R14, reg(RDX));
+    call(map_find_label);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, insert);
+    movsd_load(XMM0, memory(RSP, 0));
+    movsd_store(memory(RAX, 24), XMM0);
+    jump(done);
+
+    bind(insert);
+    mov_load(RAX, memory(RBX, 32));
+    alu_imm(ALU_ADD, reg(RAX), 1);
+    shl_imm(RAX, 3);
+    encode(0, true, 0x6B, RCX, memory(RBX, 24));    // imul rcx, capacity, 7
+    emit_byte(7);
+    alu(ALU_CMP, RAX, reg(RCX));
+    jump_if(CC_BE, room);
+    mov_load(RDI, reg(RBX));
+    call(map_rehash_label);
+    bind(room);
+    mov_load(RDI, reg(RBX));
+    mov_load(RAX, reg(R12));
+    call(map_slot_label);
+    mov_load(RCX, memory(RBX, 0));
+    alu(ALU_ADD, RCX, reg(RAX));
+    encode(0, false, 0x80, ALU_CMP, memory(RCX, 0));
+    emit_byte(MAP_EMPTY);
+    jump_if(CC_NE, reused);
+    alu_imm(ALU_ADD, memory(RBX, 32), 1);
+    bind(reused);
+    mov_load(RDX, reg(R12));
+    alu_imm(ALU_AND, reg(RDX), 0x7F);
+    encode(0, false, 0x88, RDX, memory(RCX, 0));    // mov [rcx], dl
+    mov_load(R15, reg(RAX));
+    shl_imm(R15, 5);
+    alu(ALU_ADD, R15, memory(RBX, 16));
+    mov_store(memory(R15, 0), R12);
+    encode(0, true, 0xC7, 0, memory(R15, 8));
+    emit32(0);
+    mov_store(memory(R15, 16), R14);
+    movsd_load(XMM0, memory(RSP, 0));
+    movsd_store(memory(R15, 24), XMM0);
+    encode(0, true, 0x85, R14, reg(R14));
+    jump_if(CC_E, counted);
+    encode(0, false, 0x31, RDI, reg(RDI));
+    mov_load(RSI, reg(R14));
+    call_extern(X86_REALLOC);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, out_of_memory_label);
+    mov_store(memory(R15, 8), RAX);
+    mov_load(RDI, reg(RAX));
+    mov_load(RSI, reg(R13));
+    mov_load(RDX, reg(R14));
+    call_extern(X86_MEMMOVE);
+    bind(counted);
+    alu_imm(ALU_ADD, memory(RBX, 8), 1);
+    bind(done);
+    alu_imm(ALU_ADD, reg(RSP), 16);
+    pop(R15);
+    pop(R14);
+    pop(R13);
+    pop(R12);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// Remove the key of hash rax and rdx bytes at rsi from the map at rdi, with 1
+// in rax if it was there, else 0. The slot becomes empty if its group still
+// has an empty slot, since no probe has passed that group; deleted otherwise.
+static void emit_map_delete() {
+    const int deleted = new_label();
+    const int counted = new_label();
+    const int done = new_label();
+    bind(map_delete_label);
+    push(RBX);
+    push(R12);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RBX, reg(RDI));
+    call(map_find_label);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, done);
+    mov_load(R12, reg(RAX));
+    mov_load(RDI, memory(RAX, 8));
+    call_extern(X86_FREE);
+    alu(ALU_SUB, R12, memory(RBX, 16));
+    shr_imm(R12, 5);
+    mov_load(R10, reg(R12));
+    alu_imm(ALU_AND, reg(R10), -16);
+    alu(ALU_ADD, R10, memory(RBX, 0));
+    mov_imm(RAX, MAP_EMPTY);
+    broadcast_byte(XMM1);
+    match_group(RDX, memory(R10, 0));
+    mov_load(RCX, memory(RBX, 0));
+    alu(ALU_ADD, RCX, reg(R12));
+    encode(0, false, 0x85, RDX, reg(RDX));
+    jump_if(CC_E, deleted);
+    encode(0, false, 0xC6, 0, memory(RCX, 0));
+    emit_byte(MAP_EMPTY);
+    alu_imm(ALU_SUB, memory(RBX, 32), 1);
+    jump(counted);
+    bind(deleted);
+    encode(0, false, 0xC6, 0, memory(RCX, 0));
+    emit_byte(MAP_DELETED);
+    bind(counted);
+    alu_imm(ALU_SUB, memory(RBX, 8), 1);
+    mov_imm(RAX, 1);
+    bind(done);
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    pop(R12);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// Empty the map at rdi, freeing the text of its keys and keeping its table
+static void emit_map_clear() {
+    const int next = new_label();
+    const int skip = new_label();
+    const int cleared = new_label();
+    bind(map_clear_label);
+    push(RBX);
+    push(R12);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RBX, reg(RDI));
+    encode(0, false, 0x31, R12, reg(R12));
+    bind(next);
+    alu(ALU_CMP, R12, memory(RBX, 24));
+    jump_if(CC_AE, cleared);
+    mov_load(RAX, memory(RBX, 0));
+    alu(ALU_ADD, RAX, reg(R12));
+    encode(0, false, 0x0FB6, RAX, memory(RAX, 0));
+    alu_imm(ALU_CMP, reg(RAX), MAP_EMPTY);
+    jump_if(CC_AE, skip);
+    mov_load(RAX, reg(R12));
+    shl_imm(RAX, 5);
+    alu(ALU_ADD, RAX, memory(RBX, 16));
+    mov_load(RDI, memory(RAX, 8));
+    call_extern(X86_FREE);
+    bind(skip);
+    alu_imm(ALU_ADD, reg(R12), 1);
+    jump(next);
+    bind(cleared);
+    mov_load(RDI, memory(RBX, 0));
+    mov_imm(RAX, MAP_EMPTY);
+    mov_load(RCX, memory(RBX, 24));
+    emit_byte(0xF3);                                // rep stosb
+    emit_byte(0xAA);
+    encode(0, false, 0x31, RAX, reg(RAX));
+    mov_store(memory(RBX, 8), RAX);
+    mov_store(memory(RBX, 32), RAX);
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    pop(R12);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// printf("%s\n") of the string at rdi, which has no buffer until it is set
+static void emit_out_string() {
+    const int print = new_label();
+    bind(out_string_label);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RSI, memory(RDI, 0));
+    encode(0, true, 0x85, RSI, reg(RSI));
+    jump_if(CC_NE, print);
+    lea(RSI, label_operand(pool_text("")));
+    bind(print);
+    lea(RDI, label_operand(pool_text("%s\n")));
+    encode(0, false, 0x31, RAX, reg(RAX));
+    call_extern(X86_PRINTF);
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    emit_byte(0xC3);
+}
+
+// Read a word of any length into the string at rdi, 255 bytes at a time, and
+// leave the string as it was at the end of input
+static void emit_in_string() {
+    const int more = new_label();
+    const int done = new_label();
+    bind(in_string_label);
+    push(RBX);
+    alu_imm(ALU_SUB, reg(RSP), 256);
+    mov_load(RBX, reg(RDI));
+    lea(RSI, memory(RSP, 0));
+    lea(RDI, label_operand(pool_text("%255s")));
+    encode(0, false, 0x31, RAX, reg(RAX));
+    call_extern(X86_SCANF);
+    encode(0, false, 0x83, ALU_CMP, reg(RAX));
+    emit_byte(1);
+    jump_if(CC_NE, done);
+    encode(0, true, 0xC7, 0, memory(RBX, 8));
+    emit32(0);
+    bind(more);
+    lea(RDI, memory(RSP, 0));
+    call_extern(X86_STRLEN);
+    mov_load(RDX, reg(RAX));
+    lea(RSI, memory(RSP, 0));
+    mov_load(RDI, reg(RBX));
+    call(append_string_label);
+    lea(RSI, memory(RSP, 0));
+    lea(RDI, label_operand(pool_text("%255[^ \t\n\v\f\r]")));
+    encode(0, false, 0x31, RAX, reg(RAX));
+    call_extern(X86_SCANF);
+    encode(0, false, 0x83, ALU_CMP, reg(RAX));
+    emit_byte(1);
+    jump_if(CC_E, more);
+    bind(done);
+    alu_imm(ALU_ADD, reg(RSP), 256);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// fwrite the rsi bytes of the view at rdi, then a newline
+static void emit_out_view() {
+    bind(out_view_label);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RDX, reg(RSI));
+    mov_imm(RSI, 1);
+    mov_load(RCX, extern_operand(X86_STDOUT));
+    mov_load(RCX, memory(RCX, 0));
+    call_extern(X86_FWRITE);
+    lea(RDI, label_operand(pool_text("\n")));
+    encode(0, false, 0x31, RAX, reg(RAX));
+    call_extern(X86_PRINTF);
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    emit_byte(0xC3);
+}
+
+// Offset in rax of the text at rdx, rcx bytes, in the text at rdi, rsi bytes,
+// from r8 clamped to the text, or -1; memmem does the searching
+static void emit_find() {
+    const int search = new_label();
+    const int missing = new_label();
+    const int done = new_label();
+    bind(find_label);
+    encode(0, false, 0x31, RAX, reg(RAX));
+    encode(0, true, 0x85, R8, reg(R8));
+    cmov(CC_L, R8, RAX);
+    alu(ALU_CMP, R8, reg(RSI));
+    cmov(CC_G, R8, RSI);
+    mov_load(RAX, reg(R8));
+    encode(0, true, 0x85, RCX, reg(RCX));
+    jump_if(CC_NE, search);
+    emit_byte(0xC3);
+    bind(search);
+    push(RBX);
+    mov_load(RBX, reg(RDI));
+    alu(ALU_ADD, RDI, reg(R8));
+    alu(ALU_SUB, RSI, reg(R8));
+    call_extern(X86_MEMMEM);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, missing);
+    alu(ALU_SUB, RAX, reg(RBX));
+    jump(done);
+    bind(missing);
+    mov_imm(RAX, -1);
+    bind(done);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// Piece r8 of the text at rdi, rsi bytes, cut at each copy of the text at rdx,
+// rcx bytes, as a view in rax and rdx. With no separator the whole text is
+// piece 0, and past the last piece the view is empty.
+static void emit_split() {
+    const int cut = new_label();
+    const int next = new_label();
+    const int last = new_label();
+    const int piece = new_label();
+    const int empty = new_label();
+    const int done = new_label();
+    bind(split_label);
+    mov_load(RAX, reg(RDI));
+    encode(0, true, 0x85, R8, reg(R8));
+    jump_if(CC_L, empty);
+    encode(0, true, 0x85, RCX, reg(RCX));
+    jump_if(CC_NE, cut);
+    mov_load(RDX, reg(RSI));
+    encode(0, true, 0x85, R8, reg(R8));
+    jump_if(CC_E, done);
+    bind(empty);
+    encode(0, false, 0x31, RDX, reg(RDX));
+    bind(done);
+    emit_byte(0xC3);
+
+    // rbx is the piece, r12 the end of the text, r13 and r14 the separator
+    // and r15 the pieces left to skip
+    bind(cut);
+    push(RBX);
+    push(R12);
+    push(R13);
+    push(R14);
+    push(R15);
+    mov_load(RBX, reg(RDI));
+    mov_load(R12, reg(RDI));
+    alu(ALU_ADD, R12, reg(RSI));
+    mov_load(R13, reg(RDX));
+    mov_load(R14, reg(RCX));
+    mov_load(R15, reg(R8));
+    bind(next);
+    mov_load(RDI, reg(RBX));
+    mov_load(RSI, reg(R12));
+    alu(ALU_SUB, RSI, reg(RBX));
+    mov_load(RDX, reg(R13));
+    mov_load(RCX, reg(R14));
+    call_extern(X86_MEMMEM);
+    encode(0, true, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, last);
+    encode(0, true, 0x85, R15, reg(R15));
+    jump_if(CC_E, piece);
+    alu_imm(ALU_SUB, reg(R15), 1);
+    mov_load(RBX, reg(RAX));
+    alu(ALU_ADD, RBX, reg(R14));
+    jump(next);
+    bind(last);
+    mov_load(RAX, reg(R12));
+    encode(0, true, 0x85, R15, reg(R15));
+    jump_if(CC_E, piece);
+    mov_load(RAX, reg(RBX));
+    bind(piece);
+    mov_load(RDX, reg(RAX));
+    alu(ALU_SUB, RDX, reg(RBX));
+    mov_load(RAX, reg(RBX));
+    pop(R15);
+    pop(R14);
+    pop(R13);
+    pop(R12);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// -1, 0 or 1 in rax as the text at rdi, rsi bytes, sorts before, with or
+// after the text at rdx, rcx bytes: memcmp of the shorter length, then the
+// lengths
+static void emit_compare() {
+    const int lengths = new_label();
+    const int sign = new_label();
+    const int done = new_label();
+    bind(compare_label);
+    push(RBX);
+    push(R12);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RBX, reg(RSI));
+    mov_load(R12, reg(RCX));
+    mov_load(RSI, reg(RDX));
+    mov_load(RDX, reg(RBX));
+    alu(ALU_CMP, RDX, reg(R12));
+    cmov(CC_A, RDX, R12);
+    encode(0, true, 0x85, RDX, reg(RDX));
+    jump_if(CC_E, lengths);
+    call_extern(X86_MEMCMP);
+    encode(0, false, 0x85, RAX, reg(RAX));
+    jump_if(CC_NE, sign);
+    bind(lengths);
+    alu(ALU_CMP, RBX, reg(R12));
+    setcc(CC_A, RCX);
+    setcc(CC_B, RAX);
+    jump(done);
+    bind(sign);
+    setcc(CC_G, RCX);
+    setcc(CC_L, RAX);
+    bind(done);
+    encode(0, false, 0x0FB6, RCX, reg(RCX));
+    movzx_al(RAX);
+    alu(ALU_SUB, RCX, reg(RAX));
+    mov_load(RAX, reg(RCX));
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    pop(R12);
+    pop(RBX);
+    emit_byte(0xC3);
+}
+
+// 1 in rax when the text at rdi, rsi bytes, is the text at rdx, rcx bytes
+static void emit_equal() {
+    const int differ = new_label();
+    const int same = new_label();
+    bind(equal_label);
+    alu(ALU_CMP, RSI, reg(RCX));
+    jump_if(CC_NE, differ);
+    encode(0, true, 0x85, RSI, reg(RSI));
+    jump_if(CC_E, same);
+    alu_imm(ALU_SUB, reg(RSP), 8);
+    mov_load(RAX, reg(RSI));
+    mov_load(RSI, reg(RDX));
+    mov_load(RDX, reg(RAX));
+    call_extern(X86_MEMCMP);
+    alu_imm(ALU_ADD, reg(RSP), 8);
+    encode(0, false, 0x85, RAX, reg(RAX));
+    jump_if(CC_E, same);
+    bind(differ);
+    encode(0, false, 0x31, RAX, reg(RAX));
+    emit_byte(0xC3);
+    bind(same);
+    mov_imm(RAX, 1);
+    emit_byte(0xC3);
+}
+
+static void emit_runtime() {
+    emit_call_with_format(out_int_label, "%ld\n", X86_PRINTF);
+    emit_out_double();
+    emit_in_double();
+    emit_out_string();
+    emit_in_string();
+    emit_append_string();
+    emit_out_view();
+    emit_find();
+    emit_split();
+    emit_compare();
+    emit_equal();
+    emit_push_array();
+    emit_set_array();
+    emit_index_error();
+    emit_hash_double();
+    emit_hash_text();
+    emit_map_find();
+    emit_map_slot();
+    emit_map_rehash();
+    emit_map_put();
+    emit_map_delete();
+    emit_map_clear();
+}
+
+// --- Driver -----------------------------------------------------------------
+
+static void resolve_labels() {
+    for (int i = 0; i < label_use_count; i++) {
+        const LabelUse use = label_uses[i];
+        patch32(use.offset, (uint32_t)(label_offsets[use.label] - (int)(use.offset + 4)));
+    }
+}
+
+X86Code x86_generate(const IrProgram* program, const char* precomputed, const size_t precomputed_length) {
+    ir = program;
+    out = (X86Code){0};
+    cfg = cfg_analyze(ir);
+    const int insts = ir->inst_count;
+    block_start = ir_allocate((size_t)ir->block_count, sizeof(int));
+    block_end = ir_allocate((size_t)ir->block_count, sizeof(int));
+    for (int b = 0; b < ir->block_count; b++) block_start[b] = block_end[b] = -1;
+    position = ir_allocate((size_t)insts, sizeof(int));
+    uses = ir_allocate((size_t)insts, sizeof(int));
+    fused = ir_allocate((size_t)insts, sizeof(bool));
+    locations = ir_allocate((size_t)insts, sizeof(Location));
+    call_positions = ir_allocate((size_t)insts, sizeof(int));
+    call_count = 0;
+    frame_slots = 0;
+    saved_count = 0;
+    memset(saved, 0, sizeof(saved));
+
+    bss_offsets = ir_allocate((size_t)ir->symbol_count, sizeof(int));
+    for (int slot = 0; slot < ir->symbol_count; slot++) {
+        if (ir->symbols[slot].type == TYPE_STRING) {
+            bss_offsets[slot] = (int)out.bss_size;
+            out.bss_size += 24;     // Text, length and capacity
+        } else if (ir->symbols[slot].type == TYPE_VIEW) {
+            bss_offsets[slot] = (int)out.bss_size;
+            out.bss_size += 16;     // Text and length
+        } else if (ir->symbols[slot].type == TYPE_INT_ARRAY || ir->symbols[slot].type == TYPE_DOUBLE_ARRAY) {
+            bss_offsets[slot] = (int)out.bss_size;
+            out.bss_size += 24;     // Elements, length and capacity
+        } else if (ir->symbols[slot].type == TYPE_DOUBLE_MAP || ir->symbols[slot].type == TYPE_STRING_MAP) {
+            bss_offsets[slot] = (int)out.bss_size;
+            out.bss_size += 40;     // Control bytes, count, entries, capacity and slots used
+        }
+    }
+
+    count_uses();
+    number_positions();
+    int count;
+    Interval* intervals = build_intervals(&count);
+    allocate_registers(intervals, count);
+    free(intervals);
+
+    // Labels 0 to block_count - 1 are the blocks
+    for (int b = 0; b < ir->block_count; b++) new_label();
+    out_int_label = new_label();
+    out_double_label = new_label();
+    in_double_label = new_label();
+    out_string_label = new_label();
+    in_string_label = new_label();
+    set_string_label = new_label();
+    append_string_label = new_label();
+    out_view_label = new_label();
+    split_label = new_label();
+    find_label = new_label();
+    compare_label = new_label();
+    equal_label = new_label();
+    push_array_label = new_label();
+    set_array_label = new_label();
+    index_error_label = new_label();
+    out_of_memory_label = new_label();
+    hash_double_label = new_label();
+    hash_text_label = new_label();
+    map_find_label = new_label();
+    map_slot_label = new_label();
+    map_rehash_label = new_label();
+    map_put_label = new_label();
+    map_delete_label = new_label();
+    map_clear_label = new_label();
+
+    emit_prologue(precomputed, precomputed_length);
+    for (int i = 0; i < cfg.order_count; i++) {
+        const int b = cfg.order[i];
+        bind(b);
+        for (int id = ir->blocks[b].first; id >= 0; id = ir->insts[id].next) {
+            generate_instruction(id);
+        }
+        generate_terminator(b, i + 1 < cfg.order_count ? cfg.order[i + 1] : -1);
+    }
+    out.main_size = out.length;
+    emit_runtime();
+    emit_pool();
+    resolve_labels();
+
+    for (int i = 0; i < pool_string_count; i++) {
+        if (pool_strings[i].owned) free(pool_strings[i].text);
+    }
+    free(pool_strings);
+    free(pool_doubles);
+    free(label_offsets);
+    free(label_uses);
+    free(block_start);
+    free(block_end);
+    free(position);
+    free(uses);
+    free(fused);
+    free(locations);
+    free(call_positions);
+    free(bss_offsets);
+    cfg_free(&cfg);
+    pool_strings = nullptr;
+    pool_doubles = nullptr;
+    label_offsets = nullptr;
+    label_uses = nullptr;
+    pool_string_count = pool_string_capacity = pool_double_count = pool_double_capacity = 0;
+    label_count = label_capacity = label_use_count = label_use_capacity = 0;
+    sign_mask = abs_mask = -1;
+    ir = nullptr;
+    return out;
+}
+
+const char* x86_extern_name(const X86Extern symbol) {
+    switch (symbol) {
+        case X86_PRINTF: return "printf";
+        case X86_SCANF: return "scanf";
+        case X86_FWRITE: return "fwrite";
+        case X86_REALLOC: return "realloc";
+        case X86_FREE: return "free";
+        case X86_MEMMOVE: return "memmove";
+        case X86_MEMMEM: return "memmem";
+        case X86_MEMCMP: return "memcmp";
+        case X86_STRLEN: return "strlen";
+        case X86_EXIT: return "exit";
+        case X86_FPRINTF: return "fprintf";
+        case X86_FFLUSH: return "fflush";
+        case X86_STDOUT: return "stdout";
+        case X86_STDERR: return "stderr";
+        default: return "";
+    }
+}
+
+void x86_free(X86Code* code) {
+    free(code->code);
+    free(code->relocs);
+    *code = (X86Code){0};
+}
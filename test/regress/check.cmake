@@ -0,0 +1,29 @@
+# Run one regression program in one mode and compare its output with the
+# expected file: cmake -DSILC=... -DPROGRAM=<name>.slc -DMODE=... -DWORK_DIR=... -P check.cmake
+string(REGEX REPLACE "\\.slc$" "" base "${PROGRAM}")
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+set(input "${base}.in")
+if(NOT EXISTS "${input}")
+    set(input "${WORK_DIR}/empty.in")
+    file(WRITE "${input}" "")
+endif()
+
+separate_arguments(flags UNIX_COMMAND "${MODE}")
+if(MODE MATCHES "--interp")
+    execute_process(COMMAND "${SILC}" ${flags} "${PROGRAM}" INPUT_FILE "${input}" WORKING_DIRECTORY "${WORK_DIR}"
+            OUTPUT_VARIABLE output ERROR_VARIABLE errors RESULT_VARIABLE status)
+else()
+    execute_process(COMMAND "${SILC}" ${flags} "${PROGRAM}" "${WORK_DIR}/program" WORKING_DIRECTORY "${WORK_DIR}"
+            OUTPUT_VARIABLE compile_output ERROR_VARIABLE errors RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "Compiling with ${MODE} failed:\n${compile_output}${errors}")
+    endif()
+    execute_process(COMMAND "${WORK_DIR}/program" INPUT_FILE "${input}" WORKING_DIRECTORY "${WORK_DIR}"
+            OUTPUT_VARIABLE output ERROR_VARIABLE errors RESULT_VARIABLE status)
+endif()
+
+file(READ "${base}.expected" expected)
+if(NOT status EQUAL 0 OR NOT output STREQUAL expected)
+    message(FATAL_ERROR "${MODE} exited with ${status} and printed:\n${output}${errors}\nexpected:\n${expected}")
+endif()